@@ -2,6 +2,7 @@ from fastapi import FastAPI, WebSocket, WebSocketDisconnect
 from typing import List, Dict, Any
 import json
 import asyncio
+from collections import deque
 from pydantic import BaseModel
 
 # 创建一个WebSocket连接管理器
@@ -42,6 +43,13 @@ class ConnectionManager:
 # 创建连接管理器实例
 manager = ConnectionManager()
 
+# 最近一次录音的质量统计，由send_audio_stats更新
+last_audio_stats: Dict[str, Any] = {}
+
+# 声级计每秒的摘要，保留最近一小时，由send_slm更新
+SLM_HISTORY_SECONDS = 3600
+slm_history: deque = deque(maxlen=SLM_HISTORY_SECONDS)
+
 # 数据模型
 class AudioTextResponse(BaseModel):
     text: str
@@ -97,6 +105,17 @@ def init_api(app: FastAPI):
         await manager.send_json({"text": response.text})
         return {"text": response.text, "message": "Audio transcription completed"}
 
+    @app.get("/api/audio/stats")
+    async def audio_stats():
+        """最近一次录音的质量统计 API"""
+        return {"stats": last_audio_stats}
+
+    @app.get("/api/slm")
+    async def slm(seconds: int = 60):
+        """最近seconds秒的声级计摘要 API"""
+        history = list(slm_history)[-seconds:] if seconds > 0 else []
+        return {"slm": history}
+
 # 提供直接调用的函数，用于从UDP服务器发送数据到WebSocket客户端
 async def send_trend_rising():
     await manager.send_json({"number": 3})
@@ -115,3 +134,12 @@ async def send_control_invalid():
 
 async def send_audio_text(text: str):
     await manager.send_json({"text": text})
+
+async def send_audio_stats(stats: Dict[str, Any]):
+    global last_audio_stats
+    last_audio_stats = stats
+    await manager.send_json({"stats": stats})
+
+async def send_slm(summary: Dict[str, Any]):
+    slm_history.append(summary)
+    await manager.send_json({"slm": summary})
@@ -0,0 +1,237 @@
+#!/usr/bin/python
+"""将量化(int8)的TensorFlow Lite唤醒词模型导出为设备端的 audio_kws_model.c
+
+支持的算子：CONV_2D、DEPTHWISE_CONV_2D(深度乘数1)、AVERAGE_POOL_2D、
+FULLY_CONNECTED，RESHAPE 会被跳过，最后的 SOFTMAX 由设备以浮点计算。
+模型输入为 49x10 的MFCC(与设备 audio_mfcc 相同的特征)，训练时特征单位为
+log2能量，即设备输出的 Q8 值除以 256；其他单位用 --feature-scale 指定。
+
+用法：
+    python kws_export.py model.tflite --labels silence,unknown,hey_psoc \\
+        --keyword hey_psoc -o ../source/audio_kws_model.c
+
+依赖：pip install tflite numpy
+"""
+
+import argparse
+import math
+
+import numpy as np
+import tflite
+
+SKIPPED_OPS = (tflite.BuiltinOperator.RESHAPE, tflite.BuiltinOperator.SOFTMAX)
+
+
+def quantize_multiplier(value):
+    """将实数乘数拆成Q31乘数和2的幂次移位，与TensorFlow Lite相同"""
+    if value == 0.0:
+        return 0, 0
+    mantissa, exponent = math.frexp(value)
+    multiplier = int(round(mantissa * (1 << 31)))
+    if multiplier == (1 << 31):
+        multiplier //= 2
+        exponent += 1
+    return multiplier, exponent
+
+
+def tensor_info(model, graph, index):
+    tensor = graph.Tensors(index)
+    quant = tensor.Quantization()
+    scale = quant.ScaleAsNumpy() if quant is not None and quant.ScaleLength() else np.array([1.0])
+    zero_point = quant.ZeroPointAsNumpy() if quant is not None and quant.ZeroPointLength() else np.array([0])
+    data = model.Buffers(tensor.Buffer()).DataAsNumpy()
+    return {
+        'shape': [int(d) for d in tensor.ShapeAsNumpy()],
+        'scale': np.atleast_1d(scale).astype(np.float64),
+        'zero_point': int(np.atleast_1d(zero_point)[0]),
+        'data': data if isinstance(data, np.ndarray) else None,
+    }
+
+
+def activation_range(activation, output):
+    zero_point, scale = output['zero_point'], float(output['scale'][0])
+    if activation == tflite.ActivationFunctionType.RELU:
+        return max(-128, zero_point), 127
+    if activation == tflite.ActivationFunctionType.RELU6:
+        return max(-128, zero_point), min(127, zero_point + int(round(6.0 / scale)))
+    if activation != tflite.ActivationFunctionType.NONE:
+        raise ValueError(f'不支持的激活函数 {activation}')
+    return -128, 127
+
+
+def padding(mode, size, kernel, stride):
+    if mode == tflite.Padding.VALID:
+        return 0
+    out = (size + stride - 1) // stride
+    return max((out - 1) * stride + kernel - size, 0) // 2
+
+
+def nhwc(shape):
+    """将张量形状补成(H, W, C)"""
+    shape = shape[1:] if len(shape) == 4 else shape
+    while len(shape) < 3:
+        shape = [1] + shape
+    return shape
+
+
+def export_layer(model, graph, op, code):
+    inputs = [op.Inputs(i) for i in range(op.InputsLength())]
+    tensor_in = tensor_info(model, graph, inputs[0])
+    tensor_out = tensor_info(model, graph, op.Outputs(0))
+    in_h, in_w, in_c = nhwc(tensor_in['shape'])
+    out_h, out_w, out_c = nhwc(tensor_out['shape'])
+    table = op.BuiltinOptions()
+
+    layer = {
+        'in': (in_h, in_w, in_c), 'out': (out_h, out_w, out_c),
+        'kernel': (1, 1), 'stride': (1, 1), 'pad': (0, 0),
+        'input_offset': -tensor_in['zero_point'], 'output_offset': tensor_out['zero_point'],
+        'weights': None, 'bias': None, 'multiplier': None, 'shift': None,
+    }
+
+    if code == tflite.BuiltinOperator.AVERAGE_POOL_2D:
+        options = tflite.Pool2DOptions()
+        options.Init(table.Bytes, table.Pos)
+        layer['type'] = 'AUDIO_KWS_LAYER_AVG_POOL'
+        layer['kernel'] = (options.FilterHeight(), options.FilterWidth())
+        layer['stride'] = (options.StrideH(), options.StrideW())
+        layer['pad'] = (padding(options.Padding(), in_h, options.FilterHeight(), options.StrideH()),
+                        padding(options.Padding(), in_w, options.FilterWidth(), options.StrideW()))
+        layer['act'] = activation_range(options.FusedActivationFunction(), tensor_out)
+        return layer
+
+    weights = tensor_info(model, graph, inputs[1])
+    bias = tensor_info(model, graph, inputs[2]) if len(inputs) > 2 and inputs[2] >= 0 else None
+    w_shape = weights['shape']
+
+    if code == tflite.BuiltinOperator.CONV_2D:
+        options = tflite.Conv2DOptions()
+        layer['type'] = 'AUDIO_KWS_LAYER_CONV'
+    elif code == tflite.BuiltinOperator.DEPTHWISE_CONV_2D:
+        options = tflite.DepthwiseConv2DOptions()
+        layer['type'] = 'AUDIO_KWS_LAYER_DEPTHWISE'
+    else:
+        options = tflite.FullyConnectedOptions()
+        layer['type'] = 'AUDIO_KWS_LAYER_FULLY_CONNECTED'
+        layer['in'] = (1, 1, in_h * in_w * in_c)
+        layer['out'] = (1, 1, out_c)
+    options.Init(table.Bytes, table.Pos)
+
+    if code == tflite.BuiltinOperator.DEPTHWISE_CONV_2D and options.DepthMultiplier() != 1:
+        raise ValueError('深度卷积只支持深度乘数1')
+
+    if code != tflite.BuiltinOperator.FULLY_CONNECTED:
+        kernel_h, kernel_w = w_shape[1], w_shape[2]
+        layer['kernel'] = (kernel_h, kernel_w)
+        layer['stride'] = (options.StrideH(), options.StrideW())
+        layer['pad'] = (padding(options.Padding(), in_h, kernel_h, options.StrideH()),
+                        padding(options.Padding(), in_w, kernel_w, options.StrideW()))
+
+    channels = layer['out'][2]
+    w_scale = np.resize(weights['scale'], channels)
+    in_scale, out_scale = float(tensor_in['scale'][0]), float(tensor_out['scale'][0])
+    quantized = [quantize_multiplier(in_scale * float(s) / out_scale) for s in w_scale]
+
+    layer['weights'] = weights['data'].view(np.int8)
+    layer['bias'] = bias['data'].view(np.int32) if bias is not None else np.zeros(channels, np.int32)
+    layer['multiplier'] = [m for m, _ in quantized]
+    layer['shift'] = [s for _, s in quantized]
+    layer['act'] = activation_range(options.FusedActivationFunction(), tensor_out)
+    return layer
+
+
+def c_array(ctype, name, values):
+    values = [int(v) for v in values]
+    lines = []
+    for i in range(0, len(values), 16):
+        lines.append('    ' + ', '.join(str(v) for v in values[i:i + 16]) + ',')
+    return f'static const {ctype} {name}[{len(values)}] =\n{{\n' + '\n'.join(lines) + '\n};\n'
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('model', help='量化的 .tflite 模型')
+    parser.add_argument('--labels', required=True, help='以逗号分隔的输出标签')
+    parser.add_argument('--keyword', required=True, help='唤醒词的标签')
+    parser.add_argument('--feature-scale', type=float, default=1.0 / 256.0,
+                        help='设备MFCC(Q8)到训练特征单位的比例')
+    parser.add_argument('-o', '--output', default='audio_kws_model.c')
+    args = parser.parse_args()
+
+    labels = args.labels.split(',')
+    model = tflite.Model.GetRootAsModel(open(args.model, 'rb').read(), 0)
+    graph = model.Subgraphs(0)
+
+    layers = []
+    for i in range(graph.OperatorsLength()):
+        op = graph.Operators(i)
+        opcode = model.OperatorCodes(op.OpcodeIndex())
+        code = max(opcode.BuiltinCode(), opcode.DeprecatedBuiltinCode())
+        if code in SKIPPED_OPS:
+            continue
+        if code not in (tflite.BuiltinOperator.CONV_2D, tflite.BuiltinOperator.DEPTHWISE_CONV_2D,
+                        tflite.BuiltinOperator.AVERAGE_POOL_2D, tflite.BuiltinOperator.FULLY_CONNECTED):
+            raise ValueError(f'不支持的算子 {code}')
+        layers.append(export_layer(model, graph, op, code))
+        last_op = op
+
+    model_in = tensor_info(model, graph, graph.Inputs(0))
+    model_out = tensor_info(model, graph, last_op.Outputs(0))
+    input_multiplier, input_shift = quantize_multiplier(args.feature_scale / float(model_in['scale'][0]))
+
+    out = ['/' + '*' * 78,
+           '* File Name:   audio_kws_model.c',
+           '*',
+           '* Description: This file contains the network of the wake word detector.',
+           f'* Generated by python/kws_export.py from {args.model.split("/")[-1]}, do not edit.',
+           '*',
+           '*' * 79 + '/',
+           '',
+           '#include "audio_kws.h"',
+           '']
+    for i, layer in enumerate(layers):
+        if layer['weights'] is None:
+            continue
+        out.append(c_array('int8_t', f'layer{i}_weights', layer['weights']))
+        out.append(c_array('int32_t', f'layer{i}_bias', layer['bias']))
+        out.append(c_array('int32_t', f'layer{i}_multiplier', layer['multiplier']))
+        out.append(c_array('int8_t', f'layer{i}_shift', layer['shift']))
+
+    out.append(f'static const audio_kws_layer_t layers[{len(layers)}] =\n{{')
+    for i, layer in enumerate(layers):
+        has_weights = layer['weights'] is not None
+        out.append('    {')
+        out.append(f"        .type = {layer['type']},")
+        out.append('        .in_h = {}, .in_w = {}, .in_c = {},'.format(*layer['in']))
+        out.append('        .out_h = {}, .out_w = {}, .out_c = {},'.format(*layer['out']))
+        out.append('        .kernel_h = {}, .kernel_w = {},'.format(*layer['kernel']))
+        out.append('        .stride_h = {}, .stride_w = {},'.format(*layer['stride']))
+        out.append('        .pad_h = {}, .pad_w = {},'.format(*layer['pad']))
+        out.append(f"        .input_offset = {layer['input_offset']}, .output_offset = {layer['output_offset']},")
+        out.append('        .act_min = {}, .act_max = {},'.format(*layer['act']))
+        if has_weights:
+            out.append(f'        .weights = layer{i}_weights, .bias = layer{i}_bias,')
+            out.append(f'        .multiplier = layer{i}_multiplier, .shift = layer{i}_shift,')
+        out.append('    },')
+    out.append('};\n')
+
+    out.append('const audio_kws_model_t audio_kws_model =\n{')
+    out.append('    .layers = layers,')
+    out.append(f'    .num_layers = {len(layers)},')
+    out.append(f'    .input_multiplier = {input_multiplier},')
+    out.append(f'    .input_shift = {input_shift},')
+    out.append(f"    .input_zero_point = {model_in['zero_point']},")
+    out.append(f"    .output_zero_point = {model_out['zero_point']},")
+    out.append(f"    .output_scale = {float(model_out['scale'][0]):.9g}f,")
+    out.append(f'    .num_labels = {len(labels)},')
+    out.append(f'    .keyword_index = {labels.index(args.keyword)},')
+    out.append(f'    .keyword = "{args.keyword}",')
+    out.append('};')
+
+    with open(args.output, 'w') as f:
+        f.write('\n'.join(out) + '\n')
+    print(f'已导出 {len(layers)} 层到 {args.output}')
+
+
+if __name__ == '__main__':
+    main()
@@ -13,6 +13,22 @@ init_api(app)
 async def root():
     return {"message": "嵌入式项目服务器已启动"}
 
+# 选择客户端之后的录音上传log-mel特征(features)还是音频(audio)
+@app.get("/api/audio/upload/{mode}")
+async def audio_upload_mode(mode: str):
+    if mode not in ("features", "audio"):
+        return {"status": "error", "message": "mode 必须为 features 或 audio"}
+    udp.request_features(mode == "features")
+    return {"status": "success", "mode": mode}
+
+# 选择客户端的采集配置：narrowband(8 kHz上传)、wideband(16 kHz)或fullband(48 kHz)
+@app.get("/api/audio/profile/{name}")
+async def audio_profile(name: str):
+    if name not in udp.PROFILES:
+        return {"status": "error", "message": "name 必须为 " + "、".join(udp.PROFILES)}
+    udp.request_profile(udp.PROFILES[name])
+    return {"status": "success", "profile": name}
+
 # 在 FastAPI 应用程序启动时启动 UDP 服务器
 @app.on_event("startup")
 async def startup_event():
@@ -10,9 +10,14 @@ import requests
 import socket
 import optparse
 import time
-import wave
 import os
+import sys
 import asyncio
+import array
+import struct
+import math
+import zlib
+from collections import deque, namedtuple
 from datetime import datetime
 
 # 导入API模块
@@ -26,10 +31,54 @@ CHANNELS = 1                # 单声道
 SAMPLE_WIDTH = 2           # 2字节 = 16位
 FRAMERATE = 16000          # 采样率，常见值: 8000, 16000, 44100, 48000
 
-# 结束标志位 - 当收到这个标志时表示数据传输结束
-START_FLAG = b'aaaa'       # 对应客户端发送的音频开始标志
-END_FLAG = b'flag'         # 对应客户端发送的音频结束标志
+# 上传数据包头，格式见parse_packet
+PACKET_MAGIC = b'AU'
+PACKET_HEADER = struct.Struct('<2sBBHHII') # 魔数、编码、标志、会话、序号、偏移、CRC32
+PACKET_CRC_OFFSET = 12     # CRC32覆盖包头前12字节和负载
+PACKET_FLAG_START = 0x01   # 开始包，负载为采样率(uint32，小端)，特征流为频带数，之后为FEC块的数据包数和校验包数(各uint8)、
+                           # 每个数据包的音频字节数(uint16)
+PACKET_FLAG_END = 0x02     # 结束包，负载为采样数(uint32，小端)，序号为最后一个包的序号
+PACKET_FLAG_STATS = 0x04   # 结束包之前的录音质量统计，格式见parse_stats
+PACKET_FLAG_RETRANSMIT = 0x08  # 客户端按NACK重传的包
+PACKET_FLAG_NACK = 0x10    # 发给客户端：负载为缺少序号的位图，第i位(字节i/8的低位在前)对应包头序号+i
+PACKET_FLAG_ACK = 0x20     # 发给客户端：会话已结束，包头序号为结束包的序号
+PACKET_FLAG_PARITY = 0x40  # FEC校验包：包头序号为块的第一个序号，偏移为校验序号|块的包数<<8|校验包数<<16
+PACKET_FLAG_PROBE = 0x80   # 路径MTU探测包，负载为填充；以ACK|PROBE确认，偏移为探测包的负载长度
+STATS_SIZE = 16            # 统计包负载长度
+
+# 重传：NACK检查间隔、同一序号两次NACK的最小间隔(秒)、每个NACK包最多覆盖的序号数
+NACK_INTERVAL = 0.05
+NACK_RETRY = 0.2
+NACK_MAX_SEQS = 512
+UPLOAD_TIMEOUT = 5.0       # 超过此时间没有收到数据包时放弃重传，保存收到的部分
+FINISHED_SESSIONS = 8      # 记住最近完成的会话，对重发的结束包再次确认
+
+# 前向纠错：块发送完后等待校验包恢复丢包的时间(秒)，之后才NACK块中缺少的包
+FEC_WAIT = 0.05
+FEC_SYMBOL_PREFIX = struct.Struct('<HBI')  # 校验符号的前缀：负载长度、标志、偏移
+
+# 上传的编码，对应客户端的audio_codec_t
+CODEC_PCM16 = 0
+CODEC_IMA_ADPCM = 1
+CODEC_LOG_MEL = 2
+
 START_WITH_FLAG = b'C'     # 对应客户端发送的slider标志
+CLIP_WARN_RATIO = 0.001    # 削波采样超过此比例时警告
+SLM_FLAG = b'SL'           # 对应客户端每秒发送的声级计摘要
+SLM_SIZE = 10              # 摘要长度，格式见parse_slm
+LOW_LEVEL_DBFS = -40.0     # RMS低于此电平时警告
+
+# 发给客户端的命令：之后的录音上传特征或音频
+FEATURE_CMD = b'feat'
+AUDIO_CMD = b'wave'
+# 切换采集配置的命令，后跟配置编号的数字，对应客户端的audio_profile_id_t
+PROFILE_CMD = b'prf'
+PROFILES = {'narrowband': 0, 'wideband': 1, 'fullband': 2}
+
+# 是否请求客户端上传log-mel特征，由request_features设置
+features_requested = False
+# 请求客户端使用的采集配置编号，None表示不请求，由request_profile设置
+profile_requested = None
 
 # 特殊数字
 START_NUM = 200
@@ -129,14 +178,535 @@ def audio2text(file_path, language='cn', appid='d66588e7', secret_key='43ba88218
         print(f"转写异常: {str(e)}")
         return "None"
 
-def save_as_wav(buffer, filename, channels=CHANNELS, sample_width=SAMPLE_WIDTH, framerate=FRAMERATE):
-    """将缓冲区数据保存为WAV文件"""
-    with wave.open(filename, 'wb') as wav_file:
-        wav_file.setnchannels(channels)           # 设置通道数
-        wav_file.setsampwidth(sample_width)       # 设置采样宽度
-        wav_file.setframerate(framerate)          # 设置帧率/采样率
-        wav_file.writeframes(buffer)              # 写入音频数据
-    return os.path.abspath(filename)
+# IMA-ADPCM 解码表
+IMA_INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8,
+                   -1, -1, -1, -1, 2, 4, 6, 8]
+
+IMA_STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767]
+
+ADPCM_HEADER_SIZE = 4
+
+
+def decode_ima_adpcm(block):
+    """将一个IMA-ADPCM数据包解码为16位PCM
+
+    数据包以4字节头开始：预测值(int16，小端)、步长索引(uint8)、保留字节，
+    之后每个字节包含两个4位编码，低半字节在前。
+    """
+    if len(block) < ADPCM_HEADER_SIZE:
+        return b''
+
+    predictor, index = struct.unpack_from('<hB', block, 0)
+    index = min(index, 88)
+    pcm = array.array('h')
+
+    for byte in block[ADPCM_HEADER_SIZE:]:
+        for code in (byte & 0x0F, byte >> 4):
+            step = IMA_STEP_TABLE[index]
+            vpdiff = step >> 3
+            if code & 4:
+                vpdiff += step
+            if code & 2:
+                vpdiff += step >> 1
+            if code & 1:
+                vpdiff += step >> 2
+            if code & 8:
+                predictor = max(-32768, predictor - vpdiff)
+            else:
+                predictor = min(32767, predictor + vpdiff)
+            index = min(88, max(0, index + IMA_INDEX_TABLE[code]))
+            pcm.append(predictor)
+
+    if sys.byteorder != 'little':
+        pcm.byteswap()
+    return pcm.tobytes()
+
+
+def gf_tables():
+    """返回GF(256)的指数表和对数表，多项式0x11D，与客户端的audio_fec.c相同"""
+    exp = [0] * 510
+    log = [0] * 256
+    x = 1
+    for i in range(255):
+        exp[i] = exp[i + 255] = x
+        log[x] = i
+        x <<= 1
+        if x & 0x100:
+            x ^= 0x11D
+    return exp, log
+
+
+GF_EXP, GF_LOG = gf_tables()
+
+
+def gf_mul(a, b):
+    return GF_EXP[GF_LOG[a] + GF_LOG[b]] if a and b else 0
+
+
+def gf_inv(a):
+    return GF_EXP[255 - GF_LOG[a]]
+
+
+# GF_MUL_TABLES[c]为乘以c的bytes.translate表
+GF_MUL_TABLES = [bytes(gf_mul(c, x) for x in range(256)) for c in range(256)]
+
+
+def fec_coefficient(parity, index):
+    """第parity个校验包中第index个数据包的系数：按列缩放使第一行全为1的Cauchy矩阵"""
+    return gf_mul(gf_inv((255 - parity) ^ index), 255 ^ index)
+
+
+def fec_solve(rows, rhs):
+    """在GF(256)上用高斯-约当消元解rows * x = rhs，rhs的每项为等长的bytes，返回x"""
+    rows = [list(row) for row in rows]
+    rhs = list(rhs)
+    for col in range(len(rows)):
+        pivot = next(r for r in range(col, len(rows)) if rows[r][col])
+        rows[col], rows[pivot] = rows[pivot], rows[col]
+        rhs[col], rhs[pivot] = rhs[pivot], rhs[col]
+        inv = gf_inv(rows[col][col])
+        rows[col] = [gf_mul(inv, a) for a in rows[col]]
+        rhs[col] = rhs[col].translate(GF_MUL_TABLES[inv])
+        pivot_value = int.from_bytes(rhs[col], 'little')
+        for r in range(len(rows)):
+            factor = rows[r][col]
+            if r != col and factor:
+                rows[r] = [a ^ gf_mul(factor, b) for a, b in zip(rows[r], rows[col])]
+                scaled = int.from_bytes(rhs[col].translate(GF_MUL_TABLES[factor]), 'little')
+                rhs[r] = (int.from_bytes(rhs[r], 'little') ^ scaled).to_bytes(len(rhs[r]), 'little')
+    return rhs
+
+
+Packet = namedtuple('Packet', 'codec flags session seq offset payload')
+
+
+def is_packet(data):
+    """是否为上传数据包"""
+    return len(data) >= PACKET_HEADER.size and data[:len(PACKET_MAGIC)] == PACKET_MAGIC
+
+
+def parse_packet(data):
+    """解析上传数据包，返回Packet，CRC32校验失败时返回None
+
+    包头16字节，小端：魔数'AU'、编码(uint8)、标志(uint8)、会话(uint16)、
+    序号(uint16)、负载在上传中的偏移(uint32，以采样为单位，特征流为特征值)、
+    CRC32(与zlib.crc32相同，覆盖包头前12字节和负载)。
+    """
+    _, codec, flags, session, seq, offset, crc = PACKET_HEADER.unpack_from(data)
+    payload = data[PACKET_HEADER.size:]
+    if zlib.crc32(payload, zlib.crc32(data[:PACKET_CRC_OFFSET])) != crc:
+        return None
+    return Packet(codec, flags, session, seq, offset, payload)
+
+
+def build_packet(codec, flags, session, seq, offset, payload):
+    """构造上传数据包，与客户端的audio_packet_encode相同，用于测试"""
+    header = PACKET_HEADER.pack(PACKET_MAGIC, codec, flags, session, seq, offset, 0)
+    crc = zlib.crc32(payload, zlib.crc32(header[:PACKET_CRC_OFFSET]))
+    return header[:PACKET_CRC_OFFSET] + struct.pack('<I', crc) + payload
+
+
+def request_features(enable):
+    """请求客户端之后的录音上传log-mel特征(True)或音频(False)
+
+    命令在收到客户端的下一个数据包时发出，从客户端的下一次录音开始生效。
+    """
+    global features_requested
+    features_requested = enable
+
+
+def request_profile(profile):
+    """请求客户端切换到采集配置profile(PROFILES中的编号)
+
+    命令在收到客户端的下一个数据包时发出，客户端在当前录音结束后切换。
+    """
+    global profile_requested
+    profile_requested = profile
+
+
+def level_dbfs(value):
+    """将16位采样单位的电平换算为dBFS"""
+    return 20.0 * math.log10(value / 32768.0) if value > 0 else float('-inf')
+
+
+def parse_stats(data):
+    """解析录音质量统计包，返回统计字典
+
+    统计包负载为小端字段：帧数(uint32)、RMS(uint16)、峰值(uint16)、
+    削波采样数(uint32)、直流偏移(int16)、噪声底RMS(uint16)，电平以16位采样为单位。
+    """
+    frames, rms, peak, clipped, dc, noise = struct.unpack_from('<IHHIhH', data)
+    return {
+        'frames': frames,
+        'rms': rms,
+        'rms_dbfs': round(level_dbfs(rms), 1),
+        'peak': peak,
+        'peak_dbfs': round(level_dbfs(peak), 1),
+        'clipped': clipped,
+        'dc': dc,
+        'noise_floor': noise,
+        'noise_floor_dbfs': round(level_dbfs(noise), 1),
+        'snr_db': round(level_dbfs(rms) - level_dbfs(noise), 1) if rms > 0 and noise > 0 else None,
+    }
+
+
+def parse_slm(data):
+    """解析声级计摘要，返回摘要字典
+
+    摘要为'SL'后跟小端uint16字段：周期序号、LAeq、LAFmax、LAFmin，声级单位0.01 dB。
+    """
+    period, laeq, lafmax, lafmin = struct.unpack_from('<HHHH', data, len(SLM_FLAG))
+    return {
+        'period': period,
+        'time': datetime.now().isoformat(timespec='seconds'),
+        'laeq': laeq / 100.0,
+        'lafmax': lafmax / 100.0,
+        'lafmin': lafmin / 100.0,
+    }
+
+
+def print_stats(stats, sample_rate):
+    """打印录音质量统计，削波或电平过低时给出警告"""
+    print(f"音频质量：RMS {stats['rms_dbfs']} dBFS，峰值 {stats['peak_dbfs']} dBFS，"
+          f"噪声底 {stats['noise_floor_dbfs']} dBFS，直流偏移 {stats['dc']}，削波 {stats['clipped']} 个采样")
+
+    samples = stats['frames'] * sample_rate // 100     # 每帧10 ms
+    if samples > 0 and stats['clipped'] > samples * CLIP_WARN_RATIO:
+        print(f"警告：削波采样占 {stats['clipped'] * 100.0 / samples:.2f}%，请降低增益")
+    if stats['rms'] > 0 and stats['rms_dbfs'] < LOW_LEVEL_DBFS:
+        print("警告：录音电平过低")
+
+
+WAV_HEADER_SIZE = 44
+
+
+class Upload:
+    """一次上传的接收与重组
+
+    音频包按偏移写入WAV文件，丢失的部分为静音，因此乱序和重复的包不影响录音；
+    特征按偏移缓存，结束时按顺序写入CSV。缺少的序号由nacks列出，客户端重传后补上，
+    开始包丢失时采样率等信息也由重传的开始包补上。同时按序号统计丢包、重复和乱序。
+
+    启用前向纠错时，每块的数据包以校验符号(前缀FEC_SYMBOL_PREFIX加负载)保留到块收齐，
+    块中丢失的包不多于收到的校验包时由recover直接恢复；块发送完FEC_WAIT秒后仍缺少的包才NACK。
+    """
+
+    def __init__(self, packet, addr):
+        self.session = packet.session
+        self.codec = packet.codec
+        self.addr = addr
+        self.sample_rate = FRAMERATE   # 特征流的特征提取固定为FRAMERATE
+        self.bands = 0
+        self.stats = None
+        self.end = None            # 结束包
+        self.seqs = set()          # 收到的序号
+        self.last_seq = 0
+        self.duplicates = 0
+        self.reordered = 0
+        self.crc_errors = 0
+        self.retransmitted = 0     # 收到的重传包
+        self.nacked = {}           # 序号 -> 最后一次NACK的时间
+        self.spans = []            # 收到的(偏移, 采样数)，特征流为特征值数
+        self.extent = 0            # 收到的最大偏移
+        self.features = {}         # 偏移 -> 特征数据包负载
+        self.chunk_size = None     # 每个数据包的音频字节数，由开始包给出
+        self.fec_data = None       # FEC块的数据包数，0为未启用，None为开始包尚未收到
+        self.symbols = {}          # 序号 -> 校验符号，块收齐或恢复后删除
+        self.parities = {}         # 块的第一个序号 -> (块的包数, {校验序号: 负载})
+        self.block_sent = {}       # 块的第一个序号 -> 确认块已发送完的时间
+        self.next_block = 0        # 尚未确认发送完的第一个块
+        self.parity_packets = 0    # 收到的校验包
+        self.fec_recovered = 0     # 由校验包恢复的数据包
+        self.started = time.monotonic()
+        self.last_time = self.started
+
+        timestamp = datetime.now().strftime("%Y%m%d_%H%M%S")
+        if self.codec == CODEC_LOG_MEL:
+            self.path = os.path.abspath(f"features_{timestamp}.csv")
+            self.file = None
+        else:
+            self.path = os.path.abspath(f"audio_{timestamp}.wav")
+            self.file = open(self.path, 'wb+')
+            self.file.write(bytes(WAV_HEADER_SIZE))
+
+    def add(self, packet, recovered=False):
+        """加入一个数据包，重复的包返回False，recovered为由校验包恢复的包"""
+        if packet.flags & PACKET_FLAG_PARITY:
+            return self.add_parity(packet)
+        if packet.seq in self.seqs:
+            self.duplicates += 1
+            return False
+        self.last_time = time.monotonic()
+        if recovered:
+            self.fec_recovered += 1
+        elif packet.seq < self.last_seq:
+            self.reordered += 1
+        if packet.flags & PACKET_FLAG_RETRANSMIT:
+            self.retransmitted += 1
+        self.seqs.add(packet.seq)
+        self.nacked.pop(packet.seq, None)
+        self.last_seq = max(self.last_seq, packet.seq)
+
+        if packet.flags & PACKET_FLAG_START:
+            value = struct.unpack_from('<I', packet.payload)[0] if len(packet.payload) >= 4 else FRAMERATE
+            if self.codec == CODEC_LOG_MEL:
+                self.bands = value
+            else:
+                self.sample_rate = value
+            self.fec_data = packet.payload[4] if len(packet.payload) >= 6 else 0
+            if len(packet.payload) >= 8:
+                self.chunk_size = struct.unpack_from('<H', packet.payload, 6)[0]
+            if not self.fec_data:
+                self.symbols.clear()
+        elif packet.flags & PACKET_FLAG_STATS:
+            if len(packet.payload) == STATS_SIZE:
+                self.stats = parse_stats(packet.payload)
+        elif packet.flags & PACKET_FLAG_END:
+            self.end = packet
+        else:
+            self.write(packet.offset, packet.payload)
+
+        if self.fec_data != 0 and not recovered:
+            self.symbols[packet.seq] = FEC_SYMBOL_PREFIX.pack(len(packet.payload),
+                                                              packet.flags & ~PACKET_FLAG_RETRANSMIT,
+                                                              packet.offset) + packet.payload
+            if self.fec_data:
+                # 块的最后一个包之后就是校验包，结束包之后所有的块都已发送
+                last = self.end.seq + self.fec_data - 1 if self.end is not None else self.last_seq
+                while self.next_block + self.fec_data - 1 <= last:
+                    self.block_sent.setdefault(self.next_block, self.last_time)
+                    self.next_block += self.fec_data
+                self.recover(packet.seq - packet.seq % self.fec_data)
+        return True
+
+    def add_parity(self, packet):
+        """加入一个校验包，恢复其块中丢失的数据包，重复或无效的包返回False"""
+        index = packet.offset & 0xFF
+        count = (packet.offset >> 8) & 0xFF
+        parities = (packet.offset >> 16) & 0xFF
+        if count == 0 or index >= parities or len(packet.payload) < FEC_SYMBOL_PREFIX.size:
+            return False
+
+        count, received = self.parities.get(packet.seq, (count, {}))
+        if index in received:
+            self.duplicates += 1
+            return False
+        self.last_time = time.monotonic()
+        self.parity_packets += 1
+        self.block_sent.setdefault(packet.seq, self.last_time)
+        if all(packet.seq + i in self.seqs for i in range(count)):
+            return True     # 块已收齐或已恢复
+
+        received[index] = packet.payload
+        self.parities[packet.seq] = (count, received)
+        self.recover(packet.seq)
+        return True
+
+    def recover(self, base):
+        """用校验包恢复一个块中丢失的数据包，块收齐后释放其校验符号"""
+        if base not in self.parities:
+            return
+        count, received = self.parities[base]
+        lost = [i for i in range(count) if base + i not in self.seqs]
+        if not lost:
+            del self.parities[base]
+            for i in range(count):
+                self.symbols.pop(base + i, None)
+            return
+        if len(lost) > len(received) or any(base + i not in self.symbols for i in range(count) if i not in lost):
+            return
+
+        length = len(next(iter(received.values())))
+        rows = []
+        rhs = []
+        for index in sorted(received)[:len(lost)]:
+            parity = received[index]
+            if len(parity) != length:
+                return
+            value = int.from_bytes(parity, 'little')
+            for i in range(count):
+                if i not in lost:
+                    symbol = self.symbols[base + i]
+                    if len(symbol) > length:
+                        return
+                    symbol = symbol.ljust(length, b'\0').translate(GF_MUL_TABLES[fec_coefficient(index, i)])
+                    value ^= int.from_bytes(symbol, 'little')
+            rows.append([fec_coefficient(index, i) for i in lost])
+            rhs.append(value.to_bytes(length, 'little'))
+
+        del self.parities[base]
+        for i in range(count):
+            self.symbols.pop(base + i, None)
+        for i, symbol in zip(lost, fec_solve(rows, rhs)):
+            size, flags, offset = FEC_SYMBOL_PREFIX.unpack_from(symbol)
+            if size <= length - FEC_SYMBOL_PREFIX.size:
+                payload = symbol[FEC_SYMBOL_PREFIX.size:FEC_SYMBOL_PREFIX.size + size]
+                self.add(Packet(self.codec, flags, self.session, base + i, offset, payload), recovered=True)
+
+    def fec_pending(self, seq, now):
+        """缺少的包是否还可能由其块的校验包恢复"""
+        if not self.fec_data:
+            return False
+        return now - self.block_sent.get(seq - seq % self.fec_data, now) < FEC_WAIT
+
+    def write(self, offset, payload):
+        """将一个数据包的负载写到偏移处"""
+        if self.codec == CODEC_LOG_MEL:
+            # 开始包可能尚未收到，频带数未知，结束时再按帧拆分
+            self.features[offset] = payload
+            count = len(payload) // SAMPLE_WIDTH
+        else:
+            pcm = decode_ima_adpcm(payload) if self.codec == CODEC_IMA_ADPCM else payload
+            self.file.seek(WAV_HEADER_SIZE + offset * SAMPLE_WIDTH)
+            self.file.write(pcm)
+            count = len(pcm) // SAMPLE_WIDTH
+        self.spans.append((offset, count))
+        self.extent = max(self.extent, offset + count)
+
+    def missing(self):
+        """返回缺少的序号：结束包之前，未收到结束包时为收到的最大序号之前"""
+        last = self.end.seq if self.end is not None else self.last_seq
+        return [seq for seq in range(last + 1) if seq not in self.seqs]
+
+    def complete(self):
+        """是否已收到结束包及之前的所有数据包"""
+        return self.end is not None and len(self.seqs) == self.end.seq + 1
+
+    def nacks(self, now):
+        """返回需要发出的NACK数据包，同一序号每NACK_RETRY秒最多请求一次"""
+        due = [seq for seq in self.missing()
+               if now - self.nacked.get(seq, 0.0) >= NACK_RETRY and not self.fec_pending(seq, now)]
+        for seq in due:
+            self.nacked[seq] = now
+        return build_nacks(self.codec, self.session, due)
+
+    def close(self):
+        """保存文件，返回传输统计，未收到数据时删除文件并返回None"""
+        end = self.end
+        total = struct.unpack_from('<I', end.payload)[0] if end is not None else self.extent
+        expected = (end.seq if end is not None else self.last_seq) + 1
+
+        if self.codec == CODEC_LOG_MEL:
+            if self.features and self.bands > 0:
+                with open(self.path, 'w') as feature_file:
+                    for offset in sorted(self.features):
+                        values = array.array('h')
+                        payload = self.features[offset]
+                        values.frombytes(payload[:len(payload) - len(payload) % (self.bands * SAMPLE_WIDTH)])
+                        if sys.byteorder != 'little':
+                            values.byteswap()
+                        for i in range(0, len(values), self.bands):
+                            if offset + i < total:
+                                feature_file.write(','.join(str(v) for v in values[i:i + self.bands]) + '\n')
+        else:
+            # IMA-ADPCM的最后一个包可能多解码半个字节，按采样数截断，缺失的部分补零
+            self.file.truncate(WAV_HEADER_SIZE + total * SAMPLE_WIDTH)
+            self.file.seek(0)
+            self.file.write(wav_header(total, self.sample_rate))
+            self.file.close()
+
+        if not self.spans or (self.codec == CODEC_LOG_MEL and self.bands == 0):
+            if os.path.exists(self.path):
+                os.remove(self.path)
+            return None
+
+        return {
+            'session': self.session,
+            'packets': len(self.seqs),
+            'packets_expected': expected,
+            'packets_lost': expected - len(self.seqs),
+            'chunk_size': self.chunk_size,
+            'retransmitted': self.retransmitted,
+            'parity_packets': self.parity_packets,
+            'fec_recovered': self.fec_recovered,
+            'duplicates': self.duplicates,
+            'reordered': self.reordered,
+            'crc_errors': self.crc_errors,
+            'end_received': end is not None,
+            'samples': total,
+            'samples_missing': total - sum(max(0, min(offset + count, total) - offset)
+                                           for offset, count in self.spans),
+            'duration': round(time.monotonic() - self.started, 3),
+        }
+
+
+def build_nacks(codec, session, seqs):
+    """将缺少的序号编为NACK数据包，每包的位图从包头序号起最多覆盖NACK_MAX_SEQS个序号"""
+    packets = []
+    i = 0
+    while i < len(seqs):
+        base = seqs[i]
+        bitmap = bytearray()
+        while i < len(seqs) and seqs[i] - base < NACK_MAX_SEQS:
+            bit = seqs[i] - base
+            bitmap.extend(bytes(bit // 8 + 1 - len(bitmap)))
+            bitmap[bit // 8] |= 1 << (bit % 8)
+            i += 1
+        packets.append(build_packet(codec, PACKET_FLAG_NACK, session, base, 0, bytes(bitmap)))
+    return packets
+
+
+def wav_header(samples, sample_rate, channels=CHANNELS, sample_width=SAMPLE_WIDTH):
+    """返回PCM WAV文件的44字节文件头"""
+    data_size = samples * channels * sample_width
+    return struct.pack('<4sI4s4sIHHIIHH4sI', b'RIFF', 36 + data_size, b'WAVE', b'fmt ', 16, 1, channels,
+                       sample_rate, sample_rate * channels * sample_width, channels * sample_width,
+                       sample_width * 8, b'data', data_size)
+
+
+def finish_upload(upload, loop, note=""):
+    """保存一次上传，打印传输和质量统计，发送到API，音频交给语音识别"""
+    transport = upload.close()
+    if transport is None:
+        print("缓冲区已重置，等待新的音频流")
+        return
+
+    if upload.codec == CODEC_LOG_MEL:
+        frames = transport['samples'] // max(upload.bands, 1)
+        print(f"\n特征文件已保存{note}: {upload.path}")
+        print(f"共 {frames} 帧({frames * 0.01:.2f} 秒)")
+    else:
+        print(f"\n音频文件已保存{note}: {upload.path}")
+        print(f"共 {transport['samples']} 个采样({transport['samples'] / upload.sample_rate:.2f} 秒)")
+    print_transport(transport)
+
+    if upload.stats is not None:
+        upload.stats['file'] = upload.path
+        upload.stats['transport'] = transport
+        print_stats(upload.stats, upload.sample_rate)
+        asyncio.create_task(api.send_audio_stats(upload.stats))
+
+    if upload.codec != CODEC_LOG_MEL:
+        asyncio.create_task(transcribe(upload.path, loop))
+
+
+async def transcribe(path, loop):
+    """语音识别一个录音文件，结果发送到API"""
+    text = await loop.run_in_executor(None, audio2text, path)
+    print(f"语音识别返回：{text}")
+    asyncio.create_task(api.send_audio_text(text))
+
+
+def print_transport(transport):
+    """打印一次上传的传输统计，有丢包时给出警告"""
+    print(f"传输统计：会话 {transport['session']}，收到 {transport['packets']}/{transport['packets_expected']} 个数据包"
+          f"(重传 {transport['retransmitted']}，FEC恢复 {transport['fec_recovered']}，"
+          f"校验包 {transport['parity_packets']})，重复 {transport['duplicates']}，乱序 {transport['reordered']}，"
+          f"校验错误 {transport['crc_errors']}，用时 {transport['duration']} 秒" +
+          (f"，每包 {transport['chunk_size']} 字节" if transport['chunk_size'] else ""))
+    if not transport['end_received']:
+        print("警告：未收到结束包")
+    if transport['packets_lost'] > 0 or transport['samples_missing'] > 0:
+        print(f"警告：丢失 {transport['packets_lost']} 个数据包，缺失 {transport['samples_missing']} 个采样")
 
 
 async def echo_server(host, port):
@@ -151,12 +721,11 @@ async def echo_server(host, port):
     print('等待接收来自UDP客户端的消息...')
 
     # 初始化变量
-    buffer = bytearray()           # 用于保存所有接收到的音频数据
-    client_addr = None             # 客户端地址
-    packets_received = 0           # 收到的数据包数量
-    recording = False              # 是否正在录制音频
-    last_packet_time = None        # 最后一个数据包的时间
-    audio_started = False          # 是否已收到音频开始标志
+    upload = None                  # 正在接收的上传
+    finished = deque(maxlen=FINISHED_SESSIONS)  # 最近完成或放弃的上传的会话
+    last_tick = time.monotonic()   # 上次检查重传和超时的时间
+    features_sent = False          # 最后发给客户端的命令是否为FEATURE_CMD
+    profile_sent = None            # 最后发给客户端的采集配置编号
     # txt_filename = "control_data.txt"  # 控制数据保存的文件名
 
     # 新增控制数据监测相关变量
@@ -169,7 +738,49 @@ async def echo_server(host, port):
     try:
         while True:
             try:
-                data, addr = await loop.sock_recvfrom(sock, 225000)
+                try:
+                    data, addr = await asyncio.wait_for(loop.sock_recvfrom(sock, 225000), NACK_INTERVAL)
+                except asyncio.TimeoutError:
+                    data = None
+
+                # 请求重传缺少的数据包，长时间没有数据时放弃
+                now = time.monotonic()
+                if upload is not None and now - last_tick >= NACK_INTERVAL:
+                    last_tick = now
+                    if now - upload.last_time >= UPLOAD_TIMEOUT:
+                        finished.append(upload.session)
+                        finish_upload(upload, loop, "(重传超时)")
+                        upload = None
+                    else:
+                        for nack in upload.nacks(now):
+                            sock.sendto(nack, upload.addr)
+
+                if data is None:
+                    continue
+
+                # 上传内容的请求有变化时通知客户端
+                if features_requested != features_sent:
+                    sock.sendto(FEATURE_CMD if features_requested else AUDIO_CMD, addr)
+                    features_sent = features_requested
+
+                # 请求的采集配置有变化时通知客户端
+                if profile_requested is not None and profile_requested != profile_sent:
+                    sock.sendto(PROFILE_CMD + str(profile_requested).encode('ascii'), addr)
+                    profile_sent = profile_requested
+
+                # 客户端对切换采集配置命令的回复：PROFILE_CMD后跟当前配置编号的数字
+                if data[:len(PROFILE_CMD)] == PROFILE_CMD and len(data) == len(PROFILE_CMD) + 1:
+                    active = data[len(PROFILE_CMD)] - ord('0')
+                    if profile_requested is not None and active != profile_requested:
+                        print(f"客户端未能切换到采集配置 {profile_requested}，当前配置 {active}")
+                    else:
+                        print(f"客户端当前采集配置 {active}")
+                    continue
+
+                # 检查是否是声级计摘要
+                if data[:len(SLM_FLAG)] == SLM_FLAG and len(data) == SLM_SIZE:
+                    asyncio.create_task(api.send_slm(parse_slm(data)))
+                    continue
 
                 # 检查是否是控制数据 (以b'C'开头)
                 if data.startswith(b'C'):
@@ -239,50 +850,59 @@ async def echo_server(host, port):
                         asyncio.create_task(api.send_control_invalid())
                         continue
 
-                # 检查是否是音频开始标志
-                if data == START_FLAG:
-                    # 如果是新客户端或之前有录制，先保存之前的音频
-                    if recording and len(buffer) > 0:
-                        timestamp = datetime.now().strftime("%Y%m%d_%H%M%S")
-                        filename = f"audio_{timestamp}.wav"
-                        filepath = save_as_wav(buffer, filename)
-                        print(f"\n音频文件已保存: {filepath}")
-                        print(f"接收到 {packets_received} 个数据包，总大小: {len(buffer)} 字节")
-
-                    # 重置录制状态
-                    buffer = bytearray()
-                    recording = True
-                    audio_started = True
-                    client_addr = addr
-                    packets_received = 0
-                    print(f"\n开始从 {addr[0]}:{addr[1]} 接收新的音频流")
+                if not is_packet(data):
+                    continue
+
+                packet = parse_packet(data)
+                if packet is None:
+                    if upload is not None:
+                        upload.crc_errors += 1
                     continue
 
-                # 检查是否是音频结束标志
-                if data == END_FLAG:
-                    if recording and len(buffer) > 0:
-                        timestamp = datetime.now().strftime("%Y%m%d_%H%M%S")
-                        filename = f"audio_{timestamp}.wav"
-                        filepath = save_as_wav(buffer, filename)
-                        print(f"\n收到结束标志，音频文件已保存: {filepath}")
-                        print(f"接收到 {packets_received} 个数据包，总大小: {len(buffer)} 字节")
-
-                        text = await loop.run_in_executor(None, audio2text, filepath)
-                        print(f"语音识别返回：{text}")
-                        asyncio.create_task(api.send_audio_text(text))
-
-                    # 重置状态
-                    buffer = bytearray()
-                    packets_received = 0
-                    audio_started = False
-                    recording = False
-                    print(f"缓冲区已重置，等待新的音频流")
+                # 路径MTU探测包：收到即说明此大小的数据包能到达，确认其负载长度
+                # 探测包的序号自成一个序列，不属于上传的数据包，不参与NACK与FEC
+                if packet.flags & PACKET_FLAG_PROBE:
+                    sock.sendto(build_packet(packet.codec, PACKET_FLAG_ACK | PACKET_FLAG_PROBE, packet.session,
+                                             packet.seq, len(packet.payload), b''), addr)
                     continue
 
-                # 如果是音频数据且已经开始录制
-                elif recording and audio_started:
-                    buffer.extend(data)
-                    packets_received += 1
+                # 已结束的会话：确认可能丢失，客户端重发了结束包；放弃的会话也确认，客户端停止重传
+                if packet.session in finished:
+                    if packet.flags & PACKET_FLAG_END:
+                        sock.sendto(build_packet(packet.codec, PACKET_FLAG_ACK, packet.session, packet.seq, 0, b''),
+                                    addr)
+                    continue
+
+                # 新的会话：开始包，或开始包丢失时之后的任一数据包
+                if upload is None or upload.session != packet.session:
+                    newer = upload is None or 0 < (packet.session - upload.session) % 65536 < 32768
+                    if not (packet.flags & PACKET_FLAG_START or newer):
+                        continue    # 之前上传的迟到包
+
+                    # 如果之前的录音没有收到结束包，先保存之前的录音
+                    if upload is not None:
+                        finished.append(upload.session)
+                        finish_upload(upload, loop, "(未收到结束包)")
+
+                    upload = Upload(packet, addr)
+
+                    # 客户端没有按请求的内容上传时重发命令
+                    if (upload.codec == CODEC_LOG_MEL) != features_requested:
+                        sock.sendto(FEATURE_CMD if features_requested else AUDIO_CMD, addr)
+
+                    print(f"\n开始从 {addr[0]}:{addr[1]} 接收新的" +
+                          ("特征流" if upload.codec == CODEC_LOG_MEL else "音频流") +
+                          ("(IMA-ADPCM)" if upload.codec == CODEC_IMA_ADPCM else "") + f"，会话 {upload.session}")
+
+                upload.add(packet)
+
+                # 收到所有数据包后确认并保存
+                if upload.complete():
+                    sock.sendto(build_packet(upload.codec, PACKET_FLAG_ACK, upload.session, upload.end.seq, 0, b''),
+                                upload.addr)
+                    finished.append(upload.session)
+                    finish_upload(upload, loop)
+                    upload = None
 
             except BlockingIOError:
                 await asyncio.sleep(0.001)  # 短暂休眠，释放控制权
@@ -296,14 +916,13 @@ async def echo_server(host, port):
     except KeyboardInterrupt:
         print("\n用户中断, 正在退出...")
         # 保存最后的录音
-        if len(buffer) > 0:
-            timestamp = datetime.now().strftime("%Y%m%d_%H%M%S")
-            filename = f"audio_{timestamp}.wav"
-            filepath = save_as_wav(buffer, filename)
-            print(f"最终音频文件已保存: {filepath}")
-            print(f"共接收 {packets_received} 个数据包，总大小: {len(buffer)} 字节")
+        if upload is not None:
+            finish_upload(upload, loop, "(服务器退出)")
+            upload = None
     except Exception as e:
         print(f"发生错误: {e}")
     finally:
+        if upload is not None:
+            upload.close()
         sock.close()
         print("UDP服务器已关闭")
\ No newline at end of file
@@ -58,6 +58,7 @@
 #include "app_hw_device.h"
 
 #include "led_task.h"
+#include "button.h"
 #ifdef ENABLE_BT_SPY_LOG
 #include "cybt_debug_uart.h"
 #endif
@@ -69,14 +70,11 @@
 #define APP_BTN_PRESS_SHORT_MAX        (250)
 #define APP_BTN_PRESS_5S               (5000)
 #define APP_BTN_PRESS_10S              (10000)
-#define APP_TIMEOUT_MS_BTN             (1)
 #define APP_TIMEOUT_LED_INDICATE       (500)
 #define APP_TIMEOUT_LED_BLINK          (250)
 
 #define MAXIMUM_LED_BLINK_COUNT        (11)
 
-/* Interrupt priority for GPIO connected to button */
-#define GPIO_INTERRUPT_PRIORITY         (4)
 /* Stack size for Hello Sensor BTN task */
 #define BTN_TASK_STACK_SIZE             (512u)
 /* Task Priority of Hello Sensor BTN Task */
@@ -96,10 +94,13 @@ TimerHandle_t timer_led_blink;
 /* This timer is used to toggle LED to indicate the 10 sec button press duration */
 TimerHandle_t ms_timer_led_indicate;
 
-/* ms_timer_btn is a periodic timer that ticks every millisecond.
- * This timer is used to measure the duration of button press events */
+/* ms_timer_btn is a one shot timer started on a button press. It expires
+ * when the button has been held for APP_BTN_PRESS_5S */
 TimerHandle_t ms_timer_btn;
 
+/* Debounced events of the user button */
+static QueueHandle_t btn_event_q;
+
 /* Variables to hold the timer count values */
 uint8_t led_blink_count;
 
@@ -115,16 +116,6 @@ static bool is_btn_pressed;
 /* To check if the device has entered pairing mode to connect and bond with a new device */
 bool pairing_mode = FALSE;
 
-/* The time stamp at which button is pressed */
-static uint32_t btn_press_start;
-
-/* For button press interrupt */
-cyhal_gpio_callback_data_t btn_cb_data =
-{
-    .callback     = app_bt_gpio_interrupt_handler,
-    .callback_arg = NULL
-};
-
 /**
  * Function Name: app_bt_led_blink
  *
@@ -153,9 +144,8 @@ void app_bt_led_blink(uint8_t num_of_blinks)
  * Function Name: app_bt_timeout_ms_btn
  *
  * Function Description:
- *   @brief The function invoked on timeout of FreeRTOS millisecond timer. It is
- *          used to print logs over the serial terminal every 10 seconds and to
- *          keep store time elapsed required to calculate button press duration.
+ *   @brief The function invoked when the button has been held for
+ *          APP_BTN_PRESS_5S. It starts the LED indication of the long press.
  *
  *   @param Timerhandle_t timer_handle: unused
  *
@@ -165,8 +155,7 @@ void app_bt_led_blink(uint8_t num_of_blinks)
 void app_bt_timeout_ms_btn(TimerHandle_t timer_handle)
 {
     led_command_data_t led_cmd_data;
-    hello_sensor_state.timer_count_ms++;
-    if(APP_BTN_PRESS_5S == (hello_sensor_state.timer_count_ms - btn_press_start) && (is_btn_pressed))
+    if(is_btn_pressed)
     {
         /* Start LED blink indicate for 5 more seconds */
         // cyhal_gpio_write(CYBSP_USER_LED2 , CYBSP_LED_STATE_ON);
@@ -249,8 +238,8 @@ void app_bt_timeout_led_blink(TimerHandle_t timer_handle)
  * Function Name: app_bt_interrupt_config
  *
  * Function Description:
- *   @brief This function initializes a pin as input that triggers interrupt on
- *   falling edges.
+ *   @brief This function subscribes the button task to the debounced events
+ *   of the user button.
  *
  *   @param None
  *
@@ -259,47 +248,8 @@ void app_bt_timeout_led_blink(TimerHandle_t timer_handle)
  */
 void app_bt_interrupt_config(void)
 {
-    cy_rslt_t result=0;
-
-    /* Initialize the user button */
-    result = cyhal_gpio_init(CYBSP_USER_BTN,
-                             CYHAL_GPIO_DIR_INPUT,
-                             CYHAL_GPIO_DRIVE_PULLUP,
-                             CYBSP_BTN_OFF);
-    /* Configure GPIO interrupt */
-    cyhal_gpio_register_callback(CYBSP_USER_BTN, &btn_cb_data);
-
-    cyhal_gpio_enable_event(CYBSP_USER_BTN,
-                            CYHAL_GPIO_IRQ_BOTH,
-                            GPIO_INTERRUPT_PRIORITY,
-                            true);
-    UNUSED_VARIABLE(result);
-}
-
-/**
- * Function Name: app_bt_gpio_interrupt_handler
- *
- * Function Description:
- *   @brief GPIO interrupt handler.
- *
- *   @param void *handler_arg (unused)
- *   @param cyhal_gpio_irq_event_t (unused)
- *
- *   @return None
- *
- */
-void app_bt_gpio_interrupt_handler(void *handler_arg, cyhal_gpio_event_t event)
-{
-     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-     if(CYHAL_GPIO_IRQ_FALL == event)
-     {
-         xTimerStartFromISR(ms_timer_btn, &xHigherPriorityTaskWoken);
-     }
-     if((CYHAL_GPIO_IRQ_RISE == event) || (CYHAL_GPIO_IRQ_FALL == event))
-     {
-          vTaskNotifyGiveFromISR(button_handle, &xHigherPriorityTaskWoken);
-          portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
-     }
+    btn_event_q = xQueueCreate(BUTTON_EVENT_QUEUE_LENGTH, sizeof(button_event_t));
+    button_subscribe(btn_event_q);
 }
 
 /**
@@ -321,14 +271,12 @@ void app_bt_hw_init()
     // cyhal_gpio_init(CYBSP_USER_LED2 , CYHAL_GPIO_DIR_OUTPUT,
     //                 CYHAL_GPIO_DRIVE_STRONG, CYBSP_LED_STATE_OFF);
 
-    /* Starting a log print timer for button press duration
-     * and application traces  */
+    /* Create a one shot timer for the 5 seconds button press indication */
     ms_timer_btn = xTimerCreate("ms_timer",
-                            pdMS_TO_TICKS(APP_TIMEOUT_MS_BTN),
-                            pdTRUE,
+                            pdMS_TO_TICKS(APP_BTN_PRESS_5S),
+                            pdFALSE,
                             NULL,
                             app_bt_timeout_ms_btn);
-    xTimerStart(ms_timer_btn, 0);
 
     /* Starting a 1ms timer for indication LED used to show button press duration */
     ms_timer_led_indicate = xTimerCreate("ms_timer_led_indicate",
@@ -369,25 +317,26 @@ void button_task(void *arg)
     cy_rslt_t rslt = CY_RSLT_SUCCESS;
     wiced_result_t result;
     led_command_data_t led_cmd_data;
+    button_event_t btn_event;
 
     for (;;)
     {
-        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-        if(CYBSP_BTN_PRESSED == cyhal_gpio_read(CYBSP_USER_BTN))
+        xQueueReceive(btn_event_q, &btn_event, portMAX_DELAY);
+        if(0 != (btn_event.events & BUTTON_EVT_PRESS))
         {
             is_btn_pressed = TRUE;
-            btn_press_start = hello_sensor_state.timer_count_ms;
+            xTimerStart(ms_timer_btn, 0);
             // cyhal_gpio_write(CYBSP_USER_LED2 , CYBSP_LED_STATE_ON);
             led_cmd_data.command = LED_TURN_ON;
             xQueueSendToBack(led_command_data_q, &led_cmd_data, 0u);
         }
-        else if(0 != btn_press_start)
+        if(0 != (btn_event.events & BUTTON_EVT_RELEASE))
         {
             is_btn_pressed = FALSE;
             // cyhal_gpio_write(CYBSP_USER_LED2 , CYBSP_LED_STATE_OFF);
             led_cmd_data.command = LED_TURN_ON;
             xQueueSendToBack(led_command_data_q, &led_cmd_data, 0u);
-            btn_press_duration = hello_sensor_state.timer_count_ms - btn_press_start;
+            btn_press_duration = btn_event.held_ms;
 
             /* Check if button press is short */
             if((btn_press_duration > APP_BTN_PRESS_SHORT_MIN) &&
@@ -503,7 +452,7 @@ void button_task(void *arg)
                            "Can't reset bonding information\n");
                 }
             }
-            /* Stop the ms_timer_btn, start it again when button interrupt is detected */
+            /* Stop the ms_timer_btn, start it again on the next button press */
             xTimerStop(ms_timer_btn, 0);
         }
     }
@@ -59,8 +59,6 @@ void app_bt_timeout_ms(TimerHandle_t timer_handle);
 void app_bt_timeout_led_indicate(TimerHandle_t timer_handle);
 void app_bt_timeout_led_blink(TimerHandle_t timer_handle);
 void app_bt_interrupt_config(void);
-void app_bt_gpio_interrupt_handler(void *handler_arg,
-                                   cyhal_gpio_event_t event);
 void app_bt_hw_init();
 void button_task(void *arg);
 
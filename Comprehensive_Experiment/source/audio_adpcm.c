@@ -0,0 +1,171 @@
+/******************************************************************************
+* File Name:   audio_adpcm.c
+*
+* Description: This file contains the IMA-ADPCM encoder of the audio uplink.
+*
+* The quantizer is the standard IMA one (the same codes as the reference
+* implementation), written without data dependent branches: each of the
+* three magnitude comparisons produces an all-ones or all-zeros mask that
+* selects the code bit, the residual update and the reconstruction update.
+* Two samples are encoded per loop iteration into one output byte, directly
+* in the caller's buffer.
+*
+*******************************************************************************/
+
+#include "audio_adpcm.h"
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static const int8_t index_table[16] =
+{
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const int16_t step_table[89] =
+{
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+/*******************************************************************************
+* Function Name: encode_sample
+********************************************************************************
+* Summary:
+*  Quantizes one sample to a 4-bit code and advances the encoder state.
+*
+*******************************************************************************/
+static inline uint32_t encode_sample(int32_t *predictor, int32_t *step_index, int32_t sample)
+{
+    int32_t step = step_table[*step_index];
+    int32_t diff = sample - *predictor;
+    int32_t sign = diff >> 31;                  /* 0 or -1 */
+    int32_t vpdiff = step >> 3;
+    int32_t mask;
+    uint32_t code;
+
+    diff = (diff ^ sign) - sign;
+
+    mask = ~((diff - step) >> 31);              /* -1 if diff >= step */
+    code = (uint32_t)(mask & 4);
+    diff -= step & mask;
+    vpdiff += step & mask;
+    step >>= 1;
+
+    mask = ~((diff - step) >> 31);
+    code |= (uint32_t)(mask & 2);
+    diff -= step & mask;
+    vpdiff += step & mask;
+    step >>= 1;
+
+    mask = ~((diff - step) >> 31);
+    code |= (uint32_t)(mask & 1);
+    vpdiff += step & mask;
+
+    code |= (uint32_t)(sign & 8);
+
+    int32_t pred = *predictor + ((vpdiff ^ sign) - sign);
+    pred = (pred > INT16_MAX) ? INT16_MAX : pred;
+    pred = (pred < INT16_MIN) ? INT16_MIN : pred;
+    *predictor = pred;
+
+    int32_t index = *step_index + index_table[code];
+    index = (index < 0) ? 0 : index;
+    index = (index > 88) ? 88 : index;
+    *step_index = index;
+
+    return code;
+}
+
+/*******************************************************************************
+* Function Name: audio_adpcm_init
+********************************************************************************
+* Summary:
+*  Initializes the encoder state.
+*
+* Parameters:
+*  state: Encoder state
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_adpcm_init(audio_adpcm_state_t *state)
+{
+    state->predictor = 0;
+    state->step_index = 0;
+}
+
+/*******************************************************************************
+* Function Name: audio_adpcm_write_header
+********************************************************************************
+* Summary:
+*  Writes the header of a new block, the decoder starts from this state.
+*
+* Parameters:
+*  state: Encoder state
+*  out: Buffer of at least AUDIO_ADPCM_HEADER_SIZE bytes
+*
+* Return:
+*  uint32_t: Number of bytes written, AUDIO_ADPCM_HEADER_SIZE
+*
+*******************************************************************************/
+uint32_t audio_adpcm_write_header(const audio_adpcm_state_t *state, uint8_t *out)
+{
+    out[0] = (uint8_t)(state->predictor & 0xFF);
+    out[1] = (uint8_t)((state->predictor >> 8) & 0xFF);
+    out[2] = (uint8_t)state->step_index;
+    out[3] = 0;
+
+    return AUDIO_ADPCM_HEADER_SIZE;
+}
+
+/*******************************************************************************
+* Function Name: audio_adpcm_encode
+********************************************************************************
+* Summary:
+*  Encodes samples into (num_samples + 1) / 2 bytes. If num_samples is odd
+*  the high nibble of the last byte is zero, so only the last call of a
+*  block may pass an odd count.
+*
+* Parameters:
+*  state: Encoder state
+*  samples: PCM samples
+*  num_samples: Number of samples
+*  out: Output buffer
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_adpcm_encode(audio_adpcm_state_t *state, const int16_t *samples,
+                        uint32_t num_samples, uint8_t *out)
+{
+    int32_t predictor = state->predictor;
+    int32_t step_index = state->step_index;
+    uint32_t i;
+
+    for (i = 0; (i + 1u) < num_samples; i += 2u)
+    {
+        uint32_t lo = encode_sample(&predictor, &step_index, samples[i]);
+        uint32_t hi = encode_sample(&predictor, &step_index, samples[i + 1u]);
+
+        *out++ = (uint8_t)(lo | (hi << 4));
+    }
+
+    if (i < num_samples)
+    {
+        *out = (uint8_t)encode_sample(&predictor, &step_index, samples[i]);
+    }
+
+    state->predictor = predictor;
+    state->step_index = step_index;
+}
@@ -0,0 +1,45 @@
+/******************************************************************************
+* File Name:   audio_adpcm.h
+*
+* Description: This file contains the IMA-ADPCM encoder of the audio uplink.
+* It compresses 16-bit PCM 4:1 into 4-bit codes, two samples per byte with
+* the first sample in the low nibble.
+*
+* An encoded block starts with a AUDIO_ADPCM_HEADER_SIZE byte header holding
+* the encoder state (predictor, little endian, and step index), so every
+* block can be decoded on its own and a lost block does not corrupt the
+* following ones.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_ADPCM_H_
+#define AUDIO_ADPCM_H_
+
+#include <stdint.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Size of the block header in bytes */
+#define AUDIO_ADPCM_HEADER_SIZE             (4u)
+/* Number of samples encoded into 'bytes' bytes of block payload */
+#define AUDIO_ADPCM_SAMPLES_IN_BYTES(bytes) ((bytes) * 2u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    int32_t predictor;              /* Last reconstructed sample */
+    int32_t step_index;             /* Index into the step size table, 0..88 */
+} audio_adpcm_state_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void audio_adpcm_init(audio_adpcm_state_t *state);
+uint32_t audio_adpcm_write_header(const audio_adpcm_state_t *state, uint8_t *out);
+void audio_adpcm_encode(audio_adpcm_state_t *state, const int16_t *samples,
+                        uint32_t num_samples, uint8_t *out);
+
+#endif /* AUDIO_ADPCM_H_ */
@@ -0,0 +1,81 @@
+/******************************************************************************
+* File Name:   audio_arena.c
+*
+* Description: This file contains the bump allocator over a static buffer.
+*
+*******************************************************************************/
+
+#include "audio_arena.h"
+
+/*******************************************************************************
+* Function Name: audio_arena_init
+********************************************************************************
+* Summary:
+*  Initializes an empty arena over a buffer.
+*
+* Parameters:
+*  arena: Arena
+*  buffer: Memory of the arena, AUDIO_ARENA_ALIGN aligned
+*  size: Size of the buffer in bytes
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_arena_init(audio_arena_t *arena, void *buffer, size_t size)
+{
+    arena->base = (uint8_t *)buffer;
+    arena->size = size;
+    arena->used = 0;
+    arena->peak = 0;
+}
+
+/*******************************************************************************
+* Function Name: audio_arena_alloc
+********************************************************************************
+* Summary:
+*  Allocates memory from the arena.
+*
+* Parameters:
+*  arena: Arena
+*  size: Size in bytes
+*
+* Return:
+*  void*: AUDIO_ARENA_ALIGN aligned memory, NULL if the arena is exhausted
+*
+*******************************************************************************/
+void *audio_arena_alloc(audio_arena_t *arena, size_t size)
+{
+    size_t offset = (arena->used + (AUDIO_ARENA_ALIGN - 1u)) & ~(size_t)(AUDIO_ARENA_ALIGN - 1u);
+
+    if ((offset > arena->size) || (size > (arena->size - offset)))
+    {
+        return NULL;
+    }
+
+    arena->used = offset + size;
+    if (arena->used > arena->peak)
+    {
+        arena->peak = arena->used;
+    }
+
+    return &arena->base[offset];
+}
+
+/*******************************************************************************
+* Function Name: audio_arena_reset
+********************************************************************************
+* Summary:
+*  Releases all allocations of the arena.
+*
+* Parameters:
+*  arena: Arena
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_arena_reset(audio_arena_t *arena)
+{
+    arena->used = 0;
+}
@@ -0,0 +1,39 @@
+/******************************************************************************
+* File Name:   audio_arena.h
+*
+* Description: This file contains a bump allocator over a static buffer, for
+* working memory that must not come from the FreeRTOS heap. Allocations are
+* AUDIO_ARENA_ALIGN aligned and are only released all together.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_ARENA_H_
+#define AUDIO_ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define AUDIO_ARENA_ALIGN                   (8u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    uint8_t *base;
+    size_t   size;
+    size_t   used;
+    size_t   peak;                  /* Largest 'used' since init */
+} audio_arena_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void audio_arena_init(audio_arena_t *arena, void *buffer, size_t size);
+void *audio_arena_alloc(audio_arena_t *arena, size_t size);
+void audio_arena_reset(audio_arena_t *arena);
+
+#endif /* AUDIO_ARENA_H_ */
@@ -0,0 +1,266 @@
+/******************************************************************************
+* File Name:   audio_arq.c
+*
+* Description: This file contains the selective repeat retransmission of the
+* audio upload datagrams, see audio_arq.h.
+*
+* The buffer is cut into slots of the largest datagram of the session, so
+* the window in datagrams follows the chunk size negotiated by audio_mtu.h:
+* 22 datagrams of the largest chunk, 62 of the 512 byte base chunk. The slots
+* are used in turn; a datagram is found from its age, the distance of its
+* sequence number to the newest one, which stays valid across the wrap of
+* the 16-bit sequence numbers.
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "audio_arq.h"
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static void resend(audio_arq_t *arq, uint16_t seq, audio_arq_send_t send);
+
+/*******************************************************************************
+* Function Name: audio_arq_begin
+********************************************************************************
+* Summary:
+*  Starts a new session with an empty window. An unfinished session is
+*  dropped.
+*
+* Parameters:
+*  arq: Retransmission state
+*  session: Session of the upload
+*  max_datagram: Largest datagram of the session in bytes, header included;
+*                limited to AUDIO_ARQ_MAX_DATAGRAM
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_arq_begin(audio_arq_t *arq, uint16_t session, uint32_t max_datagram)
+{
+    if (max_datagram > AUDIO_ARQ_MAX_DATAGRAM)
+    {
+        max_datagram = AUDIO_ARQ_MAX_DATAGRAM;
+    }
+    if (max_datagram < AUDIO_PACKET_HEADER_SIZE)
+    {
+        max_datagram = AUDIO_PACKET_HEADER_SIZE;
+    }
+
+    arq->slot_size = max_datagram;
+    arq->window = AUDIO_ARQ_BUFFER_SIZE / max_datagram;
+    if (arq->window > AUDIO_ARQ_MAX_WINDOW)
+    {
+        arq->window = AUDIO_ARQ_MAX_WINDOW;
+    }
+    arq->head = 0;
+    arq->state = AUDIO_ARQ_SENDING;
+    arq->session = session;
+    arq->next_seq = 0;
+    arq->end_seq = 0;
+    arq->acknowledged = false;
+    arq->stored = 0;
+    arq->feedback_ms = 0;
+    arq->end_sent_ms = 0;
+    arq->nacked = 0;
+    arq->retransmitted = 0;
+    arq->unavailable = 0;
+}
+
+/*******************************************************************************
+* Function Name: audio_arq_store
+********************************************************************************
+* Summary:
+*  Keeps a datagram of the session for retransmission, replacing the oldest
+*  one once the window is full. The datagrams have to be stored in the order
+*  of their sequence numbers, starting with 0. A datagram larger than the
+*  session's largest takes its sequence number but is not kept.
+*
+* Parameters:
+*  arq: Retransmission state
+*  datagram: Datagram as sent
+*  size: Size of the datagram in bytes
+*  now_ms: Current time in milliseconds
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_arq_store(audio_arq_t *arq, const uint8_t *datagram, uint32_t size, uint32_t now_ms)
+{
+    if (arq->state != AUDIO_ARQ_SENDING)
+    {
+        return;
+    }
+
+    if (size <= arq->slot_size)
+    {
+        memcpy(&arq->buffer[arq->head * arq->slot_size], datagram, size);
+        arq->sizes[arq->head] = (uint16_t)size;
+    }
+    else
+    {
+        arq->sizes[arq->head] = 0;
+    }
+    arq->head = (arq->head + 1u) % arq->window;
+
+    if ((datagram[3] & AUDIO_PACKET_FLAG_END) != 0u)
+    {
+        arq->state = AUDIO_ARQ_ENDING;
+        arq->end_seq = arq->next_seq;
+        arq->end_sent_ms = now_ms;
+        arq->feedback_ms = now_ms;
+    }
+
+    arq->next_seq++;
+    if (arq->stored < arq->window)
+    {
+        arq->stored++;
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_arq_feedback
+********************************************************************************
+* Summary:
+*  Handles a feedback datagram of the server: sends the NACKed datagrams
+*  again, or completes the session on the ACK of its end datagram. Feedback
+*  of other sessions and invalid datagrams are ignored.
+*
+* Parameters:
+*  arq: Retransmission state
+*  datagram: Received datagram
+*  size: Size of the datagram in bytes
+*  now_ms: Current time in milliseconds
+*  send: Sends the retransmitted datagrams
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_arq_feedback(audio_arq_t *arq, const uint8_t *datagram, uint32_t size, uint32_t now_ms,
+                        audio_arq_send_t send)
+{
+    audio_packet_header_t header;
+    const uint8_t *bitmap;
+    uint32_t bitmap_size;
+
+    if (((arq->state != AUDIO_ARQ_SENDING) && (arq->state != AUDIO_ARQ_ENDING)) ||
+        !audio_packet_decode(datagram, size, &header, &bitmap, &bitmap_size) ||
+        (header.session != arq->session))
+    {
+        return;
+    }
+
+    arq->feedback_ms = now_ms;
+
+    if ((header.flags & AUDIO_PACKET_FLAG_ACK) != 0u)
+    {
+        if ((arq->state == AUDIO_ARQ_ENDING) && (header.seq == arq->end_seq))
+        {
+            arq->acknowledged = true;
+        }
+        return;
+    }
+
+    if ((header.flags & AUDIO_PACKET_FLAG_NACK) == 0u)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < (bitmap_size * 8u); i++)
+    {
+        if ((bitmap[i / 8u] & (1u << (i % 8u))) != 0u)
+        {
+            arq->nacked++;
+            resend(arq, (uint16_t)(header.seq + i), send);
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_arq_poll
+********************************************************************************
+* Summary:
+*  Repeats the end datagram while it is not acknowledged and gives the
+*  session up after AUDIO_ARQ_TIMEOUT_MS without feedback. Call it
+*  periodically, at least every AUDIO_ARQ_END_RETRY_MS.
+*
+* Parameters:
+*  arq: Retransmission state
+*  now_ms: Current time in milliseconds
+*  send: Sends the repeated end datagram
+*
+* Return:
+*  bool: true once the session completed or timed out, see arq->state
+*
+*******************************************************************************/
+bool audio_arq_poll(audio_arq_t *arq, uint32_t now_ms, audio_arq_send_t send)
+{
+    if (arq->state != AUDIO_ARQ_ENDING)
+    {
+        return false;
+    }
+
+    if (arq->acknowledged)
+    {
+        arq->state = AUDIO_ARQ_COMPLETE;
+        return true;
+    }
+
+    if ((now_ms - arq->feedback_ms) >= AUDIO_ARQ_TIMEOUT_MS)
+    {
+        arq->state = AUDIO_ARQ_TIMEOUT;
+        return true;
+    }
+
+    if ((now_ms - arq->end_sent_ms) >= AUDIO_ARQ_END_RETRY_MS)
+    {
+        arq->end_sent_ms = now_ms;
+        resend(arq, arq->end_seq, send);
+    }
+
+    return false;
+}
+
+/*******************************************************************************
+* Function Name: resend
+********************************************************************************
+* Summary:
+*  Sends a datagram of the window again, counts it as unavailable if it was
+*  already replaced or not kept.
+*
+*******************************************************************************/
+static void resend(audio_arq_t *arq, uint16_t seq, audio_arq_send_t send)
+{
+    uint16_t age = (uint16_t)(arq->next_seq - 1u - seq);
+    uint32_t index;
+    uint8_t *data;
+
+    if (age >= arq->stored)
+    {
+        arq->unavailable++;
+        return;
+    }
+
+    index = (arq->head + arq->window - 1u - age) % arq->window;
+    if (arq->sizes[index] == 0u)
+    {
+        arq->unavailable++;
+        return;
+    }
+
+    data = &arq->buffer[index * arq->slot_size];
+    if ((data[3] & AUDIO_PACKET_FLAG_RETRANSMIT) == 0u)
+    {
+        audio_packet_set_flags(data, arq->sizes[index], AUDIO_PACKET_FLAG_RETRANSMIT);
+    }
+
+    if (send(data, arq->sizes[index]))
+    {
+        arq->retransmitted++;
+    }
+}
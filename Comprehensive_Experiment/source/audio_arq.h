@@ -0,0 +1,95 @@
+/******************************************************************************
+* File Name:   audio_arq.h
+*
+* Description: This file contains the selective repeat retransmission of the
+* audio upload datagrams.
+*
+* The last datagrams of an upload are kept as sent, as many as slots of the
+* session's largest datagram fit in AUDIO_ARQ_BUFFER_SIZE bytes. The
+* server NACKs the sequence numbers it misses with a bitmap, bit i (least
+* significant bit of byte i / 8 first) standing for the sequence number of
+* the NACK plus i, and the datagrams still in the window are sent again with
+* AUDIO_PACKET_FLAG_RETRANSMIT. Once the end datagram is sent it is repeated
+* until the server ACKs it, or no feedback came for AUDIO_ARQ_TIMEOUT_MS.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_ARQ_H_
+#define AUDIO_ARQ_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "audio_packet.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Bytes kept for retransmission. Covers the round trip of a NACK, the server
+ * sending them every 50 ms, six times over at 48 kHz PCM and for seconds at
+ * the ADPCM rates */
+#define AUDIO_ARQ_BUFFER_SIZE               (32768u)
+/* Most datagrams kept, for sessions of small datagrams */
+#define AUDIO_ARQ_MAX_WINDOW                (128u)
+/* Largest datagram kept */
+#define AUDIO_ARQ_MAX_DATAGRAM              (AUDIO_PACKET_HEADER_SIZE + AUDIO_PACKET_MAX_PAYLOAD)
+/* Largest feedback datagram, a bitmap of 512 sequence numbers */
+#define AUDIO_ARQ_MAX_FEEDBACK              (AUDIO_PACKET_HEADER_SIZE + 64u)
+/* Interval of the end datagram while it is not acknowledged */
+#define AUDIO_ARQ_END_RETRY_MS              (200u)
+/* The session is given up after this time without feedback */
+#define AUDIO_ARQ_TIMEOUT_MS                (3000u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef enum
+{
+    AUDIO_ARQ_IDLE,                 /* No session */
+    AUDIO_ARQ_SENDING,              /* Datagrams of the session are being sent */
+    AUDIO_ARQ_ENDING,               /* End sent, repairing until it is acknowledged */
+    AUDIO_ARQ_COMPLETE,             /* Acknowledged by the server */
+    AUDIO_ARQ_TIMEOUT,              /* Given up without acknowledgement */
+} audio_arq_state_t;
+
+/* Sends a datagram, returns false if it could not be sent */
+typedef bool (*audio_arq_send_t)(const uint8_t *datagram, uint32_t size);
+
+/* Feedback datagram as received, passed from the socket callback to the task
+ * of the upload */
+typedef struct
+{
+    uint16_t size;
+    uint8_t  data[AUDIO_ARQ_MAX_FEEDBACK];
+} audio_arq_feedback_t;
+
+typedef struct
+{
+    uint8_t  buffer[AUDIO_ARQ_BUFFER_SIZE];     /* Slots of slot_size bytes */
+    uint16_t sizes[AUDIO_ARQ_MAX_WINDOW];       /* Datagram size per slot, 0 if not kept */
+    uint32_t slot_size;             /* Largest datagram of the session */
+    uint32_t window;                /* Slots in the buffer */
+    uint32_t head;                  /* Slot of the next datagram */
+    audio_arq_state_t state;
+    uint16_t session;
+    uint16_t next_seq;              /* Sequence number of the next datagram */
+    uint16_t end_seq;               /* Sequence number of the end datagram */
+    bool     acknowledged;          /* The server acknowledged the end datagram */
+    uint32_t stored;                /* Datagrams in the window */
+    uint32_t feedback_ms;           /* Time of the last feedback */
+    uint32_t end_sent_ms;           /* Time the end datagram was last sent */
+    uint32_t nacked;                /* Sequence numbers NACKed, repeats counted again */
+    uint32_t retransmitted;         /* Datagrams sent again */
+    uint32_t unavailable;           /* NACKed datagrams no longer in the window */
+} audio_arq_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void audio_arq_begin(audio_arq_t *arq, uint16_t session, uint32_t max_datagram);
+void audio_arq_store(audio_arq_t *arq, const uint8_t *datagram, uint32_t size, uint32_t now_ms);
+void audio_arq_feedback(audio_arq_t *arq, const uint8_t *datagram, uint32_t size, uint32_t now_ms,
+                        audio_arq_send_t send);
+bool audio_arq_poll(audio_arq_t *arq, uint32_t now_ms, audio_arq_send_t send);
+
+#endif /* AUDIO_ARQ_H_ */
@@ -0,0 +1,330 @@
+/******************************************************************************
+* File Name:   audio_beam.c
+*
+* Description: This file contains the two-microphone front end.
+*
+* The steered channel is delayed by AUDIO_BEAM_FD_CENTER + whole + phase /
+* AUDIO_BEAM_FD_PHASES samples, the other one by AUDIO_BEAM_FD_CENTER, so
+* the output lags the input by AUDIO_BEAM_FD_CENTER samples when the steering
+* delay is zero. The fractional delays are 8 tap Kaiser windowed sinc filters
+* (beta 3) with a DC gain of exactly one; below a quarter of the sample rate
+* their gain is within 0.2 dB and their delay within 0.02 sample of the
+* nominal value. Phase 0 is a pure delay and is not filtered. Each channel
+* output is rounded to Q15 before the two are averaged, so the sum cannot
+* overflow.
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "audio_beam.h"
+
+#if AUDIO_DSP_USE_SIMD
+#include "cmsis_compiler.h"
+#endif
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Delay of the unsteered channel, the centre tap of the filters */
+#define AUDIO_BEAM_FD_CENTER                (3u)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* Fractional-delay filters, in the order of ascending sample time: tap j
+ * multiplies x[n - AUDIO_BEAM_FD_TAPS + 1 + j]. */
+static const int16_t fd_taps[AUDIO_BEAM_FD_PHASES][AUDIO_BEAM_FD_TAPS] =
+{
+    {      0,      0,      0,      0,  32767,      0,      0,      0 },
+    {   -243,    693,  -1621,   4327,  32084,  -3237,   1315,   -550 },
+    {   -526,   1437,  -3346,   9519,  29672,  -5284,   2200,   -904 },
+    {   -797,   2100,  -4887,  15167,  25766,  -6133,   2596,  -1044 },
+    {   -992,   2531,  -5919,  20765,  20763,  -5919,   2531,   -992 },
+    {  -1044,   2596,  -6133,  25766,  15167,  -4887,   2100,   -797 },
+    {   -904,   2200,  -5284,  29672,   9519,  -3346,   1437,   -526 },
+    {   -550,   1315,  -3237,  32084,   4327,  -1621,    693,   -243 }
+};
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static void history_append(audio_beam_t *beam, const int16_t *left, const int16_t *right, uint32_t num_samples);
+static void history_shift(audio_beam_t *beam, uint32_t num_samples);
+static inline int32_t round_q15(int32_t acc);
+
+/*******************************************************************************
+* Function Name: audio_beam_init
+********************************************************************************
+* Summary:
+*  Initializes the beamformer with an empty (zero) history.
+*
+* Parameters:
+*  beam: Beamformer
+*  delay: Steering delay, see audio_beam_set_delay
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_beam_init(audio_beam_t *beam, int32_t delay)
+{
+    memset(beam->history, 0, sizeof(beam->history));
+    audio_beam_set_delay(beam, delay);
+}
+
+/*******************************************************************************
+* Function Name: audio_beam_set_delay
+********************************************************************************
+* Summary:
+*  Steers the beam. A positive delay means the sound reaches the left
+*  microphone first, so the left channel is delayed; zero is broadside.
+*
+* Parameters:
+*  beam: Beamformer
+*  delay: Steering delay in 1/AUDIO_BEAM_FD_PHASES samples, limited to
+*         +/- AUDIO_BEAM_MAX_DELAY samples
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_beam_set_delay(audio_beam_t *beam, int32_t delay)
+{
+    const int32_t max_delay = (int32_t)(AUDIO_BEAM_MAX_DELAY * AUDIO_BEAM_FD_PHASES);
+    uint32_t steered;
+    uint32_t magnitude;
+
+    delay = (delay > max_delay) ? max_delay : delay;
+    delay = (delay < -max_delay) ? -max_delay : delay;
+
+    steered = (delay > 0) ? 0u : 1u;
+    magnitude = (uint32_t)((delay > 0) ? delay : -delay);
+
+    beam->delay = delay;
+    beam->whole[steered] = magnitude / AUDIO_BEAM_FD_PHASES;
+    beam->phase[steered] = magnitude % AUDIO_BEAM_FD_PHASES;
+    beam->whole[1u - steered] = 0;
+    beam->phase[1u - steered] = 0;
+}
+
+/*******************************************************************************
+* Function Name: audio_beam_process
+********************************************************************************
+* Summary:
+*  Delays the two channels and averages them into the mono output.
+*
+* Parameters:
+*  beam: Beamformer
+*  left: Left channel samples
+*  right: Right channel samples
+*  num_samples: Number of samples per channel, at most AUDIO_BEAM_MAX_BLOCK
+*  out: Output buffer of num_samples samples, may be 'left' or 'right'
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_beam_process(audio_beam_t *beam, const int16_t *left, const int16_t *right,
+                        uint32_t num_samples, int16_t *out)
+{
+#if AUDIO_DSP_USE_SIMD
+    int32_t y[2];
+
+    history_append(beam, left, right, num_samples);
+
+    for (uint32_t i = 0; i < num_samples; i++)
+    {
+        for (uint32_t c = 0; c < 2u; c++)
+        {
+            const int16_t *x = &beam->history[c][AUDIO_BEAM_HISTORY + i - beam->whole[c] -
+                                                  (AUDIO_BEAM_FD_TAPS - 1u)];
+
+            if (beam->phase[c] == 0u)
+            {
+                y[c] = x[AUDIO_BEAM_FD_TAPS - 1u - AUDIO_BEAM_FD_CENTER];
+            }
+            else
+            {
+                const int16_t *h = fd_taps[beam->phase[c]];
+                uint32_t acc = 0;
+
+                for (uint32_t j = 0; j < AUDIO_BEAM_FD_TAPS; j += 2u)
+                {
+                    uint32_t xs;
+                    uint32_t hs;
+
+                    memcpy(&xs, &x[j], sizeof(xs));
+                    memcpy(&hs, &h[j], sizeof(hs));
+                    acc = __SMLAD(xs, hs, acc);
+                }
+
+                y[c] = round_q15((int32_t)acc);
+            }
+        }
+
+        out[i] = (int16_t)((y[0] + y[1]) >> 1);
+    }
+
+    history_shift(beam, num_samples);
+#else
+    audio_beam_process_ref(beam, left, right, num_samples, out);
+#endif
+}
+
+/*******************************************************************************
+* Function Name: audio_beam_process_ref
+********************************************************************************
+* Summary:
+*  Portable reference of audio_beam_process.
+*
+*******************************************************************************/
+void audio_beam_process_ref(audio_beam_t *beam, const int16_t *left, const int16_t *right,
+                            uint32_t num_samples, int16_t *out)
+{
+    int32_t y[2];
+
+    history_append(beam, left, right, num_samples);
+
+    for (uint32_t i = 0; i < num_samples; i++)
+    {
+        for (uint32_t c = 0; c < 2u; c++)
+        {
+            const int16_t *x = &beam->history[c][AUDIO_BEAM_HISTORY + i - beam->whole[c] -
+                                                  (AUDIO_BEAM_FD_TAPS - 1u)];
+
+            if (beam->phase[c] == 0u)
+            {
+                y[c] = x[AUDIO_BEAM_FD_TAPS - 1u - AUDIO_BEAM_FD_CENTER];
+            }
+            else
+            {
+                const int16_t *h = fd_taps[beam->phase[c]];
+                int32_t acc = 0;
+
+                for (uint32_t j = 0; j < AUDIO_BEAM_FD_TAPS; j++)
+                {
+                    acc += (int32_t)x[j] * h[j];
+                }
+
+                y[c] = round_q15(acc);
+            }
+        }
+
+        out[i] = (int16_t)((y[0] + y[1]) >> 1);
+    }
+
+    history_shift(beam, num_samples);
+}
+
+/*******************************************************************************
+* Function Name: audio_beam_deinterleave
+********************************************************************************
+* Summary:
+*  Splits an interleaved stereo frame (left sample first) into one buffer
+*  per channel.
+*
+* Parameters:
+*  stereo: Interleaved samples, 2 * num_samples
+*  left: Left channel output
+*  right: Right channel output
+*  num_samples: Number of samples per channel
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_beam_deinterleave(const int16_t *stereo, int16_t *left, int16_t *right, uint32_t num_samples)
+{
+#if AUDIO_DSP_USE_SIMD
+    uint32_t i;
+
+    /* Two frames per iteration: a = R0:L0 and b = R1:L1 become L1:L0 and R1:R0 */
+    for (i = 0; (i + 1u) < num_samples; i += 2u)
+    {
+        uint32_t a;
+        uint32_t b;
+
+        memcpy(&a, &stereo[2u * i], sizeof(a));
+        memcpy(&b, &stereo[2u * i + 2u], sizeof(b));
+
+        uint32_t l = __PKHBT(a, b, 16);
+        uint32_t r = __PKHTB(b, a, 16);
+
+        memcpy(&left[i], &l, sizeof(l));
+        memcpy(&right[i], &r, sizeof(r));
+    }
+
+    if (i < num_samples)
+    {
+        left[i] = stereo[2u * i];
+        right[i] = stereo[2u * i + 1u];
+    }
+#else
+    audio_beam_deinterleave_ref(stereo, left, right, num_samples);
+#endif
+}
+
+/*******************************************************************************
+* Function Name: audio_beam_deinterleave_ref
+********************************************************************************
+* Summary:
+*  Portable reference of audio_beam_deinterleave.
+*
+*******************************************************************************/
+void audio_beam_deinterleave_ref(const int16_t *stereo, int16_t *left, int16_t *right, uint32_t num_samples)
+{
+    for (uint32_t i = 0; i < num_samples; i++)
+    {
+        left[i] = stereo[2u * i];
+        right[i] = stereo[2u * i + 1u];
+    }
+}
+
+/*******************************************************************************
+* Function Name: history_append
+********************************************************************************
+* Summary:
+*  Copies the input blocks behind the kept history of each channel.
+*
+*******************************************************************************/
+static void history_append(audio_beam_t *beam, const int16_t *left, const int16_t *right, uint32_t num_samples)
+{
+    memcpy(&beam->history[0][AUDIO_BEAM_HISTORY], left, num_samples * sizeof(int16_t));
+    memcpy(&beam->history[1][AUDIO_BEAM_HISTORY], right, num_samples * sizeof(int16_t));
+}
+
+/*******************************************************************************
+* Function Name: history_shift
+********************************************************************************
+* Summary:
+*  Keeps the last AUDIO_BEAM_HISTORY samples of each channel.
+*
+*******************************************************************************/
+static void history_shift(audio_beam_t *beam, uint32_t num_samples)
+{
+    memmove(beam->history[0], &beam->history[0][num_samples], AUDIO_BEAM_HISTORY * sizeof(int16_t));
+    memmove(beam->history[1], &beam->history[1][num_samples], AUDIO_BEAM_HISTORY * sizeof(int16_t));
+}
+
+/*******************************************************************************
+* Function Name: round_q15
+********************************************************************************
+* Summary:
+*  Rounds a Q30 sum to Q15 and saturates it to 16 bits.
+*
+*******************************************************************************/
+static inline int32_t round_q15(int32_t acc)
+{
+    acc = (acc + 0x4000) >> 15;
+
+    if (acc > INT16_MAX)
+    {
+        return INT16_MAX;
+    }
+    if (acc < INT16_MIN)
+    {
+        return INT16_MIN;
+    }
+    return acc;
+}
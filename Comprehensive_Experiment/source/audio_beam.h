@@ -0,0 +1,62 @@
+/******************************************************************************
+* File Name:   audio_beam.h
+*
+* Description: This file contains the two-microphone front end: the split of
+* the interleaved stereo PDM/PCM frames into one buffer per channel and a
+* delay-and-sum beamformer that combines them into the mono stream. Sound
+* from the steering direction adds coherently while diffuse noise does not,
+* which improves the SNR of far-field speech by up to 3 dB.
+*
+* The steering delay has a resolution of 1/AUDIO_BEAM_FD_PHASES sample; the
+* fractional part is applied with a short fractional-delay FIR. Like the
+* conditioning chain, the kernels have a SIMD form on cores with the DSP
+* extension and a portable reference with bit-identical results.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_BEAM_H_
+#define AUDIO_BEAM_H_
+
+#include <stdint.h>
+
+#include "audio_dsp.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Taps of the fractional-delay filters */
+#define AUDIO_BEAM_FD_TAPS                  (8u)
+/* Fractional delay steps per sample */
+#define AUDIO_BEAM_FD_PHASES                (8u)
+/* Largest steering delay in whole samples */
+#define AUDIO_BEAM_MAX_DELAY                (4u)
+/* Largest number of samples per channel and call */
+#define AUDIO_BEAM_MAX_BLOCK                (480u)
+/* Samples of each channel kept from the previous block */
+#define AUDIO_BEAM_HISTORY                  (AUDIO_BEAM_MAX_DELAY + AUDIO_BEAM_FD_TAPS - 1u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    int32_t  delay;                 /* Steering delay in 1/AUDIO_BEAM_FD_PHASES samples */
+    uint32_t whole[2];              /* Extra delay of each channel in whole samples */
+    uint32_t phase[2];              /* Fractional delay of each channel */
+    int16_t  history[2][AUDIO_BEAM_HISTORY + AUDIO_BEAM_MAX_BLOCK];
+} audio_beam_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void audio_beam_init(audio_beam_t *beam, int32_t delay);
+void audio_beam_set_delay(audio_beam_t *beam, int32_t delay);
+void audio_beam_process(audio_beam_t *beam, const int16_t *left, const int16_t *right,
+                        uint32_t num_samples, int16_t *out);
+void audio_beam_process_ref(audio_beam_t *beam, const int16_t *left, const int16_t *right,
+                            uint32_t num_samples, int16_t *out);
+
+void audio_beam_deinterleave(const int16_t *stereo, int16_t *left, int16_t *right, uint32_t num_samples);
+void audio_beam_deinterleave_ref(const int16_t *stereo, int16_t *left, int16_t *right, uint32_t num_samples);
+
+#endif /* AUDIO_BEAM_H_ */
@@ -0,0 +1,175 @@
+/******************************************************************************
+* File Name:   audio_chunk.c
+*
+* Description: This file contains the assembly of the audio datagrams of an
+* upload.
+*
+* The offset of a chunk is the number of samples of the upload before its
+* first sample (feature values for a feature upload), so the server places
+* every datagram in the recording whatever was lost before it.
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "audio_chunk.h"
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static void chunk_open(audio_chunk_t *chunk, uint32_t now_ms);
+
+/*******************************************************************************
+* Function Name: audio_chunk_begin
+********************************************************************************
+* Summary:
+*  Starts the chunks of a new upload.
+*
+* Parameters:
+*  chunk: Datagram assembly
+*  data: Buffer of the chunk, behind the space of the datagram header
+*  limit: Chunk size of the upload in bytes, at most the size of the buffer
+*  adpcm: true to encode the 16-bit samples to IMA ADPCM, false to collect
+*         the bytes as they are
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_chunk_begin(audio_chunk_t *chunk, uint8_t *data, uint32_t limit, bool adpcm)
+{
+    chunk->data = data;
+    chunk->limit = limit;
+    chunk->len = 0;
+    chunk->offset = 0;
+    chunk->first_ms = 0;
+    chunk->total_samples = 0;
+    chunk->adpcm = adpcm;
+    audio_adpcm_init(&chunk->encoder);
+}
+
+/*******************************************************************************
+* Function Name: audio_chunk_add
+********************************************************************************
+* Summary:
+*  Adds audio to the chunk, as much as fits. The caller sends the chunk and
+*  sets its length to 0 once audio_chunk_full or audio_chunk_held, then
+*  adds the rest.
+*
+* Parameters:
+*  chunk: Datagram assembly
+*  audio: Audio data, 16-bit aligned 16-bit samples with ADPCM
+*  size: Size of the audio data in bytes
+*  now_ms: Current time in milliseconds
+*
+* Return:
+*  uint32_t: Bytes of the audio data added
+*
+*******************************************************************************/
+uint32_t audio_chunk_add(audio_chunk_t *chunk, const uint8_t *audio, uint32_t size, uint32_t now_ms)
+{
+    if (chunk->adpcm)
+    {
+        uint32_t num_samples = size / sizeof(int16_t);
+
+        /* A byte short of a sample is dropped */
+        if (num_samples == 0u)
+        {
+            return size;
+        }
+
+        if (chunk->len == 0u)
+        {
+            chunk_open(chunk, now_ms);
+            chunk->len = audio_adpcm_write_header(&chunk->encoder, chunk->data);
+        }
+
+        uint32_t encode_size = AUDIO_ADPCM_SAMPLES_IN_BYTES(chunk->limit - chunk->len);
+        if (encode_size > num_samples)
+        {
+            encode_size = num_samples;
+        }
+
+        audio_adpcm_encode(&chunk->encoder, (const int16_t *)audio, encode_size, &chunk->data[chunk->len]);
+        chunk->len += (encode_size + 1u) / 2u;
+        chunk->total_samples += encode_size;
+
+        return (encode_size == num_samples) ? size : (encode_size * sizeof(int16_t));
+    }
+
+    uint32_t copy_size = chunk->limit - chunk->len;
+    if (copy_size > size)
+    {
+        copy_size = size;
+    }
+
+    if (chunk->len == 0u)
+    {
+        chunk_open(chunk, now_ms);
+    }
+
+    memcpy(&chunk->data[chunk->len], audio, copy_size);
+    chunk->len += copy_size;
+    chunk->total_samples += copy_size / sizeof(int16_t);
+
+    return copy_size;
+}
+
+/*******************************************************************************
+* Function Name: audio_chunk_full
+********************************************************************************
+* Summary:
+*  Returns true if the chunk holds the chunk size.
+*
+* Parameters:
+*  chunk: Datagram assembly
+*
+* Return:
+*  bool: true if the chunk is to be sent
+*
+*******************************************************************************/
+bool audio_chunk_full(const audio_chunk_t *chunk)
+{
+    return chunk->len == chunk->limit;
+}
+
+/*******************************************************************************
+* Function Name: audio_chunk_held
+********************************************************************************
+* Summary:
+*  Returns true if the first audio of a chunk that is not yet full has
+*  waited the hold time. Checked for every frame of a recording, also for
+*  the frames that add no audio.
+*
+* Parameters:
+*  chunk: Datagram assembly
+*  max_hold_ms: Longest wait of audio in the chunk, 0 to send full chunks
+*               only
+*  now_ms: Current time in milliseconds
+*
+* Return:
+*  bool: true if the chunk is to be sent
+*
+*******************************************************************************/
+bool audio_chunk_held(const audio_chunk_t *chunk, uint32_t max_hold_ms, uint32_t now_ms)
+{
+    if ((max_hold_ms == 0u) || (chunk->len == 0u))
+    {
+        return false;
+    }
+
+    return (now_ms - chunk->first_ms) >= max_hold_ms;
+}
+
+/*******************************************************************************
+* Function Name: chunk_open
+********************************************************************************
+* Summary:
+*  Records the offset and the time of the first audio of a new chunk.
+*
+*******************************************************************************/
+static void chunk_open(audio_chunk_t *chunk, uint32_t now_ms)
+{
+    chunk->offset = chunk->total_samples;
+    chunk->first_ms = now_ms;
+}
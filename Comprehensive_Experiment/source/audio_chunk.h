@@ -0,0 +1,51 @@
+/******************************************************************************
+* File Name:   audio_chunk.h
+*
+* Description: This file contains the assembly of the audio datagrams of an
+* upload.
+*
+* Audio is collected into a chunk of the chunk size of the upload, behind
+* the space of the datagram header. With IMA ADPCM the 16-bit samples are
+* encoded straight into the chunk, each chunk starting with the encoder
+* state so that every datagram decodes on its own. The caller sends a chunk
+* once it is full, or once its first audio has waited the hold time, so
+* that the server stays close behind the capture while the audio is slower
+* than the chunk size (ADPCM, speech pauses).
+*
+* Time is passed in by the caller, in milliseconds, so that the assembly
+* runs on a virtual clock off target.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_CHUNK_H_
+#define AUDIO_CHUNK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "audio_adpcm.h"
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    uint8_t *data;                  /* Chunk, behind the datagram header */
+    uint32_t limit;                 /* Chunk size of the upload in bytes */
+    uint32_t len;                   /* Bytes in the chunk, 0 if empty */
+    uint32_t offset;                /* Offset of the first sample of the chunk in the upload */
+    uint32_t first_ms;              /* Time the first audio of the chunk was added */
+    uint32_t total_samples;         /* Samples of the upload */
+    bool adpcm;                     /* Encode 16-bit samples to IMA ADPCM */
+    audio_adpcm_state_t encoder;
+} audio_chunk_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void audio_chunk_begin(audio_chunk_t *chunk, uint8_t *data, uint32_t limit, bool adpcm);
+uint32_t audio_chunk_add(audio_chunk_t *chunk, const uint8_t *audio, uint32_t size, uint32_t now_ms);
+bool audio_chunk_full(const audio_chunk_t *chunk);
+bool audio_chunk_held(const audio_chunk_t *chunk, uint32_t max_hold_ms, uint32_t now_ms);
+
+#endif /* AUDIO_CHUNK_H_ */
@@ -0,0 +1,418 @@
+/******************************************************************************
+* File Name:   audio_dsp.c
+*
+* Description: This file contains the Q15 conditioning kernels of the audio
+* pipeline.
+*
+* Every kernel has one rounding definition shared by its reference and its
+* SIMD form: products are accumulated in 32 bits, rounded by adding half an
+* LSB and shifted arithmetically, then saturated to 16 bits. The SIMD forms
+* process two samples per 32-bit word with SMLAD (pre-emphasis) and
+* SMUAD/SMUADX (gain), so they produce the same samples as the reference
+* kernels. The DC blocker is recursive on every sample and has no SIMD form.
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "audio_dsp.h"
+
+#if AUDIO_DSP_USE_SIMD
+#include "cmsis_compiler.h"
+#endif
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static inline int16_t sat_q15(int32_t x);
+
+/*******************************************************************************
+* Function Name: audio_dsp_chain_init
+********************************************************************************
+* Summary:
+*  Initializes the conditioning chain with the given configuration.
+*
+* Parameters:
+*  chain: Conditioning chain
+*  cfg: Stages to run and their parameters
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_dsp_chain_init(audio_dsp_chain_t *chain, const audio_dsp_cfg_t *cfg)
+{
+    chain->cfg = *cfg;
+
+    audio_dsp_dc_init(&chain->dc, cfg->dc_pole_q15);
+    audio_dsp_preemph_init(&chain->preemph, cfg->preemph_coef_q15);
+    audio_dsp_agc_init(&chain->agc, cfg->agc_target_peak, cfg->agc_max_gain_q12);
+}
+
+/*******************************************************************************
+* Function Name: audio_dsp_chain_process
+********************************************************************************
+* Summary:
+*  Runs the enabled stages in place on one frame: DC blocker, pre-emphasis,
+*  AGC.
+*
+* Parameters:
+*  chain: Conditioning chain
+*  samples: Frame samples, processed in place
+*  num_samples: Number of samples in the frame
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_dsp_chain_process(audio_dsp_chain_t *chain, int16_t *samples, uint32_t num_samples)
+{
+    if (chain->cfg.dc_block)
+    {
+        audio_dsp_dc_block_q15(&chain->dc, samples, num_samples);
+    }
+
+    if (chain->cfg.preemph)
+    {
+        audio_dsp_preemph_q15(&chain->preemph, samples, num_samples);
+    }
+
+    if (chain->cfg.agc)
+    {
+        audio_dsp_agc_process(&chain->agc, samples, num_samples);
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_dsp_dc_init
+********************************************************************************
+* Summary:
+*  Initializes the DC blocker.
+*
+* Parameters:
+*  dc: DC blocker
+*  pole_q15: Pole of the high-pass, closer to one gives a lower corner
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_dsp_dc_init(audio_dsp_dc_t *dc, int16_t pole_q15)
+{
+    dc->pole_q15 = pole_q15;
+    dc->x_prev = 0;
+    dc->y_prev = 0;
+}
+
+/*******************************************************************************
+* Function Name: audio_dsp_dc_block_q15
+********************************************************************************
+* Summary:
+*  First order DC-removal high-pass, in place.
+*
+* Parameters:
+*  dc: DC blocker
+*  samples: Samples, processed in place
+*  num_samples: Number of samples
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_dsp_dc_block_q15(audio_dsp_dc_t *dc, int16_t *samples, uint32_t num_samples)
+{
+    int32_t x_prev = dc->x_prev;
+    int32_t y_prev = dc->y_prev;
+    int32_t pole = dc->pole_q15;
+
+    for (uint32_t i = 0; i < num_samples; i++)
+    {
+        int32_t x = samples[i];
+        int32_t y = sat_q15((x - x_prev) + ((pole * y_prev + 0x4000) >> 15));
+
+        samples[i] = (int16_t)y;
+        x_prev = x;
+        y_prev = y;
+    }
+
+    dc->x_prev = (int16_t)x_prev;
+    dc->y_prev = (int16_t)y_prev;
+}
+
+/*******************************************************************************
+* Function Name: audio_dsp_preemph_init
+********************************************************************************
+* Summary:
+*  Initializes the pre-emphasis filter.
+*
+* Parameters:
+*  pe: Pre-emphasis filter
+*  coef_q15: Pre-emphasis coefficient, 0 to AUDIO_DSP_Q15_ONE
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_dsp_preemph_init(audio_dsp_preemph_t *pe, int16_t coef_q15)
+{
+    pe->coef_q15 = coef_q15;
+    pe->x_prev = 0;
+}
+
+/*******************************************************************************
+* Function Name: audio_dsp_preemph_q15_ref
+********************************************************************************
+* Summary:
+*  Reference pre-emphasis,
+*  y[n] = sat((x[n] * ONE - x[n-1] * coef + 2^14) >> 15), in place.
+*
+* Parameters:
+*  pe: Pre-emphasis filter
+*  samples: Samples, processed in place
+*  num_samples: Number of samples
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_dsp_preemph_q15_ref(audio_dsp_preemph_t *pe, int16_t *samples, uint32_t num_samples)
+{
+    int32_t x_prev = pe->x_prev;
+    int32_t coef = pe->coef_q15;
+
+    for (uint32_t i = 0; i < num_samples; i++)
+    {
+        int32_t x = samples[i];
+        int32_t acc = (x * AUDIO_DSP_Q15_ONE) - (x_prev * coef) + 0x4000;
+
+        samples[i] = sat_q15(acc >> 15);
+        x_prev = x;
+    }
+
+    pe->x_prev = (int16_t)x_prev;
+}
+
+/*******************************************************************************
+* Function Name: audio_dsp_preemph_q15
+********************************************************************************
+* Summary:
+*  Pre-emphasis, in place. Same result as audio_dsp_preemph_q15_ref.
+*
+* Parameters:
+*  pe: Pre-emphasis filter
+*  samples: Samples, processed in place
+*  num_samples: Number of samples
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_dsp_preemph_q15(audio_dsp_preemph_t *pe, int16_t *samples, uint32_t num_samples)
+{
+#if AUDIO_DSP_USE_SIMD
+    /* Bottom half multiplies the current sample, top half the previous one */
+    uint32_t coefs = __PKHBT((uint32_t)AUDIO_DSP_Q15_ONE, (uint32_t)(-(int32_t)pe->coef_q15), 16);
+    uint32_t x_prev = (uint16_t)pe->x_prev;
+    uint32_t i;
+
+    for (i = 0; (i + 1u) < num_samples; i += 2u)
+    {
+        uint32_t in;
+        memcpy(&in, &samples[i], sizeof(in));
+
+        /* (x0, x[-1]) and (x1, x0) */
+        uint32_t pair0 = __PKHBT(in, x_prev, 16);
+        uint32_t pair1 = __ROR(in, 16);
+
+        int32_t y0 = __SSAT((int32_t)__SMLAD(pair0, coefs, 0x4000) >> 15, 16);
+        int32_t y1 = __SSAT((int32_t)__SMLAD(pair1, coefs, 0x4000) >> 15, 16);
+
+        uint32_t out = __PKHBT((uint32_t)y0, (uint32_t)y1, 16);
+        memcpy(&samples[i], &out, sizeof(out));
+
+        x_prev = in >> 16;
+    }
+
+    pe->x_prev = (int16_t)x_prev;
+
+    if (i < num_samples)
+    {
+        audio_dsp_preemph_q15_ref(pe, &samples[i], num_samples - i);
+    }
+#else
+    audio_dsp_preemph_q15_ref(pe, samples, num_samples);
+#endif
+}
+
+/*******************************************************************************
+* Function Name: audio_dsp_gain_q15_ref
+********************************************************************************
+* Summary:
+*  Reference gain, y[n] = sat((x[n] * gain + 2^11) >> 12), in place.
+*
+* Parameters:
+*  samples: Samples, processed in place
+*  num_samples: Number of samples
+*  gain_q12: Gain in Q12
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_dsp_gain_q15_ref(int16_t *samples, uint32_t num_samples, int16_t gain_q12)
+{
+    for (uint32_t i = 0; i < num_samples; i++)
+    {
+        samples[i] = sat_q15(((int32_t)samples[i] * gain_q12 + 0x800) >> 12);
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_dsp_gain_q15
+********************************************************************************
+* Summary:
+*  Gain, in place. Same result as audio_dsp_gain_q15_ref.
+*
+* Parameters:
+*  samples: Samples, processed in place
+*  num_samples: Number of samples
+*  gain_q12: Gain in Q12
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_dsp_gain_q15(int16_t *samples, uint32_t num_samples, int16_t gain_q12)
+{
+#if AUDIO_DSP_USE_SIMD
+    /* Gain in the bottom half only: SMUAD picks x0, SMUADX picks x1 */
+    uint32_t gain = (uint16_t)gain_q12;
+    uint32_t i;
+
+    for (i = 0; (i + 1u) < num_samples; i += 2u)
+    {
+        uint32_t in;
+        memcpy(&in, &samples[i], sizeof(in));
+
+        int32_t y0 = __SSAT(((int32_t)__SMUAD(in, gain) + 0x800) >> 12, 16);
+        int32_t y1 = __SSAT(((int32_t)__SMUADX(in, gain) + 0x800) >> 12, 16);
+
+        uint32_t out = __PKHBT((uint32_t)y0, (uint32_t)y1, 16);
+        memcpy(&samples[i], &out, sizeof(out));
+    }
+
+    if (i < num_samples)
+    {
+        audio_dsp_gain_q15_ref(&samples[i], num_samples - i, gain_q12);
+    }
+#else
+    audio_dsp_gain_q15_ref(samples, num_samples, gain_q12);
+#endif
+}
+
+/*******************************************************************************
+* Function Name: audio_dsp_agc_init
+********************************************************************************
+* Summary:
+*  Initializes the AGC at unity gain.
+*
+* Parameters:
+*  agc: Automatic gain control
+*  target_peak: Frame peak the AGC regulates to
+*  max_gain_q12: Highest gain in Q12
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_dsp_agc_init(audio_dsp_agc_t *agc, int16_t target_peak, int16_t max_gain_q12)
+{
+    agc->target_peak = target_peak;
+    agc->noise_gate = AUDIO_DSP_AGC_NOISE_GATE;
+    agc->min_gain_q12 = AUDIO_DSP_AGC_MIN_GAIN_Q12;
+    agc->max_gain_q12 = max_gain_q12;
+    agc->attack_shift = AUDIO_DSP_AGC_ATTACK_SHIFT;
+    agc->release_shift = AUDIO_DSP_AGC_RELEASE_SHIFT;
+    agc->gain_q12 = AUDIO_DSP_GAIN_ONE_Q12;
+}
+
+/*******************************************************************************
+* Function Name: audio_dsp_agc_process
+********************************************************************************
+* Summary:
+*  Moves the gain towards the one that brings the frame peak to the target,
+*  quickly down and slowly up, and applies it to the frame. Frames whose
+*  peak is below the noise gate keep the current gain so that silence is
+*  not amplified.
+*
+* Parameters:
+*  agc: Automatic gain control
+*  samples: Frame samples, processed in place
+*  num_samples: Number of samples in the frame
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_dsp_agc_process(audio_dsp_agc_t *agc, int16_t *samples, uint32_t num_samples)
+{
+    int32_t peak = 0;
+
+    for (uint32_t i = 0; i < num_samples; i++)
+    {
+        int32_t x = samples[i];
+        int32_t mag = (x < 0) ? -x : x;
+        peak = (mag > peak) ? mag : peak;
+    }
+
+    if (peak >= agc->noise_gate)
+    {
+        int32_t gain = agc->gain_q12;
+        int32_t desired = (int32_t)(((int32_t)agc->target_peak << 12) / peak);
+
+        if (desired < agc->min_gain_q12)
+        {
+            desired = agc->min_gain_q12;
+        }
+        else if (desired > agc->max_gain_q12)
+        {
+            desired = agc->max_gain_q12;
+        }
+
+        if (desired < gain)
+        {
+            gain -= (gain - desired + (1 << agc->attack_shift) - 1) >> agc->attack_shift;
+        }
+        else
+        {
+            gain += (desired - gain) >> agc->release_shift;
+        }
+
+        agc->gain_q12 = (int16_t)gain;
+    }
+
+    if (agc->gain_q12 != AUDIO_DSP_GAIN_ONE_Q12)
+    {
+        audio_dsp_gain_q15(samples, num_samples, agc->gain_q12);
+    }
+}
+
+/*******************************************************************************
+* Function Name: sat_q15
+********************************************************************************
+* Summary:
+*  Saturates a 32-bit value to the Q15 range.
+*
+*******************************************************************************/
+static inline int16_t sat_q15(int32_t x)
+{
+    if (x > INT16_MAX)
+    {
+        return INT16_MAX;
+    }
+    if (x < INT16_MIN)
+    {
+        return INT16_MIN;
+    }
+    return (int16_t)x;
+}
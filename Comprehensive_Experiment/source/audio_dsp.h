@@ -0,0 +1,118 @@
+/******************************************************************************
+* File Name:   audio_dsp.h
+*
+* Description: This file contains the conditioning chain applied in place to
+* every capture frame: DC-removal high-pass, pre-emphasis and automatic gain
+* control. All kernels work on Q15 samples. On cores with the DSP extension
+* the pre-emphasis and gain kernels use the SIMD instructions; the portable
+* reference kernels give bit-identical results on any host.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_DSP_H_
+#define AUDIO_DSP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Use the Cortex-M DSP extension when the compiler targets it. Define
+ * AUDIO_DSP_USE_SIMD to 0 to build the reference kernels only. */
+#ifndef AUDIO_DSP_USE_SIMD
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#define AUDIO_DSP_USE_SIMD                  (1)
+#else
+#define AUDIO_DSP_USE_SIMD                  (0)
+#endif
+#endif
+
+/* Unity in Q15 as far as it can be represented */
+#define AUDIO_DSP_Q15_ONE                   (32767)
+/* Unity gain in Q12 */
+#define AUDIO_DSP_GAIN_ONE_Q12              (4096)
+
+/* Default pole of the DC blocker, 0.995 (~13 Hz corner at 16 kHz) */
+#define AUDIO_DSP_DC_POLE_Q15               (32604)
+/* Default pre-emphasis coefficient, 0.97 */
+#define AUDIO_DSP_PREEMPH_COEF_Q15          (31785)
+
+/* Default AGC settings */
+#define AUDIO_DSP_AGC_TARGET_PEAK           (16384)     /* -6 dBFS */
+#define AUDIO_DSP_AGC_NOISE_GATE            (300)       /* Peaks below are not amplified */
+#define AUDIO_DSP_AGC_MIN_GAIN_Q12          (1024)      /* -12 dB */
+#define AUDIO_DSP_AGC_MAX_GAIN_Q12          (32767)     /* +18 dB */
+#define AUDIO_DSP_AGC_ATTACK_SHIFT          (1u)        /* Gain decrease per frame */
+#define AUDIO_DSP_AGC_RELEASE_SHIFT         (5u)        /* Gain increase per frame */
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+/* DC blocker, y[n] = x[n] - x[n-1] + pole * y[n-1] */
+typedef struct
+{
+    int16_t pole_q15;
+    int16_t x_prev;
+    int16_t y_prev;
+} audio_dsp_dc_t;
+
+/* Pre-emphasis, y[n] = x[n] - coef * x[n-1] */
+typedef struct
+{
+    int16_t coef_q15;
+    int16_t x_prev;
+} audio_dsp_preemph_t;
+
+/* Peak based automatic gain control, the gain is updated once per frame */
+typedef struct
+{
+    int16_t  target_peak;
+    int16_t  noise_gate;
+    int16_t  min_gain_q12;
+    int16_t  max_gain_q12;
+    uint8_t  attack_shift;
+    uint8_t  release_shift;
+    int16_t  gain_q12;              /* Gain applied to the last frame */
+} audio_dsp_agc_t;
+
+/* Configuration of the conditioning chain */
+typedef struct
+{
+    bool    dc_block;
+    bool    preemph;
+    bool    agc;
+    int16_t dc_pole_q15;
+    int16_t preemph_coef_q15;
+    int16_t agc_target_peak;
+    int16_t agc_max_gain_q12;
+} audio_dsp_cfg_t;
+
+typedef struct
+{
+    audio_dsp_cfg_t     cfg;
+    audio_dsp_dc_t      dc;
+    audio_dsp_preemph_t preemph;
+    audio_dsp_agc_t     agc;
+} audio_dsp_chain_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void audio_dsp_chain_init(audio_dsp_chain_t *chain, const audio_dsp_cfg_t *cfg);
+void audio_dsp_chain_process(audio_dsp_chain_t *chain, int16_t *samples, uint32_t num_samples);
+
+void audio_dsp_dc_init(audio_dsp_dc_t *dc, int16_t pole_q15);
+void audio_dsp_dc_block_q15(audio_dsp_dc_t *dc, int16_t *samples, uint32_t num_samples);
+
+void audio_dsp_preemph_init(audio_dsp_preemph_t *pe, int16_t coef_q15);
+void audio_dsp_preemph_q15(audio_dsp_preemph_t *pe, int16_t *samples, uint32_t num_samples);
+void audio_dsp_preemph_q15_ref(audio_dsp_preemph_t *pe, int16_t *samples, uint32_t num_samples);
+
+void audio_dsp_gain_q15(int16_t *samples, uint32_t num_samples, int16_t gain_q12);
+void audio_dsp_gain_q15_ref(int16_t *samples, uint32_t num_samples, int16_t gain_q12);
+
+void audio_dsp_agc_init(audio_dsp_agc_t *agc, int16_t target_peak, int16_t max_gain_q12);
+void audio_dsp_agc_process(audio_dsp_agc_t *agc, int16_t *samples, uint32_t num_samples);
+
+#endif /* AUDIO_DSP_H_ */
@@ -0,0 +1,315 @@
+/******************************************************************************
+* File Name:   audio_fec.c
+*
+* Description: This file contains the encoder of the forward error correction
+* of the audio upload.
+*
+* GF(256) uses the polynomial x^8 + x^4 + x^3 + x^2 + 1 (0x11D). Parity j
+* of a block is the sum over the datagrams i of coef[j][i] * symbol i, with
+* coef[j][i] = (1 / (x_j + y_i)) / (1 / (x_0 + y_i)), x_j = 255 - j and
+* y_i = i: a Cauchy matrix with its columns scaled so that the first row is
+* all ones. Every square submatrix of it is invertible, which makes the code
+* MDS, and parity 0 is the plain XOR of the symbols.
+*
+* The parities are updated as each datagram is sent, so no datagram has to
+* be kept. The Cortex-M4 has no byte shuffle to multiply 16 bytes at once;
+* a 256 byte product table is built per datagram and parity instead, and the
+* XOR parity is done a word at a time.
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "audio_fec.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define GF_POLYNOMIAL                       (0x11Du)
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static uint8_t gf_mul(uint8_t a, uint8_t b);
+static uint8_t gf_inv(uint8_t a);
+static void parity_xor(uint8_t *parity, const uint8_t *data, uint32_t size);
+static void parity_mac(uint8_t *parity, const uint8_t *data, uint32_t size, const uint8_t *product);
+
+/*******************************************************************************
+* Function Name: audio_fec_init
+********************************************************************************
+* Summary:
+*  Initializes an encoder and computes its coefficients.
+*
+* Parameters:
+*  fec: Encoder
+*  data: Datagrams per block, 1 to AUDIO_FEC_MAX_DATA
+*  parities: Parity datagrams per block, 1 to AUDIO_FEC_MAX_PARITY; 1 is XOR
+*
+* Return:
+*  bool: false if data or parities is out of range
+*
+*******************************************************************************/
+bool audio_fec_init(audio_fec_t *fec, uint32_t data, uint32_t parities)
+{
+    if ((data == 0u) || (data > AUDIO_FEC_MAX_DATA) || (parities == 0u) || (parities > AUDIO_FEC_MAX_PARITY))
+    {
+        return false;
+    }
+
+    fec->data = data;
+    fec->parities = parities;
+
+    for (uint32_t i = 0; i < data; i++)
+    {
+        uint8_t scale = (uint8_t)(255u ^ i);
+
+        for (uint32_t j = 0; j < parities; j++)
+        {
+            fec->coef[j][i] = gf_mul(gf_inv((uint8_t)((255u - j) ^ i)), scale);
+        }
+    }
+
+    audio_fec_begin(fec, 0, 0);
+
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: audio_fec_begin
+********************************************************************************
+* Summary:
+*  Starts the blocks of a new upload, its start datagram opening the first.
+*
+* Parameters:
+*  fec: Encoder
+*  codec: Codec of the upload, for the parity headers
+*  session: Session of the upload
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_fec_begin(audio_fec_t *fec, uint8_t codec, uint16_t session)
+{
+    fec->codec = codec;
+    fec->session = session;
+    fec->count = 0;
+    fec->length = 0;
+    fec->closed = false;
+    memset(fec->parity, 0, sizeof(fec->parity));
+}
+
+/*******************************************************************************
+* Function Name: audio_fec_add
+********************************************************************************
+* Summary:
+*  Adds a sent datagram to the parities of its block. Datagrams are added in
+*  the order of their sequence numbers, retransmissions are not added.
+*
+* Parameters:
+*  fec: Encoder
+*  header: Header of the datagram
+*  payload: Payload of the datagram
+*  payload_size: Size of the payload, at most AUDIO_FEC_MAX_PAYLOAD
+*
+* Return:
+*  bool: true if the datagram completed its block, the parities are then
+*        read with audio_fec_parity before the next datagram is added
+*
+*******************************************************************************/
+bool audio_fec_add(audio_fec_t *fec, const audio_packet_header_t *header, const uint8_t *payload,
+                   uint32_t payload_size)
+{
+    uint8_t prefix[AUDIO_FEC_SYMBOL_PREFIX];
+    uint8_t product[256];
+
+    if (fec->closed)
+    {
+        /* Block read, clear the parities for the next one */
+        for (uint32_t j = 0; j < fec->parities; j++)
+        {
+            memset(fec->parity[j], 0, fec->length);
+        }
+        fec->count = 0;
+        fec->length = 0;
+        fec->closed = false;
+    }
+
+    if (fec->count == 0u)
+    {
+        fec->first_seq = header->seq;
+    }
+
+    prefix[0] = (uint8_t)(payload_size & 0xFF);
+    prefix[1] = (uint8_t)((payload_size >> 8) & 0xFF);
+    prefix[2] = (uint8_t)(header->flags & ~AUDIO_PACKET_FLAG_RETRANSMIT);
+    prefix[3] = (uint8_t)(header->offset & 0xFF);
+    prefix[4] = (uint8_t)((header->offset >> 8) & 0xFF);
+    prefix[5] = (uint8_t)((header->offset >> 16) & 0xFF);
+    prefix[6] = (uint8_t)((header->offset >> 24) & 0xFF);
+
+    for (uint32_t j = 0; j < fec->parities; j++)
+    {
+        uint8_t coef = fec->coef[j][fec->count];
+
+        if (coef == 1u)
+        {
+            parity_xor(fec->parity[j], prefix, AUDIO_FEC_SYMBOL_PREFIX);
+            parity_xor(&fec->parity[j][AUDIO_FEC_SYMBOL_PREFIX], payload, payload_size);
+            continue;
+        }
+
+        /* product[x] = coef * x: coef * 2x = (coef * x) * 2, coef * (2x + 1) = coef * 2x + coef */
+        product[0] = 0;
+        product[1] = coef;
+        for (uint32_t x = 1; x < 128u; x++)
+        {
+            uint32_t twice = (uint32_t)product[x] << 1;
+
+            if ((twice & 0x100u) != 0u)
+            {
+                twice ^= GF_POLYNOMIAL;
+            }
+            product[2u * x] = (uint8_t)twice;
+            product[2u * x + 1u] = (uint8_t)(twice ^ coef);
+        }
+
+        parity_mac(fec->parity[j], prefix, AUDIO_FEC_SYMBOL_PREFIX, product);
+        parity_mac(&fec->parity[j][AUDIO_FEC_SYMBOL_PREFIX], payload, payload_size, product);
+    }
+
+    if (fec->length < AUDIO_FEC_SYMBOL_PREFIX + payload_size)
+    {
+        fec->length = AUDIO_FEC_SYMBOL_PREFIX + payload_size;
+    }
+    fec->count++;
+
+    /* The end datagram shortens its block, nothing follows it */
+    fec->closed = (fec->count == fec->data) || ((header->flags & AUDIO_PACKET_FLAG_END) != 0u);
+
+    return fec->closed;
+}
+
+/*******************************************************************************
+* Function Name: audio_fec_parity
+********************************************************************************
+* Summary:
+*  Writes a parity datagram of the block completed by audio_fec_add.
+*
+* Parameters:
+*  fec: Encoder
+*  index: Parity index, below the parities of audio_fec_init
+*  datagram: Buffer of AUDIO_FEC_MAX_DATAGRAM bytes
+*
+* Return:
+*  uint32_t: Size of the datagram in bytes
+*
+*******************************************************************************/
+uint32_t audio_fec_parity(const audio_fec_t *fec, uint32_t index, uint8_t *datagram)
+{
+    audio_packet_header_t header =
+    {
+        .codec = fec->codec,
+        .flags = AUDIO_PACKET_FLAG_PARITY,
+        .session = fec->session,
+        .seq = fec->first_seq,
+        .offset = index | (fec->count << 8) | (fec->parities << 16),
+    };
+
+    memcpy(&datagram[AUDIO_PACKET_HEADER_SIZE], fec->parity[index], fec->length);
+
+    return audio_packet_encode(&header, datagram, fec->length);
+}
+
+/*******************************************************************************
+* Function Name: gf_mul
+********************************************************************************
+* Summary:
+*  Multiplies two elements of GF(256), bit by bit.
+*
+*******************************************************************************/
+static uint8_t gf_mul(uint8_t a, uint8_t b)
+{
+    uint32_t x = a;
+    uint32_t product = 0;
+
+    while (b != 0u)
+    {
+        if ((b & 1u) != 0u)
+        {
+            product ^= x;
+        }
+        x <<= 1;
+        if ((x & 0x100u) != 0u)
+        {
+            x ^= GF_POLYNOMIAL;
+        }
+        b >>= 1;
+    }
+
+    return (uint8_t)product;
+}
+
+/*******************************************************************************
+* Function Name: gf_inv
+********************************************************************************
+* Summary:
+*  Inverts a non-zero element of GF(256) as a^254.
+*
+*******************************************************************************/
+static uint8_t gf_inv(uint8_t a)
+{
+    uint8_t result = 1;
+
+    for (uint32_t i = 0; i < 254u; i++)
+    {
+        result = gf_mul(result, a);
+    }
+
+    return result;
+}
+
+/*******************************************************************************
+* Function Name: parity_xor
+********************************************************************************
+* Summary:
+*  Adds data to a parity, four bytes at a time.
+*
+*******************************************************************************/
+static void parity_xor(uint8_t *parity, const uint8_t *data, uint32_t size)
+{
+    uint32_t i = 0;
+
+    for (; i + 4u <= size; i += 4u)
+    {
+        uint32_t p;
+        uint32_t d;
+
+        memcpy(&p, &parity[i], sizeof(p));
+        memcpy(&d, &data[i], sizeof(d));
+        p ^= d;
+        memcpy(&parity[i], &p, sizeof(p));
+    }
+
+    for (; i < size; i++)
+    {
+        parity[i] ^= data[i];
+    }
+}
+
+/*******************************************************************************
+* Function Name: parity_mac
+********************************************************************************
+* Summary:
+*  Adds the data multiplied by a coefficient, given as its product table, to
+*  a parity.
+*
+*******************************************************************************/
+static void parity_mac(uint8_t *parity, const uint8_t *data, uint32_t size, const uint8_t *product)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        parity[i] ^= product[data[i]];
+    }
+}
@@ -0,0 +1,79 @@
+/******************************************************************************
+* File Name:   audio_fec.h
+*
+* Description: This file contains the forward error correction of the audio
+* upload: K parity datagrams are sent after every N datagrams, and the
+* server rebuilds up to K lost datagrams of the block from them without
+* asking for a retransmission.
+*
+* The code is a systematic Reed-Solomon code over GF(256) with a Cauchy
+* generator, any N of the N + K datagrams of a block recover the others.
+* Its first parity row is all ones, so with K = 1 it is the plain XOR of the
+* block. Each datagram contributes the symbol
+*
+*   uint16 payload size, uint8 flags, uint32 offset, payload
+*
+* zero padded to the longest symbol of the block, so a rebuilt datagram gets
+* its header back; its sequence number follows from the position in the
+* block. A parity datagram has AUDIO_PACKET_FLAG_PARITY set, the sequence
+* number of the first datagram of the block and, in its offset field, the
+* parity index (bits 0-7), the number of datagrams of the block (bits 8-15)
+* and K (bits 16-23). Blocks start at multiples of N from the start datagram;
+* the end datagram closes a block early.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_FEC_H_
+#define AUDIO_FEC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "audio_packet.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define AUDIO_FEC_MAX_DATA                  (16u)
+#define AUDIO_FEC_MAX_PARITY                (4u)
+/* Size, flags and offset in front of the payload in a symbol */
+#define AUDIO_FEC_SYMBOL_PREFIX             (7u)
+/* Longest payload protected. The parity datagrams of a block are a symbol
+ * prefix longer than its longest datagram, so with FEC the chunk of the
+ * upload is at most this size, see audio_mtu_init */
+#define AUDIO_FEC_MAX_PAYLOAD               (AUDIO_PACKET_MAX_PAYLOAD - AUDIO_FEC_SYMBOL_PREFIX)
+#define AUDIO_FEC_MAX_SYMBOL                (AUDIO_FEC_SYMBOL_PREFIX + AUDIO_FEC_MAX_PAYLOAD)
+/* Largest parity datagram */
+#define AUDIO_FEC_MAX_DATAGRAM              (AUDIO_PACKET_HEADER_SIZE + AUDIO_FEC_MAX_SYMBOL)
+
+/* The largest parity datagram with its IPv4 and UDP headers (28 bytes) has
+ * to cross a 1500 byte MTU unfragmented */
+_Static_assert((AUDIO_FEC_MAX_DATAGRAM + 28u) <= 1500u, "FEC parity datagrams exceed the 1500 byte MTU");
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    uint8_t  parity[AUDIO_FEC_MAX_PARITY][AUDIO_FEC_MAX_SYMBOL];
+    uint8_t  coef[AUDIO_FEC_MAX_PARITY][AUDIO_FEC_MAX_DATA];
+    uint32_t data;                  /* Datagrams per block, N */
+    uint32_t parities;              /* Parity datagrams per block, K */
+    uint32_t count;                 /* Datagrams in the current block */
+    uint32_t length;                /* Longest symbol of the current block */
+    bool     closed;                /* The current block is complete */
+    uint8_t  codec;
+    uint16_t session;
+    uint16_t first_seq;             /* Sequence number of the first datagram of the block */
+} audio_fec_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+bool audio_fec_init(audio_fec_t *fec, uint32_t data, uint32_t parities);
+void audio_fec_begin(audio_fec_t *fec, uint8_t codec, uint16_t session);
+bool audio_fec_add(audio_fec_t *fec, const audio_packet_header_t *header, const uint8_t *payload,
+                   uint32_t payload_size);
+uint32_t audio_fec_parity(const audio_fec_t *fec, uint32_t index, uint8_t *datagram);
+
+#endif /* AUDIO_FEC_H_ */
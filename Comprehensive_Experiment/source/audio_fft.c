@@ -0,0 +1,456 @@
+/******************************************************************************
+* File Name:   audio_fft.c
+*
+* Description: This file contains the fixed-point FFT of the on-device
+* feature extraction.
+*
+* The complex FFT is a decimation-in-frequency radix-4: every butterfly
+* scales its four inputs by 1/4 before combining them, so after log4(n)
+* stages the output is scaled by 1/n. The two middle outputs of each
+* butterfly are swapped, which turns the base-4 digit reversal of the
+* result into a plain bit reversal, done in place at the end.
+*
+* The real-input FFT of 2 * AUDIO_FFT_MAX_SIZE points packs the even and
+* odd samples into one complex sequence, transforms it with the complex FFT
+* and separates the two spectra with one more twiddle pass. It is scaled by
+* 1 / AUDIO_FFT_RFFT_SIZE like a complex FFT of that length.
+*
+* The twiddle factors are computed once by audio_fft_init.
+*
+*******************************************************************************/
+
+#include <math.h>
+
+#include "audio_fft.h"
+
+#if AUDIO_FFT_USE_CMSIS_DSP
+#include "arm_math.h"
+#include "arm_const_structs.h"
+#endif
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* cos and sin of 2 * pi * k / AUDIO_FFT_MAX_SIZE, k < 3/4 of the size, as
+ * used by the radix-4 stages */
+static int16_t twiddle_q15[2u * (3u * AUDIO_FFT_MAX_SIZE / 4u)];
+static int32_t twiddle_q31[2u * (3u * AUDIO_FFT_MAX_SIZE / 4u)];
+/* cos and sin of pi * k / AUDIO_FFT_MAX_SIZE for the real-input split */
+static int32_t split_q31[2u * AUDIO_FFT_MAX_SIZE];
+
+#if AUDIO_FFT_USE_CMSIS_DSP
+static arm_rfft_instance_q31 rfft_instance;
+#endif
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static uint32_t log2_of(uint32_t n);
+static void bit_reverse_q15(int16_t *data, uint32_t n);
+static void bit_reverse_q31(int32_t *data, uint32_t n);
+static inline int32_t mul_q31(int32_t a, int32_t b);
+
+/*******************************************************************************
+* Function Name: audio_fft_init
+********************************************************************************
+* Summary:
+*  Computes the twiddle factors. Must be called once before any transform.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_fft_init(void)
+{
+    const double pi = 3.14159265358979323846;
+
+    for (uint32_t k = 0; k < (3u * AUDIO_FFT_MAX_SIZE / 4u); k++)
+    {
+        double angle = 2.0 * pi * (double)k / (double)AUDIO_FFT_MAX_SIZE;
+        double c = cos(angle);
+        double s = sin(angle);
+
+        twiddle_q15[2u * k]      = (int16_t)lround(fmin(c * 32768.0, 32767.0));
+        twiddle_q15[2u * k + 1u] = (int16_t)lround(fmin(s * 32768.0, 32767.0));
+        twiddle_q31[2u * k]      = (int32_t)llround(fmin(c * 2147483648.0, 2147483647.0));
+        twiddle_q31[2u * k + 1u] = (int32_t)llround(fmin(s * 2147483648.0, 2147483647.0));
+    }
+
+    for (uint32_t k = 0; k < AUDIO_FFT_MAX_SIZE; k++)
+    {
+        double angle = pi * (double)k / (double)AUDIO_FFT_MAX_SIZE;
+
+        split_q31[2u * k]      = (int32_t)llround(fmin(cos(angle) * 2147483648.0, 2147483647.0));
+        split_q31[2u * k + 1u] = (int32_t)llround(fmin(sin(angle) * 2147483648.0, 2147483647.0));
+    }
+
+#if AUDIO_FFT_USE_CMSIS_DSP
+    (void)arm_rfft_init_q31(&rfft_instance, AUDIO_FFT_RFFT_SIZE, 0, 1);
+#endif
+}
+
+/*******************************************************************************
+* Function Name: audio_fft_cfft_q15
+********************************************************************************
+* Summary:
+*  In-place forward complex FFT in Q15, output scaled by 1/n in natural
+*  order.
+*
+* Parameters:
+*  data: n interleaved complex values
+*  n: Transform length, 16, 64 or 256
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_fft_cfft_q15(int16_t *data, uint32_t n)
+{
+#if AUDIO_FFT_USE_CMSIS_DSP
+    const arm_cfft_instance_q15 *instance = (n == 16u) ? &arm_cfft_sR_q15_len16 :
+                                            (n == 64u) ? &arm_cfft_sR_q15_len64 : &arm_cfft_sR_q15_len256;
+    arm_cfft_q15(instance, data, 0, 1);
+#else
+    for (uint32_t n1 = n; n1 > 1u; n1 >>= 2)
+    {
+        uint32_t n2 = n1 >> 2;
+        uint32_t step = AUDIO_FFT_MAX_SIZE / n1;
+
+        for (uint32_t j = 0; j < n2; j++)
+        {
+            const int16_t *w1 = &twiddle_q15[2u * (j * step)];
+            const int16_t *w2 = &twiddle_q15[2u * (2u * j * step)];
+            const int16_t *w3 = &twiddle_q15[2u * (3u * j * step)];
+
+            for (uint32_t i = j; i < n; i += n1)
+            {
+                int16_t *a = &data[2u * i];
+                int16_t *b = &data[2u * (i + n2)];
+                int16_t *c = &data[2u * (i + 2u * n2)];
+                int16_t *d = &data[2u * (i + 3u * n2)];
+
+                int32_t t0r = (a[0] >> 2) + (c[0] >> 2);
+                int32_t t0i = (a[1] >> 2) + (c[1] >> 2);
+                int32_t t1r = (a[0] >> 2) - (c[0] >> 2);
+                int32_t t1i = (a[1] >> 2) - (c[1] >> 2);
+                int32_t t2r = (b[0] >> 2) + (d[0] >> 2);
+                int32_t t2i = (b[1] >> 2) + (d[1] >> 2);
+                int32_t t3r = (b[0] >> 2) - (d[0] >> 2);
+                int32_t t3i = (b[1] >> 2) - (d[1] >> 2);
+
+                /* y0 = t0 + t2, y2 = t0 - t2, y1 = t1 - j*t3, y3 = t1 + j*t3 */
+                int32_t y2r = t0r - t2r;
+                int32_t y2i = t0i - t2i;
+                int32_t y1r = t1r + t3i;
+                int32_t y1i = t1i - t3r;
+                int32_t y3r = t1r - t3i;
+                int32_t y3i = t1i + t3r;
+
+                a[0] = (int16_t)(t0r + t2r);
+                a[1] = (int16_t)(t0i + t2i);
+
+                /* Multiplication by the conjugate of (cos, sin) */
+                b[0] = (int16_t)((y2r * w2[0] + y2i * w2[1]) >> 15);
+                b[1] = (int16_t)((y2i * w2[0] - y2r * w2[1]) >> 15);
+                c[0] = (int16_t)((y1r * w1[0] + y1i * w1[1]) >> 15);
+                c[1] = (int16_t)((y1i * w1[0] - y1r * w1[1]) >> 15);
+                d[0] = (int16_t)((y3r * w3[0] + y3i * w3[1]) >> 15);
+                d[1] = (int16_t)((y3i * w3[0] - y3r * w3[1]) >> 15);
+            }
+        }
+    }
+
+    bit_reverse_q15(data, n);
+#endif
+}
+
+/*******************************************************************************
+* Function Name: audio_fft_cfft_q31
+********************************************************************************
+* Summary:
+*  In-place forward complex FFT in Q31, output scaled by 1/n in natural
+*  order.
+*
+* Parameters:
+*  data: n interleaved complex values
+*  n: Transform length, 16, 64 or 256
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_fft_cfft_q31(int32_t *data, uint32_t n)
+{
+#if AUDIO_FFT_USE_CMSIS_DSP
+    const arm_cfft_instance_q31 *instance = (n == 16u) ? &arm_cfft_sR_q31_len16 :
+                                            (n == 64u) ? &arm_cfft_sR_q31_len64 : &arm_cfft_sR_q31_len256;
+    arm_cfft_q31(instance, data, 0, 1);
+#else
+    for (uint32_t n1 = n; n1 > 1u; n1 >>= 2)
+    {
+        uint32_t n2 = n1 >> 2;
+        uint32_t step = AUDIO_FFT_MAX_SIZE / n1;
+
+        for (uint32_t j = 0; j < n2; j++)
+        {
+            const int32_t *w1 = &twiddle_q31[2u * (j * step)];
+            const int32_t *w2 = &twiddle_q31[2u * (2u * j * step)];
+            const int32_t *w3 = &twiddle_q31[2u * (3u * j * step)];
+
+            for (uint32_t i = j; i < n; i += n1)
+            {
+                int32_t *a = &data[2u * i];
+                int32_t *b = &data[2u * (i + n2)];
+                int32_t *c = &data[2u * (i + 2u * n2)];
+                int32_t *d = &data[2u * (i + 3u * n2)];
+
+                int32_t t0r = (a[0] >> 2) + (c[0] >> 2);
+                int32_t t0i = (a[1] >> 2) + (c[1] >> 2);
+                int32_t t1r = (a[0] >> 2) - (c[0] >> 2);
+                int32_t t1i = (a[1] >> 2) - (c[1] >> 2);
+                int32_t t2r = (b[0] >> 2) + (d[0] >> 2);
+                int32_t t2i = (b[1] >> 2) + (d[1] >> 2);
+                int32_t t3r = (b[0] >> 2) - (d[0] >> 2);
+                int32_t t3i = (b[1] >> 2) - (d[1] >> 2);
+
+                int32_t y2r = t0r - t2r;
+                int32_t y2i = t0i - t2i;
+                int32_t y1r = t1r + t3i;
+                int32_t y1i = t1i - t3r;
+                int32_t y3r = t1r - t3i;
+                int32_t y3i = t1i + t3r;
+
+                a[0] = t0r + t2r;
+                a[1] = t0i + t2i;
+
+                b[0] = mul_q31(y2r, w2[0]) + mul_q31(y2i, w2[1]);
+                b[1] = mul_q31(y2i, w2[0]) - mul_q31(y2r, w2[1]);
+                c[0] = mul_q31(y1r, w1[0]) + mul_q31(y1i, w1[1]);
+                c[1] = mul_q31(y1i, w1[0]) - mul_q31(y1r, w1[1]);
+                d[0] = mul_q31(y3r, w3[0]) + mul_q31(y3i, w3[1]);
+                d[1] = mul_q31(y3i, w3[0]) - mul_q31(y3r, w3[1]);
+            }
+        }
+    }
+
+    bit_reverse_q31(data, n);
+#endif
+}
+
+/*******************************************************************************
+* Function Name: audio_fft_rfft_q31
+********************************************************************************
+* Summary:
+*  Forward FFT of AUDIO_FFT_RFFT_SIZE real Q31 samples, output scaled by
+*  1 / AUDIO_FFT_RFFT_SIZE. The input buffer is used as work area.
+*
+* Parameters:
+*  data: AUDIO_FFT_RFFT_SIZE real samples, overwritten
+*  bins: Output, AUDIO_FFT_RFFT_BINS interleaved complex values
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_fft_rfft_q31(int32_t *data, int32_t *bins)
+{
+#if AUDIO_FFT_USE_CMSIS_DSP
+    /* The output holds the whole spectrum, bins past Nyquist are not needed */
+    static int32_t spectrum[2u * AUDIO_FFT_RFFT_SIZE];
+
+    arm_rfft_q31(&rfft_instance, data, spectrum);
+    for (uint32_t k = 0; k < (2u * AUDIO_FFT_RFFT_BINS); k++)
+    {
+        bins[k] = spectrum[k];
+    }
+#else
+    const uint32_t n = AUDIO_FFT_MAX_SIZE;
+
+    /* z[k] = x[2k] + j x[2k+1], already laid out that way in 'data' */
+    audio_fft_cfft_q31(data, n);
+
+    for (uint32_t k = 0; k <= n; k++)
+    {
+        uint32_t k0 = (k == n) ? 0u : k;
+        uint32_t k1 = (k == 0u) ? 0u : (n - k);
+
+        int32_t zr = data[2u * k0] >> 1;
+        int32_t zi = data[2u * k0 + 1u] >> 1;
+        int32_t cr = data[2u * k1] >> 1;
+        int32_t ci = -(data[2u * k1 + 1u] >> 1);
+
+        /* Even part e = (z[k] + conj(z[n-k])) / 2, odd part o = (z[k] - conj(z[n-k])) / 2j */
+        int32_t er = zr + cr;
+        int32_t ei = zi + ci;
+        int32_t or_ = zi - ci;
+        int32_t oi = cr - zr;
+
+        /* X[k] = (e + o * exp(-j pi k / n)) / 2 */
+        int32_t wr;
+        int32_t ws;
+        if (k < n)
+        {
+            wr = split_q31[2u * k];
+            ws = split_q31[2u * k + 1u];
+        }
+        else
+        {
+            wr = INT32_MIN;
+            ws = 0;
+        }
+
+        int32_t pr = mul_q31(or_, wr) + mul_q31(oi, ws);
+        int32_t pi_ = mul_q31(oi, wr) - mul_q31(or_, ws);
+
+        bins[2u * k]      = (er >> 1) + (pr >> 1);
+        bins[2u * k + 1u] = (ei >> 1) + (pi_ >> 1);
+    }
+#endif
+}
+
+/*******************************************************************************
+* Function Name: audio_fft_rifft_q31
+********************************************************************************
+* Summary:
+*  Inverse of audio_fft_rfft_q31: returns AUDIO_FFT_RFFT_SIZE real samples
+*  from the bins DC to Nyquist, scaled by 1 / (2 * AUDIO_FFT_RFFT_SIZE)
+*  relative to an exact inverse, so rifft(rfft(x)) = x / 1024. The scaling
+*  keeps any spectrum of magnitudes up to 1 from overflowing.
+*
+* Parameters:
+*  bins: AUDIO_FFT_RFFT_BINS interleaved complex values
+*  data: Output, AUDIO_FFT_RFFT_SIZE real samples
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_fft_rifft_q31(const int32_t *bins, int32_t *data)
+{
+    const uint32_t n = AUDIO_FFT_MAX_SIZE;
+
+    for (uint32_t k = 0; k < n; k++)
+    {
+        int32_t ar = bins[2u * k] >> 2;
+        int32_t ai = bins[2u * k + 1u] >> 2;
+        int32_t br = bins[2u * (n - k)] >> 2;
+        int32_t bi = -(bins[2u * (n - k) + 1u] >> 2);
+
+        /* Spectra of the even samples e = X[k] + conj(X[n-k]) and of the odd
+         * samples o = (X[k] - conj(X[n-k])) exp(j pi k / n) */
+        int32_t er = ar + br;
+        int32_t ei = ai + bi;
+        int32_t dr = ar - br;
+        int32_t di = ai - bi;
+        int32_t wr = split_q31[2u * k];
+        int32_t ws = split_q31[2u * k + 1u];
+        int32_t or_ = mul_q31(dr, wr) - mul_q31(di, ws);
+        int32_t oi = mul_q31(di, wr) + mul_q31(dr, ws);
+
+        /* Z[k] = e + j o, conjugated so that the forward FFT inverts it */
+        data[2u * k] = er - oi;
+        data[2u * k + 1u] = -(ei + or_);
+    }
+
+    /* z[m] = x[2m] + j x[2m+1], conjugated back */
+    audio_fft_cfft_q31(data, n);
+    for (uint32_t m = 0; m < n; m++)
+    {
+        data[2u * m + 1u] = -data[2u * m + 1u];
+    }
+}
+
+/*******************************************************************************
+* Function Name: log2_of
+********************************************************************************
+* Summary:
+*  Returns log2 of a power of two.
+*
+*******************************************************************************/
+static uint32_t log2_of(uint32_t n)
+{
+    uint32_t bits = 0;
+
+    while ((1u << bits) < n)
+    {
+        bits++;
+    }
+    return bits;
+}
+
+/*******************************************************************************
+* Function Name: bit_reverse_q15
+********************************************************************************
+* Summary:
+*  Puts the output of the radix-4 stages into natural order.
+*
+*******************************************************************************/
+static void bit_reverse_q15(int16_t *data, uint32_t n)
+{
+    uint32_t bits = log2_of(n);
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t r = 0;
+        for (uint32_t b = 0; b < bits; b++)
+        {
+            r |= ((i >> b) & 1u) << (bits - 1u - b);
+        }
+
+        if (r > i)
+        {
+            int16_t tr = data[2u * i];
+            int16_t ti = data[2u * i + 1u];
+            data[2u * i] = data[2u * r];
+            data[2u * i + 1u] = data[2u * r + 1u];
+            data[2u * r] = tr;
+            data[2u * r + 1u] = ti;
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: bit_reverse_q31
+********************************************************************************
+* Summary:
+*  Puts the output of the radix-4 stages into natural order.
+*
+*******************************************************************************/
+static void bit_reverse_q31(int32_t *data, uint32_t n)
+{
+    uint32_t bits = log2_of(n);
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t r = 0;
+        for (uint32_t b = 0; b < bits; b++)
+        {
+            r |= ((i >> b) & 1u) << (bits - 1u - b);
+        }
+
+        if (r > i)
+        {
+            int32_t tr = data[2u * i];
+            int32_t ti = data[2u * i + 1u];
+            data[2u * i] = data[2u * r];
+            data[2u * i + 1u] = data[2u * r + 1u];
+            data[2u * r] = tr;
+            data[2u * r + 1u] = ti;
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: mul_q31
+********************************************************************************
+* Summary:
+*  Q31 multiplication, truncated.
+*
+*******************************************************************************/
+static inline int32_t mul_q31(int32_t a, int32_t b)
+{
+    return (int32_t)(((int64_t)a * b) >> 31);
+}
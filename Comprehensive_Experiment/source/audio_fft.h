@@ -0,0 +1,44 @@
+/******************************************************************************
+* File Name:   audio_fft.h
+*
+* Description: This file contains the fixed-point FFT of the on-device
+* feature extraction: an in-place radix-4 complex FFT in Q15 and Q31, and a
+* real-input FFT and its inverse built on the Q31 one.
+*
+* Complex data is interleaved (real, imaginary). The transforms scale their
+* output by 1/n, so they cannot overflow. Define AUDIO_FFT_USE_CMSIS_DSP to 1
+* and add the CMSIS-DSP library to the build to run them on the CMSIS-DSP
+* kernels instead, which use the same layout and scaling; the portable
+* kernels below are used otherwise.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_FFT_H_
+#define AUDIO_FFT_H_
+
+#include <stdint.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#ifndef AUDIO_FFT_USE_CMSIS_DSP
+#define AUDIO_FFT_USE_CMSIS_DSP             (0)
+#endif
+
+/* Largest complex FFT, a power of 4 */
+#define AUDIO_FFT_MAX_SIZE                  (256u)
+/* Length of the real-input FFT */
+#define AUDIO_FFT_RFFT_SIZE                 (2u * AUDIO_FFT_MAX_SIZE)
+/* Number of bins of the real-input FFT, DC to Nyquist */
+#define AUDIO_FFT_RFFT_BINS                 (AUDIO_FFT_RFFT_SIZE / 2u + 1u)
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void audio_fft_init(void);
+void audio_fft_cfft_q15(int16_t *data, uint32_t n);
+void audio_fft_cfft_q31(int32_t *data, uint32_t n);
+void audio_fft_rfft_q31(int32_t *data, int32_t *bins);
+void audio_fft_rifft_q31(const int32_t *bins, int32_t *data);
+
+#endif /* AUDIO_FFT_H_ */
@@ -0,0 +1,205 @@
+/******************************************************************************
+* File Name:   audio_gain.c
+*
+* Description: This file contains the closed-loop control of the PDM/PCM
+* hardware gain.
+*
+* The controller keeps an envelope of the RMS level of speech frames in dBFS
+* with separate attack and release time constants; non-speech frames are not
+* followed, so pauses do not raise the gain onto the noise. The gain moves
+* towards the one that brings the envelope to AUDIO_GAIN_TARGET_RMS_DBFS in
+* whole AUDIO_GAIN_STEP steps, a step being taken only once the error exceeds
+* one and a half steps so the gain does not toggle around the target, and
+* increases at most every AUDIO_GAIN_RAISE_INTERVAL_FRAMES frames. A
+* frame whose peak reaches AUDIO_GAIN_PEAK_LIMIT_DBFS lowers the gain at once
+* by as much as needed, speech or not.
+*
+* After a change the envelope is moved by the same amount, since it was
+* measured at the old gain, and the next AUDIO_GAIN_SETTLE_FRAMES frames are
+* ignored because they were captured before the new gain took effect. The
+* noise estimates of the VAD, the noise suppressor and the telemetry have to
+* be moved as well, by audio_gain_power_ratio_q16, or a quiet background
+* raised by the gain looks like speech to them.
+*
+*******************************************************************************/
+
+#include <math.h>
+
+#include "audio_gain.h"
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static float level_dbfs(uint16_t level);
+static int16_t gain_clamp(int32_t gain);
+
+/*******************************************************************************
+* Function Name: audio_gain_init
+********************************************************************************
+* Summary:
+*  Initializes the controller at a hardware gain.
+*
+* Parameters:
+*  ctrl: Gain controller
+*  gain: Hardware gain programmed at start, 0.5 dB units
+*  frame_ms: Duration of a frame in milliseconds
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_gain_init(audio_gain_t *ctrl, int16_t gain, uint32_t frame_ms)
+{
+    ctrl->gain = gain_clamp(gain);
+    ctrl->level_dbfs = AUDIO_GAIN_TARGET_RMS_DBFS;
+    ctrl->attack_coef = 1.0f - expf(-(float)frame_ms / AUDIO_GAIN_ATTACK_MS);
+    ctrl->release_coef = 1.0f - expf(-(float)frame_ms / AUDIO_GAIN_RELEASE_MS);
+    ctrl->settle_frames = 0;
+    ctrl->raise_frames = 0;
+    ctrl->level_valid = false;
+}
+
+/*******************************************************************************
+* Function Name: audio_gain_update
+********************************************************************************
+* Summary:
+*  Updates the controller with the statistics of a frame captured at the
+*  current gain and returns whether the gain has to be programmed.
+*
+* Parameters:
+*  ctrl: Gain controller
+*  rms: RMS of the frame, in 16-bit sample units
+*  peak: Peak magnitude of the frame
+*  speech: VAD decision of the frame
+*
+* Return:
+*  bool: true if ctrl->gain changed
+*
+*******************************************************************************/
+bool audio_gain_update(audio_gain_t *ctrl, uint16_t rms, uint16_t peak, bool speech)
+{
+    float peak_dbfs;
+    int32_t change = 0;
+
+    if (ctrl->raise_frames > 0u)
+    {
+        ctrl->raise_frames--;
+    }
+
+    if (ctrl->settle_frames > 0u)
+    {
+        ctrl->settle_frames--;
+        return false;
+    }
+
+    peak_dbfs = level_dbfs(peak);
+    if (peak_dbfs >= AUDIO_GAIN_PEAK_LIMIT_DBFS)
+    {
+        /* Down by whole steps until the peak is a step below the limit */
+        float over = peak_dbfs - AUDIO_GAIN_PEAK_LIMIT_DBFS;
+        change = -(int32_t)AUDIO_GAIN_STEP * ((int32_t)(over * 2.0f / (float)AUDIO_GAIN_STEP) + 1);
+    }
+    else if (speech)
+    {
+        float rms_dbfs = level_dbfs(rms);
+
+        if (!ctrl->level_valid)
+        {
+            ctrl->level_dbfs = rms_dbfs;
+            ctrl->level_valid = true;
+        }
+        else if (rms_dbfs > ctrl->level_dbfs)
+        {
+            ctrl->level_dbfs += ctrl->attack_coef * (rms_dbfs - ctrl->level_dbfs);
+        }
+        else
+        {
+            ctrl->level_dbfs += ctrl->release_coef * (rms_dbfs - ctrl->level_dbfs);
+        }
+
+        /* Error in 0.5 dB units, acted on beyond one and a half steps */
+        float error = (AUDIO_GAIN_TARGET_RMS_DBFS - ctrl->level_dbfs) * 2.0f;
+        if ((error >= 1.5f * (float)AUDIO_GAIN_STEP) && (ctrl->raise_frames == 0u))
+        {
+            change = AUDIO_GAIN_STEP;
+        }
+        else if (error <= -1.5f * (float)AUDIO_GAIN_STEP)
+        {
+            change = -AUDIO_GAIN_STEP;
+        }
+    }
+
+    change = gain_clamp(ctrl->gain + change) - ctrl->gain;
+    if (change == 0)
+    {
+        return false;
+    }
+
+    ctrl->gain = (int16_t)(ctrl->gain + change);
+    ctrl->level_dbfs += (float)change * 0.5f;
+    ctrl->settle_frames = AUDIO_GAIN_SETTLE_FRAMES;
+    if (change > 0)
+    {
+        ctrl->raise_frames = AUDIO_GAIN_RAISE_INTERVAL_FRAMES;
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: audio_gain_power_ratio_q16
+********************************************************************************
+* Summary:
+*  Returns the factor by which a gain change scales the power of the
+*  captured frames, for the noise estimates measured at the old gain.
+*
+* Parameters:
+*  from: Gain the estimates were measured at, 0.5 dB units
+*  to: New gain, 0.5 dB units
+*
+* Return:
+*  uint32_t: Power ratio in Q16, within 2^-11 and 2^11 over the gain range
+*
+*******************************************************************************/
+uint32_t audio_gain_power_ratio_q16(int16_t from, int16_t to)
+{
+    float ratio = powf(10.0f, (float)(to - from) * 0.05f);
+
+    return (uint32_t)(ratio * 65536.0f + 0.5f);
+}
+
+/*******************************************************************************
+* Function Name: level_dbfs
+********************************************************************************
+* Summary:
+*  Converts a level in 16-bit sample units to dBFS, silence giving -96 dBFS.
+*
+*******************************************************************************/
+static float level_dbfs(uint16_t level)
+{
+    if (level == 0u)
+    {
+        return -96.0f;
+    }
+    return 20.0f * log10f((float)level / 32768.0f);
+}
+
+/*******************************************************************************
+* Function Name: gain_clamp
+********************************************************************************
+* Summary:
+*  Limits a gain to the range of the PDM/PCM block.
+*
+*******************************************************************************/
+static int16_t gain_clamp(int32_t gain)
+{
+    if (gain < AUDIO_GAIN_MIN)
+    {
+        return AUDIO_GAIN_MIN;
+    }
+    if (gain > AUDIO_GAIN_MAX)
+    {
+        return AUDIO_GAIN_MAX;
+    }
+    return (int16_t)gain;
+}
@@ -0,0 +1,62 @@
+/******************************************************************************
+* File Name:   audio_gain.h
+*
+* Description: This file contains the closed-loop control of the PDM/PCM
+* hardware gain. The controller only sees the level statistics of each frame
+* and returns the gain to program, so it runs unchanged on a host against
+* recorded level traces.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_GAIN_H_
+#define AUDIO_GAIN_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Gains are in 0.5 dB units like cyhal_pdm_pcm_set_gain takes them */
+#define AUDIO_GAIN_DEFAULT                  (21)        /* +10.5 dB */
+#define AUDIO_GAIN_MIN                      (-24)       /* -12 dB */
+#define AUDIO_GAIN_MAX                      (42)        /* +21 dB */
+/* Resolution of the PDM/PCM gain stage, 1.5 dB */
+#define AUDIO_GAIN_STEP                     (3)
+
+/* Speech level the controller aims for and the peak level it keeps below */
+#define AUDIO_GAIN_TARGET_RMS_DBFS          (-26.0f)
+#define AUDIO_GAIN_PEAK_LIMIT_DBFS          (-3.0f)
+/* Time constants of the level envelope: rising levels are followed within
+ * the attack time, falling ones within the release time */
+#define AUDIO_GAIN_ATTACK_MS                (30.0f)
+#define AUDIO_GAIN_RELEASE_MS               (2000.0f)
+/* Frames still captured with the previous gain after a change, they are not
+ * measured */
+#define AUDIO_GAIN_SETTLE_FRAMES            (3u)
+/* Frames between two gain increases, limiting them to 6 dB/s; decreases
+ * only wait for the settling */
+#define AUDIO_GAIN_RAISE_INTERVAL_FRAMES    (25u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    int16_t  gain;                  /* Hardware gain, 0.5 dB units */
+    float    level_dbfs;            /* Envelope of the speech RMS at the current gain */
+    float    attack_coef;
+    float    release_coef;
+    uint32_t settle_frames;         /* Frames left before the next measurement */
+    uint32_t raise_frames;          /* Frames left before the next increase */
+    bool     level_valid;           /* No speech has been measured yet if false */
+} audio_gain_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void audio_gain_init(audio_gain_t *ctrl, int16_t gain, uint32_t frame_ms);
+bool audio_gain_update(audio_gain_t *ctrl, uint16_t rms, uint16_t peak, bool speech);
+uint32_t audio_gain_power_ratio_q16(int16_t from, int16_t to);
+
+#endif /* AUDIO_GAIN_H_ */
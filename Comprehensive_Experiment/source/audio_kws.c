@@ -0,0 +1,521 @@
+/******************************************************************************
+* File Name:   audio_kws.c
+*
+* Description: This file contains the wake word detector.
+*
+* The feature window is a ring of quantized MFCC rows; before an inference
+* it is copied oldest first into the input tensor. The layers then run one
+* after the other between two activation buffers of the arena, each sized
+* for the largest tensor of the model. The kernels are plain C loops in the
+* arithmetic of the TensorFlow Lite int8 reference kernels, so the output
+* matches the one of the exported model bit for bit. The dot products of
+* the convolutions and the fully connected layer, where nearly all the time
+* goes, use the SIMD instructions on cores with the DSP extension: four
+* int8 values are widened into two int16 pairs and multiplied with SMLAD.
+*
+*******************************************************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include "audio_kws.h"
+#include "audio_arena.h"
+#include "audio_dsp.h"
+
+#if AUDIO_DSP_USE_SIMD
+#include "cmsis_compiler.h"
+#endif
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static uint64_t arena_buffer[AUDIO_KWS_ARENA_SIZE / sizeof(uint64_t)];
+static audio_arena_t arena;
+static int8_t *activations[2];
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static float kws_invoke(audio_kws_t *kws);
+static void layer_conv(const audio_kws_layer_t *layer, const int8_t *in, int8_t *out);
+static void layer_depthwise(const audio_kws_layer_t *layer, const int8_t *in, int8_t *out);
+static void layer_avg_pool(const audio_kws_layer_t *layer, const int8_t *in, int8_t *out);
+static void layer_fully_connected(const audio_kws_layer_t *layer, const int8_t *in, int8_t *out);
+static int32_t dot_q7(const int8_t *in, const int8_t *weights, int32_t n, int32_t offset, int32_t acc);
+static int32_t dot_q7_ref(const int8_t *in, const int8_t *weights, int32_t n, int32_t offset, int32_t acc);
+static int32_t requantize(int32_t value, int32_t multiplier, int32_t shift);
+static int8_t clamp(int32_t value, int32_t min, int32_t max);
+
+/*******************************************************************************
+* Function Name: audio_kws_init
+********************************************************************************
+* Summary:
+*  Checks the model and allocates its activation buffers from the arena.
+*  audio_mfcc_init must have been called before.
+*
+* Parameters:
+*  kws: Detector state
+*
+* Return:
+*  bool: true if the detector can run, false if there is no usable model
+*
+*******************************************************************************/
+bool audio_kws_init(audio_kws_t *kws)
+{
+    const audio_kws_model_t *model = &audio_kws_model;
+    uint32_t max_size = 0;
+
+    kws->ready = false;
+    audio_kws_reset(kws);
+
+    if ((model->num_layers == 0u) || (model->num_labels > AUDIO_KWS_MAX_LABELS) ||
+        (model->keyword_index >= model->num_labels) ||
+        (model->layers[0].in_h != AUDIO_KWS_NUM_FRAMES) ||
+        (model->layers[0].in_w != AUDIO_KWS_NUM_FEATURES) || (model->layers[0].in_c != 1u) ||
+        (model->layers[model->num_layers - 1u].out_c != model->num_labels))
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < model->num_layers; i++)
+    {
+        const audio_kws_layer_t *layer = &model->layers[i];
+        uint32_t in_size = (uint32_t)layer->in_h * layer->in_w * layer->in_c;
+        uint32_t out_size = (uint32_t)layer->out_h * layer->out_w * layer->out_c;
+
+        max_size = (in_size > max_size) ? in_size : max_size;
+        max_size = (out_size > max_size) ? out_size : max_size;
+    }
+
+    audio_arena_init(&arena, arena_buffer, sizeof(arena_buffer));
+    activations[0] = audio_arena_alloc(&arena, max_size);
+    activations[1] = audio_arena_alloc(&arena, max_size);
+    if ((activations[0] == NULL) || (activations[1] == NULL))
+    {
+        return false;
+    }
+
+    kws->ready = true;
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: audio_kws_reset
+********************************************************************************
+* Summary:
+*  Empties the feature window, for a restart of the audio stream.
+*
+* Parameters:
+*  kws: Detector state
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_kws_reset(audio_kws_t *kws)
+{
+    audio_mfcc_reset(&kws->mfcc);
+    kws->head = 0;
+    kws->count = 0;
+    kws->stride = 0;
+    kws->speech_frames = 0;
+    kws->refractory = 0;
+    kws->score_index = 0;
+    kws->score = 0.0f;
+    memset(kws->scores, 0, sizeof(kws->scores));
+}
+
+/*******************************************************************************
+* Function Name: audio_kws_process
+********************************************************************************
+* Summary:
+*  Adds one frame to the feature window and runs the network when due.
+*
+* Parameters:
+*  kws: Detector state
+*  samples: AUDIO_MFCC_HOP_SAMPLES samples at AUDIO_MFCC_SAMPLE_RATE_HZ
+*  speech: VAD decision of the frame
+*
+* Return:
+*  bool: true when the wake word was detected
+*
+*******************************************************************************/
+bool audio_kws_process(audio_kws_t *kws, const int16_t *samples, bool speech)
+{
+    const audio_kws_model_t *model = &audio_kws_model;
+    int16_t log_mel[AUDIO_MFCC_NUM_BANDS];
+    int32_t coeffs[AUDIO_MFCC_NUM_COEFFS];
+
+    if (!kws->ready)
+    {
+        return false;
+    }
+
+    audio_mfcc_process(&kws->mfcc, samples, log_mel, coeffs);
+
+    for (uint32_t i = 0; i < AUDIO_KWS_NUM_FEATURES; i++)
+    {
+        kws->features[kws->head][i] = clamp(requantize(coeffs[i], model->input_multiplier, model->input_shift) +
+                                            model->input_zero_point, INT8_MIN, INT8_MAX);
+    }
+    kws->head = (kws->head + 1u) % AUDIO_KWS_NUM_FRAMES;
+    kws->count = (kws->count < AUDIO_KWS_NUM_FRAMES) ? (kws->count + 1u) : kws->count;
+
+    kws->speech_frames = speech ? AUDIO_KWS_NUM_FRAMES : ((kws->speech_frames > 0u) ? (kws->speech_frames - 1u) : 0u);
+    kws->refractory = (kws->refractory > 0u) ? (kws->refractory - 1u) : 0u;
+
+    /* Nothing to detect while the window holds no speech */
+    if ((kws->count < AUDIO_KWS_NUM_FRAMES) || (kws->speech_frames == 0u))
+    {
+        kws->stride = 0;
+        kws->score = 0.0f;
+        memset(kws->scores, 0, sizeof(kws->scores));
+        return false;
+    }
+
+    if (++kws->stride < AUDIO_KWS_STRIDE_FRAMES)
+    {
+        return false;
+    }
+    kws->stride = 0;
+
+    kws->scores[kws->score_index] = kws_invoke(kws);
+    kws->score_index = (kws->score_index + 1u) % AUDIO_KWS_SMOOTH_INFERENCES;
+
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < AUDIO_KWS_SMOOTH_INFERENCES; i++)
+    {
+        sum += kws->scores[i];
+    }
+    kws->score = sum / (float)AUDIO_KWS_SMOOTH_INFERENCES;
+
+    if ((kws->score >= AUDIO_KWS_THRESHOLD) && (kws->refractory == 0u))
+    {
+        kws->refractory = AUDIO_KWS_REFRACTORY_FRAMES;
+        memset(kws->scores, 0, sizeof(kws->scores));
+        return true;
+    }
+
+    return false;
+}
+
+/*******************************************************************************
+* Function Name: kws_invoke
+********************************************************************************
+* Summary:
+*  Runs the network over the feature window.
+*
+* Parameters:
+*  kws: Detector state
+*
+* Return:
+*  float: Probability of the wake word
+*
+*******************************************************************************/
+static float kws_invoke(audio_kws_t *kws)
+{
+    const audio_kws_model_t *model = &audio_kws_model;
+    int8_t *in = activations[0];
+    int8_t *out = activations[1];
+    float probs[AUDIO_KWS_MAX_LABELS];
+
+    /* Oldest row first; the ring is full, so the oldest row is at head */
+    uint32_t first = AUDIO_KWS_NUM_FRAMES - kws->head;
+    memcpy(in, kws->features[kws->head], first * AUDIO_KWS_NUM_FEATURES);
+    memcpy(&in[first * AUDIO_KWS_NUM_FEATURES], kws->features[0], kws->head * AUDIO_KWS_NUM_FEATURES);
+
+    for (uint32_t i = 0; i < model->num_layers; i++)
+    {
+        const audio_kws_layer_t *layer = &model->layers[i];
+
+        switch (layer->type)
+        {
+            case AUDIO_KWS_LAYER_CONV:
+                layer_conv(layer, in, out);
+                break;
+            case AUDIO_KWS_LAYER_DEPTHWISE:
+                layer_depthwise(layer, in, out);
+                break;
+            case AUDIO_KWS_LAYER_AVG_POOL:
+                layer_avg_pool(layer, in, out);
+                break;
+            default:
+                layer_fully_connected(layer, in, out);
+                break;
+        }
+
+        int8_t *swap = in;
+        in = out;
+        out = swap;
+    }
+
+    /* Softmax of the dequantized logits */
+    float max_logit = -INFINITY;
+    for (uint32_t i = 0; i < model->num_labels; i++)
+    {
+        probs[i] = (float)(in[i] - model->output_zero_point) * model->output_scale;
+        max_logit = (probs[i] > max_logit) ? probs[i] : max_logit;
+    }
+
+    float total = 0.0f;
+    for (uint32_t i = 0; i < model->num_labels; i++)
+    {
+        probs[i] = expf(probs[i] - max_logit);
+        total += probs[i];
+    }
+
+    return probs[model->keyword_index] / total;
+}
+
+/*******************************************************************************
+* Function Name: layer_conv
+********************************************************************************
+* Summary:
+*  Convolution with zero padding (padding is at the input zero point).
+*
+*******************************************************************************/
+static void layer_conv(const audio_kws_layer_t *layer, const int8_t *in, int8_t *out)
+{
+    /* Local copies, the compiler cannot keep them in registers across the
+     * int8 stores otherwise */
+    const int32_t in_h = layer->in_h;
+    const int32_t in_w = layer->in_w;
+    const int32_t in_c = layer->in_c;
+    const int32_t kernel_h = layer->kernel_h;
+    const int32_t kernel_w = layer->kernel_w;
+    const int32_t input_offset = layer->input_offset;
+
+    for (int32_t oy = 0; oy < layer->out_h; oy++)
+    {
+        for (int32_t ox = 0; ox < layer->out_w; ox++)
+        {
+            for (int32_t oc = 0; oc < layer->out_c; oc++)
+            {
+                const int8_t *weights = &layer->weights[oc * kernel_h * kernel_w * in_c];
+                int32_t acc = layer->bias[oc];
+
+                for (int32_t ky = 0; ky < kernel_h; ky++)
+                {
+                    int32_t iy = oy * layer->stride_h - layer->pad_h + ky;
+                    if ((iy < 0) || (iy >= in_h))
+                    {
+                        continue;
+                    }
+
+                    for (int32_t kx = 0; kx < kernel_w; kx++)
+                    {
+                        int32_t ix = ox * layer->stride_w - layer->pad_w + kx;
+                        if ((ix < 0) || (ix >= in_w))
+                        {
+                            continue;
+                        }
+
+                        acc = dot_q7(&in[(iy * in_w + ix) * in_c], &weights[(ky * kernel_w + kx) * in_c],
+                                     in_c, input_offset, acc);
+                    }
+                }
+
+                acc = requantize(acc, layer->multiplier[oc], layer->shift[oc]) + layer->output_offset;
+                *out++ = clamp(acc, layer->act_min, layer->act_max);
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: layer_depthwise
+********************************************************************************
+* Summary:
+*  Depthwise convolution with a depth multiplier of 1.
+*
+*******************************************************************************/
+static void layer_depthwise(const audio_kws_layer_t *layer, const int8_t *in, int8_t *out)
+{
+    for (int32_t oy = 0; oy < layer->out_h; oy++)
+    {
+        for (int32_t ox = 0; ox < layer->out_w; ox++)
+        {
+            for (int32_t c = 0; c < layer->out_c; c++)
+            {
+                int32_t acc = layer->bias[c];
+
+                for (int32_t ky = 0; ky < layer->kernel_h; ky++)
+                {
+                    int32_t iy = oy * layer->stride_h - layer->pad_h + ky;
+                    if ((iy < 0) || (iy >= layer->in_h))
+                    {
+                        continue;
+                    }
+
+                    for (int32_t kx = 0; kx < layer->kernel_w; kx++)
+                    {
+                        int32_t ix = ox * layer->stride_w - layer->pad_w + kx;
+                        if ((ix < 0) || (ix >= layer->in_w))
+                        {
+                            continue;
+                        }
+
+                        acc += (in[(iy * layer->in_w + ix) * layer->in_c + c] + layer->input_offset) *
+                               layer->weights[(ky * layer->kernel_w + kx) * layer->out_c + c];
+                    }
+                }
+
+                acc = requantize(acc, layer->multiplier[c], layer->shift[c]) + layer->output_offset;
+                *out++ = clamp(acc, layer->act_min, layer->act_max);
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: layer_avg_pool
+********************************************************************************
+* Summary:
+*  Average pooling over the valid input pixels of each window, rounded to
+*  the nearest.
+*
+*******************************************************************************/
+static void layer_avg_pool(const audio_kws_layer_t *layer, const int8_t *in, int8_t *out)
+{
+    for (int32_t oy = 0; oy < layer->out_h; oy++)
+    {
+        for (int32_t ox = 0; ox < layer->out_w; ox++)
+        {
+            for (int32_t c = 0; c < layer->out_c; c++)
+            {
+                int32_t sum = 0;
+                int32_t count = 0;
+
+                for (int32_t ky = 0; ky < layer->kernel_h; ky++)
+                {
+                    int32_t iy = oy * layer->stride_h - layer->pad_h + ky;
+                    for (int32_t kx = 0; kx < layer->kernel_w; kx++)
+                    {
+                        int32_t ix = ox * layer->stride_w - layer->pad_w + kx;
+                        if ((iy >= 0) && (iy < layer->in_h) && (ix >= 0) && (ix < layer->in_w))
+                        {
+                            sum += in[(iy * layer->in_w + ix) * layer->in_c + c];
+                            count++;
+                        }
+                    }
+                }
+
+                int32_t average = (count == 0) ? 0 :
+                                  (sum > 0) ? ((sum + count / 2) / count) : ((sum - count / 2) / count);
+                *out++ = clamp(average, layer->act_min, layer->act_max);
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: layer_fully_connected
+********************************************************************************
+* Summary:
+*  Fully connected layer over the flattened input.
+*
+*******************************************************************************/
+static void layer_fully_connected(const audio_kws_layer_t *layer, const int8_t *in, int8_t *out)
+{
+    const int32_t in_size = layer->in_h * layer->in_w * layer->in_c;
+
+    for (int32_t oc = 0; oc < layer->out_c; oc++)
+    {
+        int32_t acc = dot_q7(in, &layer->weights[oc * in_size], in_size, layer->input_offset, layer->bias[oc]);
+
+        acc = requantize(acc, layer->multiplier[oc], layer->shift[oc]) + layer->output_offset;
+        out[oc] = clamp(acc, layer->act_min, layer->act_max);
+    }
+}
+
+/*******************************************************************************
+* Function Name: dot_q7
+********************************************************************************
+* Summary:
+*  Returns acc + sum((in[i] + offset) * weights[i]) over n int8 values.
+*
+*******************************************************************************/
+static int32_t dot_q7(const int8_t *in, const int8_t *weights, int32_t n, int32_t offset, int32_t acc)
+{
+#if AUDIO_DSP_USE_SIMD
+    /* The offset in both halfwords, added while sign extending the input */
+    uint32_t offset2 = __PKHBT((uint32_t)offset, (uint32_t)offset, 16);
+    int32_t i;
+
+    for (i = 0; (i + 4) <= n; i += 4)
+    {
+        uint32_t x;
+        uint32_t w;
+
+        memcpy(&x, &in[i], sizeof(x));
+        memcpy(&w, &weights[i], sizeof(w));
+
+        /* Bytes 0 and 2, then bytes 1 and 3, as int16 pairs */
+        acc = (int32_t)__SMLAD(__SXTAB16(offset2, x), __SXTB16(w), (uint32_t)acc);
+        acc = (int32_t)__SMLAD(__SXTAB16(offset2, __ROR(x, 8)), __SXTB16(__ROR(w, 8)), (uint32_t)acc);
+    }
+
+    return dot_q7_ref(&in[i], &weights[i], n - i, offset, acc);
+#else
+    return dot_q7_ref(in, weights, n, offset, acc);
+#endif
+}
+
+/*******************************************************************************
+* Function Name: dot_q7_ref
+********************************************************************************
+* Summary:
+*  Portable reference of dot_q7.
+*
+*******************************************************************************/
+static int32_t dot_q7_ref(const int8_t *in, const int8_t *weights, int32_t n, int32_t offset, int32_t acc)
+{
+    for (int32_t i = 0; i < n; i++)
+    {
+        acc += (in[i] + offset) * weights[i];
+    }
+
+    return acc;
+}
+
+/*******************************************************************************
+* Function Name: requantize
+********************************************************************************
+* Summary:
+*  Multiplies by multiplier * 2^shift with multiplier in Q31, rounding like
+*  the TensorFlow Lite MultiplyByQuantizedMultiplier.
+*
+*******************************************************************************/
+static int32_t requantize(int32_t value, int32_t multiplier, int32_t shift)
+{
+    int32_t left = (shift > 0) ? shift : 0;
+    int32_t right = (shift > 0) ? 0 : -shift;
+    int64_t product = (int64_t)value * ((int64_t)1 << left) * multiplier;
+    int64_t nudge = (product >= 0) ? ((int64_t)1 << 30) : (1 - ((int64_t)1 << 30));
+    int32_t high = (int32_t)((product + nudge) / ((int64_t)1 << 31));
+
+    if (right == 0)
+    {
+        return high;
+    }
+
+    int32_t mask = (int32_t)((1u << right) - 1u);
+    int32_t remainder = high & mask;
+    int32_t threshold = (mask >> 1) + ((high < 0) ? 1 : 0);
+
+    return (high >> right) + ((remainder > threshold) ? 1 : 0);
+}
+
+/*******************************************************************************
+* Function Name: clamp
+********************************************************************************
+* Summary:
+*  Saturates a value to [min, max] as int8.
+*
+*******************************************************************************/
+static int8_t clamp(int32_t value, int32_t min, int32_t max)
+{
+    value = (value < min) ? min : value;
+    value = (value > max) ? max : value;
+    return (int8_t)value;
+}
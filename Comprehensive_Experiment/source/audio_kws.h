@@ -0,0 +1,122 @@
+/******************************************************************************
+* File Name:   audio_kws.h
+*
+* Description: This file contains the wake word detector: a quantized (int8)
+* keyword spotting network, typically a DS-CNN, run over a sliding window of
+* MFCCs of the 16 kHz audio.
+*
+* The network is described by audio_kws_model (audio_kws_model.c), which is
+* generated from a quantized TensorFlow Lite model by
+* python/kws_export.py. Its input is AUDIO_KWS_NUM_FRAMES frames of the first
+* AUDIO_KWS_NUM_FEATURES MFCCs of audio_mfcc; the weights and the per-channel
+* requantization follow the TensorFlow Lite int8 scheme. Activations live in
+* a static arena of AUDIO_KWS_ARENA_SIZE bytes, never on the FreeRTOS heap.
+*
+* The MFCCs are computed for every frame, the network only runs every
+* AUDIO_KWS_STRIDE_FRAMES frames and only while the window contains frames
+* the VAD marked as speech. The keyword probability is averaged over
+* AUDIO_KWS_SMOOTH_INFERENCES inferences before it is compared with the
+* threshold.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_KWS_H_
+#define AUDIO_KWS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "audio_mfcc.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* 1 s analysis window of 10 MFCCs per 10 ms frame */
+#define AUDIO_KWS_NUM_FRAMES                (49u)
+#define AUDIO_KWS_NUM_FEATURES              (10u)
+/* One inference every 100 ms: a 64 channel DS-CNN takes about 2.7 M
+ * multiply-accumulates */
+#define AUDIO_KWS_STRIDE_FRAMES             (10u)
+#define AUDIO_KWS_SMOOTH_INFERENCES         (3u)
+/* Smoothed keyword probability that fires the detector */
+#define AUDIO_KWS_THRESHOLD                 (0.80f)
+/* No new detection for 1 s after one */
+#define AUDIO_KWS_REFRACTORY_FRAMES         (100u)
+#define AUDIO_KWS_MAX_LABELS                (12u)
+/* Activation memory: input and output of the largest layer */
+#define AUDIO_KWS_ARENA_SIZE                (24u * 1024u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef enum
+{
+    AUDIO_KWS_LAYER_CONV,           /* Convolution, weights [out_c][kernel_h][kernel_w][in_c] */
+    AUDIO_KWS_LAYER_DEPTHWISE,      /* Depthwise convolution, weights [kernel_h][kernel_w][c] */
+    AUDIO_KWS_LAYER_AVG_POOL,       /* Average pooling, same quantization in and out */
+    AUDIO_KWS_LAYER_FULLY_CONNECTED /* Weights [out_c][in_h * in_w * in_c] */
+} audio_kws_layer_type_t;
+
+/* One layer over NHWC int8 tensors. Convolutions and the fully connected
+ * layer compute sum((input + input_offset) * weight) + bias and requantize
+ * it per output channel: multiplier is Q31, shift a power of two (positive
+ * to the left). */
+typedef struct
+{
+    audio_kws_layer_type_t type;
+    uint16_t in_h, in_w, in_c;
+    uint16_t out_h, out_w, out_c;
+    uint8_t  kernel_h, kernel_w;
+    uint8_t  stride_h, stride_w;
+    uint8_t  pad_h, pad_w;          /* Padding at the top and the left */
+    int32_t  input_offset;          /* Minus the input zero point */
+    int32_t  output_offset;         /* Output zero point */
+    int32_t  act_min, act_max;      /* Output clamp, includes a fused ReLU */
+    const int8_t  *weights;
+    const int32_t *bias;
+    const int32_t *multiplier;
+    const int8_t  *shift;
+} audio_kws_layer_t;
+
+typedef struct
+{
+    const audio_kws_layer_t *layers;
+    uint32_t num_layers;
+    /* Quantization of the MFCCs (Q8 log2) into the input tensor */
+    int32_t  input_multiplier;
+    int32_t  input_shift;
+    int32_t  input_zero_point;
+    /* Dequantization of the logits of the last layer */
+    int32_t  output_zero_point;
+    float    output_scale;
+    uint32_t num_labels;
+    uint32_t keyword_index;         /* Label of the wake word */
+    const char *keyword;
+} audio_kws_model_t;
+
+typedef struct
+{
+    audio_mfcc_t mfcc;
+    int8_t   features[AUDIO_KWS_NUM_FRAMES][AUDIO_KWS_NUM_FEATURES];
+    uint32_t head;                  /* Row the next frame is written to */
+    uint32_t count;                 /* Valid rows */
+    uint32_t stride;                /* Frames since the last inference */
+    uint32_t speech_frames;         /* Frames the last speech frame stays in the window */
+    uint32_t refractory;
+    float    scores[AUDIO_KWS_SMOOTH_INFERENCES];
+    uint32_t score_index;
+    float    score;                 /* Last smoothed keyword probability */
+    bool     ready;                 /* A model is present and fits the arena */
+} audio_kws_t;
+
+extern const audio_kws_model_t audio_kws_model;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+bool audio_kws_init(audio_kws_t *kws);
+void audio_kws_reset(audio_kws_t *kws);
+bool audio_kws_process(audio_kws_t *kws, const int16_t *samples, bool speech);
+
+#endif /* AUDIO_KWS_H_ */
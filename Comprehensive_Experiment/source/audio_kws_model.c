@@ -0,0 +1,20 @@
+/******************************************************************************
+* File Name:   audio_kws_model.c
+*
+* Description: This file contains the network of the wake word detector.
+*
+* Generate it from a quantized (int8) TensorFlow Lite keyword spotting model
+* with python/kws_export.py. This placeholder has no layers, so the wake word
+* detector stays disabled until a model is exported over it.
+*
+*******************************************************************************/
+
+#include "audio_kws.h"
+
+const audio_kws_model_t audio_kws_model =
+{
+    .layers = NULL,
+    .num_layers = 0,
+    .num_labels = 0,
+    .keyword = "",
+};
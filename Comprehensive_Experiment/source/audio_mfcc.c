@@ -0,0 +1,241 @@
+/******************************************************************************
+* File Name:   audio_mfcc.c
+*
+* Description: This file contains the log-mel and MFCC feature extraction.
+*
+* The window of samples is Hamming weighted, zero padded to the real FFT
+* length and transformed with the Q31 real FFT. The power of every bin is
+* split between the two mel triangles it falls into, so one weight per bin
+* describes the whole filterbank. Band energies are accumulated in 64 bits
+* and converted to log2 with a normalization and a quadratic fit of the
+* mantissa, accurate to about 2 LSB of the Q8 result.
+*
+* The window, filterbank and DCT tables are computed once by
+* audio_mfcc_init.
+*
+*******************************************************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include "audio_mfcc.h"
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static int16_t hamming_q15[AUDIO_MFCC_WINDOW_SAMPLES];
+/* Bin k lies between the mel points bin_band[k] and bin_band[k] + 1: it
+ * belongs to the rising edge of band bin_band[k] with weight bin_weight[k]
+ * and to the falling edge of the band before with the remaining weight.
+ * Bins outside the filterbank have bin_band -1. */
+static int8_t bin_band[AUDIO_FFT_RFFT_BINS];
+static uint16_t bin_weight[AUDIO_FFT_RFFT_BINS];
+static int16_t dct_q15[AUDIO_MFCC_NUM_COEFFS][AUDIO_MFCC_NUM_BANDS];
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static double hz_to_mel(double hz);
+static int16_t log2_q8(uint64_t value);
+
+/*******************************************************************************
+* Function Name: audio_mfcc_init
+********************************************************************************
+* Summary:
+*  Computes the window, filterbank and DCT tables, and the FFT twiddles.
+*  Must be called once before audio_mfcc_process.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_mfcc_init(void)
+{
+    const double pi = 3.14159265358979323846;
+    double mel_points[AUDIO_MFCC_NUM_BANDS + 2u];
+
+    audio_fft_init();
+
+    for (uint32_t i = 0; i < AUDIO_MFCC_WINDOW_SAMPLES; i++)
+    {
+        double w = 0.54 - 0.46 * cos(2.0 * pi * (double)i / (double)(AUDIO_MFCC_WINDOW_SAMPLES - 1u));
+        hamming_q15[i] = (int16_t)lround(fmin(w * 32768.0, 32767.0));
+    }
+
+    double mel_low = hz_to_mel((double)AUDIO_MFCC_LOW_FREQ_HZ);
+    double mel_high = hz_to_mel((double)AUDIO_MFCC_SAMPLE_RATE_HZ / 2.0);
+    for (uint32_t m = 0; m < (AUDIO_MFCC_NUM_BANDS + 2u); m++)
+    {
+        mel_points[m] = mel_low + (mel_high - mel_low) * (double)m / (double)(AUDIO_MFCC_NUM_BANDS + 1u);
+    }
+
+    for (uint32_t k = 0; k < AUDIO_FFT_RFFT_BINS; k++)
+    {
+        double mel = hz_to_mel((double)k * (double)AUDIO_MFCC_SAMPLE_RATE_HZ / (double)AUDIO_FFT_RFFT_SIZE);
+
+        bin_band[k] = -1;
+        bin_weight[k] = 0;
+        for (uint32_t m = 0; m < (AUDIO_MFCC_NUM_BANDS + 1u); m++)
+        {
+            if ((mel >= mel_points[m]) && (mel < mel_points[m + 1u]))
+            {
+                double w = (mel - mel_points[m]) / (mel_points[m + 1u] - mel_points[m]);
+                bin_band[k] = (int8_t)m;
+                bin_weight[k] = (uint16_t)lround(w * 32768.0);
+                break;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < AUDIO_MFCC_NUM_COEFFS; i++)
+    {
+        double scale = sqrt(((i == 0u) ? 1.0 : 2.0) / (double)AUDIO_MFCC_NUM_BANDS);
+
+        for (uint32_t b = 0; b < AUDIO_MFCC_NUM_BANDS; b++)
+        {
+            double c = scale * cos(pi * (double)i * ((double)b + 0.5) / (double)AUDIO_MFCC_NUM_BANDS);
+            dct_q15[i][b] = (int16_t)lround(c * 32768.0);
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_mfcc_reset
+********************************************************************************
+* Summary:
+*  Clears the analysis window, for the start of a new stream.
+*
+* Parameters:
+*  mfcc: Extractor state
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_mfcc_reset(audio_mfcc_t *mfcc)
+{
+    memset(mfcc->window, 0, sizeof(mfcc->window));
+}
+
+/*******************************************************************************
+* Function Name: audio_mfcc_process
+********************************************************************************
+* Summary:
+*  Appends one hop of samples to the analysis window and computes the
+*  features of the window.
+*
+* Parameters:
+*  mfcc: Extractor state
+*  samples: AUDIO_MFCC_HOP_SAMPLES samples at AUDIO_MFCC_SAMPLE_RATE_HZ
+*  log_mel: Output, AUDIO_MFCC_NUM_BANDS log-mel energies
+*  coeffs: Output, AUDIO_MFCC_NUM_COEFFS MFCCs, or NULL if not needed
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_mfcc_process(audio_mfcc_t *mfcc, const int16_t *samples,
+                        int16_t *log_mel, int32_t *coeffs)
+{
+    uint64_t energy[AUDIO_MFCC_NUM_BANDS] = {0};
+
+    memmove(mfcc->window, &mfcc->window[AUDIO_MFCC_HOP_SAMPLES],
+            (AUDIO_MFCC_WINDOW_SAMPLES - AUDIO_MFCC_HOP_SAMPLES) * sizeof(int16_t));
+    memcpy(&mfcc->window[AUDIO_MFCC_WINDOW_SAMPLES - AUDIO_MFCC_HOP_SAMPLES], samples,
+           AUDIO_MFCC_HOP_SAMPLES * sizeof(int16_t));
+
+    for (uint32_t i = 0; i < AUDIO_MFCC_WINDOW_SAMPLES; i++)
+    {
+        mfcc->fft[i] = ((int32_t)mfcc->window[i] * hamming_q15[i]) << 1;
+    }
+    memset(&mfcc->fft[AUDIO_MFCC_WINDOW_SAMPLES], 0,
+           (AUDIO_FFT_RFFT_SIZE - AUDIO_MFCC_WINDOW_SAMPLES) * sizeof(int32_t));
+
+    audio_fft_rfft_q31(mfcc->fft, mfcc->bins);
+
+    for (uint32_t k = 0; k < AUDIO_FFT_RFFT_BINS; k++)
+    {
+        int32_t band = bin_band[k];
+        if (band < 0)
+        {
+            continue;
+        }
+
+        int64_t re = mfcc->bins[2u * k];
+        int64_t im = mfcc->bins[2u * k + 1u];
+        /* The spectrum is scaled by 1/N, so by Parseval the power of all bins
+         * together stays below 2^62 and the weighted sums cannot overflow */
+        uint64_t power = ((uint64_t)(re * re) + (uint64_t)(im * im)) >> 15;
+
+        if (band < (int32_t)AUDIO_MFCC_NUM_BANDS)
+        {
+            energy[band] += power * bin_weight[k];
+        }
+        if (band > 0)
+        {
+            energy[band - 1] += power * (32768u - bin_weight[k]);
+        }
+    }
+
+    for (uint32_t b = 0; b < AUDIO_MFCC_NUM_BANDS; b++)
+    {
+        log_mel[b] = log2_q8(energy[b]);
+    }
+
+    if (coeffs != NULL)
+    {
+        for (uint32_t i = 0; i < AUDIO_MFCC_NUM_COEFFS; i++)
+        {
+            int64_t acc = 0;
+            for (uint32_t b = 0; b < AUDIO_MFCC_NUM_BANDS; b++)
+            {
+                acc += (int32_t)log_mel[b] * dct_q15[i][b];
+            }
+            coeffs[i] = (int32_t)(acc >> 15);
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: hz_to_mel
+********************************************************************************
+* Summary:
+*  Converts a frequency to the mel scale.
+*
+*******************************************************************************/
+static double hz_to_mel(double hz)
+{
+    return 2595.0 * log10(1.0 + hz / 700.0);
+}
+
+/*******************************************************************************
+* Function Name: log2_q8
+********************************************************************************
+* Summary:
+*  Returns log2 of a value in Q8, 0 for values below 2.
+*
+*******************************************************************************/
+static int16_t log2_q8(uint64_t value)
+{
+    int32_t exponent = 0;
+
+    if (value < 2u)
+    {
+        return 0;
+    }
+
+    while ((value >> exponent) > 1u)
+    {
+        exponent++;
+    }
+
+    /* Mantissa fraction in Q16: value / 2^exponent - 1 */
+    uint32_t frac = (uint32_t)(((value << (63 - exponent)) >> 47) & 0xFFFFu);
+    /* log2(1 + f) ~= f + 0.3466 * f * (1 - f) */
+    uint32_t fit = frac + (uint32_t)((((uint64_t)frac * (65536u - frac)) >> 16) * 22713u >> 16);
+
+    return (int16_t)((exponent << 8) + (int32_t)(fit >> 8));
+}
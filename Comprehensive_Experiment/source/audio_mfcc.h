@@ -0,0 +1,53 @@
+/******************************************************************************
+* File Name:   audio_mfcc.h
+*
+* Description: This file contains the log-mel and MFCC feature extraction of
+* 16 kHz audio.
+*
+* The analysis window is AUDIO_MFCC_WINDOW_SAMPLES long and advances by one
+* AUDIO_MFCC_HOP_SAMPLES capture frame, so every frame produces one feature
+* vector. The log-mel energies are log2 of the band energies in Q8 (one unit
+* is 3.01 dB / 256); the MFCCs are the orthonormal DCT-II of the log-mel
+* energies, in the same Q8 log2 units.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_MFCC_H_
+#define AUDIO_MFCC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio_fft.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define AUDIO_MFCC_SAMPLE_RATE_HZ           (16000u)
+/* 25 ms analysis window, 10 ms hop */
+#define AUDIO_MFCC_WINDOW_SAMPLES           (400u)
+#define AUDIO_MFCC_HOP_SAMPLES              (160u)
+#define AUDIO_MFCC_NUM_BANDS                (40u)
+#define AUDIO_MFCC_NUM_COEFFS               (13u)
+/* Lower edge of the first mel band, the last band ends at Nyquist */
+#define AUDIO_MFCC_LOW_FREQ_HZ              (20u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    int16_t window[AUDIO_MFCC_WINDOW_SAMPLES];  /* Last samples, oldest first */
+    int32_t fft[AUDIO_FFT_RFFT_SIZE];
+    int32_t bins[2u * AUDIO_FFT_RFFT_BINS];
+} audio_mfcc_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void audio_mfcc_init(void);
+void audio_mfcc_reset(audio_mfcc_t *mfcc);
+void audio_mfcc_process(audio_mfcc_t *mfcc, const int16_t *samples,
+                        int16_t *log_mel, int32_t *coeffs);
+
+#endif /* AUDIO_MFCC_H_ */
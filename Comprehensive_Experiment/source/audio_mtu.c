@@ -0,0 +1,238 @@
+/******************************************************************************
+* File Name:   audio_mtu.c
+*
+* Description: This file contains the choice of the audio upload chunk size.
+*
+* The chunk steps between AUDIO_MTU_BASE_CHUNK, AUDIO_MTU_INITIAL_CHUNK and
+* the largest chunk of the link MTU, so a probe that fails costs three
+* uploads at most before the search settles.
+*
+*******************************************************************************/
+
+#include "audio_mtu.h"
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static uint32_t chunk_larger(const audio_mtu_t *mtu, uint32_t chunk);
+static uint32_t chunk_smaller(uint32_t chunk);
+
+/*******************************************************************************
+* Function Name: audio_mtu_init
+********************************************************************************
+* Summary:
+*  Initializes the chunk size policy for a link.
+*
+* Parameters:
+*  mtu: Chunk size policy
+*  link_mtu: MTU of the network interface, 1500 for Ethernet and Wi-Fi
+*  overhead: Bytes the largest datagram of an upload carries beyond its
+*            chunk, AUDIO_FEC_SYMBOL_PREFIX with FEC, 0 without
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_mtu_init(audio_mtu_t *mtu, uint32_t link_mtu, uint32_t overhead)
+{
+    uint32_t max_chunk = AUDIO_MTU_BASE_CHUNK;
+    uint32_t headers = AUDIO_MTU_IP_UDP_HEADER_SIZE + AUDIO_PACKET_HEADER_SIZE + overhead;
+
+    if (link_mtu > (headers + AUDIO_MTU_BASE_CHUNK))
+    {
+        max_chunk = link_mtu - headers;
+    }
+    if (max_chunk > (AUDIO_PACKET_MAX_PAYLOAD - overhead))
+    {
+        max_chunk = AUDIO_PACKET_MAX_PAYLOAD - overhead;
+    }
+    /* Whole 16-bit samples */
+    max_chunk &= ~1u;
+
+    mtu->max_chunk = max_chunk;
+    mtu->overhead = overhead;
+    mtu->chunk = (max_chunk < AUDIO_MTU_INITIAL_CHUNK) ? max_chunk : AUDIO_MTU_INITIAL_CHUNK;
+    mtu->probe_chunk = 0;
+    mtu->probe_session = 0;
+    mtu->probe_failures = 0;
+    mtu->raise_wait = 0;
+    mtu->loss_chunk = 0;
+    mtu->loss_hold = 0;
+    mtu->fallbacks = 0;
+}
+
+/*******************************************************************************
+* Function Name: audio_mtu_probe
+********************************************************************************
+* Summary:
+*  Decides at the start of an upload whether to probe a larger chunk.
+*
+* Parameters:
+*  mtu: Chunk size policy
+*  session: Session of the upload
+*
+* Return:
+*  uint32_t: Payload size of the probe datagram to send, 0 for no probe; the
+*            probed chunk plus the overhead, the largest datagram of an
+*            upload at that chunk
+*
+*******************************************************************************/
+uint32_t audio_mtu_probe(audio_mtu_t *mtu, uint16_t session)
+{
+    if (mtu->raise_wait > 0u)
+    {
+        mtu->raise_wait--;
+        return 0;
+    }
+
+    if (mtu->chunk >= mtu->max_chunk)
+    {
+        return 0;
+    }
+
+    mtu->probe_chunk = chunk_larger(mtu, mtu->chunk);
+    mtu->probe_session = session;
+
+    return mtu->probe_chunk + mtu->overhead;
+}
+
+/*******************************************************************************
+* Function Name: audio_mtu_feedback
+********************************************************************************
+* Summary:
+*  Handles a feedback datagram of the server if it acknowledges a probe; the
+*  probed chunk is used from the next upload.
+*
+* Parameters:
+*  mtu: Chunk size policy
+*  datagram: Received datagram
+*  size: Size of the datagram in bytes
+*
+* Return:
+*  bool: true if the datagram is a probe acknowledgement, which needs no
+*        further handling
+*
+*******************************************************************************/
+bool audio_mtu_feedback(audio_mtu_t *mtu, const uint8_t *datagram, uint32_t size)
+{
+    audio_packet_header_t header;
+    const uint8_t *payload;
+    uint32_t payload_size;
+
+    if (!audio_packet_decode(datagram, size, &header, &payload, &payload_size) ||
+        ((header.flags & AUDIO_PACKET_FLAG_PROBE) == 0u))
+    {
+        return false;
+    }
+
+    if (((header.flags & AUDIO_PACKET_FLAG_ACK) != 0u) && (mtu->probe_chunk != 0u) &&
+        (header.session == mtu->probe_session) && (header.offset == (mtu->probe_chunk + mtu->overhead)))
+    {
+        mtu->chunk = mtu->probe_chunk;
+        mtu->probe_chunk = 0;
+        mtu->probe_failures = 0;
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: audio_mtu_upload_done
+********************************************************************************
+* Summary:
+*  Accounts for an upload once the server acknowledged it or it was given
+*  up: counts an unanswered probe and falls back to a smaller chunk if the
+*  server NACKed too many of its datagrams, or back to the larger one if the
+*  smaller chunk did not lose less.
+*
+* Parameters:
+*  mtu: Chunk size policy
+*  datagrams: Datagrams of the upload
+*  nacked: Datagrams the server NACKed, repeated NACKs counted again
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_mtu_upload_done(audio_mtu_t *mtu, uint32_t datagrams, uint32_t nacked)
+{
+    bool lossy;
+
+    if (mtu->probe_chunk != 0u)
+    {
+        mtu->probe_chunk = 0;
+        mtu->probe_failures++;
+        if (mtu->probe_failures >= AUDIO_MTU_MAX_PROBES)
+        {
+            mtu->probe_failures = 0;
+            mtu->raise_wait = AUDIO_MTU_RAISE_UPLOADS;
+        }
+    }
+
+    if (datagrams < AUDIO_MTU_LOSS_MIN_DATAGRAMS)
+    {
+        return;
+    }
+
+    if (mtu->loss_hold > 0u)
+    {
+        mtu->loss_hold--;
+        return;
+    }
+
+    lossy = (nacked * 100u) >= (datagrams * AUDIO_MTU_LOSS_PERCENT);
+
+    if (mtu->loss_chunk != 0u)
+    {
+        /* First upload after a fall back */
+        if (lossy)
+        {
+            mtu->chunk = mtu->loss_chunk;
+            mtu->raise_wait = 0;
+            mtu->loss_hold = AUDIO_MTU_RAISE_UPLOADS;
+        }
+        mtu->loss_chunk = 0;
+        return;
+    }
+
+    if (lossy && (mtu->chunk > AUDIO_MTU_BASE_CHUNK))
+    {
+        mtu->loss_chunk = mtu->chunk;
+        mtu->chunk = chunk_smaller(mtu->chunk);
+        mtu->probe_failures = 0;
+        mtu->raise_wait = AUDIO_MTU_RAISE_UPLOADS;
+        mtu->fallbacks++;
+    }
+}
+
+/*******************************************************************************
+* Function Name: chunk_larger
+********************************************************************************
+* Summary:
+*  Returns the next chunk size above a chunk size.
+*
+*******************************************************************************/
+static uint32_t chunk_larger(const audio_mtu_t *mtu, uint32_t chunk)
+{
+    if ((chunk < AUDIO_MTU_INITIAL_CHUNK) && (AUDIO_MTU_INITIAL_CHUNK < mtu->max_chunk))
+    {
+        return AUDIO_MTU_INITIAL_CHUNK;
+    }
+    return mtu->max_chunk;
+}
+
+/*******************************************************************************
+* Function Name: chunk_smaller
+********************************************************************************
+* Summary:
+*  Returns the next chunk size below a chunk size.
+*
+*******************************************************************************/
+static uint32_t chunk_smaller(uint32_t chunk)
+{
+    if (chunk > AUDIO_MTU_INITIAL_CHUNK)
+    {
+        return AUDIO_MTU_INITIAL_CHUNK;
+    }
+    return AUDIO_MTU_BASE_CHUNK;
+}
@@ -0,0 +1,88 @@
+/******************************************************************************
+* File Name:   audio_mtu.h
+*
+* Description: This file contains the choice of the audio upload chunk size,
+* the audio bytes behind the header of each datagram.
+*
+* Larger chunks need fewer datagrams, and so less airtime for the preamble,
+* contention and acknowledgement of every Wi-Fi frame, as long as a datagram
+* fits the path MTU; beyond it every datagram is fragmented and the loss of
+* either fragment loses it. lwIP does not report ICMP fragmentation needed
+* to UDP sockets, so the path is probed in the manner of RFC 8899 datagram
+* PLPMTUD: at the start of an upload a probe datagram of the next larger
+* chunk is sent, and the chunk grows once the server acknowledges it. Three
+* unanswered probes end the search, and an upload whose datagrams the server
+* NACKed for AUDIO_MTU_LOSS_PERCENT or more falls back to the next smaller
+* chunk; the next larger chunk is probed again after AUDIO_MTU_RAISE_UPLOADS
+* uploads. If the smaller chunk loses as much, the loss is not caused by the
+* size: the larger chunk is restored and the loss ignored for
+* AUDIO_MTU_RAISE_UPLOADS uploads.
+*
+* The chunk leaves room for a per-datagram overhead beyond the audio bytes,
+* the symbol prefix of the FEC parity datagrams (see audio_fec.h), so that
+* the largest datagram of an upload fits the path and not only its audio
+* datagrams. A probe of a chunk carries that overhead too, so it tests the
+* size of the parity datagrams.
+*
+* A probe datagram has AUDIO_PACKET_FLAG_PROBE set, the session of the
+* upload and a sequence number of the probes, see audio_packet.h; its
+* payload is padding. The server answers with AUDIO_PACKET_FLAG_ACK and
+* AUDIO_PACKET_FLAG_PROBE and the payload size of the probe in the offset
+* field.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_MTU_H_
+#define AUDIO_MTU_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "audio_packet.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* IPv4 and UDP headers in front of each datagram */
+#define AUDIO_MTU_IP_UDP_HEADER_SIZE        (28u)
+/* Chunk that crosses any IPv4 path unfragmented, datagrams of at most 576
+ * bytes */
+#define AUDIO_MTU_BASE_CHUNK                (512u)
+/* Chunk of the uploads before the first probe, the former fixed size */
+#define AUDIO_MTU_INITIAL_CHUNK             (1024u)
+/* Unanswered probes of a chunk size that end the search */
+#define AUDIO_MTU_MAX_PROBES                (3u)
+/* NACKed datagrams of an upload, in percent of its datagrams, that make the
+ * next upload use a smaller chunk */
+#define AUDIO_MTU_LOSS_PERCENT              (10u)
+/* Uploads shorter than this many datagrams do not count for the loss */
+#define AUDIO_MTU_LOSS_MIN_DATAGRAMS        (16u)
+/* Uploads after a fall back or an ended search before the next probe */
+#define AUDIO_MTU_RAISE_UPLOADS             (16u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    uint32_t chunk;                 /* Chunk of the next upload */
+    uint32_t max_chunk;             /* Largest chunk of the link MTU */
+    uint32_t overhead;              /* Bytes the largest datagram adds to the chunk */
+    uint32_t probe_chunk;           /* Chunk of the unanswered probe, 0 if none */
+    uint16_t probe_session;         /* Session the probe was sent in */
+    uint32_t probe_failures;        /* Unanswered probes of the next larger chunk */
+    uint32_t raise_wait;            /* Uploads until the next probe */
+    uint32_t loss_chunk;            /* Chunk that lost the last upload, 0 if none */
+    uint32_t loss_hold;             /* Uploads until the loss counts again */
+    uint32_t fallbacks;             /* Chunk reductions for loss */
+} audio_mtu_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void audio_mtu_init(audio_mtu_t *mtu, uint32_t link_mtu, uint32_t overhead);
+uint32_t audio_mtu_probe(audio_mtu_t *mtu, uint16_t session);
+bool audio_mtu_feedback(audio_mtu_t *mtu, const uint8_t *datagram, uint32_t size);
+void audio_mtu_upload_done(audio_mtu_t *mtu, uint32_t datagrams, uint32_t nacked);
+
+#endif /* AUDIO_MTU_H_ */
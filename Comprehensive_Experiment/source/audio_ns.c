@@ -0,0 +1,312 @@
+/******************************************************************************
+* File Name:   audio_ns.c
+*
+* Description: This file contains the spectral subtraction noise suppressor.
+*
+* The analysis window spans the last and the current frame and is the
+* square root of a Hann window; the same window is applied after the
+* inverse FFT, so the overlapping halves add up to the input exactly when
+* every gain is 1. The window is zero padded to the 512 point FFT.
+*
+* Per bin the gain is sqrt(1 - a N / P) with over-subtraction a, limited
+* below by the gain floor, N being the noise power and P the power of the
+* bin averaged with the previous frame. Musical noise, the isolated bins
+* that random peaks of the noise leave behind, is reduced by this averaging,
+* by smoothing the gains over neighbouring bins and by letting gains fall
+* only gradually from frame to frame.
+*
+* Samples are windowed into Q31, the power spectrum is kept in 64 bits and
+* the gains are Q15, so the only floating point is in building the window.
+*
+*******************************************************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include "audio_ns.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Extra fraction bits of the overlap-add: rifft scales by 1/1024 and the
+ * windowed input is the sample shifted by 16 bits, leaving 6 */
+#define NS_OUTPUT_SHIFT                     (6u)
+/* Largest bin power: both parts of a bin are below 2^23 */
+#define NS_POWER_MAX                        ((uint64_t)1u << 47)
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static void spectrum_gains(audio_ns_t *ns, bool speech);
+static uint32_t isqrt32(uint32_t value);
+static uint64_t power_scale(uint64_t power, uint32_t ratio_q16);
+
+/*******************************************************************************
+* Function Name: audio_ns_init
+********************************************************************************
+* Summary:
+*  Initializes a suppressor for a frame length. audio_fft_init must have
+*  been called.
+*
+* Parameters:
+*  ns: Noise suppressor
+*  hop: Frame length in samples, at most AUDIO_NS_MAX_HOP
+*
+* Return:
+*  bool: false if the frame length is not supported
+*
+*******************************************************************************/
+bool audio_ns_init(audio_ns_t *ns, uint32_t hop)
+{
+    const double pi = 3.14159265358979323846;
+
+    if ((hop == 0u) || (hop > AUDIO_NS_MAX_HOP))
+    {
+        return false;
+    }
+
+    ns->hop = hop;
+    for (uint32_t i = 0; i < (2u * hop); i++)
+    {
+        double w = sin(pi * ((double)i + 0.5) / (double)(2u * hop));
+        ns->window[i] = (int16_t)lround(fmin(w * 32768.0, 32767.0));
+    }
+
+    audio_ns_reset(ns);
+
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: audio_ns_reset
+********************************************************************************
+* Summary:
+*  Clears the signal history and forgets the noise estimate.
+*
+* Parameters:
+*  ns: Noise suppressor
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_ns_reset(audio_ns_t *ns)
+{
+    memset(ns->previous, 0, sizeof(ns->previous));
+    memset(ns->overlap, 0, sizeof(ns->overlap));
+    memset(ns->noise, 0, sizeof(ns->noise));
+    memset(ns->power, 0, sizeof(ns->power));
+    for (uint32_t k = 0; k < AUDIO_NS_BINS; k++)
+    {
+        ns->gain[k] = INT16_MAX;
+    }
+    ns->noise_valid = false;
+}
+
+/*******************************************************************************
+* Function Name: audio_ns_process
+********************************************************************************
+* Summary:
+*  Suppresses the noise of a frame in place. The output is delayed by one
+*  frame: the samples written back are the previous frame, denoised.
+*
+* Parameters:
+*  ns: Noise suppressor
+*  samples: Frame of hop samples, replaced by the output
+*  speech: VAD decision of the frame, the noise is learned from the others
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_ns_process(audio_ns_t *ns, int16_t *samples, bool speech)
+{
+    const uint32_t hop = ns->hop;
+    int32_t *x = ns->fft;
+
+    /* Window the previous and the current frame into Q31 */
+    for (uint32_t i = 0; i < hop; i++)
+    {
+        x[i] = ((int32_t)ns->previous[i] * ns->window[i]) * 2;
+        x[hop + i] = ((int32_t)samples[i] * ns->window[hop + i]) * 2;
+    }
+    memset(&x[2u * hop], 0, (AUDIO_FFT_RFFT_SIZE - 2u * hop) * sizeof(int32_t));
+    memcpy(ns->previous, samples, hop * sizeof(int16_t));
+
+    audio_fft_rfft_q31(x, ns->bins);
+    spectrum_gains(ns, speech);
+
+    for (uint32_t k = 0; k < AUDIO_NS_BINS; k++)
+    {
+        ns->bins[2u * k] = (int32_t)(((int64_t)ns->bins[2u * k] * ns->gain[k]) >> 15);
+        ns->bins[2u * k + 1u] = (int32_t)(((int64_t)ns->bins[2u * k + 1u] * ns->gain[k]) >> 15);
+    }
+
+    audio_fft_rifft_q31(ns->bins, x);
+
+    /* Overlap-add: the first half completes the previous frame */
+    for (uint32_t i = 0; i < hop; i++)
+    {
+        int32_t first = (int32_t)(((int64_t)x[i] * ns->window[i]) >> 15);
+        int32_t second = (int32_t)(((int64_t)x[hop + i] * ns->window[hop + i]) >> 15);
+        int32_t out = (ns->overlap[i] + first + (1 << (NS_OUTPUT_SHIFT - 1u))) >> NS_OUTPUT_SHIFT;
+
+        out = (out > INT16_MAX) ? INT16_MAX : out;
+        out = (out < INT16_MIN) ? INT16_MIN : out;
+        samples[i] = (int16_t)out;
+        ns->overlap[i] = second;
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_ns_scale_noise
+********************************************************************************
+* Summary:
+*  Scales the noise and power spectra after a change of the capture gain, so
+*  that the frames captured at the new gain see the same suppression.
+*
+* Parameters:
+*  ns: Noise suppressor
+*  ratio_q16: Power ratio of the new to the old gain, Q16
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_ns_scale_noise(audio_ns_t *ns, uint32_t ratio_q16)
+{
+    for (uint32_t k = 0; k < AUDIO_NS_BINS; k++)
+    {
+        ns->noise[k] = power_scale(ns->noise[k], ratio_q16);
+        ns->power[k] = power_scale(ns->power[k], ratio_q16);
+    }
+}
+
+/*******************************************************************************
+* Function Name: spectrum_gains
+********************************************************************************
+* Summary:
+*  Updates the power and noise spectra from ns->bins and computes the gains.
+*
+*******************************************************************************/
+static void spectrum_gains(audio_ns_t *ns, bool speech)
+{
+    uint16_t raw[AUDIO_NS_BINS];
+
+    for (uint32_t k = 0; k < AUDIO_NS_BINS; k++)
+    {
+        int64_t re = ns->bins[2u * k] >> 8;
+        int64_t im = ns->bins[2u * k + 1u] >> 8;
+        uint64_t power = (uint64_t)(re * re + im * im);
+
+        /* |X| < 2^23 after the shift, so the sums stay below 2^48 */
+        ns->power[k] = ns->power[k] - (ns->power[k] >> AUDIO_NS_POWER_SHIFT) + (power >> AUDIO_NS_POWER_SHIFT);
+
+        if (!speech)
+        {
+            if (ns->noise_valid)
+            {
+                ns->noise[k] = ns->noise[k] - (ns->noise[k] >> AUDIO_NS_NOISE_SHIFT) +
+                               (power >> AUDIO_NS_NOISE_SHIFT);
+            }
+            else
+            {
+                ns->noise[k] = power;
+            }
+        }
+    }
+
+    if (!speech)
+    {
+        ns->noise_valid = true;
+    }
+
+    for (uint32_t k = 0; k < AUDIO_NS_BINS; k++)
+    {
+        uint64_t noise = (ns->noise[k] * AUDIO_NS_OVERSUBTRACT_Q12) >> 12;
+        uint32_t floor = (AUDIO_NS_GAIN_FLOOR_Q15 * AUDIO_NS_GAIN_FLOOR_Q15) >> 15;
+        uint32_t g2 = 32768u;                /* Squared gain, Q15 */
+
+        if (!ns->noise_valid)
+        {
+            raw[k] = INT16_MAX;
+            continue;
+        }
+
+        if (noise >= ns->power[k])
+        {
+            g2 = floor;
+        }
+        else if (noise > 0u)
+        {
+            g2 -= (uint32_t)((noise << 15) / ns->power[k]);
+            g2 = (g2 < floor) ? floor : g2;
+        }
+
+        g2 = isqrt32(g2 << 15);
+        raw[k] = (uint16_t)((g2 > INT16_MAX) ? INT16_MAX : g2);
+    }
+
+    /* Smooth over the neighbouring bins (1/4, 1/2, 1/4), then in time */
+    for (uint32_t k = 0; k < AUDIO_NS_BINS; k++)
+    {
+        uint32_t lo = raw[(k == 0u) ? 1u : (k - 1u)];
+        uint32_t hi = raw[(k == (AUDIO_NS_BINS - 1u)) ? (k - 1u) : (k + 1u)];
+        uint32_t g = (lo + 2u * raw[k] + hi + 2u) >> 2;
+
+        if (g < ns->gain[k])
+        {
+            g = ns->gain[k] - ((ns->gain[k] - g) >> AUDIO_NS_RELEASE_SHIFT);
+        }
+        ns->gain[k] = (uint16_t)g;
+    }
+}
+
+/*******************************************************************************
+* Function Name: isqrt32
+********************************************************************************
+* Summary:
+*  Returns the integer square root of a value, rounded down.
+*
+*******************************************************************************/
+static uint32_t isqrt32(uint32_t value)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1uL << 30;
+
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+
+    while (bit != 0u)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return root;
+}
+
+/*******************************************************************************
+* Function Name: power_scale
+********************************************************************************
+* Summary:
+*  Multiplies a bin power by a Q16 ratio, limited to NS_POWER_MAX.
+*
+*******************************************************************************/
+static uint64_t power_scale(uint64_t power, uint32_t ratio_q16)
+{
+    /* power < 2^48 and ratio_q16 < 2^28, split to stay within 64 bits */
+    uint64_t scaled = (power >> 16) * ratio_q16 + (((power & 0xFFFFu) * ratio_q16) >> 16);
+
+    return (scaled > NS_POWER_MAX) ? NS_POWER_MAX : scaled;
+}
@@ -0,0 +1,63 @@
+/******************************************************************************
+* File Name:   audio_ns.h
+*
+* Description: This file contains the spectral subtraction noise suppressor
+* applied to the capture frames ahead of the recording. Frames are analysed
+* with 50 % overlapping windows of two frames, the noise spectrum is learned
+* from the frames the VAD classifies as silence, and the frame is rebuilt by
+* overlap-add, one frame late.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_NS_H_
+#define AUDIO_NS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "audio_fft.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Longest frame: the window of two frames has to fit the FFT */
+#define AUDIO_NS_MAX_HOP                    (AUDIO_FFT_RFFT_SIZE / 2u)
+#define AUDIO_NS_BINS                       AUDIO_FFT_RFFT_BINS
+
+/* Noise power subtracted, 2.0 in Q12 */
+#define AUDIO_NS_OVERSUBTRACT_Q12           (8192u)
+/* Lowest gain, -20 dB in Q15; the residual noise stays natural */
+#define AUDIO_NS_GAIN_FLOOR_Q15             (3277u)
+/* The noise estimate follows silent frames by 1/8 per frame */
+#define AUDIO_NS_NOISE_SHIFT                (3u)
+/* The power spectrum is averaged with the last frame's, 1/2 */
+#define AUDIO_NS_POWER_SHIFT                (1u)
+/* Falling gains move by 1/2 per frame, rising ones at once */
+#define AUDIO_NS_RELEASE_SHIFT              (1u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    uint32_t hop;                           /* Frame length */
+    int16_t  window[2u * AUDIO_NS_MAX_HOP]; /* Square root Hann, Q15 */
+    int16_t  previous[AUDIO_NS_MAX_HOP];    /* Last input frame */
+    int32_t  overlap[AUDIO_NS_MAX_HOP];     /* Second half of the last output window */
+    uint64_t noise[AUDIO_NS_BINS];          /* Noise power spectrum */
+    uint64_t power[AUDIO_NS_BINS];          /* Smoothed power spectrum */
+    uint16_t gain[AUDIO_NS_BINS];           /* Gains of the last frame, Q15 */
+    bool     noise_valid;                   /* A silent frame has been seen */
+    int32_t  fft[AUDIO_FFT_RFFT_SIZE];
+    int32_t  bins[2u * AUDIO_NS_BINS];
+} audio_ns_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+bool audio_ns_init(audio_ns_t *ns, uint32_t hop);
+void audio_ns_reset(audio_ns_t *ns);
+void audio_ns_process(audio_ns_t *ns, int16_t *samples, bool speech);
+void audio_ns_scale_noise(audio_ns_t *ns, uint32_t ratio_q16);
+
+#endif /* AUDIO_NS_H_ */
@@ -0,0 +1,158 @@
+/******************************************************************************
+* File Name:   audio_pacer.c
+*
+* Description: This file contains the token bucket that paces the datagrams
+* sent to the UDP server.
+*
+* Tokens are counted in 1/1000 bytes, so that a rate in bytes per second
+* adds 'rate' tokens per millisecond without a remainder. The debt of the
+* senders that do not wait is limited to one bucket.
+*
+*******************************************************************************/
+
+#include "audio_pacer.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define TOKENS_PER_BYTE                     (1000)
+/* Largest bucket, so that the tokens of a bucket and its debt fit 32 bits */
+#define PACER_MAX_BURST                     (1000000u)
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static void refill(audio_pacer_t *pacer, uint32_t now_ms);
+
+/*******************************************************************************
+* Function Name: audio_pacer_init
+********************************************************************************
+* Summary:
+*  Initializes a full bucket.
+*
+* Parameters:
+*  pacer: Token bucket
+*  rate: Bytes per second, 0 to send without pacing
+*  burst: Bucket size in bytes, at least the largest datagram
+*  now_ms: Current time in milliseconds
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_pacer_init(audio_pacer_t *pacer, uint32_t rate, uint32_t burst, uint32_t now_ms)
+{
+    if (burst > PACER_MAX_BURST)
+    {
+        burst = PACER_MAX_BURST;
+    }
+
+    pacer->rate = rate;
+    pacer->burst = burst;
+    pacer->tokens = (int32_t)burst * TOKENS_PER_BYTE;
+    pacer->last_ms = now_ms;
+}
+
+/*******************************************************************************
+* Function Name: audio_pacer_delay
+********************************************************************************
+* Summary:
+*  Returns how long a paced sender waits before it may send a datagram. A
+*  datagram larger than the bucket waits for a full bucket.
+*
+* Parameters:
+*  pacer: Token bucket
+*  size: Size of the datagram in bytes
+*  now_ms: Current time in milliseconds
+*
+* Return:
+*  uint32_t: Milliseconds to wait, 0 to send now with audio_pacer_consume
+*
+*******************************************************************************/
+uint32_t audio_pacer_delay(audio_pacer_t *pacer, uint32_t size, uint32_t now_ms)
+{
+    int32_t needed;
+
+    if (pacer->rate == 0u)
+    {
+        return 0;
+    }
+
+    refill(pacer, now_ms);
+
+    if (size > pacer->burst)
+    {
+        size = pacer->burst;
+    }
+
+    needed = (int32_t)size * TOKENS_PER_BYTE - pacer->tokens;
+    if (needed <= 0)
+    {
+        return 0;
+    }
+
+    return ((uint32_t)needed + pacer->rate - 1u) / pacer->rate;
+}
+
+/*******************************************************************************
+* Function Name: audio_pacer_consume
+********************************************************************************
+* Summary:
+*  Takes the bytes of a datagram being sent from the bucket, whether or not
+*  the bucket holds them.
+*
+* Parameters:
+*  pacer: Token bucket
+*  size: Size of the datagram in bytes
+*  now_ms: Current time in milliseconds
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_pacer_consume(audio_pacer_t *pacer, uint32_t size, uint32_t now_ms)
+{
+    int32_t limit = -(int32_t)pacer->burst * TOKENS_PER_BYTE;
+
+    if (pacer->rate == 0u)
+    {
+        return;
+    }
+
+    refill(pacer, now_ms);
+
+    if (size > pacer->burst)
+    {
+        size = pacer->burst;
+    }
+
+    pacer->tokens -= (int32_t)size * TOKENS_PER_BYTE;
+    if (pacer->tokens < limit)
+    {
+        pacer->tokens = limit;
+    }
+}
+
+/*******************************************************************************
+* Function Name: refill
+********************************************************************************
+* Summary:
+*  Adds the tokens of the time since the last refill, up to a full bucket.
+*
+*******************************************************************************/
+static void refill(audio_pacer_t *pacer, uint32_t now_ms)
+{
+    uint32_t elapsed_ms = now_ms - pacer->last_ms;
+    uint32_t missing = (uint32_t)((int32_t)pacer->burst * TOKENS_PER_BYTE - pacer->tokens);
+
+    pacer->last_ms = now_ms;
+
+    if (elapsed_ms >= (missing / pacer->rate) + 1u)
+    {
+        pacer->tokens = (int32_t)pacer->burst * TOKENS_PER_BYTE;
+    }
+    else
+    {
+        pacer->tokens += (int32_t)(elapsed_ms * pacer->rate);
+    }
+}
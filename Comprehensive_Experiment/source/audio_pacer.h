@@ -0,0 +1,42 @@
+/******************************************************************************
+* File Name:   audio_pacer.h
+*
+* Description: This file contains the token bucket that paces the datagrams
+* sent to the UDP server.
+*
+* The bucket fills at 'rate' bytes per second up to 'burst' bytes. A paced
+* sender waits until the bucket holds its datagram, so bursts such as the
+* pre-roll of a recording or a retransmission leave at the rate the Wi-Fi
+* link drains them instead of overflowing the lwIP and WHD queues. Senders
+* that must not wait take their bytes all the same, running the bucket into
+* debt, so the paced traffic makes room for them.
+*
+* Time is passed in by the caller, in milliseconds, so that the bucket runs
+* on a virtual clock off target.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_PACER_H_
+#define AUDIO_PACER_H_
+
+#include <stdint.h>
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    uint32_t rate;                  /* Bytes per second, 0 does not pace */
+    uint32_t burst;                 /* Bucket size in bytes */
+    int32_t  tokens;                /* Tokens in 1/1000 bytes, negative for debt */
+    uint32_t last_ms;               /* Time of the last refill */
+} audio_pacer_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void audio_pacer_init(audio_pacer_t *pacer, uint32_t rate, uint32_t burst, uint32_t now_ms);
+uint32_t audio_pacer_delay(audio_pacer_t *pacer, uint32_t size, uint32_t now_ms);
+void audio_pacer_consume(audio_pacer_t *pacer, uint32_t size, uint32_t now_ms);
+
+#endif /* AUDIO_PACER_H_ */
@@ -0,0 +1,88 @@
+/******************************************************************************
+* File Name:   audio_packet.h
+*
+* Description: This file contains the framing of the audio upload datagrams.
+*
+* Every datagram of an upload starts with a 16 byte header, little endian:
+*
+*   0  "AU"      magic
+*   2  uint8     codec of the upload (audio_codec_t)
+*   3  uint8     flags, AUDIO_PACKET_FLAG_*
+*   4  uint16    session, a new one for every upload
+*   6  uint16    sequence number, 0 for the start datagram, +1 per datagram
+*   8  uint32    offset of the payload in the upload, in samples (values of
+*                the feature vectors for a feature upload)
+*   12 uint32    CRC-32 (IEEE 802.3, as zlib.crc32) of the header bytes 0 to
+*                11 followed by the payload
+*
+* The payload of the start datagram is the sample rate (the number of bands
+* of a feature upload) followed by the uint8 datagrams and parities per FEC
+* block (see audio_fec.h) and the uint16 audio bytes per datagram of the
+* upload (see audio_mtu.h), of the end datagram the number of samples of the
+* upload as uint32; the statistics datagram carries the fields of
+* audio_upload_stats. The other datagrams carry the encoded audio, each one
+* decodable on its own, so the receiver can place it by its offset.
+*
+* Path MTU probes (AUDIO_PACKET_FLAG_PROBE) carry the session of the upload
+* they were sent with but have a sequence space of their own, counted by
+* the client across uploads: their sequence numbers never name a datagram of
+* the upload, and they are neither NACKed, retransmitted nor covered by the
+* FEC. The offset of a probe is its payload size.
+*
+* The server answers with datagrams of the same header: a NACK lists the
+* missing sequence numbers as a bitmap from the sequence number of its
+* header, an ACK carrying the sequence number of the end datagram closes
+* the session, complete or given up.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_PACKET_H_
+#define AUDIO_PACKET_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define AUDIO_PACKET_HEADER_SIZE            (16u)
+#define AUDIO_PACKET_MAGIC                  "AU"
+/* Largest payload: the 1500 byte MTU of Ethernet and Wi-Fi less the IPv4,
+ * UDP and packet headers */
+#define AUDIO_PACKET_MAX_PAYLOAD            (1456u)
+
+#define AUDIO_PACKET_FLAG_START             (0x01u)
+#define AUDIO_PACKET_FLAG_END               (0x02u)
+#define AUDIO_PACKET_FLAG_STATS             (0x04u)
+/* Set on datagrams sent again in answer to a NACK */
+#define AUDIO_PACKET_FLAG_RETRANSMIT        (0x08u)
+/* Parity datagram, see audio_fec.h */
+#define AUDIO_PACKET_FLAG_PARITY            (0x40u)
+/* Path MTU probe and its acknowledgement, see audio_mtu.h */
+#define AUDIO_PACKET_FLAG_PROBE             (0x80u)
+/* Feedback of the server, see audio_arq.h */
+#define AUDIO_PACKET_FLAG_NACK              (0x10u)
+#define AUDIO_PACKET_FLAG_ACK               (0x20u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    uint8_t  codec;
+    uint8_t  flags;
+    uint16_t session;
+    uint16_t seq;
+    uint32_t offset;
+} audio_packet_header_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+uint32_t audio_packet_encode(const audio_packet_header_t *header, uint8_t *datagram, uint32_t payload_size);
+bool audio_packet_decode(const uint8_t *datagram, uint32_t size, audio_packet_header_t *header,
+                         const uint8_t **payload, uint32_t *payload_size);
+void audio_packet_set_flags(uint8_t *datagram, uint32_t size, uint8_t flags);
+uint32_t audio_packet_crc32(uint32_t crc, const uint8_t *data, uint32_t size);
+
+#endif /* AUDIO_PACKET_H_ */
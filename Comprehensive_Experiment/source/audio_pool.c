@@ -0,0 +1,149 @@
+/******************************************************************************
+* File Name:   audio_pool.c
+*
+* Description: This file contains the frame pool of the recording path.
+*
+* The free frames are the set bits of one atomic word: a frame is allocated
+* by clearing its bit with compare-and-swap and freed by setting it again.
+* Unlike a linked free list this cannot suffer from ABA when a frame is
+* freed and allocated again between the load and the swap of another task.
+* The reference count is decremented with acquire-release ordering and the
+* frame is freed with release ordering, so everything every consumer did
+* with the frame happens before its next allocation.
+*
+*******************************************************************************/
+
+#include "audio_pool.h"
+
+/*******************************************************************************
+* Function Name: audio_pool_init
+********************************************************************************
+* Summary:
+*  Initializes a pool with all frames free.
+*
+* Parameters:
+*  pool: Pool
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_pool_init(audio_pool_t *pool)
+{
+    for (uint32_t i = 0; i < AUDIO_POOL_FRAMES; i++)
+    {
+        pool->frames[i].pool = pool;
+        atomic_init(&pool->frames[i].refs, 0u);
+    }
+
+    atomic_init(&pool->free_mask, (AUDIO_POOL_FRAMES == 32u) ? UINT32_MAX : ((1u << AUDIO_POOL_FRAMES) - 1u));
+}
+
+/*******************************************************************************
+* Function Name: audio_pool_alloc
+********************************************************************************
+* Summary:
+*  Takes a free frame from the pool.
+*
+* Parameters:
+*  pool: Pool
+*
+* Return:
+*  audio_pool_frame_t*: Frame with one reference, NULL if the pool is empty
+*
+*******************************************************************************/
+audio_pool_frame_t *audio_pool_alloc(audio_pool_t *pool)
+{
+    unsigned int mask = atomic_load_explicit(&pool->free_mask, memory_order_relaxed);
+    uint32_t index;
+
+    do
+    {
+        if (mask == 0u)
+        {
+            return NULL;
+        }
+
+        /* Lowest free frame */
+        index = 0;
+        while ((mask & (1u << index)) == 0u)
+        {
+            index++;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&pool->free_mask, &mask, mask & ~(1u << index),
+                                                    memory_order_acquire, memory_order_relaxed));
+
+    audio_pool_frame_t *frame = &pool->frames[index];
+    atomic_store_explicit(&frame->refs, 1u, memory_order_relaxed);
+
+    return frame;
+}
+
+/*******************************************************************************
+* Function Name: audio_pool_retain
+********************************************************************************
+* Summary:
+*  Takes another reference to a frame the caller holds a reference to.
+*
+* Parameters:
+*  frame: Frame
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_pool_retain(audio_pool_frame_t *frame)
+{
+    atomic_fetch_add_explicit(&frame->refs, 1u, memory_order_relaxed);
+}
+
+/*******************************************************************************
+* Function Name: audio_pool_release
+********************************************************************************
+* Summary:
+*  Drops a reference to a frame, the last one returns it to its pool.
+*
+* Parameters:
+*  frame: Frame
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_pool_release(audio_pool_frame_t *frame)
+{
+    if (atomic_fetch_sub_explicit(&frame->refs, 1u, memory_order_acq_rel) == 1u)
+    {
+        audio_pool_t *pool = frame->pool;
+        uint32_t index = (uint32_t)(frame - pool->frames);
+
+        atomic_fetch_or_explicit(&pool->free_mask, 1u << index, memory_order_release);
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_pool_available
+********************************************************************************
+* Summary:
+*  Returns the number of free frames, for diagnostics.
+*
+* Parameters:
+*  pool: Pool
+*
+* Return:
+*  uint32_t: Number of free frames
+*
+*******************************************************************************/
+uint32_t audio_pool_available(const audio_pool_t *pool)
+{
+    unsigned int mask = atomic_load_explicit((atomic_uint *)&pool->free_mask, memory_order_relaxed);
+    uint32_t count = 0;
+
+    while (mask != 0u)
+    {
+        mask &= mask - 1u;
+        count++;
+    }
+
+    return count;
+}
@@ -0,0 +1,62 @@
+/******************************************************************************
+* File Name:   audio_pool.h
+*
+* Description: This file contains the frame pool of the recording path:
+* fixed-size frame blocks with atomic reference counts, so one frame can be
+* handed to several consumers (UDP sender, emFile writer, a future BLE
+* streamer) without copying it.
+*
+* audio_pool_alloc returns a frame holding one reference for the caller.
+* Every consumer that keeps the frame beyond the call it received it in
+* takes its own reference with audio_pool_retain and drops it with
+* audio_pool_release when it is done; the frame goes back to the pool when
+* the last reference is dropped. All functions may be called from any task
+* concurrently; none of them blocks.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_POOL_H_
+#define AUDIO_POOL_H_
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "audio_stream.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Frames of the pool: the recording lookback, the SD card queue and the
+ * frames in flight; at most 32 */
+#define AUDIO_POOL_FRAMES                   (24u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+struct audio_pool;
+
+typedef struct
+{
+    int16_t  samples[AUDIO_STREAM_MAX_FRAME_SAMPLES];
+    uint32_t num_samples;
+    uint32_t seq;                   /* Capture sequence number */
+    atomic_uint refs;
+    struct audio_pool *pool;        /* Pool the frame returns to */
+} audio_pool_frame_t;
+
+typedef struct audio_pool
+{
+    audio_pool_frame_t frames[AUDIO_POOL_FRAMES];
+    atomic_uint free_mask;          /* Bit i set while frames[i] is free */
+} audio_pool_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void audio_pool_init(audio_pool_t *pool);
+audio_pool_frame_t *audio_pool_alloc(audio_pool_t *pool);
+void audio_pool_retain(audio_pool_frame_t *frame);
+void audio_pool_release(audio_pool_frame_t *frame);
+uint32_t audio_pool_available(const audio_pool_t *pool);
+
+#endif /* AUDIO_POOL_H_ */
@@ -0,0 +1,142 @@
+/******************************************************************************
+* File Name:   audio_preroll.c
+*
+* Description: This file contains the pre-roll of the audio pipeline.
+*
+* Frames are copied into the ring together with their capture sequence
+* number, the oldest frame being overwritten once the ring is full. When a
+* recording starts the frames are read back oldest first; the first live
+* frame that follows has the sequence number of the newest pre-roll frame
+* plus one, unless the capture dropped frames in between, so the consumer
+* can check the seam sample-accurately from the sequence numbers alone.
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "audio_preroll.h"
+
+/*******************************************************************************
+* Function Name: audio_preroll_init
+********************************************************************************
+* Summary:
+*  Initializes an empty pre-roll.
+*
+* Parameters:
+*  preroll: Pre-roll
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_preroll_init(audio_preroll_t *preroll)
+{
+    preroll->head = 0;
+    preroll->count = 0;
+}
+
+/*******************************************************************************
+* Function Name: audio_preroll_push
+********************************************************************************
+* Summary:
+*  Copies a capture frame into the pre-roll, replacing the oldest frame when
+*  the pre-roll is full.
+*
+* Parameters:
+*  preroll: Pre-roll
+*  samples: Frame samples
+*  num_samples: Number of samples, at most AUDIO_STREAM_MAX_FRAME_SAMPLES
+*  seq: Capture sequence number of the frame
+*  speech: VAD decision of the frame
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_preroll_push(audio_preroll_t *preroll, const int16_t *samples, uint32_t num_samples,
+                        uint32_t seq, bool speech)
+{
+    audio_preroll_frame_t *slot = &preroll->frames[preroll->head];
+
+    memcpy(slot->samples, samples, num_samples * sizeof(int16_t));
+    slot->seq = seq;
+    slot->speech = speech;
+
+    preroll->head++;
+    if (preroll->head == AUDIO_PREROLL_FRAMES)
+    {
+        preroll->head = 0;
+    }
+
+    if (preroll->count < AUDIO_PREROLL_FRAMES)
+    {
+        preroll->count++;
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_preroll_count
+********************************************************************************
+* Summary:
+*  Returns the number of frames in the pre-roll.
+*
+* Parameters:
+*  preroll: Pre-roll
+*
+* Return:
+*  uint32_t: Number of frames, at most AUDIO_PREROLL_FRAMES
+*
+*******************************************************************************/
+uint32_t audio_preroll_count(const audio_preroll_t *preroll)
+{
+    return preroll->count;
+}
+
+/*******************************************************************************
+* Function Name: audio_preroll_get
+********************************************************************************
+* Summary:
+*  Returns a frame of the pre-roll, 0 being the oldest.
+*
+* Parameters:
+*  preroll: Pre-roll
+*  index: Frame index, below audio_preroll_count
+*
+* Return:
+*  const audio_preroll_frame_t*: Frame, NULL if index is out of range
+*
+*******************************************************************************/
+const audio_preroll_frame_t *audio_preroll_get(const audio_preroll_t *preroll, uint32_t index)
+{
+    if (index >= preroll->count)
+    {
+        return NULL;
+    }
+
+    uint32_t slot = preroll->head + AUDIO_PREROLL_FRAMES - preroll->count + index;
+    if (slot >= AUDIO_PREROLL_FRAMES)
+    {
+        slot -= AUDIO_PREROLL_FRAMES;
+    }
+
+    return &preroll->frames[slot];
+}
+
+/*******************************************************************************
+* Function Name: audio_preroll_clear
+********************************************************************************
+* Summary:
+*  Empties the pre-roll.
+*
+* Parameters:
+*  preroll: Pre-roll
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_preroll_clear(audio_preroll_t *preroll)
+{
+    preroll->head = 0;
+    preroll->count = 0;
+}
@@ -0,0 +1,55 @@
+/******************************************************************************
+* File Name:   audio_preroll.h
+*
+* Description: This file contains the pre-roll of the audio pipeline, a ring
+* of the most recent capture frames kept while no recording is active, so
+* that a recording can start before the moment it was requested.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_PREROLL_H_
+#define AUDIO_PREROLL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "audio_stream.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Length of the pre-roll in milliseconds */
+#define AUDIO_PREROLL_MS                    (500u)
+/* Number of capture frames in the pre-roll */
+#define AUDIO_PREROLL_FRAMES                (AUDIO_PREROLL_MS / AUDIO_STREAM_FRAME_MS)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+/* One frame of the pre-roll. All frames have the length of the frames of
+ * the audio profile, the pre-roll is cleared when the profile changes. */
+typedef struct
+{
+    int16_t  samples[AUDIO_STREAM_MAX_FRAME_SAMPLES];
+    uint32_t seq;                   /* Capture sequence number of the frame */
+    bool     speech;                /* VAD decision taken when it was captured */
+} audio_preroll_frame_t;
+
+typedef struct
+{
+    audio_preroll_frame_t frames[AUDIO_PREROLL_FRAMES];
+    uint32_t head;                  /* Slot the next frame is written to */
+    uint32_t count;                 /* Number of valid frames */
+} audio_preroll_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void audio_preroll_init(audio_preroll_t *preroll);
+void audio_preroll_push(audio_preroll_t *preroll, const int16_t *samples, uint32_t num_samples,
+                        uint32_t seq, bool speech);
+uint32_t audio_preroll_count(const audio_preroll_t *preroll);
+const audio_preroll_frame_t *audio_preroll_get(const audio_preroll_t *preroll, uint32_t index);
+void audio_preroll_clear(audio_preroll_t *preroll);
+
+#endif /* AUDIO_PREROLL_H_ */
@@ -0,0 +1,221 @@
+/******************************************************************************
+* File Name:   audio_resample.c
+*
+* Description: This file contains the fixed-point polyphase decimator.
+*
+* The 2:1 filter (16 kHz to 8 kHz) is a 48 tap Kaiser windowed sinc (beta
+* 5.65) with the DC gain rounded to exactly 32768. It is flat within 0.02 dB
+* up to 3.4 kHz and attenuates by at least 53 dB from 4.6 kHz, the band that
+* would alias into the passband.
+*
+* Each output is the dot product of the taps with a window of the history
+* buffer that advances by 'factor' samples per output. Products are summed
+* in 64 bits so that no input can overflow the sum; the SIMD form uses
+* SMLALD on sample pairs and gives bit-identical results.
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "audio_resample.h"
+
+#if AUDIO_DSP_USE_SIMD
+#include "cmsis_compiler.h"
+#endif
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static const int16_t taps_decim2[48] =
+{
+    -6, -12, 20, 30, -43, -59, 80, 105, -136, -173, 218, 271,
+    -335, -411, 502, 614, -753, -930, 1164, 1491, -1991, -2866, 4867, 14737,
+    14737, 4867, -2866, -1991, 1491, 1164, -930, -753, 614, 502, -411, -335,
+    271, 218, -173, -136, 105, 80, -59, -43, 30, 20, -12, -6
+};
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static void history_append(audio_resample_t *rs, const int16_t *in, uint32_t num_in);
+static void history_shift(audio_resample_t *rs, uint32_t num_in);
+static inline int16_t round_q15(int64_t acc);
+
+/*******************************************************************************
+* Function Name: audio_resample_init
+********************************************************************************
+* Summary:
+*  Initializes a decimator with an empty (zero) history.
+*
+* Parameters:
+*  rs: Decimator
+*  factor: Decimation factor, 1 or 2
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_resample_init(audio_resample_t *rs, uint32_t factor)
+{
+    switch (factor)
+    {
+        case 2u:
+        {
+            rs->taps = taps_decim2;
+            rs->num_taps = sizeof(taps_decim2) / sizeof(taps_decim2[0]);
+            break;
+        }
+        default:
+        {
+            factor = 1u;
+            rs->taps = NULL;
+            rs->num_taps = 0;
+            break;
+        }
+    }
+
+    rs->factor = factor;
+    memset(rs->history, 0, sizeof(rs->history));
+}
+
+/*******************************************************************************
+* Function Name: audio_resample_process
+********************************************************************************
+* Summary:
+*  Decimates a block of samples. 'in' and 'out' may be the same buffer.
+*
+* Parameters:
+*  rs: Decimator
+*  in: Input samples
+*  num_in: Number of input samples, a multiple of the factor and at most
+*          AUDIO_RESAMPLE_MAX_BLOCK
+*  out: Output buffer of num_in / factor samples
+*
+* Return:
+*  uint32_t: Number of output samples
+*
+*******************************************************************************/
+uint32_t audio_resample_process(audio_resample_t *rs, const int16_t *in, uint32_t num_in, int16_t *out)
+{
+#if AUDIO_DSP_USE_SIMD
+    uint32_t num_out;
+
+    if (rs->factor == 1u)
+    {
+        memmove(out, in, num_in * sizeof(int16_t));
+        return num_in;
+    }
+
+    history_append(rs, in, num_in);
+
+    num_out = num_in / rs->factor;
+    for (uint32_t k = 0; k < num_out; k++)
+    {
+        const int16_t *x = &rs->history[k * rs->factor];
+        uint64_t acc = 0;
+
+        for (uint32_t i = 0; i < rs->num_taps; i += 2u)
+        {
+            uint32_t xs;
+            uint32_t hs;
+
+            memcpy(&xs, &x[i], sizeof(xs));
+            memcpy(&hs, &rs->taps[i], sizeof(hs));
+            acc = __SMLALD(xs, hs, acc);
+        }
+
+        out[k] = round_q15((int64_t)acc);
+    }
+
+    history_shift(rs, num_in);
+
+    return num_out;
+#else
+    return audio_resample_process_ref(rs, in, num_in, out);
+#endif
+}
+
+/*******************************************************************************
+* Function Name: audio_resample_process_ref
+********************************************************************************
+* Summary:
+*  Portable reference of audio_resample_process.
+*
+*******************************************************************************/
+uint32_t audio_resample_process_ref(audio_resample_t *rs, const int16_t *in, uint32_t num_in, int16_t *out)
+{
+    uint32_t num_out;
+
+    if (rs->factor == 1u)
+    {
+        memmove(out, in, num_in * sizeof(int16_t));
+        return num_in;
+    }
+
+    history_append(rs, in, num_in);
+
+    num_out = num_in / rs->factor;
+    for (uint32_t k = 0; k < num_out; k++)
+    {
+        const int16_t *x = &rs->history[k * rs->factor];
+        int64_t acc = 0;
+
+        /* The taps are symmetric, so the convolution needs no reversal */
+        for (uint32_t i = 0; i < rs->num_taps; i++)
+        {
+            acc += (int32_t)x[i] * rs->taps[i];
+        }
+
+        out[k] = round_q15(acc);
+    }
+
+    history_shift(rs, num_in);
+
+    return num_out;
+}
+
+/*******************************************************************************
+* Function Name: history_append
+********************************************************************************
+* Summary:
+*  Copies the input block behind the kept history.
+*
+*******************************************************************************/
+static void history_append(audio_resample_t *rs, const int16_t *in, uint32_t num_in)
+{
+    memcpy(&rs->history[rs->num_taps - 1u], in, num_in * sizeof(int16_t));
+}
+
+/*******************************************************************************
+* Function Name: history_shift
+********************************************************************************
+* Summary:
+*  Keeps the last num_taps - 1 samples for the next block.
+*
+*******************************************************************************/
+static void history_shift(audio_resample_t *rs, uint32_t num_in)
+{
+    memmove(rs->history, &rs->history[num_in], (rs->num_taps - 1u) * sizeof(int16_t));
+}
+
+/*******************************************************************************
+* Function Name: round_q15
+********************************************************************************
+* Summary:
+*  Rounds a Q30 sum to Q15 and saturates it to 16 bits.
+*
+*******************************************************************************/
+static inline int16_t round_q15(int64_t acc)
+{
+    acc = (acc + 0x4000) >> 15;
+
+    if (acc > INT16_MAX)
+    {
+        return INT16_MAX;
+    }
+    if (acc < INT16_MIN)
+    {
+        return INT16_MIN;
+    }
+    return (int16_t)acc;
+}
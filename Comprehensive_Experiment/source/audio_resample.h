@@ -0,0 +1,46 @@
+/******************************************************************************
+* File Name:   audio_resample.h
+*
+* Description: This file contains the fixed-point polyphase decimator that
+* converts capture frames from the native PDM/PCM rate to the uplink rate of
+* the selected audio profile. The anti-aliasing filters are linear phase
+* Q15 FIRs; only the outputs that are kept are computed, so the cost is
+* num_taps multiply-accumulates per output sample.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_RESAMPLE_H_
+#define AUDIO_RESAMPLE_H_
+
+#include <stdint.h>
+
+#include "audio_dsp.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Longest filter */
+#define AUDIO_RESAMPLE_MAX_TAPS             (48u)
+/* Largest number of input samples per call */
+#define AUDIO_RESAMPLE_MAX_BLOCK            (480u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    const int16_t *taps;            /* Q15 coefficients, DC gain of one */
+    uint32_t num_taps;              /* Even */
+    uint32_t factor;                /* 1 passes the samples through */
+    /* The last num_taps - 1 input samples followed by the current block */
+    int16_t  history[AUDIO_RESAMPLE_MAX_TAPS - 1u + AUDIO_RESAMPLE_MAX_BLOCK];
+} audio_resample_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void audio_resample_init(audio_resample_t *rs, uint32_t factor);
+uint32_t audio_resample_process(audio_resample_t *rs, const int16_t *in, uint32_t num_in, int16_t *out);
+uint32_t audio_resample_process_ref(audio_resample_t *rs, const int16_t *in, uint32_t num_in, int16_t *out);
+
+#endif /* AUDIO_RESAMPLE_H_ */
@@ -0,0 +1,401 @@
+/******************************************************************************
+* File Name:   audio_slm.c
+*
+* Description: This file contains the sound level meter.
+*
+* The A-weighting filter is designed at init for the sample rate. The two
+* 20.6 Hz poles, the 107.7 Hz and the 737.9 Hz pole and the four zeros at DC
+* are mapped by the bilinear transform, which is accurate far below the
+* Nyquist frequency. The two 12194 Hz poles lie close to or above the
+* Nyquist frequency of the uplink rates; the bilinear transform would pull
+* the response to zero at Nyquist, so they are matched (z = exp(-w T)) and an
+* extra zero at z = -r restores the analog curve at 0.35 of the sample rate.
+* The response is within 0.3 dB of IEC 61672-1 from 20 Hz to 0.4 of the
+* sample rate at 8, 16 and 48 kHz. Each biquad is scaled to unity gain at
+* 1 kHz.
+*
+* The biquads run in direct form I with Q28 coefficients on samples with 8
+* extra fraction bits, so that the quantization of the low frequency
+* sections stays far below the microphone noise. Levels are computed per
+* frame in floating point: the frame mean square is scaled to sound pressure
+* with the PDM/PCM gain the frame was captured with, so gain changes do not
+* show in the levels.
+*
+*******************************************************************************/
+
+#include <math.h>
+#include <complex.h>
+
+#include "audio_slm.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Pole frequencies of the A-weighting in Hz */
+#define A_POLE_1_HZ                         (20.598997)
+#define A_POLE_2_HZ                         (107.65265)
+#define A_POLE_3_HZ                         (737.86223)
+#define A_POLE_4_HZ                         (12194.217)
+/* Frequency at which the high frequency correction matches the analog
+ * curve, relative to the sample rate */
+#define A_MATCH_FRACTION                    (0.35)
+#define A_NORM_HZ                           (1000.0)
+
+/* Samples enter the filter with this many extra fraction bits */
+#define SLM_SAMPLE_SHIFT                    (8u)
+/* Of which the mean square keeps this many */
+#define SLM_SQUARE_SHIFT                    (4u)
+
+#define PI                                  (3.14159265358979323846)
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static void biquad_set(audio_slm_biquad_t *bq, const double *b, const double *a, double fs);
+static double complex biquad_response(const double *b, const double *a, double f, double fs);
+static double analog_a(double f);
+static double bilinear_pole(double f, double fs);
+static inline int32_t weight_sample(audio_slm_t *slm, int32_t x);
+static float level_db(float power);
+static uint16_t level_code(float db);
+
+/*******************************************************************************
+* Function Name: audio_slm_init
+********************************************************************************
+* Summary:
+*  Designs the A-weighting filter for a sample rate and starts a new period.
+*
+* Parameters:
+*  slm: Sound level meter
+*  sample_rate_hz: Sample rate of the frames
+*  frame_ms: Duration of a frame in milliseconds
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_slm_init(audio_slm_t *slm, uint32_t sample_rate_hz, uint32_t frame_ms)
+{
+    double fs = (double)sample_rate_hz;
+    double p1 = bilinear_pole(A_POLE_1_HZ, fs);
+    double p2 = bilinear_pole(A_POLE_2_HZ, fs);
+    double p3 = bilinear_pole(A_POLE_3_HZ, fs);
+    double p4 = exp(-2.0 * PI * A_POLE_4_HZ / fs);
+
+    const double b_dc[3] = { 1.0, -2.0, 1.0 };
+    const double a_1[3] = { 1.0, -2.0 * p1, p1 * p1 };
+    const double a_2[3] = { 1.0, -(p2 + p3), p2 * p3 };
+    const double a_4[3] = { 1.0, -2.0 * p4, p4 * p4 };
+    double b_4[3] = { 1.0, 0.0, 0.0 };
+
+    /* Zero at -r: solve |H(f_match)| / |H(1 kHz)| = analog ratio for r */
+    double f_match = A_MATCH_FRACTION * fs;
+    double ratio = analog_a(f_match) / analog_a(A_NORM_HZ);
+    double digital = cabs(biquad_response(b_dc, a_1, f_match, fs) * biquad_response(b_dc, a_2, f_match, fs) *
+                          biquad_response(b_4, a_4, f_match, fs)) /
+                     cabs(biquad_response(b_dc, a_1, A_NORM_HZ, fs) * biquad_response(b_dc, a_2, A_NORM_HZ, fs) *
+                          biquad_response(b_4, a_4, A_NORM_HZ, fs));
+    double t2 = (ratio / digital) * (ratio / digital);
+    double c1 = cos(2.0 * PI * f_match / fs);
+    double c0 = cos(2.0 * PI * A_NORM_HZ / fs);
+    double qa = 1.0 - t2;
+    double qb = 2.0 * (c1 - t2 * c0);
+    double r = 0.0;
+
+    if (fabs(qa) > 1e-12)
+    {
+        /* The roots are reciprocal, the one inside the unit circle is kept */
+        double root = sqrt(qb * qb - 4.0 * qa * qa);
+        r = (-qb + root) / (2.0 * qa);
+        if ((r <= -1.0) || (r >= 1.0))
+        {
+            r = (-qb - root) / (2.0 * qa);
+        }
+    }
+    b_4[1] = r;
+
+    biquad_set(&slm->biquad[0], b_dc, a_1, fs);
+    biquad_set(&slm->biquad[1], b_dc, a_2, fs);
+    biquad_set(&slm->biquad[2], b_4, a_4, fs);
+
+    slm->fast_coef = 1.0f - expf(-(float)frame_ms / AUDIO_SLM_FAST_MS);
+    slm->fast = 0.0f;
+    slm->energy = 0.0;
+    slm->frames = 0;
+    slm->period_frames = AUDIO_SLM_PERIOD_MS / frame_ms;
+    slm->period = 0;
+    slm->started = false;
+}
+
+/*******************************************************************************
+* Function Name: audio_slm_weight
+********************************************************************************
+* Summary:
+*  A-weights samples, continuing the filter state of audio_slm_process.
+*
+* Parameters:
+*  slm: Sound level meter
+*  samples: Input samples
+*  num_samples: Number of samples
+*  out: Weighted samples with SLM_SAMPLE_SHIFT (8) extra fraction bits
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_slm_weight(audio_slm_t *slm, const int16_t *samples, uint32_t num_samples, int32_t *out)
+{
+    for (uint32_t i = 0; i < num_samples; i++)
+    {
+        out[i] = weight_sample(slm, (int32_t)samples[i] * (1 << SLM_SAMPLE_SHIFT));
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_slm_process
+********************************************************************************
+* Summary:
+*  Measures a frame and, at the end of a period, returns its summary.
+*
+* Parameters:
+*  slm: Sound level meter
+*  samples: Frame samples
+*  num_samples: Number of samples
+*  gain: PDM/PCM gain the frame was captured with, 0.5 dB units
+*  summary: Filled at the end of a period
+*
+* Return:
+*  bool: true if summary was filled
+*
+*******************************************************************************/
+bool audio_slm_process(audio_slm_t *slm, const int16_t *samples, uint32_t num_samples, int16_t gain,
+                       audio_slm_summary_t *summary)
+{
+    uint64_t sum = 0;
+    float power;
+
+    if (num_samples == 0u)
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < num_samples; i++)
+    {
+        int32_t y = weight_sample(slm, (int32_t)samples[i] * (1 << SLM_SAMPLE_SHIFT)) >>
+                    (SLM_SAMPLE_SHIFT - SLM_SQUARE_SHIFT);
+        sum += (uint64_t)((int64_t)y * y);
+    }
+
+    /* Mean square relative to full scale, then to the reference pressure */
+    power = (float)((double)sum / (double)num_samples /
+                    (double)(1uLL << (2u * (15u + SLM_SQUARE_SHIFT))));
+    power *= powf(10.0f, (AUDIO_SLM_FULL_SCALE_DB_SPL - 0.5f * (float)gain) / 10.0f);
+
+    if (!slm->started)
+    {
+        slm->fast = power;
+        slm->started = true;
+    }
+    else
+    {
+        slm->fast += slm->fast_coef * (power - slm->fast);
+    }
+
+    if (slm->frames == 0u)
+    {
+        slm->fast_max = slm->fast;
+        slm->fast_min = slm->fast;
+    }
+    slm->fast_max = (slm->fast > slm->fast_max) ? slm->fast : slm->fast_max;
+    slm->fast_min = (slm->fast < slm->fast_min) ? slm->fast : slm->fast_min;
+    slm->energy += power;
+    slm->frames++;
+
+    if (slm->frames < slm->period_frames)
+    {
+        return false;
+    }
+
+    summary->laeq_db = level_db((float)(slm->energy / slm->frames));
+    summary->lafmax_db = level_db(slm->fast_max);
+    summary->lafmin_db = level_db(slm->fast_min);
+    summary->period = slm->period;
+
+    slm->period++;
+    slm->energy = 0.0;
+    slm->frames = 0;
+
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: audio_slm_encode
+********************************************************************************
+* Summary:
+*  Encodes a summary into the AUDIO_SLM_SUMMARY_SIZE bytes sent to the
+*  server: "SL", the period number, LAeq, LAFmax and LAFmin, each 16-bit
+*  little endian, levels in 0.01 dB.
+*
+* Parameters:
+*  summary: Summary
+*  out: Buffer of AUDIO_SLM_SUMMARY_SIZE bytes
+*
+* Return:
+*  uint32_t: Number of bytes written
+*
+*******************************************************************************/
+uint32_t audio_slm_encode(const audio_slm_summary_t *summary, uint8_t *out)
+{
+    uint16_t fields[4] =
+    {
+        summary->period,
+        level_code(summary->laeq_db),
+        level_code(summary->lafmax_db),
+        level_code(summary->lafmin_db),
+    };
+
+    out[0] = 'S';
+    out[1] = 'L';
+    for (uint32_t i = 0; i < 4u; i++)
+    {
+        out[2u + 2u * i] = (uint8_t)(fields[i] & 0xFF);
+        out[3u + 2u * i] = (uint8_t)(fields[i] >> 8);
+    }
+
+    return AUDIO_SLM_SUMMARY_SIZE;
+}
+
+/*******************************************************************************
+* Function Name: biquad_set
+********************************************************************************
+* Summary:
+*  Quantizes a biquad to Q28, scaling the numerator to unity gain at 1 kHz,
+*  and clears its state.
+*
+*******************************************************************************/
+static void biquad_set(audio_slm_biquad_t *bq, const double *b, const double *a, double fs)
+{
+    const double one = (double)(1uL << AUDIO_SLM_COEF_SHIFT);
+    double g = 1.0 / cabs(biquad_response(b, a, A_NORM_HZ, fs));
+
+    bq->b0 = (int32_t)lround(b[0] * g * one);
+    bq->b1 = (int32_t)lround(b[1] * g * one);
+    bq->b2 = (int32_t)lround(b[2] * g * one);
+    bq->a1 = (int32_t)lround(a[1] * one);
+    bq->a2 = (int32_t)lround(a[2] * one);
+    bq->x1 = 0;
+    bq->x2 = 0;
+    bq->y1 = 0;
+    bq->y2 = 0;
+}
+
+/*******************************************************************************
+* Function Name: biquad_response
+********************************************************************************
+* Summary:
+*  Returns the frequency response of a biquad.
+*
+*******************************************************************************/
+static double complex biquad_response(const double *b, const double *a, double f, double fs)
+{
+    double complex z1 = cexp(-I * 2.0 * PI * f / fs);
+    double complex z2 = z1 * z1;
+
+    return (b[0] + b[1] * z1 + b[2] * z2) / (a[0] + a[1] * z1 + a[2] * z2);
+}
+
+/*******************************************************************************
+* Function Name: analog_a
+********************************************************************************
+* Summary:
+*  Returns the magnitude of the analog A-weighting at a frequency, unscaled.
+*
+*******************************************************************************/
+static double analog_a(double f)
+{
+    double f2 = f * f;
+
+    return (A_POLE_4_HZ * A_POLE_4_HZ * f2 * f2) /
+           ((f2 + A_POLE_1_HZ * A_POLE_1_HZ) *
+            sqrt((f2 + A_POLE_2_HZ * A_POLE_2_HZ) * (f2 + A_POLE_3_HZ * A_POLE_3_HZ)) *
+            (f2 + A_POLE_4_HZ * A_POLE_4_HZ));
+}
+
+/*******************************************************************************
+* Function Name: bilinear_pole
+********************************************************************************
+* Summary:
+*  Maps a real analog pole at -2 pi f to the z-plane by the bilinear
+*  transform.
+*
+*******************************************************************************/
+static double bilinear_pole(double f, double fs)
+{
+    double k = PI * f / fs;
+
+    return (1.0 - k) / (1.0 + k);
+}
+
+/*******************************************************************************
+* Function Name: weight_sample
+********************************************************************************
+* Summary:
+*  Runs one sample through the biquad cascade.
+*
+*******************************************************************************/
+static inline int32_t weight_sample(audio_slm_t *slm, int32_t x)
+{
+    for (uint32_t s = 0; s < AUDIO_SLM_BIQUADS; s++)
+    {
+        audio_slm_biquad_t *bq = &slm->biquad[s];
+        int64_t acc = (int64_t)bq->b0 * x + (int64_t)bq->b1 * bq->x1 + (int64_t)bq->b2 * bq->x2 -
+                      (int64_t)bq->a1 * bq->y1 - (int64_t)bq->a2 * bq->y2;
+        int64_t y = (acc + (1 << (AUDIO_SLM_COEF_SHIFT - 1u))) >> AUDIO_SLM_COEF_SHIFT;
+
+        y = (y > INT32_MAX) ? INT32_MAX : y;
+        y = (y < INT32_MIN) ? INT32_MIN : y;
+
+        bq->x2 = bq->x1;
+        bq->x1 = x;
+        bq->y2 = bq->y1;
+        bq->y1 = (int32_t)y;
+        x = (int32_t)y;
+    }
+
+    return x;
+}
+
+/*******************************************************************************
+* Function Name: level_db
+********************************************************************************
+* Summary:
+*  Converts a mean square pressure relative to the reference to dB SPL, no
+*  sound giving 0 dB.
+*
+*******************************************************************************/
+static float level_db(float power)
+{
+    return (power > 1.0f) ? (10.0f * log10f(power)) : 0.0f;
+}
+
+/*******************************************************************************
+* Function Name: level_code
+********************************************************************************
+* Summary:
+*  Converts a level to the 0.01 dB units of the summary datagram.
+*
+*******************************************************************************/
+static uint16_t level_code(float db)
+{
+    float code = db * 100.0f + 0.5f;
+
+    if (code <= 0.0f)
+    {
+        return 0;
+    }
+    if (code >= 65535.0f)
+    {
+        return UINT16_MAX;
+    }
+    return (uint16_t)code;
+}
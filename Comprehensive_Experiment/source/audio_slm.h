@@ -0,0 +1,76 @@
+/******************************************************************************
+* File Name:   audio_slm.h
+*
+* Description: This file contains the sound level meter: A-weighting of the
+* capture frames by a fixed-point biquad cascade, the 'Fast' (125 ms) time
+* weighting and the per-second aggregates LAeq, LAFmax and LAFmin.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_SLM_H_
+#define AUDIO_SLM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define AUDIO_SLM_BIQUADS                   (3u)
+/* Fraction bits of the biquad coefficients */
+#define AUDIO_SLM_COEF_SHIFT                (28u)
+/* Sound pressure level of a mean square of full scale (a full scale square
+ * wave) at 0 dB PDM/PCM gain. The microphone gives a -26 dBFS sine at 94 dB
+ * SPL, a full scale sine is 120 dB SPL and its mean square 3 dB below full
+ * scale. Calibrate against a reference meter for better than a few dB. */
+#define AUDIO_SLM_FULL_SCALE_DB_SPL         (123.0f)
+/* Time constant of the 'Fast' time weighting */
+#define AUDIO_SLM_FAST_MS                   (125.0f)
+/* Aggregation period of the summaries */
+#define AUDIO_SLM_PERIOD_MS                 (1000u)
+/* Size of the summary datagram: "SL", the period number and the three
+ * levels, all 16-bit little endian, levels in 0.01 dB */
+#define AUDIO_SLM_SUMMARY_SIZE              (10u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+/* Direct form I biquad, y = b0 x + b1 x1 + b2 x2 - a1 y1 - a2 y2 */
+typedef struct
+{
+    int32_t b0, b1, b2, a1, a2;     /* Q28 */
+    int32_t x1, x2, y1, y2;
+} audio_slm_biquad_t;
+
+typedef struct
+{
+    float    laeq_db;               /* Equivalent continuous level of the period */
+    float    lafmax_db;             /* Highest 'Fast' level of the period */
+    float    lafmin_db;             /* Lowest 'Fast' level of the period */
+    uint16_t period;                /* Period number, wraps around */
+} audio_slm_summary_t;
+
+typedef struct
+{
+    audio_slm_biquad_t biquad[AUDIO_SLM_BIQUADS];
+    float    fast_coef;
+    float    fast;                  /* 'Fast' weighted mean square, full scale 1.0 */
+    double   energy;                /* Sum of the frame mean squares of the period */
+    float    fast_max;
+    float    fast_min;
+    uint32_t frames;                /* Frames of the current period */
+    uint32_t period_frames;
+    uint16_t period;
+    bool     started;
+} audio_slm_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void audio_slm_init(audio_slm_t *slm, uint32_t sample_rate_hz, uint32_t frame_ms);
+void audio_slm_weight(audio_slm_t *slm, const int16_t *samples, uint32_t num_samples, int32_t *out);
+bool audio_slm_process(audio_slm_t *slm, const int16_t *samples, uint32_t num_samples, int16_t gain,
+                       audio_slm_summary_t *summary);
+uint32_t audio_slm_encode(const audio_slm_summary_t *summary, uint8_t *out);
+
+#endif /* AUDIO_SLM_H_ */
@@ -0,0 +1,410 @@
+/******************************************************************************
+* File Name:   audio_stats.c
+*
+* Description: This file contains the audio quality telemetry.
+*
+* The frame pass sums the samples and their squares and keeps the largest
+* magnitude and the number of clipped samples. The SIMD form handles two
+* samples per instruction: SMLAD and SMLALD for the sums, QSUB16 and SEL for
+* the magnitudes (saturating, so -32768 counts as 32767) and SSUB16 and SEL
+* for the running maximum and the clip counter.
+*
+* The noise floor follows the minimum statistics method: the frame power is
+* smoothed and its minimum is tracked over a sliding window made of
+* sub-windows, so the estimate follows a rising floor within one window
+* length while speech, which is never stationary that long, does not lift it.
+* A frame averages a few hundred samples, so the minimum of the smoothed power
+* is used without a bias correction (within a few percent on white noise).
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "audio_stats.h"
+
+#if AUDIO_DSP_USE_SIMD
+#include "cmsis_compiler.h"
+#endif
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static void frame_finish(int32_t sum, uint64_t sum_sq, uint32_t num_samples, audio_stats_frame_t *stats);
+static uint16_t isqrt32(uint32_t value);
+static uint32_t power_scale(uint32_t power, uint32_t ratio_q16);
+
+/*******************************************************************************
+* Function Name: audio_stats_measure
+********************************************************************************
+* Summary:
+*  Measures the level statistics of a frame.
+*
+* Parameters:
+*  samples: Frame samples
+*  num_samples: Number of samples, at most 65535
+*  stats: Filled with the statistics
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_stats_measure(const int16_t *samples, uint32_t num_samples, audio_stats_frame_t *stats)
+{
+#if AUDIO_DSP_USE_SIMD
+    const uint32_t ones = 0x00010001u;
+    const uint32_t clip = ((uint32_t)AUDIO_STATS_CLIP_LEVEL << 16) | (uint32_t)AUDIO_STATS_CLIP_LEVEL;
+    uint64_t sum_sq = 0;
+    int32_t sum = 0;
+    uint32_t peak = 0;
+    uint32_t clipped = 0;
+    uint32_t peak_lo;
+    uint32_t peak_hi;
+    uint32_t i;
+
+    for (i = 0; (i + 1u) < num_samples; i += 2u)
+    {
+        uint32_t xs;
+        uint32_t mag;
+
+        memcpy(&xs, &samples[i], sizeof(xs));
+        sum = (int32_t)__SMLAD(xs, ones, (uint32_t)sum);
+        sum_sq = __SMLALD(xs, xs, sum_sq);
+
+        mag = __QSUB16(0u, xs);
+        (void)__SSUB16(xs, mag);                /* GE set where x >= 0 */
+        mag = __SEL(xs, mag);
+
+        (void)__SSUB16(mag, peak);
+        peak = __SEL(mag, peak);
+
+        (void)__SSUB16(mag, clip);
+        clipped = __UADD16(clipped, __SEL(ones, 0u));
+    }
+
+    peak_lo = peak & 0xFFFFu;
+    peak_hi = peak >> 16;
+    peak = (peak_hi > peak_lo) ? peak_hi : peak_lo;
+    clipped = (clipped & 0xFFFFu) + (clipped >> 16);
+
+    if (i < num_samples)
+    {
+        int32_t x = samples[i];
+        uint32_t mag = (x < 0) ? (uint32_t)((x == INT16_MIN) ? INT16_MAX : -x) : (uint32_t)x;
+
+        sum += x;
+        sum_sq += (uint64_t)(x * x);
+        peak = (mag > peak) ? mag : peak;
+        clipped += (mag >= (uint32_t)AUDIO_STATS_CLIP_LEVEL) ? 1u : 0u;
+    }
+
+    stats->peak = (uint16_t)peak;
+    stats->clipped = (uint16_t)clipped;
+    frame_finish(sum, sum_sq, num_samples, stats);
+#else
+    audio_stats_measure_ref(samples, num_samples, stats);
+#endif
+}
+
+/*******************************************************************************
+* Function Name: audio_stats_measure_ref
+********************************************************************************
+* Summary:
+*  Portable reference of audio_stats_measure.
+*
+*******************************************************************************/
+void audio_stats_measure_ref(const int16_t *samples, uint32_t num_samples, audio_stats_frame_t *stats)
+{
+    uint64_t sum_sq = 0;
+    int32_t sum = 0;
+    uint32_t peak = 0;
+    uint32_t clipped = 0;
+
+    for (uint32_t i = 0; i < num_samples; i++)
+    {
+        int32_t x = samples[i];
+        uint32_t mag = (x < 0) ? (uint32_t)((x == INT16_MIN) ? INT16_MAX : -x) : (uint32_t)x;
+
+        sum += x;
+        sum_sq += (uint64_t)(x * x);
+        peak = (mag > peak) ? mag : peak;
+        clipped += (mag >= (uint32_t)AUDIO_STATS_CLIP_LEVEL) ? 1u : 0u;
+    }
+
+    stats->peak = (uint16_t)peak;
+    stats->clipped = (uint16_t)clipped;
+    frame_finish(sum, sum_sq, num_samples, stats);
+}
+
+/*******************************************************************************
+* Function Name: audio_stats_noise_init
+********************************************************************************
+* Summary:
+*  Initializes the noise floor tracker; the first frame sets the estimate.
+*
+* Parameters:
+*  noise: Noise floor tracker
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_stats_noise_init(audio_stats_noise_t *noise)
+{
+    noise->smoothed = 0;
+    noise->window_min = UINT32_MAX;
+    noise->window_frames = 0;
+    for (uint32_t i = 0; i < AUDIO_STATS_NOISE_SUBWINDOWS; i++)
+    {
+        noise->minima[i] = UINT32_MAX;
+    }
+    noise->index = 0;
+    noise->floor = 0;
+    noise->started = false;
+}
+
+/*******************************************************************************
+* Function Name: audio_stats_noise_update
+********************************************************************************
+* Summary:
+*  Updates the noise floor estimate with the power of a frame.
+*
+* Parameters:
+*  noise: Noise floor tracker
+*  power: Frame power, audio_stats_frame_t.power
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_stats_noise_update(audio_stats_noise_t *noise, uint32_t power)
+{
+    uint32_t minimum;
+
+    if (!noise->started)
+    {
+        noise->smoothed = power;
+        noise->started = true;
+    }
+
+    if (power >= noise->smoothed)
+    {
+        noise->smoothed += (power - noise->smoothed) >> AUDIO_STATS_NOISE_SMOOTH_SHIFT;
+    }
+    else
+    {
+        noise->smoothed -= (noise->smoothed - power) >> AUDIO_STATS_NOISE_SMOOTH_SHIFT;
+    }
+
+    if (noise->smoothed < noise->window_min)
+    {
+        noise->window_min = noise->smoothed;
+    }
+
+    minimum = noise->window_min;
+    for (uint32_t i = 0; i < AUDIO_STATS_NOISE_SUBWINDOWS; i++)
+    {
+        minimum = (noise->minima[i] < minimum) ? noise->minima[i] : minimum;
+    }
+
+    noise->window_frames++;
+    if (noise->window_frames == AUDIO_STATS_NOISE_SUBWINDOW_FRAMES)
+    {
+        /* The oldest sub-window leaves the search window */
+        noise->minima[noise->index] = noise->window_min;
+        noise->index = (noise->index + 1u) % AUDIO_STATS_NOISE_SUBWINDOWS;
+        noise->window_min = noise->smoothed;
+        noise->window_frames = 0;
+    }
+
+    noise->floor = minimum;
+}
+
+/*******************************************************************************
+* Function Name: audio_stats_noise_scale
+********************************************************************************
+* Summary:
+*  Scales the noise floor estimate and the minima it is searched over after a
+*  change of the capture gain.
+*
+* Parameters:
+*  noise: Noise floor tracker
+*  ratio_q16: Power ratio of the new to the old gain, Q16
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_stats_noise_scale(audio_stats_noise_t *noise, uint32_t ratio_q16)
+{
+    noise->smoothed = power_scale(noise->smoothed, ratio_q16);
+    noise->window_min = power_scale(noise->window_min, ratio_q16);
+    for (uint32_t i = 0; i < AUDIO_STATS_NOISE_SUBWINDOWS; i++)
+    {
+        noise->minima[i] = power_scale(noise->minima[i], ratio_q16);
+    }
+    noise->floor = power_scale(noise->floor, ratio_q16);
+}
+
+/*******************************************************************************
+* Function Name: audio_stats_session_init
+********************************************************************************
+* Summary:
+*  Clears the statistics of a recording.
+*
+* Parameters:
+*  session: Recording statistics
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_stats_session_init(audio_stats_session_t *session)
+{
+    memset(session, 0, sizeof(*session));
+}
+
+/*******************************************************************************
+* Function Name: audio_stats_session_add
+********************************************************************************
+* Summary:
+*  Adds the statistics of a frame to the recording.
+*
+* Parameters:
+*  session: Recording statistics
+*  stats: Frame statistics
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_stats_session_add(audio_stats_session_t *session, const audio_stats_frame_t *stats)
+{
+    session->frames++;
+    session->power_sum += stats->power;
+    session->dc_sum += stats->dc;
+    session->clipped += stats->clipped;
+    if (stats->peak > session->peak)
+    {
+        session->peak = stats->peak;
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_stats_session_summary
+********************************************************************************
+* Summary:
+*  Summarizes a recording: the RMS of the mean frame power, the largest peak,
+*  the clipped samples, the mean DC offset and the current noise floor.
+*
+* Parameters:
+*  session: Recording statistics
+*  noise: Noise floor tracker
+*  summary: Filled with the summary
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_stats_session_summary(const audio_stats_session_t *session, const audio_stats_noise_t *noise,
+                                 audio_stats_summary_t *summary)
+{
+    memset(summary, 0, sizeof(*summary));
+
+    summary->frames = session->frames;
+    summary->peak = session->peak;
+    summary->clipped = session->clipped;
+    summary->noise_floor = isqrt32(noise->floor);
+    if (session->frames > 0u)
+    {
+        summary->rms = isqrt32((uint32_t)(session->power_sum / session->frames));
+        summary->dc = (int16_t)(session->dc_sum / (int32_t)session->frames);
+    }
+}
+
+/*******************************************************************************
+* Function Name: frame_finish
+********************************************************************************
+* Summary:
+*  Derives the DC offset, the power and the RMS of a frame from its sums.
+*
+*******************************************************************************/
+static void frame_finish(int32_t sum, uint64_t sum_sq, uint32_t num_samples, audio_stats_frame_t *stats)
+{
+    int32_t dc;
+    uint64_t spread;
+
+    if (num_samples == 0u)
+    {
+        stats->power = 0;
+        stats->rms = 0;
+        stats->dc = 0;
+        return;
+    }
+
+    /* Rounded to nearest, halves away from zero */
+    dc = (sum >= 0) ? ((sum + (int32_t)(num_samples / 2u)) / (int32_t)num_samples)
+                    : -((-sum + (int32_t)(num_samples / 2u)) / (int32_t)num_samples);
+
+    /* n * sum(x^2) - sum(x)^2 is exact in 64 bits for n below 2^16, unlike
+     * subtracting the rounded DC offset from the mean square */
+    spread = (uint64_t)num_samples * sum_sq - (uint64_t)((int64_t)sum * sum);
+
+    stats->dc = (int16_t)dc;
+    stats->power = (uint32_t)(spread / ((uint64_t)num_samples * num_samples));
+    stats->rms = isqrt32(stats->power);
+}
+
+/*******************************************************************************
+* Function Name: isqrt32
+********************************************************************************
+* Summary:
+*  Returns the integer square root of a value, rounded down.
+*
+*******************************************************************************/
+static uint16_t isqrt32(uint32_t value)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1uL << 30;
+
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+
+    while (bit != 0u)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint16_t)root;
+}
+
+/*******************************************************************************
+* Function Name: power_scale
+********************************************************************************
+* Summary:
+*  Multiplies a power by a Q16 ratio, saturating. UINT32_MAX marks a minimum
+*  not taken yet and is kept.
+*
+*******************************************************************************/
+static uint32_t power_scale(uint32_t power, uint32_t ratio_q16)
+{
+    uint64_t scaled;
+
+    if (power == UINT32_MAX)
+    {
+        return UINT32_MAX;
+    }
+
+    scaled = ((uint64_t)power * ratio_q16) >> 16;
+    return (scaled >= UINT32_MAX) ? (UINT32_MAX - 1u) : (uint32_t)scaled;
+}
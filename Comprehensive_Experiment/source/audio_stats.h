@@ -0,0 +1,91 @@
+/******************************************************************************
+* File Name:   audio_stats.h
+*
+* Description: This file contains the audio quality telemetry: level
+* statistics of every capture frame (RMS, peak, clipped samples, DC offset)
+* taken in one pass over the raw PCM, a minimum statistics noise floor
+* estimate and the summary of a recording sent to the server.
+*
+* Levels are Q15 amplitudes like the samples; the server converts them to
+* dBFS. On cores with the DSP extension the frame pass uses the SIMD
+* instructions; the portable reference gives bit-identical results.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_STATS_H_
+#define AUDIO_STATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "audio_dsp.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Samples with a magnitude from this level up count as clipped */
+#define AUDIO_STATS_CLIP_LEVEL              (32700)
+/* Smoothing of the frame power before the minimum search, 1/4 */
+#define AUDIO_STATS_NOISE_SMOOTH_SHIFT      (2u)
+/* The minimum is searched over AUDIO_STATS_NOISE_SUBWINDOWS windows of
+ * AUDIO_STATS_NOISE_SUBWINDOW_FRAMES frames (1.6 s) */
+#define AUDIO_STATS_NOISE_SUBWINDOW_FRAMES  (32u)
+#define AUDIO_STATS_NOISE_SUBWINDOWS        (5u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    uint32_t power;                 /* Mean square with the DC offset removed */
+    uint16_t rms;                   /* Square root of power */
+    uint16_t peak;                  /* Largest magnitude */
+    uint16_t clipped;               /* Samples at or above AUDIO_STATS_CLIP_LEVEL */
+    int16_t  dc;                    /* Mean */
+} audio_stats_frame_t;
+
+typedef struct
+{
+    uint32_t smoothed;              /* Smoothed frame power */
+    uint32_t window_min;            /* Minimum of the current sub-window */
+    uint32_t window_frames;
+    uint32_t minima[AUDIO_STATS_NOISE_SUBWINDOWS];  /* Minima of the last sub-windows */
+    uint32_t index;                 /* Sub-window replaced next */
+    uint32_t floor;                 /* Noise power estimate */
+    bool     started;               /* The first frame sets the smoothed power */
+} audio_stats_noise_t;
+
+typedef struct
+{
+    uint32_t frames;
+    uint64_t power_sum;
+    int32_t  dc_sum;
+    uint16_t peak;
+    uint32_t clipped;
+} audio_stats_session_t;
+
+/* Summary of a recording */
+typedef struct
+{
+    uint32_t frames;
+    uint16_t rms;
+    uint16_t peak;
+    uint32_t clipped;
+    int16_t  dc;
+    uint16_t noise_floor;           /* RMS of the noise floor estimate */
+} audio_stats_summary_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void audio_stats_measure(const int16_t *samples, uint32_t num_samples, audio_stats_frame_t *stats);
+void audio_stats_measure_ref(const int16_t *samples, uint32_t num_samples, audio_stats_frame_t *stats);
+void audio_stats_noise_init(audio_stats_noise_t *noise);
+void audio_stats_noise_update(audio_stats_noise_t *noise, uint32_t power);
+void audio_stats_noise_scale(audio_stats_noise_t *noise, uint32_t ratio_q16);
+void audio_stats_session_init(audio_stats_session_t *session);
+void audio_stats_session_add(audio_stats_session_t *session, const audio_stats_frame_t *stats);
+void audio_stats_session_summary(const audio_stats_session_t *session, const audio_stats_noise_t *noise,
+                                 audio_stats_summary_t *summary);
+
+#endif /* AUDIO_STATS_H_ */
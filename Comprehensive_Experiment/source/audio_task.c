@@ -20,47 +20,259 @@
 
 /* TCP client task header file. */
 #include "udp_client.h"
+#include "net_tx_task.h"
 #include "audio_task.h"
 #include "led_task.h"
+#include "button.h"
+#include "audio_vad.h"
+#include "audio_dsp.h"
+#include "audio_chunk.h"
+#include "audio_preroll.h"
+#include "audio_resample.h"
+#include "audio_beam.h"
+#include "audio_mfcc.h"
+#include "audio_kws.h"
+#include "audio_pool.h"
+#include "audio_stats.h"
+#include "audio_gain.h"
+#include "audio_slm.h"
+#include "audio_ns.h"
+#include "audio_packet.h"
+#include "audio_arq.h"
+#include "audio_fec.h"
+#include "audio_mtu.h"
 
 /*******************************************************************************
 * Function Prototypes
 ********************************************************************************/
 static void pdm_pcm_isr_handler(void *arg, cyhal_pdm_pcm_event_t event);
-static uint32_t read_switch_status(void);
 static void clock_init(void);
+static cy_rslt_t capture_start(void);
+static void capture_stop(void);
+static void audio_profile_apply(void);
+static void audio_profile_reset(void);
+static void audio_profile_report(void);
+static void record_start(uint32_t live_seq);
+static void record_process(const int16_t *samples, uint32_t seq, bool speech);
+static bool record_should_stop(void);
+static void record_stop(void);
+static void record_frame(audio_pool_frame_t *frame);
+static void lookback_push(audio_pool_frame_t *frame);
+static void lookback_flush(void);
+static void lookback_clear(void);
+static audio_codec_t upload_codec_select(uint32_t sample_rate_hz);
+static void wake_word_configure(void);
+static void gain_apply(void);
+static void noise_estimates_scale(uint32_t ratio_q16);
+static void slm_configure(void);
+static void slm_report(const audio_slm_summary_t *summary);
+static void noise_suppressor_configure(void);
+static cy_rslt_t upload_flush_chunk(void);
+static void upload_flush_held(void);
+static cy_rslt_t upload_send(uint8_t flags, uint32_t offset, uint8_t *datagram, uint32_t payload_size);
+static bool upload_transmit(const uint8_t *datagram, uint32_t size);
+static void upload_arq_service(void);
+static void upload_fec_send(const audio_packet_header_t *header, const uint8_t *payload, uint32_t payload_size);
+static void upload_probe_send(uint32_t payload_size);
+static uint16_t upload_session_seed(void);
 
 /*******************************************************************************
 * Global Variables
 ********************************************************************************/
-volatile bool pdm_pcm_flag = false;
-
 /* HAL Object */
 cyhal_pdm_pcm_t pdm_pcm;
 cyhal_clock_t   audio_clock;
 cyhal_clock_t   pll_clock;
 
-/* HAL Config */
-const cyhal_pdm_pcm_cfg_t pdm_pcm_cfg =
+/* HAL Config, the sample and decimation rates are set from the profile */
+static cyhal_pdm_pcm_cfg_t pdm_pcm_cfg =
 {
-    .sample_rate     = SAMPLE_RATE_HZ,
+    .sample_rate     = 16000u,
     .decimation_rate = DECIMATION_RATE,
-    .mode            = CYHAL_PDM_PCM_MODE_LEFT,
+    .mode            = (AUDIO_CAPTURE_CHANNELS == 2u) ? CYHAL_PDM_PCM_MODE_STEREO : CYHAL_PDM_PCM_MODE_LEFT,
     .word_length     = 16,  /* bits */
-    .left_gain       = CY_PDM_PCM_GAIN_10_5_DB,   /* dB */
-    .right_gain      = 0U,   /* dB */
+    .left_gain       = AUDIO_GAIN_DEFAULT,   /* 0.5 dB units */
+    .right_gain      = (AUDIO_CAPTURE_CHANNELS == 2u) ? AUDIO_GAIN_DEFAULT : 0,   /* 0.5 dB units */
+};
+
+/* Capture profiles. The uplink rate is capture_rate_hz / resample_factor;
+ * the conditioning, VAD, SD card and upload all run at the uplink rate. */
+static const audio_profile_t audio_profiles[AUDIO_PROFILE_COUNT] =
+{
+    [AUDIO_PROFILE_NARROWBAND] = { 16000u, DECIMATION_RATE, 2u },
+    [AUDIO_PROFILE_WIDEBAND]   = { 16000u, DECIMATION_RATE, 1u },
+    [AUDIO_PROFILE_FULLBAND]   = { 48000u, DECIMATION_RATE, 1u },
+};
+
+/* Active profile and the one requested by audio_profile_request, applied
+ * by the audio task between recordings */
+static audio_profile_id_t profile_id = AUDIO_DEFAULT_PROFILE;
+static volatile audio_profile_id_t profile_pending = AUDIO_DEFAULT_PROFILE;
+
+/* Samples per channel and frame at the capture rate and after the decimation */
+static volatile uint32_t capture_frame_samples;
+static uint32_t frame_samples;
+
+/* Decimation from the capture rate to the uplink rate */
+static audio_resample_t resampler;
+
+/* Beamformer of the stereo capture and its planar input */
+static audio_beam_t beam;
+static int16_t beam_left[(AUDIO_CAPTURE_CHANNELS == 2u) ? AUDIO_STREAM_MAX_FRAME_SAMPLES : 1u];
+static int16_t beam_right[(AUDIO_CAPTURE_CHANNELS == 2u) ? AUDIO_STREAM_MAX_FRAME_SAMPLES : 1u];
+
+/* Continuous capture ring filled by the PDM/PCM block */
+static audio_stream_t capture_stream;
+
+/* Task notified by the PDM/PCM interrupt for every published frame */
+static TaskHandle_t capture_consumer = NULL;
+
+/* Debounced user button events */
+static QueueHandle_t button_event_q = NULL;
+
+/* Conditioning applied in place to every captured frame. Pre-emphasis is
+ * off because the uploaded audio is fed to ASR unweighted; the software AGC
+ * is only used without the hardware gain control. */
+static const audio_dsp_cfg_t conditioning_cfg =
+{
+    .dc_block         = true,
+    .preemph          = false,
+    .agc              = (AUDIO_HW_GAIN_CONTROL == 0u),
+    .dc_pole_q15      = AUDIO_DSP_DC_POLE_Q15,
+    .preemph_coef_q15 = AUDIO_DSP_PREEMPH_COEF_Q15,
+    .agc_target_peak  = AUDIO_DSP_AGC_TARGET_PEAK,
+    .agc_max_gain_q12 = AUDIO_DSP_AGC_MAX_GAIN_Q12,
+};
+static audio_dsp_chain_t conditioning;
+
+/* Voice activity detector, runs on every captured frame */
+static audio_vad_t vad;
+
+/* Most recent frames captured while no recording is active. A recording
+ * starts with them, so the audio around the button press is not lost. */
+static audio_preroll_t preroll;
+
+/* Set by the button, the recording starts on the next captured frame */
+static bool record_requested;
+static bool record_active;
+/* Button held since the press that started the recording. A recording is
+ * never ended by the endpoint detection while the button is held. */
+static bool record_held;
+/* Sequence number expected for the next frame of the recording and the
+ * one of its first live frame */
+static uint32_t record_next_seq;
+static uint32_t record_live_seq;
+/* Non-speech frames since the last speech frame */
+static uint32_t record_silence_frames;
+/* Frames of the recording dropped by the capture */
+static uint32_t record_dropped;
+
+/* Frames of the recording, shared by reference between the UDP upload and
+ * the SD card */
+static audio_pool_t frame_pool;
+
+/* Non-speech frames of the recording that are only uploaded if speech
+ * follows, so that the speech onset is not cut */
+static audio_pool_frame_t *lookback[RECORD_LOOKBACK_FRAMES];
+static uint32_t lookback_head;
+static uint32_t lookback_count;
+
+/* Set once the recording contained speech and the upload was started */
+static bool upload_active;
+/* Set if the upload could not be started; the rest of the recording is
+ * skipped */
+static bool upload_failed;
+
+/* Server address of the audio upload */
+static const cy_socket_sockaddr_t audio_server_addr =
+{
+    .ip_address.ip.v4 = UDP_SERVER_IP_ADDRESS,
+    .ip_address.version = CY_SOCKET_IP_VER_V4,
+    .port = UDP_SERVER_PORT
 };
 
-/* Pointer to the new frame that need to be written */
-uint8_t *current_frame;
+/* Audio not yet sent because it does not fill a whole datagram, behind the
+ * space of the datagram header; the chunk also counts the samples of the
+ * current upload, sent with the end datagram */
+static uint8_t  upload_datagram[AUDIO_PACKET_HEADER_SIZE + AUDIO_UPLOAD_CHUNK_SIZE];
+static audio_chunk_t upload_chunk;
+static uint32_t upload_total_bytes;
+/* Datagrams of the current upload that found the network queue full */
+static uint32_t upload_queue_drops;
+/* Session of the current upload and sequence number of its next datagram */
+static uint16_t upload_session;
+static uint16_t upload_seq;
+/* Sequence number of the next path MTU probe, counted apart from the
+ * datagrams of the uploads, see audio_packet.h */
+static uint16_t upload_probe_seq;
+
+/* Datagrams of the upload kept for the NACKs of the server, and the
+ * feedback received by the socket callback */
+static audio_arq_t upload_arq;
+static QueueHandle_t upload_feedback_q = NULL;
+
+/* Parities of the upload, and the buffer their datagrams are sent from */
+static audio_fec_t upload_fec;
+static bool upload_fec_active;
+static uint8_t upload_parity[AUDIO_FEC_MAX_DATAGRAM];
+
+/* Chunk size of the uploads and the probes of the path MTU */
+static audio_mtu_t upload_mtu;
+
+/* Encoding of the current upload */
+static audio_codec_t upload_codec = AUDIO_CODEC_PCM16;
+
+/* Wake word detector, runs between recordings if a model is present and
+ * the uplink rate matches */
+static audio_kws_t kws;
+static bool kws_active;
+
+/* Set by the server to receive log-mel features instead of audio */
+static volatile bool features_requested;
+static audio_mfcc_t features;
+static int16_t feature_vector[AUDIO_MFCC_NUM_BANDS];
+
+/* Level statistics of the raw capture: of the current frame, the noise floor
+ * and the live frames of the recording */
+static audio_stats_frame_t frame_stats;
+static audio_stats_noise_t noise_floor;
+static audio_stats_session_t record_stats;
+
+/* Control of the PDM/PCM gain from the frame statistics */
+static audio_gain_t hw_gain;
+
+/* Power ratio of the last gain change, applied to the noise estimates once
+ * the frames captured at the new gain arrive */
+static uint32_t gain_ratio_q16;
+static uint32_t gain_ratio_frames;
 
-uint8_t audio_frame[PDM_PCM_BUFFER_SIZE] = {0};
+/* Sound level meter, reports a summary to the server every second */
+static audio_slm_t slm;
+static audio_slm_summary_t slm_summary;
+
+/* Noise suppressor of the uploaded speech, learns the noise from the frames
+ * the VAD rejects */
+static audio_ns_t noise_suppressor;
+static bool ns_active;
 
 /*******************************************************************************
 * Function Name: audio_task
 ********************************************************************************
 * Summary:
-*  Task function that handles audio recording and sending to TCP server.
+*  Task function that handles audio recording and sending to UDP server.
+*  The PDM/PCM block captures continuously into capture_stream and every
+*  frame is run through the voice activity detector. While no recording is
+*  active the frames are kept in the pre-roll, and a recording starts with
+*  the pre-roll followed by the live frames.
+*
+*  The wake word starts a recording like a short press of the button.
+*  A recording started with a short press ends at the speech endpoint, after
+*  RECORD_ENDPOINT_SILENCE_MS without speech; one started by holding the
+*  button ends when it is released (push-to-talk). A press during the
+*  recording ends it too. Speech frames of the recording are forwarded to
+*  the UDP server and the SD card as soon as they are filled; silence
+*  before, between and after speech is dropped, and a recording without
+*  speech is not uploaded at all.
 *
 * Parameters:
 *  void *arg : Task parameter defined during task creation (unused).
@@ -72,10 +284,27 @@ uint8_t audio_frame[PDM_PCM_BUFFER_SIZE] = {0};
 void audio_task(void *arg)
 {
     cy_rslt_t result;
-    
+    const audio_stream_frame_t *frame;
+    button_event_t button_event;
+
     /* To avoid compiler warning */
     (void)arg;
 
+    capture_consumer = xTaskGetCurrentTaskHandle();
+
+    button_event_q = xQueueCreate(BUTTON_EVENT_QUEUE_LENGTH, sizeof(button_event_t));
+    button_subscribe(button_event_q);
+    upload_feedback_q = xQueueCreate(AUDIO_UPLOAD_FEEDBACK_QUEUE_LENGTH, sizeof(audio_arq_feedback_t));
+
+    audio_dsp_chain_init(&conditioning, &conditioning_cfg);
+    audio_vad_init(&vad);
+    audio_stats_noise_init(&noise_floor);
+    audio_gain_init(&hw_gain, AUDIO_GAIN_DEFAULT, AUDIO_STREAM_FRAME_MS);
+    audio_preroll_init(&preroll);
+    audio_pool_init(&frame_pool);
+    audio_mfcc_init();
+    (void)audio_kws_init(&kws);
+
     /* 初始化音频系统 */
     result = init_audio_system();
     if (result != CY_RSLT_SUCCESS)
@@ -84,6 +313,19 @@ void audio_task(void *arg)
         return;
     }
 
+    /* Sessions start at a random number, so that the server does not mistake
+     * the uploads after a reset for the ones before it */
+    upload_session = upload_session_seed();
+
+    upload_fec_active = (AUDIO_UPLOAD_FEC_DATA != 0u) &&
+                        audio_fec_init(&upload_fec, AUDIO_UPLOAD_FEC_DATA, AUDIO_UPLOAD_FEC_PARITY);
+    if ((AUDIO_UPLOAD_FEC_DATA != 0u) && !upload_fec_active)
+    {
+        printf("前向纠错参数无效，上传不带校验包\r\n");
+    }
+    /* The parity datagrams are the largest ones of an upload with FEC */
+    audio_mtu_init(&upload_mtu, AUDIO_UPLOAD_LINK_MTU, upload_fec_active ? AUDIO_FEC_SYMBOL_PREFIX : 0u);
+
     /* 初始化WIFI */
     result = init_wifi();
     if (result != CY_RSLT_SUCCESS)
@@ -92,66 +334,135 @@ void audio_task(void *arg)
         return;
     }
 
+    wake_word_configure();
+    slm_configure();
+    noise_suppressor_configure();
     printf("音频任务已启动，按下按钮开始录音\r\n");
     init_ok = true;
 
-    //led_command_data_t led_cmd_data;
-
     for(;;)
     {
-        /* Check if any microphone has data to process */
-        if (pdm_pcm_flag)
+        /* Sleep until the PDM/PCM interrupt publishes the next frame */
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(AUDIO_FRAME_WAIT_TIMEOUT_MS));
+
+        /* Consume every frame captured since the last pass */
+        while ((frame = audio_stream_get_frame(&capture_stream)) != NULL)
         {
-            // cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_ON);
+            /* Combine the microphones into the mono frame */
+            if (AUDIO_CAPTURE_CHANNELS == 2u)
+            {
+                audio_beam_deinterleave(frame->samples, beam_left, beam_right, capture_frame_samples);
+                audio_beam_process(&beam, beam_left, beam_right, capture_frame_samples, frame->samples);
+            }
+
+            /* Convert to the uplink rate in place */
+            (void)audio_resample_process(&resampler, frame->samples, capture_frame_samples, frame->samples);
+
+            /* First frame at the new gain: the noise estimates follow it */
+            if ((gain_ratio_frames > 0u) && (--gain_ratio_frames == 0u))
+            {
+                noise_estimates_scale(gain_ratio_q16);
+            }
+
+            /* Measured ahead of the conditioning, which removes the DC offset */
+            audio_stats_measure(frame->samples, frame_samples, &frame_stats);
+            audio_stats_noise_update(&noise_floor, frame_stats.power);
+
+            /* Scaled with the programmed gain, which the frames captured just
+             * after a change do not have yet; a few frames per change at most */
+            if ((AUDIO_SLM_ENABLE != 0u) &&
+                audio_slm_process(&slm, frame->samples, frame_samples, pdm_pcm_cfg.left_gain, &slm_summary))
+            {
+                slm_report(&slm_summary);
+            }
 
+            audio_dsp_chain_process(&conditioning, frame->samples, frame_samples);
 
-            /* Clear the PDM/PCM flag */
-            pdm_pcm_flag = 0;
+            /* Keep the noise floor up to date between recordings too */
+            bool speech = audio_vad_process(&vad, frame->samples, frame_samples);
 
-            if (emfile_task_handle != NULL)
+            if ((AUDIO_HW_GAIN_CONTROL != 0u) &&
+                audio_gain_update(&hw_gain, frame_stats.rms, frame_stats.peak, speech))
             {
-                printf("录音完成，正在保存数据到SD卡...\r\n");
-                xTaskNotifyGive(emfile_task_handle);
+                gain_apply();
             }
 
-            printf("录音完成，正在发送数据到UDP服务器...\r\n");
+            /* The frame is replaced by the previous one, denoised; the VAD
+             * decision is kept, its hangover covers the 10 ms offset */
+            if (ns_active)
+            {
+                audio_ns_process(&noise_suppressor, frame->samples, speech);
+            }
 
-            /* 发送音频数据到服务器 */
-            result = send_audio_data_to_server(audio_frame, PDM_PCM_BUFFER_SIZE);
+            if (record_requested)
+            {
+                record_requested = false;
+                record_start(frame->seq);
+            }
 
-            if (result != CY_RSLT_SUCCESS)
+            if (record_active)
             {
-                printf("发送数据到服务器失败，错误码: %ld\r\n", result);
+                audio_stats_session_add(&record_stats, &frame_stats);
+                record_process(frame->samples, frame->seq, speech);
+
+                if (record_should_stop())
+                {
+                    record_stop();
+                }
             }
             else
             {
-                printf("数据发送成功！\r\n");
+                audio_preroll_push(&preroll, frame->samples, frame_samples, frame->seq, speech);
+
+                if (kws_active && !record_requested && audio_kws_process(&kws, frame->samples, speech))
+                {
+                    printf("检测到唤醒词 \"%s\"（得分 %d%%）\r\n", audio_kws_model.keyword,
+                           (int)(kws.score * 100.0f));
+                    record_requested = true;
+                    record_held = false;
+                }
             }
-            
-            // cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_OFF);
-            
-            printf("按下按钮开始新的录音\r\n");
+
+            audio_stream_release_frame(&capture_stream);
         }
-        
-        if (0UL != read_switch_status())
+
+        /* A press starts a recording or ends the active one, releasing a
+         * button held for a long press ends it as well */
+        while (xQueueReceive(button_event_q, &button_event, 0) == pdTRUE)
         {
-            printf("开始录音...\r\n");
-
-            // cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_ON);
-            // led_cmd_data.command = LED_TURN_ON;
-            // xQueueSendToBack(led_command_data_q, &led_cmd_data, 0u);
-            
-            memset(audio_frame, 0, sizeof(audio_frame));
-            cyhal_system_delay_ms(1000);
-
-            /* Read the next frame */
-            cyhal_pdm_pcm_read_async(&pdm_pcm, audio_frame, PDM_PCM_BUFFER_SIZE/2);
-            // cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_OFF);
-            // led_cmd_data.command = LED_TURN_OFF;
-            // xQueueSendToBack(led_command_data_q, &led_cmd_data, 0u);
+            if (0UL != (button_event.events & BUTTON_EVT_PRESS))
+            {
+                if (record_active)
+                {
+                    record_stop();
+                    record_held = false;
+                }
+                else
+                {
+                    record_requested = true;
+                    record_held = true;
+                }
+            }
+
+            if ((0UL != (button_event.events & BUTTON_EVT_RELEASE)) && record_held)
+            {
+                record_held = false;
+
+                if (record_active && (button_event.held_ms >= BUTTON_LONG_PRESS_MS))
+                {
+                    record_stop();
+                }
+            }
         }
 
-        cyhal_system_delay_ms(1);
+        /* Retransmit what the server misses of the uploads */
+        upload_arq_service();
+
+        /* The profile only changes between recordings */
+        if ((profile_pending != profile_id) && !record_active && !record_requested)
+        {
+            audio_profile_apply();
+        }
     }
 }
 
@@ -171,20 +482,50 @@ void audio_task(void *arg)
 cy_rslt_t init_audio_system(void)
 {
     cy_rslt_t result;
-    
+
+    profile_id = profile_pending;
+
     /* Init the clocks */
     clock_init();
 
-    /* Initialize the User button */
-    result = cyhal_gpio_init(CYBSP_USER_BTN, CYHAL_GPIO_DIR_INPUT, CYHAL_GPIO_DRIVE_PULLUP, 1);
-
-    /* GPIO initialization failed. Return error */
+    result = capture_start();
     if (result != CY_RSLT_SUCCESS)
     {
-        printf("按钮初始化失败，错误码: %ld\r\n", result);
         return result;
     }
-    
+
+    printf("音频系统初始化完成\r\n");
+    return CY_RSLT_SUCCESS;
+}
+
+/*******************************************************************************
+* Function Name: capture_start
+********************************************************************************
+* Summary:
+*  Initializes the PDM/PCM block for the active profile and starts the
+*  continuous capture on an empty capture stream.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  cy_rslt_t: CY_RSLT_SUCCESS if the operation is successful, an error code otherwise
+*
+*******************************************************************************/
+static cy_rslt_t capture_start(void)
+{
+    cy_rslt_t result;
+    const audio_profile_t *profile = &audio_profiles[profile_id];
+
+    pdm_pcm_cfg.sample_rate = profile->capture_rate_hz;
+    pdm_pcm_cfg.decimation_rate = profile->decimation_rate;
+
+    capture_frame_samples = AUDIO_STREAM_FRAME_SAMPLES_AT(profile->capture_rate_hz);
+    frame_samples = capture_frame_samples / profile->resample_factor;
+    audio_resample_init(&resampler, profile->resample_factor);
+    audio_beam_init(&beam, (int32_t)(((int64_t)AUDIO_BEAM_STEER_DELAY_US * (int32_t)profile->capture_rate_hz *
+                                      (int32_t)AUDIO_BEAM_FD_PHASES) / 1000000));
+
     /* Initialize the PDM/PCM block */
     result = cyhal_pdm_pcm_init(&pdm_pcm, PDM_DATA, PDM_CLK, &audio_clock, &pdm_pcm_cfg);
     if (result != CY_RSLT_SUCCESS)
@@ -192,26 +533,231 @@ cy_rslt_t init_audio_system(void)
         printf("PDM/PCM初始化失败，错误码: %ld\r\n", result);
         return result;
     }
-    
+
+    audio_stream_init(&capture_stream);
+
     cyhal_pdm_pcm_register_callback(&pdm_pcm, pdm_pcm_isr_handler, NULL);
     cyhal_pdm_pcm_enable_event(&pdm_pcm, CYHAL_PDM_PCM_ASYNC_COMPLETE, CYHAL_ISR_PRIORITY_DEFAULT, true);
-    
+
     result = cyhal_pdm_pcm_start(&pdm_pcm);
     if (result != CY_RSLT_SUCCESS)
     {
         printf("PDM/PCM启动失败，错误码: %ld\r\n", result);
+        cyhal_pdm_pcm_free(&pdm_pcm);
         return result;
     }
-    
-    printf("音频系统初始化完成\r\n");
+
+    /* Start the continuous capture on the first frame of the ring */
+    result = cyhal_pdm_pcm_read_async(&pdm_pcm, audio_stream_start(&capture_stream),
+                                      capture_frame_samples * AUDIO_CAPTURE_CHANNELS);
+    if (result != CY_RSLT_SUCCESS)
+    {
+        printf("PDM/PCM读取失败，错误码: %ld\r\n", result);
+        capture_stop();
+        return result;
+    }
+
     return CY_RSLT_SUCCESS;
 }
 
+/*******************************************************************************
+* Function Name: capture_stop
+********************************************************************************
+* Summary:
+*  Stops the capture and releases the PDM/PCM block. No frame is published
+*  afterwards, so the capture stream can be re-initialized.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void capture_stop(void)
+{
+    cyhal_pdm_pcm_stop(&pdm_pcm);
+    cyhal_pdm_pcm_abort_async(&pdm_pcm);
+    cyhal_pdm_pcm_free(&pdm_pcm);
+}
+
+/*******************************************************************************
+* Function Name: audio_profile_request
+********************************************************************************
+* Summary:
+*  Requests a capture profile. The audio task switches to it as soon as no
+*  recording is active, the current recording keeps its profile, and
+*  reports the active profile to the UDP server (see audio_profile_report).
+*  Profiles capturing faster than AUDIO_CAPTURE_MAX_RATE_HZ are refused.
+*
+* Parameters:
+*  profile: Requested profile
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_profile_request(audio_profile_id_t profile)
+{
+    if ((profile < AUDIO_PROFILE_COUNT) &&
+        (audio_profiles[profile].capture_rate_hz <= AUDIO_CAPTURE_MAX_RATE_HZ))
+    {
+        profile_pending = profile;
+    }
+    else
+    {
+        printf("不支持音频配置 %d\r\n", (int)profile);
+        audio_profile_report();
+    }
+}
+
+/*******************************************************************************
+* Function Name: audio_profile_apply
+********************************************************************************
+* Summary:
+*  Switches the capture to the requested profile: the PDM/PCM block is
+*  released and the capture restarts at the new rate; all profiles share
+*  the AUDIO_SYS_CLOCK_HZ audio subsystem clock. If the capture does not
+*  start at the new rate, the previous profile is restored. The active
+*  profile is reported to the UDP server either way.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void audio_profile_apply(void)
+{
+    cy_rslt_t result;
+    const audio_profile_t *profile;
+    audio_profile_id_t previous = profile_id;
+
+    capture_stop();
+
+    profile_id = profile_pending;
+    audio_profile_reset();
+
+    result = capture_start();
+    if (result != CY_RSLT_SUCCESS)
+    {
+        printf("音频配置切换失败，错误码: %ld，恢复之前的配置\r\n", result);
+
+        /* Not retried until the server requests a profile again */
+        if (profile_pending == profile_id)
+        {
+            profile_pending = previous;
+        }
+        profile_id = previous;
+        audio_profile_reset();
+
+        result = capture_start();
+        if (result != CY_RSLT_SUCCESS)
+        {
+            printf("音频采集无法恢复，错误码: %ld\r\n", result);
+        }
+    }
+    else
+    {
+        profile = &audio_profiles[profile_id];
+        printf("音频配置已切换：采集 %lu Hz，上传 %lu Hz\r\n", profile->capture_rate_hz,
+               profile->capture_rate_hz / profile->resample_factor);
+    }
+
+    audio_profile_report();
+}
+
+/*******************************************************************************
+* Function Name: audio_profile_reset
+********************************************************************************
+* Summary:
+*  Starts the conditioning, the VAD, the pre-roll and the other per-frame
+*  processing over for the active profile, their state belongs to the rate
+*  of the previous one.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void audio_profile_reset(void)
+{
+    audio_dsp_chain_init(&conditioning, &conditioning_cfg);
+    audio_vad_init(&vad);
+    audio_stats_noise_init(&noise_floor);
+    gain_ratio_frames = 0;
+    audio_preroll_clear(&preroll);
+    wake_word_configure();
+    slm_configure();
+    noise_suppressor_configure();
+}
+
+/*******************************************************************************
+* Function Name: audio_profile_report
+********************************************************************************
+* Summary:
+*  Answers a UDP_CMD_PROFILE request of the UDP server with UDP_CMD_PROFILE
+*  and the digit of the active profile. A digit other than the requested
+*  one tells the server that the profile was refused or did not start.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void audio_profile_report(void)
+{
+    char reply[UDP_CMD_SIZE];
+
+    memcpy(reply, UDP_CMD_PROFILE, UDP_CMD_PROFILE_SIZE);
+    reply[UDP_CMD_PROFILE_SIZE] = (char)('0' + profile_id);
+    (void)net_tx_send(NET_TX_PRIORITY_CONTROL, reply, UDP_CMD_SIZE);
+}
+
+/*******************************************************************************
+* Function Name: wake_word_configure
+********************************************************************************
+* Summary:
+*  Enables the wake word detector if it is configured, a model is present
+*  and the uplink rate of the active profile is the one of the MFCCs.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void wake_word_configure(void)
+{
+    uint32_t sample_rate_hz = audio_profiles[profile_id].capture_rate_hz /
+                              audio_profiles[profile_id].resample_factor;
+
+    audio_kws_reset(&kws);
+    kws_active = (AUDIO_WAKE_WORD_ENABLE != 0u) && kws.ready &&
+                 (sample_rate_hz == AUDIO_MFCC_SAMPLE_RATE_HZ);
+
+    if (kws_active)
+    {
+        printf("唤醒词 \"%s\" 已启用\r\n", audio_kws_model.keyword);
+    }
+    else if ((AUDIO_WAKE_WORD_ENABLE != 0u) && kws.ready)
+    {
+        printf("唤醒词需要 %lu Hz 采样率，当前配置下停用\r\n", (uint32_t)AUDIO_MFCC_SAMPLE_RATE_HZ);
+    }
+}
+
 /*******************************************************************************
 * Function Name: pdm_pcm_isr_handler
 ********************************************************************************
 * Summary:
-*  PDM/PCM interrupt handler.
+*  PDM/PCM interrupt handler. Publishes the filled frame and re-arms the
+*  async read on the next frame of the capture ring.
 *
 * Parameters:
 *  void *arg: Pointer to the argument passed during initialization
@@ -226,7 +772,18 @@ static void pdm_pcm_isr_handler(void *arg, cyhal_pdm_pcm_event_t event)
     (void) arg;
     (void) event;
 
-    pdm_pcm_flag = true;
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    int16_t *next_frame;
+
+    bool published = audio_stream_frame_done(&capture_stream, &next_frame);
+
+    cyhal_pdm_pcm_read_async(&pdm_pcm, next_frame, capture_frame_samples * AUDIO_CAPTURE_CHANNELS);
+
+    if (published && (capture_consumer != NULL))
+    {
+        vTaskNotifyGiveFromISR(capture_consumer, &higher_priority_task_woken);
+        portYIELD_FROM_ISR(higher_priority_task_woken);
+    }
 }
 
 /*******************************************************************************
@@ -259,145 +816,1076 @@ static void clock_init(void)
 }
 
 /*******************************************************************************
-* Function Name: read_switch_status
+* Function Name: gain_apply
 ********************************************************************************
 * Summary:
-*  Reads the status of the user button with debouncing.
+*  Programs the gain chosen by the gain controller into the PDM/PCM block,
+*  both microphones getting the same gain. The configuration is updated too
+*  so that a profile switch keeps the gain. The noise estimates are scaled
+*  by the change after the AUDIO_GAIN_SETTLE_FRAMES frames still captured at
+*  the old gain.
 *
 * Parameters:
 *  None
 *
 * Return:
-*  uint32_t: 1 if button is pressed and released, 0 otherwise
+*  None
 *
 *******************************************************************************/
-static uint32_t read_switch_status(void)
+static void gain_apply(void)
 {
-    uint32_t delayCounter = 0;
-    uint32_t sw_status = 0;
-
-    /* Check if the switch is pressed */
-    while(0UL == cyhal_gpio_read(CYBSP_USER_BTN))
-    {
-        /* Switch is pressed. Proceed for debouncing. */
-        cyhal_system_delay_ms(SWITCH_DEBOUNCE_CHECK_UNIT);
-        ++delayCounter;
-
-        /* Keep checking the switch status till the switch is pressed for a
-         * minimum period of SWITCH_DEBOUNCE_CHECK_UNIT x SWITCH_DEBOUNCE_MAX_PERIOD_UNITS */
-        if (delayCounter > SWITCH_DEBOUNCE_MAX_PERIOD_UNITS)
-        {
-            /* Wait till the switch is released */
-            while(0UL == cyhal_gpio_read(CYBSP_USER_BTN))
-            {
-            }
-
-            /* Debounce when the switch is being released */
-            do
-            {
-                delayCounter = 0;
-
-                while(delayCounter < SWITCH_DEBOUNCE_MAX_PERIOD_UNITS)
-                {
-                    cyhal_system_delay_ms(SWITCH_DEBOUNCE_CHECK_UNIT);
-                    ++delayCounter;
-                }
+    cy_rslt_t result;
+    int16_t previous = pdm_pcm_cfg.left_gain;
 
-            }while(0UL == cyhal_gpio_read(CYBSP_USER_BTN));
+    pdm_pcm_cfg.left_gain = hw_gain.gain;
+    pdm_pcm_cfg.right_gain = (AUDIO_CAPTURE_CHANNELS == 2u) ? hw_gain.gain : 0;
 
-            /* Switch is pressed and released*/
-            sw_status = 1u;
-        }
+    result = cyhal_pdm_pcm_set_gain(&pdm_pcm, pdm_pcm_cfg.left_gain, pdm_pcm_cfg.right_gain);
+    if (result != CY_RSLT_SUCCESS)
+    {
+        printf("设置PDM增益失败，错误码: %ld\r\n", result);
+        return;
     }
 
-    return (sw_status);
+    gain_ratio_q16 = audio_gain_power_ratio_q16(previous, hw_gain.gain);
+    gain_ratio_frames = AUDIO_GAIN_SETTLE_FRAMES + 1u;
 }
 
 /*******************************************************************************
-* Function Name: send_audio_data_to_server
+* Function Name: noise_estimates_scale
 ********************************************************************************
 * Summary:
-*  Sends audio data to the UDP server.
+*  Scales the noise floors of the VAD and the telemetry and the noise
+*  spectrum of the noise suppressor by the power ratio of a gain change.
+*  Left at the old gain, a quiet background raised by the gain would be
+*  taken for speech, which in turn raises the gain further.
 *
 * Parameters:
-*  audio_data: Pointer to the audio data buffer
-*  data_size: Size of the audio data in bytes
+*  ratio_q16: Power ratio of the new to the old gain, Q16
 *
 * Return:
-*  cy_rslt_t: CY_RSLT_SUCCESS if the operation is successful, an error code otherwise
+*  None
 *
 *******************************************************************************/
-cy_rslt_t send_audio_data_to_server(uint8_t *audio_data, uint32_t data_size)
+static void noise_estimates_scale(uint32_t ratio_q16)
 {
-    cy_rslt_t result;
-    
-    /* 设置目标服务器地址和端口 */
-    cy_socket_sockaddr_t server_addr = {
-        .ip_address.ip.v4 = UDP_SERVER_IP_ADDRESS,
-        .ip_address.version = CY_SOCKET_IP_VER_V4,
-        .port = UDP_SERVER_PORT
-    };
-    
-    /* 检查客户端套接字是否已创建 */
+    audio_vad_scale_noise(&vad, ratio_q16);
+    audio_stats_noise_scale(&noise_floor, ratio_q16);
+    if (ns_active)
+    {
+        audio_ns_scale_noise(&noise_suppressor, ratio_q16);
+    }
+}
+
+/*******************************************************************************
+* Function Name: slm_configure
+********************************************************************************
+* Summary:
+*  Designs the A-weighting of the sound level meter for the uplink rate of
+*  the current profile and starts a new period.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void slm_configure(void)
+{
+    uint32_t sample_rate_hz = audio_profiles[profile_id].capture_rate_hz /
+                              audio_profiles[profile_id].resample_factor;
+
+    audio_slm_init(&slm, sample_rate_hz, AUDIO_STREAM_FRAME_MS);
+}
+
+/*******************************************************************************
+* Function Name: slm_report
+********************************************************************************
+* Summary:
+*  Sends a sound level summary to the UDP server, see audio_slm_encode.
+*
+* Parameters:
+*  summary: Summary of the last period
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void slm_report(const audio_slm_summary_t *summary)
+{
+    uint8_t datagram[AUDIO_SLM_SUMMARY_SIZE];
+
+    (void)net_tx_send(NET_TX_PRIORITY_TELEMETRY, datagram, audio_slm_encode(summary, datagram));
+}
+
+/*******************************************************************************
+* Function Name: noise_suppressor_configure
+********************************************************************************
+* Summary:
+*  Enables the noise suppressor if it is configured and the frames of the
+*  current profile fit its FFT, and restarts its noise estimate.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void noise_suppressor_configure(void)
+{
+    uint32_t hop = AUDIO_STREAM_FRAME_SAMPLES_AT(audio_profiles[profile_id].capture_rate_hz) /
+                   audio_profiles[profile_id].resample_factor;
+
+    ns_active = (AUDIO_NS_ENABLE != 0u) && audio_ns_init(&noise_suppressor, hop);
+
+    if ((AUDIO_NS_ENABLE != 0u) && !ns_active)
+    {
+        printf("降噪仅支持每帧不超过 %lu 个采样，当前配置下停用\r\n", (uint32_t)AUDIO_NS_MAX_HOP);
+    }
+}
+
+/*******************************************************************************
+* Function Name: record_start
+********************************************************************************
+* Summary:
+*  Starts a recording from the frame with sequence number live_seq, preceded
+*  by the frames of the pre-roll. The pre-roll frames are recorded oldest
+*  first and the pre-roll is emptied.
+*
+* Parameters:
+*  live_seq: Sequence number of the first live frame of the recording
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void record_start(uint32_t live_seq)
+{
+    uint32_t count = audio_preroll_count(&preroll);
+    const audio_preroll_frame_t *first = audio_preroll_get(&preroll, 0);
+
+    printf("开始录音（预录 %lu ms）...\r\n", count * AUDIO_STREAM_FRAME_MS);
+
+    upload_active = false;
+    upload_failed = false;
+    lookback_clear();
+
+    record_active = true;
+    record_dropped = 0;
+    audio_stats_session_init(&record_stats);
+    record_next_seq = (first != NULL) ? first->seq : live_seq;
+    record_live_seq = live_seq;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const audio_preroll_frame_t *pre = audio_preroll_get(&preroll, i);
+        record_process(pre->samples, pre->seq, pre->speech);
+    }
+
+    audio_preroll_clear(&preroll);
+
+    /* The endpoint is only searched for in the live audio */
+    record_silence_frames = 0;
+}
+
+/*******************************************************************************
+* Function Name: record_process
+********************************************************************************
+* Summary:
+*  Handles one frame of the active recording. Speech frames are recorded
+*  together with the non-speech frames kept ahead of them, other frames are
+*  kept in the lookback. Frames missing from the sequence numbers were
+*  dropped by the capture and are counted, as are frames that find the
+*  frame pool empty. If the socket or the network task is not ready to
+*  start the upload on the first speech frame, the rest of the recording is
+*  skipped.
+*
+* Parameters:
+*  samples: Frame of frame_samples samples
+*  seq: Capture sequence number of the frame
+*  speech: VAD decision of the frame
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void record_process(const int16_t *samples, uint32_t seq, bool speech)
+{
+    record_dropped += seq - record_next_seq;
+    record_next_seq = seq + 1u;
+
+    if (upload_failed)
+    {
+        return;
+    }
+
+    audio_pool_frame_t *frame = audio_pool_alloc(&frame_pool);
+    if (frame == NULL)
+    {
+        record_dropped++;
+        record_silence_frames = speech ? 0u : (record_silence_frames + 1u);
+        if (upload_active)
+        {
+            upload_flush_held();
+        }
+        return;
+    }
+
+    memcpy(frame->samples, samples, frame_samples * sizeof(int16_t));
+    frame->num_samples = frame_samples;
+    frame->seq = seq;
+
+    if (speech)
+    {
+        if (!upload_active)
+        {
+            uint32_t sample_rate_hz = audio_profiles[profile_id].capture_rate_hz /
+                                      audio_profiles[profile_id].resample_factor;
+
+            /* Only a socket or network task that is not ready fails the
+             * upload; a start datagram dropped on a full queue is kept for
+             * retransmission, and the server opens the session from any
+             * datagram of it */
+            cy_rslt_t result = audio_upload_begin(upload_codec_select(sample_rate_hz), sample_rate_hz);
+            if (result == CY_RSLT_MODULE_SECURE_SOCKETS_NOT_INITIALIZED)
+            {
+                printf("错误：无法开始上传，跳过本次录音\r\n");
+                upload_failed = true;
+                audio_pool_release(frame);
+                lookback_clear();
+                return;
+            }
+
+            emfile_session_start();
+            upload_active = true;
+        }
+
+        lookback_flush();
+        record_frame(frame);
+    }
+    else
+    {
+        lookback_push(frame);
+    }
+
+    audio_pool_release(frame);
+
+    if (upload_active)
+    {
+        upload_flush_held();
+    }
+
+    record_silence_frames = speech ? 0u : (record_silence_frames + 1u);
+}
+
+/*******************************************************************************
+* Function Name: record_should_stop
+********************************************************************************
+* Summary:
+*  Checks the end conditions of the active recording: a failed start of the
+*  upload, the speech endpoint (unless the button is held), no speech at all
+*  within RECORD_NO_SPEECH_TIMEOUT_MS, or the RECORD_MAX_DURATION_MS limit.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  bool: true if the recording has to be ended
+*
+*******************************************************************************/
+static bool record_should_stop(void)
+{
+    uint32_t live_frames = record_next_seq - record_live_seq;
+
+    if (upload_failed)
+    {
+        return true;
+    }
+
+    if (live_frames >= RECORD_MAX_FRAMES)
+    {
+        printf("录音达到最大时长\r\n");
+        return true;
+    }
+
+    if (record_held)
+    {
+        return false;
+    }
+
+    if (upload_active)
+    {
+        return (record_silence_frames >= RECORD_ENDPOINT_FRAMES);
+    }
+
+    return (live_frames >= RECORD_NO_SPEECH_FRAMES);
+}
+
+/*******************************************************************************
+* Function Name: record_stop
+********************************************************************************
+* Summary:
+*  Ends the active recording. Non-speech frames still in the lookback are
+*  dropped.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void record_stop(void)
+{
+    uint32_t duration_ms = (record_next_seq - record_live_seq) * AUDIO_STREAM_FRAME_MS;
+    audio_stats_summary_t summary;
+
+    record_active = false;
+    lookback_clear();
+
+    /* The feature window continues from the next frame, not from the audio
+     * before the recording */
+    audio_kws_reset(&kws);
+
+    audio_stats_session_summary(&record_stats, &noise_floor, &summary);
+
+    if (upload_active)
+    {
+        emfile_session_stop();
+        audio_upload_stats(&summary);
+        audio_upload_end();
+
+        printf("录音完成，时长 %lu ms，共发送 %lu 字节（%lu 个采样），丢帧 %lu\r\n", duration_ms,
+               upload_total_bytes, upload_chunk.total_samples, record_dropped);
+        if (upload_queue_drops > 0u)
+        {
+            printf("网络发送队列已满，%lu 个数据包留待重传\r\n", upload_queue_drops);
+        }
+        printf("音频质量：RMS %u，峰值 %u，削波 %lu 个采样，直流 %d，噪声底 %u\r\n",
+               summary.rms, summary.peak, summary.clipped, summary.dc, summary.noise_floor);
+    }
+    else if (!upload_failed)
+    {
+        printf("录音完成，未检测到语音，不上传\r\n");
+    }
+    printf("按下按钮开始新的录音\r\n");
+}
+
+/*******************************************************************************
+* Function Name: record_frame
+********************************************************************************
+* Summary:
+*  Writes one frame of the recording to the SD card and the UDP server. The
+*  SD card queues a reference to the frame, the upload reads it before
+*  returning. A feature upload sends the log-mel features of the frame
+*  instead of the samples; the SD card always gets the samples.
+*
+* Parameters:
+*  frame: Frame, the caller keeps its reference
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void record_frame(audio_pool_frame_t *frame)
+{
+    cy_rslt_t result;
+
+    emfile_session_write(frame);
+
+    if (upload_codec == AUDIO_CODEC_LOG_MEL)
+    {
+        audio_mfcc_process(&features, frame->samples, feature_vector, NULL);
+        result = send_audio_data_to_server((const uint8_t *)feature_vector, sizeof(feature_vector));
+    }
+    else
+    {
+        result = send_audio_data_to_server((const uint8_t *)frame->samples,
+                                           frame->num_samples * sizeof(int16_t));
+    }
+    if (result != CY_RSLT_SUCCESS)
+    {
+        printf("发送数据到服务器失败，错误码: %ld\r\n", result);
+    }
+}
+
+/*******************************************************************************
+* Function Name: lookback_push
+********************************************************************************
+* Summary:
+*  Keeps a reference to a non-speech frame of the recording, dropping the
+*  oldest one when RECORD_LOOKBACK_FRAMES frames are already kept.
+*
+* Parameters:
+*  frame: Frame, the caller keeps its reference
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void lookback_push(audio_pool_frame_t *frame)
+{
+    if (lookback_count == RECORD_LOOKBACK_FRAMES)
+    {
+        audio_pool_release(lookback[lookback_head]);
+    }
+
+    audio_pool_retain(frame);
+    lookback[lookback_head] = frame;
+    lookback_head = (lookback_head + 1u) % RECORD_LOOKBACK_FRAMES;
+
+    if (lookback_count < RECORD_LOOKBACK_FRAMES)
+    {
+        lookback_count++;
+    }
+}
+
+/*******************************************************************************
+* Function Name: lookback_flush
+********************************************************************************
+* Summary:
+*  Records the kept frames, oldest first, and empties the lookback.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void lookback_flush(void)
+{
+    uint32_t index = (lookback_head + RECORD_LOOKBACK_FRAMES - lookback_count) % RECORD_LOOKBACK_FRAMES;
+
+    while (lookback_count > 0)
+    {
+        record_frame(lookback[index]);
+        audio_pool_release(lookback[index]);
+        index = (index + 1u) % RECORD_LOOKBACK_FRAMES;
+        lookback_count--;
+    }
+}
+
+/*******************************************************************************
+* Function Name: lookback_clear
+********************************************************************************
+* Summary:
+*  Drops the kept frames without recording them.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void lookback_clear(void)
+{
+    uint32_t index = (lookback_head + RECORD_LOOKBACK_FRAMES - lookback_count) % RECORD_LOOKBACK_FRAMES;
+
+    while (lookback_count > 0)
+    {
+        audio_pool_release(lookback[index]);
+        index = (index + 1u) % RECORD_LOOKBACK_FRAMES;
+        lookback_count--;
+    }
+
+    lookback_head = 0;
+}
+
+/*******************************************************************************
+* Function Name: upload_codec_select
+********************************************************************************
+* Summary:
+*  Returns the encoding of a new upload: log-mel features if the server asked
+*  for them and the uplink rate is the one of the feature extraction,
+*  AUDIO_UPLOAD_CODEC otherwise.
+*
+* Parameters:
+*  sample_rate_hz: Uplink sample rate
+*
+* Return:
+*  audio_codec_t: Encoding of the upload
+*
+*******************************************************************************/
+static audio_codec_t upload_codec_select(uint32_t sample_rate_hz)
+{
+    if (!features_requested)
+    {
+        return AUDIO_UPLOAD_CODEC;
+    }
+
+    if (sample_rate_hz != AUDIO_MFCC_SAMPLE_RATE_HZ)
+    {
+        printf("特征提取需要 %lu Hz 采样率，改为上传音频\r\n", (uint32_t)AUDIO_MFCC_SAMPLE_RATE_HZ);
+        return AUDIO_UPLOAD_CODEC;
+    }
+
+    return AUDIO_CODEC_LOG_MEL;
+}
+
+/*******************************************************************************
+* Function Name: audio_upload_request_features
+********************************************************************************
+* Summary:
+*  Selects what the next uploads carry: the log-mel features of every frame
+*  or the audio itself. Called when the server sends a command, it takes
+*  effect from the next upload.
+*
+* Parameters:
+*  enable: true for log-mel features, false for audio
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_upload_request_features(bool enable)
+{
+    features_requested = enable;
+}
+
+/*******************************************************************************
+* Function Name: audio_upload_begin
+********************************************************************************
+* Summary:
+*  Starts a new audio upload in a new session by sending the start datagram
+*  to the UDP server, which carries the sample rate as a little endian
+*  32-bit value followed by the datagrams and parities per FEC block, 0
+*  without FEC (see audio_packet.h). The start datagram of a feature upload
+*  carries the number of bands instead; its datagrams hold whole feature
+*  vectors of AUDIO_MFCC_NUM_BANDS 16-bit values.
+*
+* Parameters:
+*  codec: Encoding of the audio datagrams of this upload
+*  sample_rate_hz: Sample rate of the uploaded audio
+*
+* Return:
+*  cy_rslt_t: CY_RSLT_SUCCESS if the operation is successful, an error code otherwise
+*
+*******************************************************************************/
+cy_rslt_t audio_upload_begin(audio_codec_t codec, uint32_t sample_rate_hz)
+{
+    cy_rslt_t result;
+
+    /* 检查客户端套接字是否已创建 */
+    if (client_handle == NULL)
+    {
+        printf("错误：UDP客户端套接字未初始化\r\n");
+        return CY_RSLT_MODULE_SECURE_SOCKETS_NOT_INITIALIZED;
+    }
+
+    upload_codec = codec;
+    upload_total_bytes = 0;
+    upload_queue_drops = 0;
+    upload_session++;
+    upload_seq = 0;
+
+    if (upload_arq.state == AUDIO_ARQ_ENDING)
+    {
+        printf("上一次上传未得到服务器确认，停止重传\r\n");
+    }
+    audio_fec_begin(&upload_fec, (uint8_t)codec, upload_session);
+
+    /* Datagram size of the upload, a whole number of feature vectors for
+     * AUDIO_CODEC_LOG_MEL */
+    uint32_t chunk_limit = upload_mtu.chunk;
+    uint32_t header_value = sample_rate_hz;
+    if (codec == AUDIO_CODEC_LOG_MEL)
+    {
+        chunk_limit -= chunk_limit % sizeof(feature_vector);
+        header_value = AUDIO_MFCC_NUM_BANDS;
+        audio_mfcc_reset(&features);
+    }
+    audio_chunk_begin(&upload_chunk, &upload_datagram[AUDIO_PACKET_HEADER_SIZE], chunk_limit,
+                      codec == AUDIO_CODEC_IMA_ADPCM);
+
+    /* The window holds as many datagrams as fit at the chunk size */
+    audio_arq_begin(&upload_arq, upload_session, AUDIO_PACKET_HEADER_SIZE + chunk_limit);
+
+    uint8_t start[AUDIO_PACKET_HEADER_SIZE + AUDIO_UPLOAD_START_SIZE] =
+    {
+        [AUDIO_PACKET_HEADER_SIZE] =
+        (uint8_t)(header_value & 0xFF),
+        (uint8_t)((header_value >> 8) & 0xFF),
+        (uint8_t)((header_value >> 16) & 0xFF),
+        (uint8_t)((header_value >> 24) & 0xFF),
+        (uint8_t)(upload_fec_active ? upload_fec.data : 0u),
+        (uint8_t)(upload_fec_active ? upload_fec.parities : 0u),
+        (uint8_t)(chunk_limit & 0xFF),
+        (uint8_t)((chunk_limit >> 8) & 0xFF),
+    };
+
+    printf("正在发送音频数据到服务器 %d.%d.%d.%d:%d...\r\n",
+           (uint8)(audio_server_addr.ip_address.ip.v4),
+           (uint8)(audio_server_addr.ip_address.ip.v4 >> 8),
+           (uint8)(audio_server_addr.ip_address.ip.v4 >> 16),
+           (uint8)(audio_server_addr.ip_address.ip.v4 >> 24),
+           audio_server_addr.port);
+
+    result = upload_send(AUDIO_PACKET_FLAG_START, 0, start, AUDIO_UPLOAD_START_SIZE);
+
+    uint32_t probe_size = audio_mtu_probe(&upload_mtu, upload_session);
+    if (probe_size > 0u)
+    {
+        upload_probe_send(probe_size);
+    }
+
+    return result;
+}
+
+/*******************************************************************************
+* Function Name: send_audio_data_to_server
+********************************************************************************
+* Summary:
+*  Sends audio data of the current upload to the UDP server. The data is
+*  collected into datagrams of the chunk size of the upload behind the
+*  header; a partial datagram is kept until more data arrives or
+*  audio_upload_end is called. With AUDIO_CODEC_IMA_ADPCM the 16-bit samples
+*  are encoded straight into the datagram, each datagram starting with the
+*  encoder state.
+*
+* Parameters:
+*  audio_data: Pointer to the audio data buffer, 16-bit aligned
+*  data_size: Size of the audio data in bytes
+*
+* Return:
+*  cy_rslt_t: CY_RSLT_SUCCESS if the operation is successful, an error code otherwise
+*
+*******************************************************************************/
+cy_rslt_t send_audio_data_to_server(const uint8_t *audio_data, uint32_t data_size)
+{
+    cy_rslt_t result;
+    uint32_t now_ms = pdTICKS_TO_MS(xTaskGetTickCount());
+
+    /* 检查客户端套接字是否已创建 */
     if (client_handle == NULL)
     {
-        printf("错误：UDP客户端套接字未初始化\r\n");
         return CY_RSLT_MODULE_SECURE_SOCKETS_NOT_INITIALIZED;
     }
 
-    uint32_t bytes_sent = 0;
-    char* start_flag = "aaaa";
-    result = cy_socket_sendto(client_handle, start_flag, sizeof(start_flag), 
-                             CY_SOCKET_FLAGS_NONE, &server_addr,
-                             sizeof(cy_socket_sockaddr_t), &bytes_sent);
-    
-    /* 发送音频数据到服务器 */
-    printf("正在发送 %lu 字节的音频数据到服务器 %d.%d.%d.%d:%d...\r\n", 
-           data_size,
-           (uint8)(server_addr.ip_address.ip.v4),
-           (uint8)(server_addr.ip_address.ip.v4 >> 8),
-           (uint8)(server_addr.ip_address.ip.v4 >> 16),
-           (uint8)(server_addr.ip_address.ip.v4 >> 24),
-           server_addr.port);
-    
-
-    /* 分块发送音频数据，每次发送1KB */
-    uint32_t total_bytes_sent = 0;
-    uint32_t chunk_size = 1024;
-    uint32_t remaining_bytes = data_size;
-
-    while (remaining_bytes > 0)
-    {
-        uint32_t current_chunk_size = (remaining_bytes < chunk_size) ? remaining_bytes : chunk_size;
-        
-        /* 使用UDP发送数据 */
-        result = cy_socket_sendto(client_handle, audio_data + total_bytes_sent, current_chunk_size, 
-                             CY_SOCKET_FLAGS_NONE, &server_addr,
-                             sizeof(cy_socket_sockaddr_t), &bytes_sent);
-        
-        if (result != CY_RSLT_SUCCESS)
+    while (data_size > 0)
+    {
+        uint32_t added = audio_chunk_add(&upload_chunk, audio_data, data_size, now_ms);
+        audio_data += added;
+        data_size -= added;
+
+        if (audio_chunk_full(&upload_chunk))
         {
-            printf("发送音频数据失败，已发送 %lu 字节\r\n", total_bytes_sent);
-            return result;
+            result = upload_flush_chunk();
+            if (result != CY_RSLT_SUCCESS)
+            {
+                return result;
+            }
         }
-        
-        total_bytes_sent += bytes_sent;
-        remaining_bytes -= bytes_sent;
-        
-        /* 打印进度 */
-        // if (total_bytes_sent % (chunk_size * 10) == 0 || total_bytes_sent == data_size)
-        // {
-        //     printf("已发送 %lu / %lu 字节 (%.1f%%)\r\n", 
-        //            total_bytes_sent, data_size, 
-        //            ((float)total_bytes_sent / data_size) * 100);
-        // }
-    }
-
-    /* 发送结束标志位，以便server处理 */
-    char* end_flag = "flag";
-    result = cy_socket_sendto(client_handle, end_flag, sizeof(end_flag), 
-                             CY_SOCKET_FLAGS_NONE, &server_addr,
-                             sizeof(cy_socket_sockaddr_t), &bytes_sent);
-    
+    }
+
     return CY_RSLT_SUCCESS;
 }
+
+/*******************************************************************************
+* Function Name: audio_upload_stats
+********************************************************************************
+* Summary:
+*  Sends the level statistics of the recording, ahead of the end datagram.
+*  The payload holds little endian fields: the number of frames (32-bit),
+*  the RMS and the peak (16-bit), the number of clipped samples (32-bit),
+*  the DC offset (signed 16-bit) and the RMS of the noise floor (16-bit);
+*  the levels are in units of the 16-bit samples.
+*
+* Parameters:
+*  summary: Statistics of the recording
+*
+* Return:
+*  cy_rslt_t: CY_RSLT_SUCCESS if the operation is successful, an error code otherwise
+*
+*******************************************************************************/
+cy_rslt_t audio_upload_stats(const audio_stats_summary_t *summary)
+{
+    uint16_t dc = (uint16_t)summary->dc;
+
+    if (client_handle == NULL)
+    {
+        return CY_RSLT_MODULE_SECURE_SOCKETS_NOT_INITIALIZED;
+    }
+
+    uint8_t stats[AUDIO_PACKET_HEADER_SIZE + AUDIO_UPLOAD_STATS_SIZE] =
+    {
+        [AUDIO_PACKET_HEADER_SIZE] =
+        (uint8_t)(summary->frames & 0xFF),
+        (uint8_t)((summary->frames >> 8) & 0xFF),
+        (uint8_t)((summary->frames >> 16) & 0xFF),
+        (uint8_t)((summary->frames >> 24) & 0xFF),
+        (uint8_t)(summary->rms & 0xFF),
+        (uint8_t)((summary->rms >> 8) & 0xFF),
+        (uint8_t)(summary->peak & 0xFF),
+        (uint8_t)((summary->peak >> 8) & 0xFF),
+        (uint8_t)(summary->clipped & 0xFF),
+        (uint8_t)((summary->clipped >> 8) & 0xFF),
+        (uint8_t)((summary->clipped >> 16) & 0xFF),
+        (uint8_t)((summary->clipped >> 24) & 0xFF),
+        (uint8_t)(dc & 0xFF),
+        (uint8_t)((dc >> 8) & 0xFF),
+        (uint8_t)(summary->noise_floor & 0xFF),
+        (uint8_t)((summary->noise_floor >> 8) & 0xFF),
+    };
+
+    return upload_send(AUDIO_PACKET_FLAG_STATS, upload_chunk.total_samples, stats, AUDIO_UPLOAD_STATS_SIZE);
+}
+
+/*******************************************************************************
+* Function Name: audio_upload_end
+********************************************************************************
+* Summary:
+*  Sends the remaining audio data of the current upload and the end
+*  datagram. Its payload is the number of samples (feature values for a
+*  feature upload) of the upload as a little endian 32-bit value, and its
+*  sequence number the one of the last datagram, so the server knows the
+*  length of the recording and how many datagrams were lost.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  cy_rslt_t: CY_RSLT_SUCCESS if the operation is successful, an error code otherwise
+*
+*******************************************************************************/
+cy_rslt_t audio_upload_end(void)
+{
+
+    if (client_handle == NULL)
+    {
+        return CY_RSLT_MODULE_SECURE_SOCKETS_NOT_INITIALIZED;
+    }
+
+    if (upload_chunk.len > 0)
+    {
+        (void)upload_flush_chunk();
+    }
+
+    /* 发送结束标志位和采样数，以便server处理 */
+    uint8_t end[AUDIO_PACKET_HEADER_SIZE + AUDIO_UPLOAD_END_SIZE] =
+    {
+        [AUDIO_PACKET_HEADER_SIZE] =
+        (uint8_t)(upload_chunk.total_samples & 0xFF),
+        (uint8_t)((upload_chunk.total_samples >> 8) & 0xFF),
+        (uint8_t)((upload_chunk.total_samples >> 16) & 0xFF),
+        (uint8_t)((upload_chunk.total_samples >> 24) & 0xFF),
+    };
+
+    return upload_send(AUDIO_PACKET_FLAG_END, upload_chunk.total_samples, end, AUDIO_UPLOAD_END_SIZE);
+}
+
+/*******************************************************************************
+* Function Name: audio_upload_feedback
+********************************************************************************
+* Summary:
+*  Passes a NACK or ACK of the server to the audio task, which retransmits
+*  the missing datagrams. Called by the socket receive callback; the
+*  feedback is dropped if the queue is full, the server repeats it.
+*
+* Parameters:
+*  datagram: Received datagram
+*  size: Size of the datagram in bytes
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_upload_feedback(const uint8_t *datagram, uint32_t size)
+{
+    audio_arq_feedback_t feedback;
+
+    if ((upload_feedback_q == NULL) || (size > sizeof(feedback.data)))
+    {
+        return;
+    }
+
+    memcpy(feedback.data, datagram, size);
+    feedback.size = (uint16_t)size;
+
+    if ((xQueueSend(upload_feedback_q, &feedback, 0) == pdTRUE) && (capture_consumer != NULL))
+    {
+        xTaskNotifyGive(capture_consumer);
+    }
+}
+
+/*******************************************************************************
+* Function Name: upload_flush_chunk
+********************************************************************************
+* Summary:
+*  Sends the collected datagram and empties it.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  cy_rslt_t: CY_RSLT_SUCCESS if the operation is successful, an error code otherwise
+*
+*******************************************************************************/
+static cy_rslt_t upload_flush_chunk(void)
+{
+    cy_rslt_t result;
+
+    /* 使用UDP发送数据 */
+    result = upload_send(0, upload_chunk.offset, upload_datagram, upload_chunk.len);
+    upload_chunk.len = 0;
+
+    if (result != CY_RSLT_SUCCESS)
+    {
+        printf("发送音频数据失败，已发送 %lu 字节\r\n", upload_total_bytes);
+    }
+
+    return result;
+}
+
+/*******************************************************************************
+* Function Name: upload_flush_held
+********************************************************************************
+* Summary:
+*  Sends the datagram being filled once its first audio has waited
+*  AUDIO_UPLOAD_MAX_HOLD_MS. Called for every frame of the recording, also
+*  for the frames of a speech pause that add no audio and for the frames
+*  dropped on an empty frame pool.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void upload_flush_held(void)
+{
+    if (audio_chunk_held(&upload_chunk, AUDIO_UPLOAD_MAX_HOLD_MS, pdTICKS_TO_MS(xTaskGetTickCount())))
+    {
+        (void)upload_flush_chunk();
+    }
+}
+
+/*******************************************************************************
+* Function Name: upload_send
+********************************************************************************
+* Summary:
+*  Queues a datagram of the current upload for net_tx_task, writing its
+*  header with the next sequence number in front of the payload. Waits up
+*  to AUDIO_UPLOAD_QUEUE_WAIT_MS for the pacing if the queue is full.
+*
+* Parameters:
+*  flags: AUDIO_PACKET_FLAG_* of the datagram
+*  offset: Offset of the payload in the upload
+*  datagram: Datagram, the payload starts at AUDIO_PACKET_HEADER_SIZE
+*  payload_size: Size of the payload in bytes
+*
+* Return:
+*  cy_rslt_t: CY_RSLT_SUCCESS if the operation is successful, an error code otherwise
+*
+*******************************************************************************/
+static cy_rslt_t upload_send(uint8_t flags, uint32_t offset, uint8_t *datagram, uint32_t payload_size)
+{
+    cy_rslt_t result;
+    uint32_t size;
+    audio_packet_header_t header =
+    {
+        .codec = (uint8_t)upload_codec,
+        .flags = flags,
+        .session = upload_session,
+        .seq = upload_seq++,
+        .offset = offset,
+    };
+
+    size = audio_packet_encode(&header, datagram, payload_size);
+    result = net_tx_send_wait(NET_TX_PRIORITY_BULK, datagram, size, AUDIO_UPLOAD_QUEUE_WAIT_MS);
+    if (result == CY_RSLT_SUCCESS)
+    {
+        upload_total_bytes += size;
+    }
+    else if (result == CY_RSLT_MODULE_SECURE_SOCKETS_NOMEM)
+    {
+        upload_queue_drops++;
+    }
+
+    /* Kept even if it was not queued, the server NACKs it like a lost one
+     * and the end datagram is repeated until the server acknowledges it */
+    audio_arq_store(&upload_arq, datagram, size, pdTICKS_TO_MS(xTaskGetTickCount()));
+
+    if (upload_fec_active)
+    {
+        upload_fec_send(&header, &datagram[AUDIO_PACKET_HEADER_SIZE], payload_size);
+    }
+
+    return result;
+}
+
+/*******************************************************************************
+* Function Name: upload_fec_send
+********************************************************************************
+* Summary:
+*  Adds a sent datagram to the parities of its block and sends the parity
+*  datagrams once the block is complete. Parity datagrams take no sequence
+*  number and are not kept for retransmission.
+*
+* Parameters:
+*  header: Header of the sent datagram
+*  payload: Payload of the sent datagram
+*  payload_size: Size of the payload in bytes
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void upload_fec_send(const audio_packet_header_t *header, const uint8_t *payload, uint32_t payload_size)
+{
+    if (!audio_fec_add(&upload_fec, header, payload, payload_size))
+    {
+        return;
+    }
+
+    for (uint32_t j = 0; j < upload_fec.parities; j++)
+    {
+        uint32_t size = audio_fec_parity(&upload_fec, j, upload_parity);
+
+        if (net_tx_send(NET_TX_PRIORITY_BULK, upload_parity, size) == CY_RSLT_SUCCESS)
+        {
+            upload_total_bytes += size;
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: upload_probe_send
+********************************************************************************
+* Summary:
+*  Sends a path MTU probe of the chunk size audio_mtu_probe asked for, see
+*  audio_mtu.h. Called before any audio is collected in upload_datagram.
+*  The probe takes the next probe sequence number, never one of the
+*  datagrams of the upload.
+*
+* Parameters:
+*  payload_size: Payload size of the probe, see audio_mtu_probe
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void upload_probe_send(uint32_t payload_size)
+{
+    uint32_t size;
+    audio_packet_header_t header =
+    {
+        .codec = (uint8_t)upload_codec,
+        .flags = AUDIO_PACKET_FLAG_PROBE,
+        .session = upload_session,
+        .seq = upload_probe_seq++,
+        .offset = payload_size,
+    };
+
+    memset(&upload_datagram[AUDIO_PACKET_HEADER_SIZE], 0, payload_size);
+    size = audio_packet_encode(&header, upload_datagram, payload_size);
+    if (net_tx_send(NET_TX_PRIORITY_BULK, upload_datagram, size) == CY_RSLT_SUCCESS)
+    {
+        upload_total_bytes += size;
+    }
+}
+
+/*******************************************************************************
+* Function Name: upload_transmit
+********************************************************************************
+* Summary:
+*  Sends a retransmitted datagram of the upload, see audio_arq_send_t.
+*
+* Parameters:
+*  datagram: Datagram, header included
+*  size: Size of the datagram in bytes
+*
+* Return:
+*  bool: true if the datagram was queued for net_tx_task
+*
+*******************************************************************************/
+static bool upload_transmit(const uint8_t *datagram, uint32_t size)
+{
+    return net_tx_send(NET_TX_PRIORITY_BULK, datagram, size) == CY_RSLT_SUCCESS;
+}
+
+/*******************************************************************************
+* Function Name: upload_arq_service
+********************************************************************************
+* Summary:
+*  Answers the feedback of the server received since the last call, repeats
+*  the end datagram of the upload until it is acknowledged and reports how
+*  the upload ended. Probe acknowledgements and the loss of the upload
+*  choose the chunk size of the next upload.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void upload_arq_service(void)
+{
+    audio_arq_feedback_t feedback;
+    uint32_t now_ms = pdTICKS_TO_MS(xTaskGetTickCount());
+    uint32_t chunk = upload_mtu.chunk;
+
+    while (xQueueReceive(upload_feedback_q, &feedback, 0) == pdTRUE)
+    {
+        if (!audio_mtu_feedback(&upload_mtu, feedback.data, feedback.size))
+        {
+            audio_arq_feedback(&upload_arq, feedback.data, feedback.size, now_ms, upload_transmit);
+        }
+    }
+
+    if (audio_arq_poll(&upload_arq, now_ms, upload_transmit))
+    {
+        audio_mtu_upload_done(&upload_mtu, upload_arq.next_seq, upload_arq.nacked);
+
+        if (upload_arq.state == AUDIO_ARQ_COMPLETE)
+        {
+            printf("服务器已确认上传，重传 %lu 个数据包\r\n", upload_arq.retransmitted);
+        }
+        else
+        {
+            printf("上传未得到服务器确认，重传 %lu 个数据包\r\n", upload_arq.retransmitted);
+        }
+
+        if (upload_arq.unavailable > 0u)
+        {
+            printf("%lu 个数据包已不在重传窗口中\r\n", upload_arq.unavailable);
+        }
+    }
+
+    if (upload_mtu.chunk != chunk)
+    {
+        printf("之后的上传每个数据包 %lu 字节\r\n", upload_mtu.chunk);
+    }
+}
+
+/*******************************************************************************
+* Function Name: upload_session_seed
+********************************************************************************
+* Summary:
+*  Returns a random session number from the TRNG, 0 if it is not available.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  uint16_t: Session number the sessions of the uploads count on from
+*
+*******************************************************************************/
+static uint16_t upload_session_seed(void)
+{
+    cyhal_trng_t trng_obj;
+    uint16_t seed = 0;
+
+    if (cyhal_trng_init(&trng_obj) == CY_RSLT_SUCCESS)
+    {
+        seed = (uint16_t)cyhal_trng_generate(&trng_obj);
+        cyhal_trng_free(&trng_obj);
+    }
+
+    return seed;
+}
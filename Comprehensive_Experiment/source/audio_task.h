@@ -15,36 +15,124 @@
 #include "emfile_task.h"
 #include "queue.h"
 
+#include "audio_stream.h"
+#include "audio_stats.h"
+#include "audio_packet.h"
+
 /*******************************************************************************
 * Macros
 ********************************************************************************/
-/* Define how many samples in a frame */
-#define PDM_PCM_BUFFER_SIZE                 (224000u) // 16000 * 2 * 7 (7 seconds)
+/* Longest recording after the button press in milliseconds, the recording
+ * also contains the AUDIO_PREROLL_MS before it */
+#define RECORD_MAX_DURATION_MS              (60000u)
+#define RECORD_MAX_FRAMES                   (RECORD_MAX_DURATION_MS / AUDIO_STREAM_FRAME_MS)
+/* Silence after speech that ends a recording not held by the button */
+#define RECORD_ENDPOINT_SILENCE_MS          (800u)
+#define RECORD_ENDPOINT_FRAMES              (RECORD_ENDPOINT_SILENCE_MS / AUDIO_STREAM_FRAME_MS)
+/* A recording without any speech ends after this time */
+#define RECORD_NO_SPEECH_TIMEOUT_MS         (5000u)
+#define RECORD_NO_SPEECH_FRAMES             (RECORD_NO_SPEECH_TIMEOUT_MS / AUDIO_STREAM_FRAME_MS)
+/* Non-speech frames kept to be uploaded ahead of the next speech onset */
+#define RECORD_LOOKBACK_FRAMES              (10u)
+/* Longest wait for a captured frame before the task re-checks the button events */
+#define AUDIO_FRAME_WAIT_TIMEOUT_MS         (2u * AUDIO_STREAM_FRAME_MS)
+/* Largest audio bytes of one UDP audio datagram, behind the header of
+ * audio_packet.h; the size used is chosen per upload, see audio_mtu.h */
+#define AUDIO_UPLOAD_CHUNK_SIZE             AUDIO_PACKET_MAX_PAYLOAD
+/* Longest time audio waits in a datagram that is not yet full before it is
+ * sent anyway, so that the server stays close behind the capture while the
+ * audio is slower than the chunk size (ADPCM, speech pauses); 0 sends only
+ * full datagrams */
+#define AUDIO_UPLOAD_MAX_HOLD_MS            (100u)
+/* Longest wait of the audio task for the pacing to free a queued datagram
+ * when it sends faster than the pacing rate, as when the pre-roll of a PCM
+ * upload is flushed; well below the 80 ms of the capture ring. A datagram
+ * that finds the queue still full is left to the retransmission */
+#define AUDIO_UPLOAD_QUEUE_WAIT_MS          (20u)
+/* MTU of the Wi-Fi interface, the largest IP datagram sent unfragmented */
+#define AUDIO_UPLOAD_LINK_MTU               (1500u)
+/* Payload of the start datagram: the sample rate, or the number of bands of
+ * a feature upload, followed by the datagrams and parities per FEC block and
+ * the audio bytes per datagram of the upload (uint16) */
+#define AUDIO_UPLOAD_START_SIZE             (8u)
+/* Payload of the end datagram: the number of samples */
+#define AUDIO_UPLOAD_END_SIZE               (4u)
+/* Payload of the statistics datagram sent ahead of the end datagram, see
+ * audio_upload_stats */
+#define AUDIO_UPLOAD_STATS_SIZE             (16u)
+/* Feedback datagrams of the server waiting for the audio task */
+#define AUDIO_UPLOAD_FEEDBACK_QUEUE_LENGTH  (4u)
+/* Forward error correction of the uploads (see audio_fec.h): every
+ * AUDIO_UPLOAD_FEC_DATA datagrams are followed by AUDIO_UPLOAD_FEC_PARITY
+ * parity datagrams, from which the server rebuilds as many lost datagrams
+ * without waiting for a retransmission. One parity is a plain XOR, more are
+ * Reed-Solomon. 0 datagrams disables it */
+#define AUDIO_UPLOAD_FEC_DATA               (0u)
+#define AUDIO_UPLOAD_FEC_PARITY             (2u)
+/* Encoding of the audio uploads, AUDIO_CODEC_PCM16 or AUDIO_CODEC_IMA_ADPCM */
+#define AUDIO_UPLOAD_CODEC                  AUDIO_CODEC_IMA_ADPCM
 
-/* Desired sample rate. Typical values: 8/16/22.05/32/44.1/48kHz */
-#define SAMPLE_RATE_HZ                      16000u
+/* Audio profile used from start up, see audio_profile_request */
+#define AUDIO_DEFAULT_PROFILE               AUDIO_PROFILE_WIDEBAND
+/* Start recordings on the wake word of audio_kws_model as well as on the
+ * button; needs a 16 kHz uplink. Off until a trained model is exported with
+ * python/kws_export.py: audio_kws_model.c is a placeholder without layers */
+#define AUDIO_WAKE_WORD_ENABLE              (0u)
+/* Microphones and highest capture rate: AUDIO_CAPTURE_CHANNELS and
+ * AUDIO_CAPTURE_MAX_RATE_HZ in audio_stream.h */
+/* Measure the A-weighted sound level continuously and send 1 s LAeq, LAFmax
+ * and LAFmin summaries to the UDP server (see audio_slm.h) */
+#define AUDIO_SLM_ENABLE                    (1u)
+/* Suppress stationary background noise in the frames ahead of the pre-roll,
+ * recording and wake word (see audio_ns.h); delays the audio by one frame
+ * and needs frames of at most AUDIO_NS_MAX_HOP samples */
+#define AUDIO_NS_ENABLE                     (1u)
+/* Adjust the PDM/PCM gain between frames from the measured speech level and
+ * peaks (see audio_gain.h) instead of the software AGC */
+#define AUDIO_HW_GAIN_CONTROL               (1u)
+/* Steering of the beamformer: arrival time difference of the wanted sound,
+ * positive if it reaches the left microphone first; 0 is broadside */
+#define AUDIO_BEAM_STEER_DELAY_US           (0)
 /* Decimation Rate of the PDM/PCM block. Typical value is 64 */
 #define DECIMATION_RATE                     64u
 /* Audio Subsystem Clock. Typical values depends on the desire sample rate:
 - 8/16/48kHz    : 24.576 MHz
-- 22.05/44.1kHz : 22.579 MHz */
+- 22.05/44.1kHz : 22.579 MHz
+All capture profiles are 16 or 48 kHz and share it */
 #define AUDIO_SYS_CLOCK_HZ                  24576000u
 /* PDM/PCM Pins */
 #define PDM_DATA                            P10_5
 #define PDM_CLK                             P10_4
-/* Switch press/release check interval in milliseconds for debouncing */
-#define SWITCH_DEBOUNCE_CHECK_UNIT          (1u)
-/* Number of debounce check units to count before considering that switch is pressed or released */
-#define SWITCH_DEBOUNCE_MAX_PERIOD_UNITS    (80u)
 
 #define AMBIENT_TEMPERATURE_C               (20)
 #define SPI_BAUD_RATE_HZ                    (20000000)
 
-// /* Audio buffer */
-// extern uint8_t* audio_frame;
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+/* Encoding of the audio datagrams of one upload */
+typedef enum
+{
+    AUDIO_CODEC_PCM16,              /* 16-bit little endian PCM */
+    AUDIO_CODEC_IMA_ADPCM,          /* 4:1 IMA-ADPCM, see audio_adpcm.h */
+    AUDIO_CODEC_LOG_MEL,            /* Log-mel features per frame, see audio_mfcc.h */
+} audio_codec_t;
+
+/* Capture and uplink sample rates, selectable at run time */
+typedef enum
+{
+    AUDIO_PROFILE_NARROWBAND,       /* 16 kHz capture, 8 kHz uplink */
+    AUDIO_PROFILE_WIDEBAND,         /* 16 kHz capture and uplink */
+    AUDIO_PROFILE_FULLBAND,         /* 48 kHz capture and uplink */
+    AUDIO_PROFILE_COUNT
+} audio_profile_id_t;
 
-/* Audio buffer */
-extern uint8_t audio_frame[PDM_PCM_BUFFER_SIZE];
+typedef struct
+{
+    uint32_t capture_rate_hz;       /* Sample rate of the PDM/PCM block */
+    uint32_t decimation_rate;       /* Decimation rate of the PDM/PCM block */
+    uint32_t resample_factor;       /* Software decimation to the uplink rate */
+} audio_profile_t;
 
 extern bool init_ok;
 
@@ -52,7 +140,13 @@ extern bool init_ok;
 * Function Prototypes
 ********************************************************************************/
 void audio_task(void *arg);
-cy_rslt_t send_audio_data_to_server(uint8_t *audio_data, uint32_t data_size);
+void audio_profile_request(audio_profile_id_t profile);
+void audio_upload_request_features(bool enable);
+cy_rslt_t audio_upload_begin(audio_codec_t codec, uint32_t sample_rate_hz);
+cy_rslt_t send_audio_data_to_server(const uint8_t *audio_data, uint32_t data_size);
+cy_rslt_t audio_upload_stats(const audio_stats_summary_t *summary);
+cy_rslt_t audio_upload_end(void);
+void audio_upload_feedback(const uint8_t *datagram, uint32_t size);
 cy_rslt_t init_audio_system(void);
 
 #endif /* AUDIO_TASK_H_ */
@@ -0,0 +1,309 @@
+/******************************************************************************
+* File Name:   audio_vad.c
+*
+* Description: This file contains the voice activity detector of the audio
+* pipeline.
+*
+* A frame is speech-like if its energy is well above the noise floor, or
+* moderately above it with a low zero-crossing rate (voiced speech). Both
+* measures are taken around the frame mean so that a DC offset of the
+* microphone does not bias them. The noise floor is tracked while no speech
+* is active. While speech is reported, the lowest frame energy of every
+* second raises the floor when it is above it, so that a step in the
+* background noise, which keeps every frame speech-like, ends the speech.
+* A hangover state machine bridges short pauses and requires a few
+* speech-like frames in a row before speech is reported, so that single
+* clicks are ignored.
+*
+*******************************************************************************/
+
+#include "audio_vad.h"
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static bool frame_is_speech(const audio_vad_t *vad, uint32_t num_samples);
+static void update_noise_floor(audio_vad_t *vad);
+static void track_noise_in_speech(audio_vad_t *vad);
+
+/*******************************************************************************
+* Function Name: audio_vad_init
+********************************************************************************
+* Summary:
+*  Initializes the detector. The noise floor is learnt from the first
+*  AUDIO_VAD_WARMUP_FRAMES frames.
+*
+* Parameters:
+*  vad: Voice activity detector
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_vad_init(audio_vad_t *vad)
+{
+    vad->state = AUDIO_VAD_STATE_SILENCE;
+    vad->count = 0;
+    vad->frames = 0;
+    vad->noise_energy = AUDIO_VAD_MIN_NOISE_ENERGY;
+    vad->energy = 0;
+    vad->zcr = 0;
+    vad->speech_min = UINT32_MAX;
+    vad->speech_frames = 0;
+}
+
+/*******************************************************************************
+* Function Name: audio_vad_process
+********************************************************************************
+* Summary:
+*  Classifies one frame and advances the hangover state machine.
+*
+* Parameters:
+*  vad: Voice activity detector
+*  samples: Frame samples
+*  num_samples: Number of samples in the frame, at most 65536
+*
+* Return:
+*  bool: true if the frame belongs to speech (speech or hangover state)
+*
+*******************************************************************************/
+bool audio_vad_process(audio_vad_t *vad, const int16_t *samples, uint32_t num_samples)
+{
+    int32_t  sum = 0;
+    uint64_t sum_sq = 0;
+    uint32_t zcr = 0;
+
+    if (num_samples == 0)
+    {
+        return (vad->state == AUDIO_VAD_STATE_SPEECH) || (vad->state == AUDIO_VAD_STATE_HANGOVER);
+    }
+
+    for (uint32_t i = 0; i < num_samples; i++)
+    {
+        int32_t x = samples[i];
+        sum += x;
+        sum_sq += (uint64_t)(x * x);
+    }
+
+    /* Mean square around the mean: E[x^2] - E[x]^2 */
+    int32_t mean = sum / (int32_t)num_samples;
+    uint64_t mean_sq = sum_sq / num_samples;
+    uint64_t dc_sq = (uint64_t)((int64_t)mean * mean);
+    vad->energy = (mean_sq > dc_sq) ? (uint32_t)(mean_sq - dc_sq) : 0u;
+
+    bool negative = (samples[0] < mean);
+    for (uint32_t i = 1; i < num_samples; i++)
+    {
+        bool n = (samples[i] < mean);
+        zcr += (n != negative) ? 1u : 0u;
+        negative = n;
+    }
+    vad->zcr = zcr;
+
+    if (vad->frames < AUDIO_VAD_WARMUP_FRAMES)
+    {
+        /* Average the first frames into the noise floor */
+        if (vad->frames == 0)
+        {
+            vad->noise_energy = vad->energy;
+        }
+        else
+        {
+            vad->noise_energy = (uint32_t)(((uint64_t)vad->noise_energy * vad->frames + vad->energy) /
+                                           (vad->frames + 1u));
+        }
+        if (vad->noise_energy < AUDIO_VAD_MIN_NOISE_ENERGY)
+        {
+            vad->noise_energy = AUDIO_VAD_MIN_NOISE_ENERGY;
+        }
+        vad->frames++;
+        return false;
+    }
+
+    bool speech = frame_is_speech(vad, num_samples);
+
+    if ((vad->state != AUDIO_VAD_STATE_SILENCE) || speech)
+    {
+        track_noise_in_speech(vad);
+    }
+    else
+    {
+        vad->speech_min = UINT32_MAX;
+        vad->speech_frames = 0;
+    }
+
+    switch (vad->state)
+    {
+        case AUDIO_VAD_STATE_SILENCE:
+        {
+            if (speech)
+            {
+                vad->state = AUDIO_VAD_STATE_ONSET;
+                vad->count = 1;
+            }
+            else
+            {
+                update_noise_floor(vad);
+            }
+            break;
+        }
+        case AUDIO_VAD_STATE_ONSET:
+        {
+            if (!speech)
+            {
+                vad->state = AUDIO_VAD_STATE_SILENCE;
+                update_noise_floor(vad);
+            }
+            else if (++vad->count >= AUDIO_VAD_ONSET_FRAMES)
+            {
+                vad->state = AUDIO_VAD_STATE_SPEECH;
+            }
+            break;
+        }
+        case AUDIO_VAD_STATE_SPEECH:
+        {
+            if (!speech)
+            {
+                vad->state = AUDIO_VAD_STATE_HANGOVER;
+                vad->count = 1;
+            }
+            break;
+        }
+        case AUDIO_VAD_STATE_HANGOVER:
+        {
+            if (speech)
+            {
+                vad->state = AUDIO_VAD_STATE_SPEECH;
+            }
+            else if (++vad->count > AUDIO_VAD_HANGOVER_FRAMES)
+            {
+                vad->state = AUDIO_VAD_STATE_SILENCE;
+                update_noise_floor(vad);
+            }
+            break;
+        }
+        default:
+        {
+            vad->state = AUDIO_VAD_STATE_SILENCE;
+            break;
+        }
+    }
+
+    return (vad->state == AUDIO_VAD_STATE_SPEECH) || (vad->state == AUDIO_VAD_STATE_HANGOVER);
+}
+
+/*******************************************************************************
+* Function Name: audio_vad_scale_noise
+********************************************************************************
+* Summary:
+*  Scales the noise floor after a change of the capture gain, so that the
+*  frames captured at the new gain are compared with the same floor.
+*
+* Parameters:
+*  vad: Voice activity detector
+*  ratio_q16: Power ratio of the new to the old gain, Q16
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_vad_scale_noise(audio_vad_t *vad, uint32_t ratio_q16)
+{
+    uint64_t noise = ((uint64_t)vad->noise_energy * ratio_q16) >> 16;
+
+    vad->noise_energy = (noise > UINT32_MAX) ? UINT32_MAX : (uint32_t)noise;
+    if (vad->noise_energy < AUDIO_VAD_MIN_NOISE_ENERGY)
+    {
+        vad->noise_energy = AUDIO_VAD_MIN_NOISE_ENERGY;
+    }
+
+    /* The minimum taken during speech mixes both gains, start it again */
+    vad->speech_min = UINT32_MAX;
+    vad->speech_frames = 0;
+}
+
+/*******************************************************************************
+* Function Name: frame_is_speech
+********************************************************************************
+* Summary:
+*  Compares the energy and zero-crossing rate of the last frame with the
+*  thresholds derived from the noise floor.
+*
+*******************************************************************************/
+static bool frame_is_speech(const audio_vad_t *vad, uint32_t num_samples)
+{
+    uint64_t noise = vad->noise_energy;
+
+    if (vad->energy < AUDIO_VAD_MIN_SPEECH_ENERGY)
+    {
+        return false;
+    }
+
+    if (vad->energy > noise * AUDIO_VAD_HIGH_ENERGY_RATIO)
+    {
+        return true;
+    }
+
+    return (vad->energy > noise * AUDIO_VAD_LOW_ENERGY_RATIO) &&
+           ((vad->zcr << 8) < (AUDIO_VAD_ZCR_VOICED_MAX_Q8 * num_samples));
+}
+
+/*******************************************************************************
+* Function Name: update_noise_floor
+********************************************************************************
+* Summary:
+*  Moves the noise floor towards the energy of the last frame, quickly
+*  downwards and slowly upwards.
+*
+*******************************************************************************/
+static void update_noise_floor(audio_vad_t *vad)
+{
+    if (vad->energy < vad->noise_energy)
+    {
+        vad->noise_energy -= (vad->noise_energy - vad->energy) >> AUDIO_VAD_NOISE_FALL_SHIFT;
+    }
+    else
+    {
+        vad->noise_energy += (vad->energy - vad->noise_energy) >> AUDIO_VAD_NOISE_RISE_SHIFT;
+    }
+
+    if (vad->noise_energy < AUDIO_VAD_MIN_NOISE_ENERGY)
+    {
+        vad->noise_energy = AUDIO_VAD_MIN_NOISE_ENERGY;
+    }
+}
+
+/*******************************************************************************
+* Function Name: track_noise_in_speech
+********************************************************************************
+* Summary:
+*  Takes the lowest energy of the frames while speech is seen and moves the
+*  noise floor towards it at the end of every AUDIO_VAD_SPEECH_MIN_FRAMES
+*  frames, only upwards.
+*
+* Parameters:
+*  vad: Voice activity detector
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void track_noise_in_speech(audio_vad_t *vad)
+{
+    if (vad->energy < vad->speech_min)
+    {
+        vad->speech_min = vad->energy;
+    }
+
+    if (++vad->speech_frames < AUDIO_VAD_SPEECH_MIN_FRAMES)
+    {
+        return;
+    }
+
+    if (vad->speech_min > vad->noise_energy)
+    {
+        vad->noise_energy += (vad->speech_min - vad->noise_energy) >> AUDIO_VAD_SPEECH_RISE_SHIFT;
+    }
+    vad->speech_min = UINT32_MAX;
+    vad->speech_frames = 0;
+}
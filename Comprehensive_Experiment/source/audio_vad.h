@@ -0,0 +1,76 @@
+/******************************************************************************
+* File Name:   audio_vad.h
+*
+* Description: This file contains the voice activity detector of the audio
+* pipeline. It classifies every capture frame from its energy and
+* zero-crossing rate against an adaptive noise floor, using integer
+* arithmetic only.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_VAD_H_
+#define AUDIO_VAD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Frames used to learn the noise floor before any speech is reported */
+#define AUDIO_VAD_WARMUP_FRAMES             (20u)
+/* Consecutive speech frames needed to enter the speech state */
+#define AUDIO_VAD_ONSET_FRAMES              (3u)
+/* Non-speech frames still reported as speech after the speech ends */
+#define AUDIO_VAD_HANGOVER_FRAMES           (30u)
+
+/* Energy above noise floor x ratio is speech regardless of the ZCR (~9 dB) */
+#define AUDIO_VAD_HIGH_ENERGY_RATIO         (8u)
+/* Energy above noise floor x ratio is speech if the ZCR is low (~5 dB) */
+#define AUDIO_VAD_LOW_ENERGY_RATIO          (3u)
+/* Zero crossings per sample (Q8) below which a frame counts as voiced */
+#define AUDIO_VAD_ZCR_VOICED_MAX_Q8         (64u)
+/* Mean square energy below which a frame is never speech (~-60 dBFS) */
+#define AUDIO_VAD_MIN_SPEECH_ENERGY         (1100u)
+/* Lowest value of the noise floor estimate */
+#define AUDIO_VAD_MIN_NOISE_ENERGY          (16u)
+/* Noise floor smoothing shifts, falling fast and rising slowly */
+#define AUDIO_VAD_NOISE_FALL_SHIFT          (2u)
+#define AUDIO_VAD_NOISE_RISE_SHIFT          (6u)
+/* Frames over which the lowest energy is taken while speech is reported,
+ * 1 s; pauses between words bring it down to the noise */
+#define AUDIO_VAD_SPEECH_MIN_FRAMES         (100u)
+/* The noise floor moves by 1/2 towards that minimum when it is higher */
+#define AUDIO_VAD_SPEECH_RISE_SHIFT         (1u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef enum
+{
+    AUDIO_VAD_STATE_SILENCE,
+    AUDIO_VAD_STATE_ONSET,          /* Speech seen, not yet confirmed */
+    AUDIO_VAD_STATE_SPEECH,
+    AUDIO_VAD_STATE_HANGOVER,       /* Speech ended, waiting for it to resume */
+} audio_vad_state_t;
+
+typedef struct
+{
+    audio_vad_state_t state;
+    uint32_t count;                 /* Frames spent in the onset / hangover state */
+    uint32_t frames;                /* Frames processed, saturates after warm-up */
+    uint32_t noise_energy;          /* Noise floor, mean square of the frames */
+    uint32_t energy;                /* Mean square of the last frame, DC removed */
+    uint32_t zcr;                   /* Zero crossings of the last frame */
+    uint32_t speech_min;            /* Lowest energy since speech was seen */
+    uint32_t speech_frames;         /* Frames in which speech_min was taken */
+} audio_vad_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void audio_vad_init(audio_vad_t *vad);
+bool audio_vad_process(audio_vad_t *vad, const int16_t *samples, uint32_t num_samples);
+void audio_vad_scale_noise(audio_vad_t *vad, uint32_t ratio_q16);
+
+#endif /* AUDIO_VAD_H_ */
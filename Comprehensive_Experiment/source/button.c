@@ -0,0 +1,211 @@
+/******************************************************************************
+* File Name:   button.c
+*
+* Description: This file contains the interrupt driven handling of the user
+* button.
+*
+* The GPIO interrupt only captures the tick count of the edge and defers the
+* processing to the RTOS timer task with xTimerPendFunctionCallFromISR. The
+* debounce and long press timeouts are one one-shot software timer whose
+* callback runs in the same task, so the state machine is never accessed
+* concurrently and no CPU time is spent while the button is idle or held.
+*
+*******************************************************************************/
+
+/* Header file includes. */
+#include "cyhal.h"
+#include "cybsp.h"
+
+/* RTOS header file. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+#include "button.h"
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static void button_isr(void *arg, cyhal_gpio_event_t event);
+static void button_process(void *arg, uint32_t now_ticks);
+static void button_timer_callback(TimerHandle_t timer);
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static button_fsm_t button_fsm;
+
+static StaticTimer_t button_timer_struct;
+static TimerHandle_t button_timer = NULL;
+
+static QueueHandle_t subscribers[BUTTON_MAX_SUBSCRIBERS];
+static uint32_t num_subscribers = 0;
+
+static cyhal_gpio_callback_data_t button_callback_data =
+{
+    .callback     = button_isr,
+    .callback_arg = NULL
+};
+
+/*******************************************************************************
+* Function Name: button_init
+********************************************************************************
+* Summary:
+*  Initializes the user button pin, its edge interrupt and the debounce timer.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  cy_rslt_t: CY_RSLT_SUCCESS if the operation is successful, an error code otherwise
+*
+*******************************************************************************/
+cy_rslt_t button_init(void)
+{
+    cy_rslt_t result;
+
+    result = cyhal_gpio_init(CYBSP_USER_BTN, CYHAL_GPIO_DIR_INPUT, CYHAL_GPIO_DRIVE_PULLUP, 1);
+    if (result != CY_RSLT_SUCCESS)
+    {
+        return result;
+    }
+
+    button_timer = xTimerCreateStatic("Button Timer", 1, pdFALSE, NULL,
+                                      button_timer_callback, &button_timer_struct);
+
+    button_fsm_init(&button_fsm, pdTICKS_TO_MS(xTaskGetTickCount()));
+
+    cyhal_gpio_register_callback(CYBSP_USER_BTN, &button_callback_data);
+    cyhal_gpio_enable_event(CYBSP_USER_BTN, CYHAL_GPIO_IRQ_BOTH, BUTTON_IRQ_PRIORITY, true);
+
+    /* Pick up a button that is already held */
+    xTimerPendFunctionCall(button_process, NULL, xTaskGetTickCount(), 0);
+
+    return CY_RSLT_SUCCESS;
+}
+
+/*******************************************************************************
+* Function Name: button_subscribe
+********************************************************************************
+* Summary:
+*  Registers a queue of button_event_t that receives every button event.
+*  Events are posted without blocking; a full queue loses the event.
+*
+* Parameters:
+*  queue: Queue created with an item size of sizeof(button_event_t)
+*
+* Return:
+*  bool: false if BUTTON_MAX_SUBSCRIBERS queues are already registered
+*
+*******************************************************************************/
+bool button_subscribe(QueueHandle_t queue)
+{
+    bool added = false;
+
+    taskENTER_CRITICAL();
+    if (num_subscribers < BUTTON_MAX_SUBSCRIBERS)
+    {
+        subscribers[num_subscribers++] = queue;
+        added = true;
+    }
+    taskEXIT_CRITICAL();
+
+    return added;
+}
+
+/*******************************************************************************
+* Function Name: button_isr
+********************************************************************************
+* Summary:
+*  User button edge interrupt. Time stamps the edge and defers it to the
+*  timer task.
+*
+* Parameters:
+*  void *arg: Callback argument (unused)
+*  cyhal_gpio_event_t event: GPIO event (unused)
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void button_isr(void *arg, cyhal_gpio_event_t event)
+{
+    BaseType_t higher_priority_task_woken = pdFALSE;
+
+    (void)arg;
+    (void)event;
+
+    xTimerPendFunctionCallFromISR(button_process, NULL, xTaskGetTickCountFromISR(),
+                                  &higher_priority_task_woken);
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+}
+
+/*******************************************************************************
+* Function Name: button_process
+********************************************************************************
+* Summary:
+*  Feeds the pin level into the state machine, posts the resulting events and
+*  re-arms the timer for the next debounce or long press timeout. Runs in the
+*  timer task.
+*
+* Parameters:
+*  void *arg: Unused
+*  uint32_t now_ticks: Tick count of the edge or of the timer expiry
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void button_process(void *arg, uint32_t now_ticks)
+{
+    (void)arg;
+
+    bool pressed = (cyhal_gpio_read(CYBSP_USER_BTN) == CYBSP_BTN_PRESSED);
+    uint32_t now_ms = pdTICKS_TO_MS(now_ticks);
+
+    button_event_t msg =
+    {
+        .events  = button_fsm_update(&button_fsm, pressed, now_ms),
+        .time_ms = now_ms,
+        .held_ms = button_fsm.held_ms,
+    };
+
+    if (msg.events != 0)
+    {
+        for (uint32_t i = 0; i < num_subscribers; i++)
+        {
+            xQueueSendToBack(subscribers[i], &msg, 0);
+        }
+    }
+
+    uint32_t timeout_ms = button_fsm_next_timeout(&button_fsm, pdTICKS_TO_MS(xTaskGetTickCount()));
+    if (timeout_ms == BUTTON_FSM_NO_TIMEOUT)
+    {
+        xTimerStop(button_timer, 0);
+    }
+    else
+    {
+        TickType_t period = pdMS_TO_TICKS(timeout_ms);
+        xTimerChangePeriod(button_timer, (period > 0) ? period : 1, 0);
+    }
+}
+
+/*******************************************************************************
+* Function Name: button_timer_callback
+********************************************************************************
+* Summary:
+*  Debounce / long press timeout.
+*
+* Parameters:
+*  TimerHandle_t timer (unused)
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void button_timer_callback(TimerHandle_t timer)
+{
+    (void)timer;
+
+    button_process(NULL, xTaskGetTickCount());
+}
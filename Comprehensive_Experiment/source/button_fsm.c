@@ -0,0 +1,171 @@
+/******************************************************************************
+* File Name:   button_fsm.c
+*
+* Description: This file contains the debounce state machine of the user
+* button.
+*
+* A level change moves a stable state into a debounce state. The change is
+* accepted once the level has not changed for BUTTON_DEBOUNCE_MS, otherwise
+* the state machine falls back to the previous stable state without an event.
+* All time arithmetic is done on differences so that the millisecond counter
+* may wrap.
+*
+*******************************************************************************/
+
+#include "button_fsm.h"
+
+/*******************************************************************************
+* Function Name: button_fsm_init
+********************************************************************************
+* Summary:
+*  Initializes the state machine in the released state. The caller feeds the
+*  current pin level with button_fsm_update afterwards.
+*
+* Parameters:
+*  fsm: State machine
+*  now_ms: Current time in milliseconds
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void button_fsm_init(button_fsm_t *fsm, uint32_t now_ms)
+{
+    fsm->state = BUTTON_STATE_RELEASED;
+    fsm->raw_pressed = false;
+    fsm->last_edge_ms = now_ms;
+    fsm->press_ms = now_ms;
+    fsm->held_ms = 0;
+}
+
+/*******************************************************************************
+* Function Name: button_fsm_update
+********************************************************************************
+* Summary:
+*  Advances the state machine. Must be called on every edge of the pin and
+*  when the time returned by button_fsm_next_timeout has elapsed.
+*
+* Parameters:
+*  fsm: State machine
+*  pressed: Current level, true if the button is pressed
+*  now_ms: Time of the edge or of the timer expiry in milliseconds
+*
+* Return:
+*  uint32_t: Combination of BUTTON_EVT_* generated by this update
+*
+*******************************************************************************/
+uint32_t button_fsm_update(button_fsm_t *fsm, bool pressed, uint32_t now_ms)
+{
+    uint32_t events = 0;
+
+    if (pressed != fsm->raw_pressed)
+    {
+        fsm->raw_pressed = pressed;
+        fsm->last_edge_ms = now_ms;
+    }
+
+    bool stable = ((now_ms - fsm->last_edge_ms) >= BUTTON_DEBOUNCE_MS);
+
+    switch (fsm->state)
+    {
+        case BUTTON_STATE_RELEASED:
+        {
+            if (pressed)
+            {
+                fsm->state = BUTTON_STATE_PRESS_DEBOUNCE;
+            }
+            break;
+        }
+        case BUTTON_STATE_PRESS_DEBOUNCE:
+        {
+            if (!pressed && stable)
+            {
+                /* Glitch, the press was never accepted */
+                fsm->state = BUTTON_STATE_RELEASED;
+            }
+            else if (pressed && stable)
+            {
+                fsm->state = BUTTON_STATE_PRESSED;
+                fsm->press_ms = fsm->last_edge_ms;
+                events |= BUTTON_EVT_PRESS;
+            }
+            break;
+        }
+        case BUTTON_STATE_PRESSED:
+        case BUTTON_STATE_LONG_PRESSED:
+        {
+            if (!pressed)
+            {
+                fsm->state = BUTTON_STATE_RELEASE_DEBOUNCE;
+            }
+            else if ((fsm->state == BUTTON_STATE_PRESSED) &&
+                     ((now_ms - fsm->press_ms) >= BUTTON_LONG_PRESS_MS))
+            {
+                fsm->state = BUTTON_STATE_LONG_PRESSED;
+                events |= BUTTON_EVT_LONG_PRESS;
+            }
+            break;
+        }
+        case BUTTON_STATE_RELEASE_DEBOUNCE:
+        {
+            if (pressed && stable)
+            {
+                /* Glitch, the button is still held */
+                fsm->state = ((now_ms - fsm->press_ms) >= BUTTON_LONG_PRESS_MS) ?
+                             BUTTON_STATE_LONG_PRESSED : BUTTON_STATE_PRESSED;
+            }
+            else if (!pressed && stable)
+            {
+                fsm->state = BUTTON_STATE_RELEASED;
+                fsm->held_ms = fsm->last_edge_ms - fsm->press_ms;
+                events |= BUTTON_EVT_RELEASE;
+            }
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+
+    return events;
+}
+
+/*******************************************************************************
+* Function Name: button_fsm_next_timeout
+********************************************************************************
+* Summary:
+*  Returns how long the caller may wait for the next edge before
+*  button_fsm_update has to be called anyway.
+*
+* Parameters:
+*  fsm: State machine
+*  now_ms: Current time in milliseconds
+*
+* Return:
+*  uint32_t: Time in milliseconds, BUTTON_FSM_NO_TIMEOUT to wait for an edge
+*
+*******************************************************************************/
+uint32_t button_fsm_next_timeout(const button_fsm_t *fsm, uint32_t now_ms)
+{
+    uint32_t elapsed;
+
+    switch (fsm->state)
+    {
+        case BUTTON_STATE_PRESS_DEBOUNCE:
+        case BUTTON_STATE_RELEASE_DEBOUNCE:
+        {
+            elapsed = now_ms - fsm->last_edge_ms;
+            return (elapsed >= BUTTON_DEBOUNCE_MS) ? 0u : (BUTTON_DEBOUNCE_MS - elapsed);
+        }
+        case BUTTON_STATE_PRESSED:
+        {
+            elapsed = now_ms - fsm->press_ms;
+            return (elapsed >= BUTTON_LONG_PRESS_MS) ? 0u : (BUTTON_LONG_PRESS_MS - elapsed);
+        }
+        default:
+        {
+            return BUTTON_FSM_NO_TIMEOUT;
+        }
+    }
+}
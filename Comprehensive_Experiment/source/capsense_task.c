@@ -53,6 +53,7 @@
 #include "timers.h"
 #include "led_task.h"
 #include "udp_client.h"
+#include "net_tx_task.h"
 #include "stdio.h"
 
 
@@ -459,37 +460,17 @@ static void tuner_init(void)
 
 cy_rslt_t send_capsense_data_to_server(uint32_t data)
 {
-    if (!init_ok) return;
+    char msg[12];
 
-    cy_rslt_t result;
-    
-    /* 设置目标服务器地址和端口 */
-    cy_socket_sockaddr_t server_addr = {
-        .ip_address.ip.v4 = UDP_SERVER_IP_ADDRESS,
-        .ip_address.version = CY_SOCKET_IP_VER_V4,
-        .port = UDP_SERVER_PORT
-    };
-    
-    /* 检查客户端套接字是否已创建 */
-    if (client_handle == NULL)
+    if (!init_ok)
     {
-        printf("错误：UDP客户端套接字未初始化\r\n");
         return CY_RSLT_MODULE_SECURE_SOCKETS_NOT_INITIALIZED;
     }
-    
-    /* 发送Capsense数据到服务器 */
-    printf("正在发送Capsense数据到服务器...\r\n");
 
-    uint32_t bytes_sent = 0;
-    char msg[10];
-    sprintf(msg, "%c%d", 'C', data);
-    
-    result = cy_socket_sendto(client_handle, msg, strlen(msg), CY_SOCKET_FLAGS_NONE,
-                                &server_addr, sizeof(cy_socket_sockaddr_t), &bytes_sent);
+    /* 交给网络发送任务，CapSense任务不等待发送 */
+    snprintf(msg, sizeof(msg), "%c%lu", 'C', (unsigned long)data);
 
-    printf("发送成功...\r\n");
-    
-    return CY_RSLT_SUCCESS;
+    return net_tx_send(NET_TX_PRIORITY_CONTROL, msg, strlen(msg));
 }
 
 
@@ -3,8 +3,39 @@
 
 #include "random_tool.h"
 
+/* Notification bits sent to emfile_task */
+#define EMFILE_EVT_SESSION_START            (1UL << 0)
+#define EMFILE_EVT_SESSION_STOP             (1UL << 1)
+
 static char random_filename[13];
 
+/* A queued frame and the session it was written in */
+typedef struct
+{
+    audio_pool_frame_t *frame;
+    uint32_t session;
+} sd_queue_item_t;
+
+/* Frames waiting to be written, each queued with its own reference. Frames
+ * of the next session can be queued before the previous session is
+ * closed; the session number tells them apart */
+static StaticQueue_t sd_queue_struct;
+static uint8_t sd_queue_storage[EMFILE_QUEUE_LENGTH * sizeof(sd_queue_item_t)];
+static QueueHandle_t sd_queue = NULL;
+/* Session of emfile_session_write, counted by emfile_session_start */
+static volatile uint32_t write_session;
+/* Audio collected into whole SD sectors */
+static uint8_t write_block[EMFILE_WRITE_BLOCK_SIZE];
+static uint32_t write_block_len;
+
+static volatile bool emfile_ready = false;
+static uint32_t session_dropped_bytes;
+
+static void write_frame(FS_FILE *file_ptr, audio_pool_frame_t *frame);
+static void write_block_flush(FS_FILE *file_ptr);
+static void session_close(FS_FILE **file_ptr, uint32_t session);
+static void sd_queue_drop(uint32_t session);
+
 static void check_error(char *message, int error)
 {
     if (error < 0)
@@ -46,41 +77,242 @@ void emfile_task(void* arg)
     printf("emFile Task ready to receive write events.\n\n");
 
 
-    // --- 主循环，等待事件来触发写入 ---
+    sd_queue = xQueueCreateStatic(EMFILE_QUEUE_LENGTH, sizeof(sd_queue_item_t),
+                                  sd_queue_storage, &sd_queue_struct);
+    emfile_ready = true;
+
+    // --- 主循环，等待录音会话并把音频流写入文件 ---
+    file_ptr = NULL;
+    uint32_t file_session = 0;
+
     for (;;)
     {
-    	uint32_t notification_value = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        uint32_t events = 0;
+        sd_queue_item_t item;
+
+        /* Only block on the notification while no file is open */
+        xTaskNotifyWait(0, UINT32_MAX, &events, (file_ptr != NULL) ? 0 : portMAX_DELAY);
+
+        /* The open session is closed before the next one is opened, also
+         * when the stop and the next start arrive together */
+        if (events & (EMFILE_EVT_SESSION_STOP | EMFILE_EVT_SESSION_START))
+        {
+            session_close(&file_ptr, file_session);
+        }
 
-        if (notification_value > 0)
+        if (events & EMFILE_EVT_SESSION_START)
         {
+            file_session = write_session;
             printf("Write event received! Writing to file...\n");
             generate_password();
             memset(random_filename, '\0', sizeof random_filename);
             snprintf(random_filename, sizeof random_filename, "%.8s.bin", (char*)password);
-            random_filename[13] = '\0';
 
             // 'a' 模式表示追加 (append)。如果文件不存在则创建。
             file_ptr = FS_FOpen(random_filename, "ab");
-
-            if(file_ptr != NULL)
+            write_block_len = 0;
+            if (file_ptr == NULL)
             {
-                U32 bytes_written = FS_Write(file_ptr, audio_frame, PDM_PCM_BUFFER_SIZE);
-
-                if(bytes_written != PDM_PCM_BUFFER_SIZE)
-                {
-                    error = FS_FError(file_ptr);
-                    check_error("Error in writing to the file", error);
-                }
+                printf("Unable to open the file for writing!\n");
+            }
+        }
 
-                error = FS_FClose(file_ptr);
-                check_error("Error in closing the file", error);
+        if (file_ptr == NULL)
+        {
+            /* Nothing to write the audio to: the frames of the session go
+             * back to the pool */
+            sd_queue_drop(file_session);
+            continue;
+        }
 
-                printf("Successfully wrote to %s\n", random_filename);
+        /* A frame of the next session waits for its start event, which was
+         * sent before the frame was queued */
+        if (xQueuePeek(sd_queue, &item, pdMS_TO_TICKS(EMFILE_WRITE_TIMEOUT_MS)) == pdTRUE)
+        {
+            if (item.session == file_session)
+            {
+                (void)xQueueReceive(sd_queue, &item, 0);
+                write_frame(file_ptr, item.frame);
+                audio_pool_release(item.frame);
             }
-            else
+            else if ((int32_t)(item.session - file_session) < 0)
             {
-                printf("Unable to open the file for writing!\n");
+                sd_queue_drop(file_session);
             }
         }
     }
 }
+
+/*******************************************************************************
+* Function Name: session_close
+********************************************************************************
+* Summary:
+*  Ends the open session: writes its frames still queued and the partial
+*  write block, and closes its file. Frames of the next session stay
+*  queued.
+*
+*******************************************************************************/
+static void session_close(FS_FILE **file_ptr, uint32_t session)
+{
+    sd_queue_item_t item;
+    int error;
+
+    if (*file_ptr == NULL)
+    {
+        sd_queue_drop(session);
+        return;
+    }
+
+    /* The frames of the session were queued before its stop event */
+    while ((xQueuePeek(sd_queue, &item, 0) == pdTRUE) && (item.session == session))
+    {
+        (void)xQueueReceive(sd_queue, &item, 0);
+        write_frame(*file_ptr, item.frame);
+        audio_pool_release(item.frame);
+    }
+    sd_queue_drop(session);
+
+    write_block_flush(*file_ptr);
+    error = FS_FClose(*file_ptr);
+    check_error("Error in closing the file", error);
+    *file_ptr = NULL;
+
+    printf("Successfully wrote to %s (dropped %lu bytes)\n", random_filename, session_dropped_bytes);
+}
+
+/*******************************************************************************
+* Function Name: write_frame
+********************************************************************************
+* Summary:
+*  Collects the samples of a frame into the write block and writes every
+*  block that gets full.
+*
+*******************************************************************************/
+static void write_frame(FS_FILE *file_ptr, audio_pool_frame_t *frame)
+{
+    const uint8_t *data = (const uint8_t *)frame->samples;
+    uint32_t len = frame->num_samples * sizeof(int16_t);
+
+    while (len > 0)
+    {
+        uint32_t copy_size = EMFILE_WRITE_BLOCK_SIZE - write_block_len;
+        if (copy_size > len)
+        {
+            copy_size = len;
+        }
+
+        memcpy(&write_block[write_block_len], data, copy_size);
+        write_block_len += copy_size;
+        data += copy_size;
+        len -= copy_size;
+
+        if (write_block_len == EMFILE_WRITE_BLOCK_SIZE)
+        {
+            write_block_flush(file_ptr);
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: write_block_flush
+********************************************************************************
+* Summary:
+*  Writes the collected audio to the file.
+*
+*******************************************************************************/
+static void write_block_flush(FS_FILE *file_ptr)
+{
+    if (write_block_len > 0)
+    {
+        U32 bytes_written = FS_Write(file_ptr, write_block, write_block_len);
+
+        if (bytes_written != write_block_len)
+        {
+            check_error("Error in writing to the file", FS_FError(file_ptr));
+        }
+        write_block_len = 0;
+    }
+}
+
+/*******************************************************************************
+* Function Name: sd_queue_drop
+********************************************************************************
+* Summary:
+*  Releases the queued frames of the given and earlier sessions without
+*  writing them, returning their references to the frame pool.
+*
+* Parameters:
+*  session: last session to drop, frames of later sessions stay queued
+*
+*******************************************************************************/
+static void sd_queue_drop(uint32_t session)
+{
+    sd_queue_item_t item;
+
+    while ((xQueuePeek(sd_queue, &item, 0) == pdTRUE) &&
+           ((int32_t)(item.session - session) <= 0))
+    {
+        (void)xQueueReceive(sd_queue, &item, 0);
+        audio_pool_release(item.frame);
+    }
+}
+
+/*******************************************************************************
+* Function Name: emfile_session_start
+********************************************************************************
+* Summary:
+*  Opens a new file for the audio written by emfile_session_write. A
+*  session still open is closed first, with all audio written before.
+*
+*******************************************************************************/
+void emfile_session_start(void)
+{
+    if (emfile_ready)
+    {
+        write_session++;
+        session_dropped_bytes = 0;
+        xTaskNotify(emfile_task_handle, EMFILE_EVT_SESSION_START, eSetBits);
+    }
+}
+
+/*******************************************************************************
+* Function Name: emfile_session_write
+********************************************************************************
+* Summary:
+*  Queues a frame of the current session for writing, taking a reference
+*  to it that is dropped once it is written. Never blocks; a frame that
+*  does not fit into the queue is dropped and counted.
+*
+* Parameters:
+*  frame: Frame, the caller keeps its own reference
+*
+*******************************************************************************/
+void emfile_session_write(audio_pool_frame_t *frame)
+{
+    if (emfile_ready)
+    {
+        sd_queue_item_t item = { .frame = frame, .session = write_session };
+
+        audio_pool_retain(frame);
+        if (xQueueSend(sd_queue, &item, 0) != pdTRUE)
+        {
+            session_dropped_bytes += frame->num_samples * sizeof(int16_t);
+            audio_pool_release(frame);
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: emfile_session_stop
+********************************************************************************
+* Summary:
+*  Closes the file of the current session once all queued audio is written.
+*
+*******************************************************************************/
+void emfile_session_stop(void)
+{
+    if (emfile_ready)
+    {
+        xTaskNotify(emfile_task_handle, EMFILE_EVT_SESSION_STOP, eSetBits);
+    }
+}
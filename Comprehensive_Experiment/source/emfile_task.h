@@ -10,13 +10,23 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "semphr.h"
+#include "queue.h"
 #include <inttypes.h>
 #include <stdio.h>
 
+#include "audio_pool.h"
+
 
 #define NUM_BYTES_TO_READ_FROM_FILE         (256U)
 #define DEBOUNCE_DELAY_MS                   (50U)
 
+/* Frames queued between audio_task and the SD card */
+#define EMFILE_QUEUE_LENGTH                 (12U)
+/* Size of one FS_Write, in bytes (one SD sector) */
+#define EMFILE_WRITE_BLOCK_SIZE             (512U)
+/* Time to wait for more audio before writing a partial write block */
+#define EMFILE_WRITE_TIMEOUT_MS             (20U)
+
 
 extern cyhal_trng_t trng_obj;
 
@@ -24,6 +34,9 @@ extern TaskHandle_t emfile_task_handle;
 
 
 void emfile_task(void* arg);
+void emfile_session_start(void);
+void emfile_session_write(audio_pool_frame_t *frame);
+void emfile_session_stop(void);
 
 
 #endif
@@ -27,8 +27,10 @@
 #include "led_task.h"
 
 #include "emfile_task.h"
+#include "net_tx_task.h"
 
 #include "bluetooth_task.h"
+#include "button.h"
 
 
 /*******************************************************************************
@@ -46,6 +48,11 @@
 
 #define TASK_BT_INIT_PRIORITY            (configMAX_PRIORITIES - 3)
 
+/* Above the audio task, so that a queued CapSense message is sent between
+ * two audio datagrams; below the lwIP and Wi-Fi driver tasks */
+#define NET_TX_TASK_PRIORITY              (CY_RTOS_PRIORITY_ABOVENORMAL)
+#define NET_TX_TASK_STACK_SIZE            (1024u)
+
 /*******************************************************************************
 * Global Variables
 ********************************************************************************/
@@ -64,6 +71,8 @@ TaskHandle_t audio_task_handle;
 
 TaskHandle_t emfile_task_handle;
 
+TaskHandle_t net_tx_task_handle;
+
 cyhal_trng_t trng_obj;
 
 bool init_ok = false;
@@ -124,11 +133,22 @@ int main(void)
 
     capsense_command_q = xQueueCreate(SINGLE_ELEMENT_QUEUE,
                                       sizeof(capsense_command_t));
+
+    /* The user button is shared by the audio and Bluetooth tasks, which
+     * subscribe to its debounced events */
+    result = button_init();
+    if (result != CY_RSLT_SUCCESS)
+    {
+        CY_ASSERT(0);
+    }
     
 
     xTaskCreate(audio_task, "Audio task", AUDIO_TASK_STACK_SIZE,
     			NULL, AUDIO_TASK_PRIORITY, &audio_task_handle);
 
+    xTaskCreate(net_tx_task, "Net TX Task", NET_TX_TASK_STACK_SIZE,
+                NULL, NET_TX_TASK_PRIORITY, &net_tx_task_handle);
+
     xTaskCreate(task_capsense, "CapSense Task", TASK_CAPSENSE_STACK_SIZE,
                 NULL, TASK_CAPSENSE_PRIORITY, NULL);
 
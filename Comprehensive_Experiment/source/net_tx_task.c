@@ -0,0 +1,284 @@
+/******************************************************************************
+* File Name:   net_tx_task.c
+*
+* Description: This file contains the task that sends all datagrams to the
+* UDP server.
+*
+* The messages of every priority are buffers of a pool of their own, handed
+* between the free queue of the pool and the queue of the priority, so that
+* net_tx_send only copies the datagram and never allocates memory; only
+* net_tx_send_wait waits, for a message to come back to the pool. The task
+* sends the oldest message of the highest priority that has one; an audio
+* datagram waits for the pacing, during which a newly queued control or
+* telemetry message wakes the task and is sent first.
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "net_tx_task.h"
+#include "udp_client.h"
+#include "audio_pacer.h"
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    uint32_t size;
+    uint8_t *data;                  /* Buffer in the pool of its priority */
+} net_tx_message_t;
+
+typedef struct
+{
+    QueueHandle_t pending;          /* Messages to send, oldest first */
+    QueueHandle_t free;             /* Messages not in use */
+    uint32_t max_size;
+} net_tx_queue_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static bool queue_init(net_tx_queue_t *queue, net_tx_message_t *messages, uint8_t *data, uint32_t count,
+                       uint32_t max_size);
+static void message_send(net_tx_priority_t priority, net_tx_message_t *message);
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static uint8_t control_data[NET_TX_CONTROL_QUEUE_LENGTH][NET_TX_MESSAGE_MAX_SIZE];
+static uint8_t telemetry_data[NET_TX_TELEMETRY_QUEUE_LENGTH][NET_TX_MESSAGE_MAX_SIZE];
+static uint8_t bulk_data[NET_TX_BULK_QUEUE_LENGTH][NET_TX_BULK_MAX_SIZE];
+static net_tx_message_t messages[NET_TX_CONTROL_QUEUE_LENGTH + NET_TX_TELEMETRY_QUEUE_LENGTH +
+                                 NET_TX_BULK_QUEUE_LENGTH];
+static net_tx_queue_t queues[NET_TX_PRIORITY_COUNT];
+
+/* Pacing of all datagrams; only the bulk ones wait for it */
+static audio_pacer_t pacer;
+
+static volatile bool net_tx_ready = false;
+
+static const cy_socket_sockaddr_t server_addr =
+{
+    .ip_address.ip.v4 = UDP_SERVER_IP_ADDRESS,
+    .ip_address.version = CY_SOCKET_IP_VER_V4,
+    .port = UDP_SERVER_PORT
+};
+
+/*******************************************************************************
+* Function Name: net_tx_task
+********************************************************************************
+* Summary:
+*  Sends the queued datagrams to the UDP server, by priority, pacing the
+*  bulk ones.
+*
+* Parameters:
+*  arg: Unused
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void net_tx_task(void *arg)
+{
+    (void)arg;
+
+    if (!queue_init(&queues[NET_TX_PRIORITY_CONTROL], &messages[0], &control_data[0][0],
+                    NET_TX_CONTROL_QUEUE_LENGTH, NET_TX_MESSAGE_MAX_SIZE) ||
+        !queue_init(&queues[NET_TX_PRIORITY_TELEMETRY], &messages[NET_TX_CONTROL_QUEUE_LENGTH],
+                    &telemetry_data[0][0], NET_TX_TELEMETRY_QUEUE_LENGTH, NET_TX_MESSAGE_MAX_SIZE) ||
+        !queue_init(&queues[NET_TX_PRIORITY_BULK],
+                    &messages[NET_TX_CONTROL_QUEUE_LENGTH + NET_TX_TELEMETRY_QUEUE_LENGTH],
+                    &bulk_data[0][0], NET_TX_BULK_QUEUE_LENGTH, NET_TX_BULK_MAX_SIZE))
+    {
+        printf("网络发送队列创建失败\r\n");
+        vTaskDelete(NULL);
+        return;
+    }
+
+    audio_pacer_init(&pacer, UDP_PACING_RATE_BPS, UDP_PACING_BURST_BYTES, pdTICKS_TO_MS(xTaskGetTickCount()));
+    net_tx_ready = true;
+
+    for (;;)
+    {
+        net_tx_message_t *message;
+        uint32_t priority;
+        TickType_t wait = portMAX_DELAY;
+
+        for (priority = 0; priority < NET_TX_PRIORITY_COUNT; priority++)
+        {
+            if (xQueuePeek(queues[priority].pending, &message, 0) == pdTRUE)
+            {
+                break;
+            }
+        }
+
+        if (priority < NET_TX_PRIORITY_COUNT)
+        {
+            uint32_t now_ms = pdTICKS_TO_MS(xTaskGetTickCount());
+            uint32_t delay_ms = (priority == NET_TX_PRIORITY_BULK) ?
+                                audio_pacer_delay(&pacer, message->size, now_ms) : 0u;
+
+            if (delay_ms == 0u)
+            {
+                (void)xQueueReceive(queues[priority].pending, &message, 0);
+                audio_pacer_consume(&pacer, message->size, now_ms);
+                message_send((net_tx_priority_t)priority, message);
+                continue;
+            }
+
+            wait = pdMS_TO_TICKS(delay_ms);
+        }
+
+        /* Until a message is queued or the pacing lets the bulk one go */
+        (void)ulTaskNotifyTake(pdTRUE, wait);
+    }
+}
+
+/*******************************************************************************
+* Function Name: net_tx_send
+********************************************************************************
+* Summary:
+*  Queues a copy of a datagram for the UDP server. Never blocks; a datagram
+*  that finds the queue of its priority full is dropped.
+*
+* Parameters:
+*  priority: Priority of the datagram
+*  data: Datagram
+*  size: Size of the datagram in bytes
+*
+* Return:
+*  cy_rslt_t: CY_RSLT_SUCCESS if queued,
+*             CY_RSLT_MODULE_SECURE_SOCKETS_NOT_INITIALIZED before the task
+*             or the socket is ready,
+*             CY_RSLT_MODULE_SECURE_SOCKETS_BADARG if the datagram is too
+*             large for its priority,
+*             CY_RSLT_MODULE_SECURE_SOCKETS_NOMEM if the queue is full
+*
+*******************************************************************************/
+cy_rslt_t net_tx_send(net_tx_priority_t priority, const void *data, uint32_t size)
+{
+    return net_tx_send_wait(priority, data, size, 0u);
+}
+
+/*******************************************************************************
+* Function Name: net_tx_send_wait
+********************************************************************************
+* Summary:
+*  Queues a copy of a datagram for the UDP server like net_tx_send, waiting
+*  up to wait_ms for a free message if the queue of its priority is full.
+*  For bulk datagrams, net_tx_task frees a message as fast as the pacing
+*  lets the oldest one go, so a sender waiting here is paced with it.
+*
+* Parameters:
+*  priority: Priority of the datagram
+*  data: Datagram
+*  size: Size of the datagram in bytes
+*  wait_ms: Longest wait for a free message, 0 to never block
+*
+* Return:
+*  cy_rslt_t: As net_tx_send; CY_RSLT_MODULE_SECURE_SOCKETS_NOMEM if the
+*             queue stayed full for wait_ms
+*
+*******************************************************************************/
+cy_rslt_t net_tx_send_wait(net_tx_priority_t priority, const void *data, uint32_t size, uint32_t wait_ms)
+{
+    net_tx_queue_t *queue = &queues[priority];
+    net_tx_message_t *message;
+
+    if (!net_tx_ready || (client_handle == NULL))
+    {
+        return CY_RSLT_MODULE_SECURE_SOCKETS_NOT_INITIALIZED;
+    }
+
+    if (size > queue->max_size)
+    {
+        return CY_RSLT_MODULE_SECURE_SOCKETS_BADARG;
+    }
+
+    if (xQueueReceive(queue->free, &message, pdMS_TO_TICKS(wait_ms)) != pdTRUE)
+    {
+        return CY_RSLT_MODULE_SECURE_SOCKETS_NOMEM;
+    }
+
+    memcpy(message->data, data, size);
+    message->size = size;
+
+    /* Holds every message of the pool, never full */
+    (void)xQueueSend(queue->pending, &message, 0);
+    xTaskNotifyGive(net_tx_task_handle);
+
+    return CY_RSLT_SUCCESS;
+}
+
+/*******************************************************************************
+* Function Name: queue_init
+********************************************************************************
+* Summary:
+*  Creates the queues of a priority and puts its messages into the free one.
+*
+* Parameters:
+*  queue: Queues of the priority
+*  messages: Messages of the priority
+*  data: Buffer of count messages of max_size bytes each
+*  count: Number of messages
+*  max_size: Largest message in bytes
+*
+* Return:
+*  bool: true if the queues were created
+*
+*******************************************************************************/
+static bool queue_init(net_tx_queue_t *queue, net_tx_message_t *messages, uint8_t *data, uint32_t count,
+                       uint32_t max_size)
+{
+    queue->pending = xQueueCreate(count, sizeof(net_tx_message_t *));
+    queue->free = xQueueCreate(count, sizeof(net_tx_message_t *));
+    queue->max_size = max_size;
+
+    if ((queue->pending == NULL) || (queue->free == NULL))
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        net_tx_message_t *message = &messages[i];
+
+        message->data = &data[i * max_size];
+        message->size = 0;
+        (void)xQueueSend(queue->free, &message, 0);
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: message_send
+********************************************************************************
+* Summary:
+*  Sends a message and returns it to the free queue. A failed audio datagram
+*  is left to the retransmission on the NACKs of the server, see audio_arq.h.
+*
+* Parameters:
+*  priority: Priority the message was queued with
+*  message: Message to send
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void message_send(net_tx_priority_t priority, net_tx_message_t *message)
+{
+    uint32_t bytes_sent = 0;
+    cy_rslt_t result;
+
+    result = cy_socket_sendto(client_handle, message->data, message->size, CY_SOCKET_FLAGS_NONE,
+                              &server_addr, sizeof(cy_socket_sockaddr_t), &bytes_sent);
+    if ((result != CY_RSLT_SUCCESS) && (priority != NET_TX_PRIORITY_BULK))
+    {
+        printf("发送到服务器失败，错误码: %ld\r\n", result);
+    }
+
+    (void)xQueueSend(queues[priority].free, &message, 0);
+}
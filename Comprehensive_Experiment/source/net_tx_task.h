@@ -0,0 +1,65 @@
+/******************************************************************************
+* File Name:   net_tx_task.h
+*
+* Description: This file contains the task that sends all datagrams to the
+* UDP server.
+*
+* The task owns the sending side of client_handle. Other tasks queue their
+* datagrams with net_tx_send, which copies them and never blocks, so a
+* real-time task such as the CapSense task never waits for lwIP or the
+* Wi-Fi driver. net_tx_send_wait waits a bounded time for a free message
+* instead, so a burst of audio datagrams is paced instead of dropped. Every priority has its own queue; a queued control message
+* is sent before the next telemetry message, and both before the next audio
+* datagram, also while the audio waits for the pacing of udp_client.h.
+*
+*******************************************************************************/
+
+#ifndef NET_TX_TASK_H_
+#define NET_TX_TASK_H_
+
+#include "cy_secure_sockets.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "audio_fec.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Largest control and telemetry message in bytes */
+#define NET_TX_MESSAGE_MAX_SIZE             (32u)
+/* Largest bulk datagram, a parity datagram of the audio upload */
+#define NET_TX_BULK_MAX_SIZE                AUDIO_FEC_MAX_DATAGRAM
+/* Messages queued per priority; a message that does not fit is dropped */
+#define NET_TX_CONTROL_QUEUE_LENGTH         (8u)
+#define NET_TX_TELEMETRY_QUEUE_LENGTH       (4u)
+/* Bulk datagrams queued ahead of the pacing: the pre-roll and lookback of
+ * a 16 kHz IMA-ADPCM upload (600 ms, 4800 bytes) at the smallest chunk of
+ * 512 bytes are 10 datagrams. A PCM upload flushes four times as many; its
+ * sender waits for the pacing to free messages, see net_tx_send_wait */
+#define NET_TX_BULK_QUEUE_LENGTH            (12u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+/* Priorities of the queued datagrams, highest first */
+typedef enum
+{
+    NET_TX_PRIORITY_CONTROL,        /* CapSense commands */
+    NET_TX_PRIORITY_TELEMETRY,      /* Sound level summaries */
+    NET_TX_PRIORITY_BULK,           /* Audio upload, paced */
+    NET_TX_PRIORITY_COUNT
+} net_tx_priority_t;
+
+extern TaskHandle_t net_tx_task_handle;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void net_tx_task(void *arg);
+cy_rslt_t net_tx_send(net_tx_priority_t priority, const void *data, uint32_t size);
+cy_rslt_t net_tx_send_wait(net_tx_priority_t priority, const void *data, uint32_t size, uint32_t wait_ms);
+
+#endif /* NET_TX_TASK_H_ */
@@ -22,6 +22,10 @@
 
 /* UDP client task header file. */
 #include "udp_client.h"
+#include "audio_task.h"
+#include "audio_arq.h"
+
+#include <string.h>
 
 /*******************************************************************************
 * Macros
@@ -39,8 +43,9 @@
 /* Initial message sent to UDP Server to confirm client availability. */
 // #define START_COMM_MSG                         "A"
 
-/* Buffer size to store the incoming messages from server, in bytes. */
-#define MAX_UDP_RECV_BUFFER_SIZE          (20)
+/* Buffer size to store the incoming messages from server, in bytes: the
+ * commands and the feedback of the audio upload. */
+#define MAX_UDP_RECV_BUFFER_SIZE          (AUDIO_ARQ_MAX_FEEDBACK)
 
 /* RTOS related macros for UDP client task. */
 #define RTOS_TASK_TICKS_TO_WAIT           (1000)
@@ -260,8 +265,7 @@ cy_rslt_t create_udp_client_socket(void)
 
     /* Variable used to set socket receive callback function. */
     cy_socket_opt_callback_t udp_recv_option = {
-            // .callback = udp_client_recv_handler,
-            .callback = NULL,
+            .callback = udp_client_recv_handler,
             .arg = NULL
     };
 
@@ -276,7 +280,10 @@ cy_rslt_t create_udp_client_socket(void)
  * Function Name: udp_client_recv_handler
  *******************************************************************************
  * Summary:
- *  Callback function to handle incoming UDP server messages.
+ *  Callback function to handle incoming UDP server messages: UDP_CMD_FEATURES
+ *  and UDP_CMD_AUDIO select what the next audio uploads carry, UDP_CMD_PROFILE
+ *  selects the capture profile, NACKs and ACKs of the uploads are passed to
+ *  the audio task, other messages are ignored.
  *
  * Parameters:
  *  cy_socket_t socket_handle: Connection handle for the UDP client socket
@@ -298,8 +305,40 @@ cy_rslt_t udp_client_recv_handler(cy_socket_t socket_handle, void *arg)
     result = cy_socket_recvfrom(client_handle, rx_buffer, MAX_UDP_RECV_BUFFER_SIZE,
                                     CY_SOCKET_FLAGS_RECVFROM_NONE, NULL, 0, &bytes_received);
 
-    /* Send notification to the task to turn the LED on/off and send acknowledgment to the server. */
-    xTaskNotify(client_task_handle, (uint32_t)rx_buffer[0], eSetValueWithoutOverwrite);
+    if (result != CY_RSLT_SUCCESS)
+    {
+        return result;
+    }
+
+    if ((bytes_received >= AUDIO_PACKET_HEADER_SIZE) &&
+        (memcmp(rx_buffer, AUDIO_PACKET_MAGIC, 2u) == 0))
+    {
+        audio_upload_feedback((const uint8_t *)rx_buffer, bytes_received);
+        return result;
+    }
+
+    if (bytes_received != UDP_CMD_SIZE)
+    {
+        return result;
+    }
+
+    if (memcmp(rx_buffer, UDP_CMD_FEATURES, UDP_CMD_SIZE) == 0)
+    {
+        printf("服务器请求上传特征\r\n");
+        audio_upload_request_features(true);
+    }
+    else if (memcmp(rx_buffer, UDP_CMD_AUDIO, UDP_CMD_SIZE) == 0)
+    {
+        printf("服务器请求上传音频\r\n");
+        audio_upload_request_features(false);
+    }
+    else if ((memcmp(rx_buffer, UDP_CMD_PROFILE, UDP_CMD_PROFILE_SIZE) == 0) &&
+             (rx_buffer[UDP_CMD_PROFILE_SIZE] >= '0') &&
+             (rx_buffer[UDP_CMD_PROFILE_SIZE] < (char)('0' + AUDIO_PROFILE_COUNT)))
+    {
+        printf("服务器请求切换音频配置 %c\r\n", rx_buffer[UDP_CMD_PROFILE_SIZE]);
+        audio_profile_request((audio_profile_id_t)(rx_buffer[UDP_CMD_PROFILE_SIZE] - '0'));
+    }
 
     return result;
 }
@@ -43,6 +43,24 @@
 #define UDP_SERVER_IP_ADDRESS             MAKE_IPV4_ADDRESS(123, 60, 80, 170)
 #define UDP_SERVER_PORT                   (57345)
 
+/* Commands of the UDP server: upload log-mel features or audio, and switch
+ * to the capture profile of the digit following UDP_CMD_PROFILE, the
+ * audio_profile_id_t value. The client answers UDP_CMD_PROFILE with the
+ * same command and the digit of the profile it captures with */
+#define UDP_CMD_FEATURES                  "feat"
+#define UDP_CMD_AUDIO                     "wave"
+#define UDP_CMD_PROFILE                   "prf"
+#define UDP_CMD_PROFILE_SIZE              (3u)
+#define UDP_CMD_SIZE                      (4u)
+
+/* Token bucket pacing of the datagrams sent to the UDP server by
+ * net_tx_task.c (see audio_pacer.h), so that the pre-roll and
+ * retransmissions do not overflow the Wi-Fi transmit queue: the long term
+ * rate in bytes per second, 0 sends without pacing, and the bytes that may
+ * be sent back to back */
+#define UDP_PACING_RATE_BPS               (512000u)
+#define UDP_PACING_BURST_BYTES            (12000u)
+
 
 /* Cypress secure socket header file. */
 #include "cy_secure_sockets.h"
@@ -0,0 +1,40 @@
+/******************************************************************************
+* File Name:   FreeRTOS.h
+*
+* Description: This file contains the host version of the FreeRTOS types
+* and macros used by the tasks of ../source that the host tests build. The
+* tasks run as POSIX threads and the tick is the monotonic clock in
+* milliseconds, see rtos_host.c. Only the calls the tested tasks make are
+* provided.
+*
+*******************************************************************************/
+
+#ifndef FREERTOS_H_
+#define FREERTOS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define pdTRUE                              (1)
+#define pdFALSE                             (0)
+#define pdPASS                              (pdTRUE)
+#define portMAX_DELAY                       (0xFFFFFFFFu)
+/* One tick per millisecond */
+#define pdMS_TO_TICKS(ms)                   ((TickType_t)(ms))
+#define pdTICKS_TO_MS(ticks)                ((uint32_t)(ticks))
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+typedef struct host_task *TaskHandle_t;
+typedef struct host_queue *QueueHandle_t;
+typedef void (*TaskFunction_t)(void *arg);
+
+#endif /* FREERTOS_H_ */
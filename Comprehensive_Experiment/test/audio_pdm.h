@@ -0,0 +1,55 @@
+/******************************************************************************
+* File Name:   audio_pdm.h
+*
+* Description: This file contains the software PDM to PCM decimator: a 5th
+* order CIC filter followed by a compensating decimate-by-2 FIR, producing
+* the same 16-bit PCM as the PDM/PCM block. It lets the audio modules run
+* from recorded or synthesized PDM streams on a host.
+*
+* The board captures through the PDM/PCM block and has no other PDM input,
+* so the decimator lives with the host tests and is not built into the
+* firmware.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_PDM_H_
+#define AUDIO_PDM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define AUDIO_PDM_CIC_ORDER                 (5u)
+/* Compensation FIR, decimating the CIC output by 2 */
+#define AUDIO_PDM_FIR_TAPS                  (64u)
+#define AUDIO_PDM_FIR_DECIMATION            (2u)
+/* Supported PDM to PCM decimation rates */
+#define AUDIO_PDM_MIN_DECIMATION            (32u)
+#define AUDIO_PDM_MAX_DECIMATION            (128u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    uint32_t integrator[AUDIO_PDM_CIC_ORDER];   /* Modulo 2^32, like the comb */
+    uint32_t comb[AUDIO_PDM_CIC_ORDER];
+    uint32_t cic_bytes;             /* PDM bytes per CIC output */
+    uint32_t byte_count;            /* Bytes since the last CIC output */
+    uint32_t cic_offset;            /* CIC output of a zero input */
+    int32_t  cic_shift;             /* Left shift of the CIC output to Q24 */
+    int32_t  delay[2u * AUDIO_PDM_FIR_TAPS];    /* FIR history, stored twice */
+    uint32_t pos;                   /* Oldest sample in delay */
+    uint32_t phase;                 /* CIC outputs since the last PCM sample */
+} audio_pdm_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+bool audio_pdm_init(audio_pdm_t *pdm, uint32_t decimation_rate);
+uint32_t audio_pdm_process(audio_pdm_t *pdm, const uint8_t *pdm_data, uint32_t num_bytes,
+                           int16_t *out, uint32_t stride);
+
+#endif /* AUDIO_PDM_H_ */
@@ -0,0 +1,193 @@
+/******************************************************************************
+* File Name:   cmsis_compiler.h
+*
+* Description: This file contains host versions of the Cortex-M DSP
+* extension intrinsics used by the audio modules. Building a module with its
+* *_USE_SIMD macro set to 1 on the host picks up this file instead of the
+* CMSIS one, so that the SIMD kernels can be compared with the reference
+* kernels. Each function follows the instruction description of the Armv7-M
+* architecture manual.
+*
+*******************************************************************************/
+
+#ifndef CMSIS_COMPILER_H_
+#define CMSIS_COMPILER_H_
+
+#include <stdint.h>
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* APSR.GE flags of the halfwords, bits 0 (bottom) and 1 (top) */
+static uint32_t host_ge;
+
+/*******************************************************************************
+* Function Name: host_lo, host_hi
+********************************************************************************
+* Summary:
+*  Return the signed bottom and top halfword of a word.
+*
+*******************************************************************************/
+static inline int32_t host_lo(uint32_t x)
+{
+    return (int16_t)(x & 0xFFFFu);
+}
+
+static inline int32_t host_hi(uint32_t x)
+{
+    return (int16_t)(x >> 16);
+}
+
+/*******************************************************************************
+* Function Name: __PKHBT
+********************************************************************************
+* Summary:
+*  Bottom halfword of a, top halfword of b shifted left.
+*
+*******************************************************************************/
+static inline uint32_t __PKHBT(uint32_t a, uint32_t b, uint32_t shift)
+{
+    return (a & 0xFFFFu) | ((b << shift) & 0xFFFF0000u);
+}
+
+/*******************************************************************************
+* Function Name: __PKHTB
+********************************************************************************
+* Summary:
+*  Top halfword of a, bottom halfword of b shifted right arithmetically.
+*
+*******************************************************************************/
+static inline uint32_t __PKHTB(uint32_t a, uint32_t b, uint32_t shift)
+{
+    return (a & 0xFFFF0000u) | ((uint32_t)((int32_t)b >> shift) & 0xFFFFu);
+}
+
+/*******************************************************************************
+* Function Name: __ROR
+********************************************************************************
+* Summary:
+*  Rotates a word right.
+*
+*******************************************************************************/
+static inline uint32_t __ROR(uint32_t x, uint32_t n)
+{
+    n &= 31u;
+    return (n == 0u) ? x : ((x >> n) | (x << (32u - n)));
+}
+
+/*******************************************************************************
+* Function Name: __SSAT
+********************************************************************************
+* Summary:
+*  Saturates a value to a signed range of the given number of bits.
+*
+*******************************************************************************/
+static inline int32_t __SSAT(int32_t x, uint32_t bits)
+{
+    int32_t max = (int32_t)((1u << (bits - 1u)) - 1u);
+    int32_t min = -max - 1;
+
+    return (x > max) ? max : ((x < min) ? min : x);
+}
+
+/*******************************************************************************
+* Function Name: __QSUB16
+********************************************************************************
+* Summary:
+*  Dual signed 16-bit subtraction, saturating. Leaves the GE flags.
+*
+*******************************************************************************/
+static inline uint32_t __QSUB16(uint32_t x, uint32_t y)
+{
+    uint32_t lo = (uint32_t)__SSAT(host_lo(x) - host_lo(y), 16u) & 0xFFFFu;
+    uint32_t hi = (uint32_t)__SSAT(host_hi(x) - host_hi(y), 16u) & 0xFFFFu;
+
+    return (hi << 16) | lo;
+}
+
+/*******************************************************************************
+* Function Name: __SSUB16
+********************************************************************************
+* Summary:
+*  Dual signed 16-bit subtraction, wrapping. Sets the GE flag of a halfword
+*  when its difference is not negative.
+*
+*******************************************************************************/
+static inline uint32_t __SSUB16(uint32_t x, uint32_t y)
+{
+    int32_t lo = host_lo(x) - host_lo(y);
+    int32_t hi = host_hi(x) - host_hi(y);
+
+    host_ge = ((lo >= 0) ? 1u : 0u) | ((hi >= 0) ? 2u : 0u);
+    return ((uint32_t)hi << 16) | ((uint32_t)lo & 0xFFFFu);
+}
+
+/*******************************************************************************
+* Function Name: __UADD16
+********************************************************************************
+* Summary:
+*  Dual unsigned 16-bit addition, wrapping. Sets the GE flag of a halfword
+*  when its sum carries out.
+*
+*******************************************************************************/
+static inline uint32_t __UADD16(uint32_t x, uint32_t y)
+{
+    uint32_t lo = (x & 0xFFFFu) + (y & 0xFFFFu);
+    uint32_t hi = (x >> 16) + (y >> 16);
+
+    host_ge = ((lo > 0xFFFFu) ? 1u : 0u) | ((hi > 0xFFFFu) ? 2u : 0u);
+    return (hi << 16) | (lo & 0xFFFFu);
+}
+
+/*******************************************************************************
+* Function Name: __SEL
+********************************************************************************
+* Summary:
+*  Selects each halfword from x where its GE flag is set, from y otherwise.
+*
+*******************************************************************************/
+static inline uint32_t __SEL(uint32_t x, uint32_t y)
+{
+    uint32_t lo = ((host_ge & 1u) ? x : y) & 0xFFFFu;
+    uint32_t hi = ((host_ge & 2u) ? x : y) & 0xFFFF0000u;
+
+    return hi | lo;
+}
+
+/*******************************************************************************
+* Function Name: __SMUAD, __SMUADX, __SMLAD
+********************************************************************************
+* Summary:
+*  Dual signed 16-bit multiplies, the products added, optionally with the
+*  halfwords of y exchanged and to an accumulator.
+*
+*******************************************************************************/
+static inline uint32_t __SMUAD(uint32_t x, uint32_t y)
+{
+    return (uint32_t)(host_lo(x) * host_lo(y) + host_hi(x) * host_hi(y));
+}
+
+static inline uint32_t __SMUADX(uint32_t x, uint32_t y)
+{
+    return (uint32_t)(host_lo(x) * host_hi(y) + host_hi(x) * host_lo(y));
+}
+
+static inline uint32_t __SMLAD(uint32_t x, uint32_t y, uint32_t acc)
+{
+    return __SMUAD(x, y) + acc;
+}
+
+/*******************************************************************************
+* Function Name: __SMLALD
+********************************************************************************
+* Summary:
+*  Dual signed 16-bit multiplies, the products added to a 64-bit
+*  accumulator.
+*
+*******************************************************************************/
+static inline uint64_t __SMLALD(uint32_t x, uint32_t y, uint64_t acc)
+{
+    return acc + (uint64_t)((int64_t)host_lo(x) * host_lo(y) + (int64_t)host_hi(x) * host_hi(y));
+}
+
+#endif /* CMSIS_COMPILER_H_ */
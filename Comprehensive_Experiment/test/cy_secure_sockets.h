@@ -0,0 +1,57 @@
+/******************************************************************************
+* File Name:   cy_secure_sockets.h
+*
+* Description: This file contains the host version of the secure sockets
+* types and result codes used by the tasks of ../source that the host tests
+* build. The result codes only need to differ from each other. A test that
+* sends provides cy_socket_sendto and client_handle itself, to capture the
+* datagrams.
+*
+*******************************************************************************/
+
+#ifndef CY_SECURE_SOCKETS_H_
+#define CY_SECURE_SOCKETS_H_
+
+#include <stdint.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define CY_RSLT_SUCCESS                                 (0u)
+#define CY_RSLT_MODULE_SECURE_SOCKETS_NOT_INITIALIZED   (0x100u)
+#define CY_RSLT_MODULE_SECURE_SOCKETS_NOMEM             (0x101u)
+#define CY_RSLT_MODULE_SECURE_SOCKETS_BADARG            (0x102u)
+
+#define CY_SOCKET_IP_VER_V4                 (4)
+#define CY_SOCKET_FLAGS_NONE                (0)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+/* unsigned long like uint32_t of the Arm toolchain, for the %ld of the
+ * firmware printfs */
+typedef unsigned long cy_rslt_t;
+typedef void *cy_socket_t;
+typedef uint32_t cy_socket_sockaddr_len_t;
+
+typedef struct
+{
+    struct
+    {
+        struct
+        {
+            uint32_t v4;
+        } ip;
+        int version;
+    } ip_address;
+    uint16_t port;
+} cy_socket_sockaddr_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+cy_rslt_t cy_socket_sendto(cy_socket_t handle, const void *buffer, uint32_t length, int flags,
+                           const cy_socket_sockaddr_t *dest_addr, cy_socket_sockaddr_len_t address_length,
+                           uint32_t *bytes_sent);
+
+#endif /* CY_SECURE_SOCKETS_H_ */
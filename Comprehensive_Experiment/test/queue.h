@@ -0,0 +1,23 @@
+/******************************************************************************
+* File Name:   queue.h
+*
+* Description: This file contains the host version of the FreeRTOS queue
+* calls, see FreeRTOS.h. Items are copied in and out like in FreeRTOS.
+*
+*******************************************************************************/
+
+#ifndef QUEUE_H_
+#define QUEUE_H_
+
+#include "FreeRTOS.h"
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait);
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+#endif /* QUEUE_H_ */
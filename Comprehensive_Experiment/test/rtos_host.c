@@ -0,0 +1,412 @@
+/******************************************************************************
+* File Name:   rtos_host.c
+*
+* Description: This file contains the host version of the FreeRTOS calls of
+* FreeRTOS.h, task.h and queue.h. Tasks are POSIX threads; one mutex
+* guards every queue and notification and one condition variable wakes all
+* waiters, which check again what they wait for. Waits time out on the
+* monotonic clock, the tick being one millisecond of it.
+*
+*******************************************************************************/
+
+#include <errno.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+struct host_task
+{
+    pthread_t thread;
+    TaskFunction_t function;
+    void *arg;
+    uint32_t notifications;
+};
+
+struct host_queue
+{
+    uint8_t *items;
+    uint32_t length;
+    uint32_t item_size;
+    uint32_t head;                  /* Index of the oldest item */
+    uint32_t count;
+};
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+static void *task_entry(void *arg);
+static void lock(void);
+static bool wait_until(const struct timespec *deadline);
+static void deadline_after(TickType_t ticks, struct timespec *deadline);
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static pthread_mutex_t host_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t host_cond;
+static pthread_once_t host_once = PTHREAD_ONCE_INIT;
+/* Task of the calling thread, NULL for the main thread of the test */
+static __thread struct host_task *current_task;
+
+/*******************************************************************************
+* Function Name: xTaskCreate
+********************************************************************************
+* Summary:
+*  Starts a task on a thread of its own. The stack depth and the priority
+*  are left to the host.
+*
+*******************************************************************************/
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    struct host_task *task = calloc(1u, sizeof(*task));
+
+    (void)name;
+    (void)stack_depth;
+    (void)priority;
+
+    if (task == NULL)
+    {
+        return pdFALSE;
+    }
+    task->function = function;
+    task->arg = arg;
+    if (handle != NULL)
+    {
+        *handle = task;
+    }
+
+    if (pthread_create(&task->thread, NULL, task_entry, task) != 0)
+    {
+        free(task);
+        return pdFALSE;
+    }
+    pthread_detach(task->thread);
+
+    return pdPASS;
+}
+
+/*******************************************************************************
+* Function Name: vTaskDelete
+********************************************************************************
+* Summary:
+*  Ends the calling task; other tasks are not deleted on the host.
+*
+*******************************************************************************/
+void vTaskDelete(TaskHandle_t task)
+{
+    if ((task == NULL) || (task == current_task))
+    {
+        pthread_exit(NULL);
+    }
+}
+
+/*******************************************************************************
+* Function Name: vTaskDelay
+********************************************************************************
+* Summary:
+*  Sleeps for a number of ticks.
+*
+*******************************************************************************/
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec delay = { (time_t)(ticks / 1000u), (long)(ticks % 1000u) * 1000000L };
+
+    while (nanosleep(&delay, &delay) != 0)
+    {
+    }
+}
+
+/*******************************************************************************
+* Function Name: xTaskGetTickCount
+********************************************************************************
+* Summary:
+*  Returns the monotonic clock in milliseconds.
+*
+*******************************************************************************/
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (TickType_t)((uint64_t)now.tv_sec * 1000u + (uint64_t)now.tv_nsec / 1000000u);
+}
+
+/*******************************************************************************
+* Function Name: ulTaskNotifyTake
+********************************************************************************
+* Summary:
+*  Waits up to 'wait' ticks for a notification of the calling task and
+*  takes it, all of them if 'clear' is set.
+*
+*******************************************************************************/
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait)
+{
+    struct host_task *task = current_task;
+    struct timespec deadline;
+    uint32_t value;
+
+    deadline_after(wait, &deadline);
+    lock();
+    while ((task->notifications == 0u) && (wait != 0u))
+    {
+        if (!wait_until((wait == portMAX_DELAY) ? NULL : &deadline))
+        {
+            break;
+        }
+    }
+    value = task->notifications;
+    if (value > 0u)
+    {
+        task->notifications = (clear != pdFALSE) ? 0u : (value - 1u);
+    }
+    pthread_mutex_unlock(&host_mutex);
+
+    return value;
+}
+
+/*******************************************************************************
+* Function Name: xTaskNotifyGive
+********************************************************************************
+* Summary:
+*  Notifies a task.
+*
+*******************************************************************************/
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    lock();
+    task->notifications++;
+    pthread_cond_broadcast(&host_cond);
+    pthread_mutex_unlock(&host_mutex);
+
+    return pdPASS;
+}
+
+/*******************************************************************************
+* Function Name: xQueueCreate
+********************************************************************************
+* Summary:
+*  Creates a queue of 'length' items of 'item_size' bytes.
+*
+*******************************************************************************/
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *queue = calloc(1u, sizeof(*queue));
+
+    if (queue == NULL)
+    {
+        return NULL;
+    }
+    queue->items = calloc(length, item_size);
+    if (queue->items == NULL)
+    {
+        free(queue);
+        return NULL;
+    }
+    queue->length = (uint32_t)length;
+    queue->item_size = (uint32_t)item_size;
+
+    return queue;
+}
+
+/*******************************************************************************
+* Function Name: xQueueSend
+********************************************************************************
+* Summary:
+*  Copies an item to the back of a queue, waiting up to 'wait' ticks for
+*  room.
+*
+*******************************************************************************/
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait)
+{
+    struct timespec deadline;
+
+    deadline_after(wait, &deadline);
+    lock();
+    while (queue->count == queue->length)
+    {
+        if ((wait == 0u) || !wait_until((wait == portMAX_DELAY) ? NULL : &deadline))
+        {
+            pthread_mutex_unlock(&host_mutex);
+            return pdFALSE;
+        }
+    }
+
+    memcpy(&queue->items[((queue->head + queue->count) % queue->length) * queue->item_size], item,
+           queue->item_size);
+    queue->count++;
+    pthread_cond_broadcast(&host_cond);
+    pthread_mutex_unlock(&host_mutex);
+
+    return pdPASS;
+}
+
+/*******************************************************************************
+* Function Name: xQueueReceive
+********************************************************************************
+* Summary:
+*  Copies the oldest item out of a queue and removes it, waiting up to
+*  'wait' ticks for one.
+*
+*******************************************************************************/
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait)
+{
+    if (xQueuePeek(queue, item, wait) != pdTRUE)
+    {
+        return pdFALSE;
+    }
+
+    lock();
+    queue->head = (queue->head + 1u) % queue->length;
+    queue->count--;
+    pthread_cond_broadcast(&host_cond);
+    pthread_mutex_unlock(&host_mutex);
+
+    return pdTRUE;
+}
+
+/*******************************************************************************
+* Function Name: xQueuePeek
+********************************************************************************
+* Summary:
+*  Copies the oldest item out of a queue without removing it, waiting up to
+*  'wait' ticks for one.
+*
+*******************************************************************************/
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t wait)
+{
+    struct timespec deadline;
+
+    deadline_after(wait, &deadline);
+    lock();
+    while (queue->count == 0u)
+    {
+        if ((wait == 0u) || !wait_until((wait == portMAX_DELAY) ? NULL : &deadline))
+        {
+            pthread_mutex_unlock(&host_mutex);
+            return pdFALSE;
+        }
+    }
+
+    memcpy(item, &queue->items[queue->head * queue->item_size], queue->item_size);
+    pthread_mutex_unlock(&host_mutex);
+
+    return pdTRUE;
+}
+
+/*******************************************************************************
+* Function Name: uxQueueMessagesWaiting
+********************************************************************************
+* Summary:
+*  Returns the number of items in a queue.
+*
+*******************************************************************************/
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    UBaseType_t count;
+
+    lock();
+    count = queue->count;
+    pthread_mutex_unlock(&host_mutex);
+
+    return count;
+}
+
+/*******************************************************************************
+* Function Name: task_entry
+********************************************************************************
+* Summary:
+*  Runs the function of a task on its thread.
+*
+*******************************************************************************/
+static void *task_entry(void *arg)
+{
+    struct host_task *task = arg;
+
+    current_task = task;
+    task->function(task->arg);
+
+    return NULL;
+}
+
+/*******************************************************************************
+* Function Name: host_init
+********************************************************************************
+* Summary:
+*  Makes the condition variable time out on the monotonic clock.
+*
+*******************************************************************************/
+static void host_init(void)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&host_cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/*******************************************************************************
+* Function Name: lock
+********************************************************************************
+* Summary:
+*  Takes the mutex of the queues and notifications.
+*
+*******************************************************************************/
+static void lock(void)
+{
+    pthread_once(&host_once, host_init);
+    pthread_mutex_lock(&host_mutex);
+}
+
+/*******************************************************************************
+* Function Name: wait_until
+********************************************************************************
+* Summary:
+*  Waits for a change of any queue or notification, or the deadline, NULL
+*  for none. Returns false once the deadline passed.
+*
+*******************************************************************************/
+static bool wait_until(const struct timespec *deadline)
+{
+    if (deadline == NULL)
+    {
+        pthread_cond_wait(&host_cond, &host_mutex);
+        return true;
+    }
+
+    return pthread_cond_timedwait(&host_cond, &host_mutex, deadline) != ETIMEDOUT;
+}
+
+/*******************************************************************************
+* Function Name: deadline_after
+********************************************************************************
+* Summary:
+*  Returns the time on the monotonic clock a number of ticks from now.
+*
+*******************************************************************************/
+static void deadline_after(TickType_t ticks, struct timespec *deadline)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    if (ticks == portMAX_DELAY)
+    {
+        return;
+    }
+
+    deadline->tv_sec += (time_t)(ticks / 1000u);
+    deadline->tv_nsec += (long)(ticks % 1000u) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L)
+    {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
@@ -0,0 +1,25 @@
+/******************************************************************************
+* File Name:   task.h
+*
+* Description: This file contains the host version of the FreeRTOS task and
+* task notification calls, see FreeRTOS.h.
+*
+*******************************************************************************/
+
+#ifndef TASK_H_
+#define TASK_H_
+
+#include "FreeRTOS.h"
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+#endif /* TASK_H_ */
@@ -0,0 +1,277 @@
+/******************************************************************************
+* File Name:   test_adpcm.c
+*
+* Description: This file contains the host test of the IMA-ADPCM encoder.
+* The codes of a short signal are compared with those of the reference
+* algorithm of the IMA recommendation, and the encoded audio is decoded the
+* way the UDP server does (python/udp.py, decode_ima_adpcm): the round trip
+* keeps the signal to noise ratio of 4-bit ADPCM, every block decodes on
+* its own from its header, and the decoder ends on the encoder state.
+*
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_adpcm.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define SAMPLE_RATE_HZ                      (16000u)
+#define SAMPLES                             (4u * SAMPLE_RATE_HZ)
+/* Block payload of a 1024 byte upload datagram */
+#define BLOCK_BYTES                         (1024u - AUDIO_ADPCM_HEADER_SIZE)
+#define BLOCK_SAMPLES                       AUDIO_ADPCM_SAMPLES_IN_BYTES(BLOCK_BYTES)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static const int8_t index_table[16] =
+{
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const int16_t step_table[89] =
+{
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+/* A 440 Hz tone with a step, and its codes from the reference algorithm */
+static const int16_t golden_input[32] =
+{
+    0, 2063, 4065, 5946, 7649, 9125, 10329, 11225, 11787, 11999, 11852, 11353, 10516, 9365, 7936, 6270,
+    4417, 2433, 377, -1691, -708, -2615, -4355, -5876, -7132, -8087, -8711, -8987, -8905, -8470, -7692, -6596
+};
+static const uint8_t golden_codes[16] =
+{
+    0x70, 0x77, 0x77, 0x77, 0x77, 0x80, 0x98, 0x98, 0x9A, 0xBA, 0xA1, 0xAB, 0x9B, 0x99, 0x10, 0x52
+};
+#define GOLDEN_PREDICTOR                    (-6496)
+#define GOLDEN_STEP_INDEX                   (55)
+
+static int16_t input[SAMPLES];
+static int16_t output[SAMPLES];
+static uint8_t encoded[SAMPLES / 2u];
+
+/*******************************************************************************
+* Function Name: decode_block
+********************************************************************************
+* Summary:
+*  Decodes a block, header and codes, like decode_ima_adpcm of the UDP
+*  server. Returns the number of samples.
+*
+*******************************************************************************/
+static uint32_t decode_block(const uint8_t *block, uint32_t size, int16_t *pcm)
+{
+    int32_t predictor = (int16_t)(block[0] | (block[1] << 8));
+    int32_t index = (block[2] > 88u) ? 88 : block[2];
+    uint32_t count = 0;
+
+    for (uint32_t i = AUDIO_ADPCM_HEADER_SIZE; i < size; i++)
+    {
+        for (uint32_t nibble = 0; nibble < 2u; nibble++)
+        {
+            uint32_t code = (block[i] >> (4u * nibble)) & 0x0Fu;
+            int32_t step = step_table[index];
+            int32_t vpdiff = step >> 3;
+
+            vpdiff += (code & 4u) ? step : 0;
+            vpdiff += (code & 2u) ? (step >> 1) : 0;
+            vpdiff += (code & 1u) ? (step >> 2) : 0;
+            predictor += (code & 8u) ? -vpdiff : vpdiff;
+            predictor = (predictor > INT16_MAX) ? INT16_MAX : ((predictor < INT16_MIN) ? INT16_MIN : predictor);
+
+            index += index_table[code];
+            index = (index < 0) ? 0 : ((index > 88) ? 88 : index);
+            pcm[count++] = (int16_t)predictor;
+        }
+    }
+    return count;
+}
+
+/*******************************************************************************
+* Function Name: snr_db
+********************************************************************************
+* Summary:
+*  Returns the ratio of the input power to the power of the coding error.
+*
+*******************************************************************************/
+static double snr_db(const int16_t *in, const int16_t *out, uint32_t count)
+{
+    double signal = 0.0;
+    double error = 0.0;
+
+    for (uint32_t n = 0; n < count; n++)
+    {
+        signal += (double)in[n] * in[n];
+        error += ((double)in[n] - out[n]) * ((double)in[n] - out[n]);
+    }
+    return 10.0 * log10(signal / error);
+}
+
+/*******************************************************************************
+* Function Name: round_trip
+********************************************************************************
+* Summary:
+*  Encodes the input into blocks of BLOCK_BYTES, decodes every block on its
+*  own and returns the SNR of the round trip. Also checks that each block
+*  ends on the state the encoder carries into the next header.
+*
+*******************************************************************************/
+static double round_trip(const char *name)
+{
+    audio_adpcm_state_t state;
+    uint8_t block[AUDIO_ADPCM_HEADER_SIZE + BLOCK_BYTES];
+    uint32_t decoded = 0;
+    uint32_t state_errors = 0;
+
+    audio_adpcm_init(&state);
+    for (uint32_t n = 0; n < SAMPLES; n += BLOCK_SAMPLES)
+    {
+        uint32_t count = ((SAMPLES - n) < BLOCK_SAMPLES) ? (SAMPLES - n) : BLOCK_SAMPLES;
+        uint32_t size = audio_adpcm_write_header(&state, block);
+
+        audio_adpcm_encode(&state, &input[n], count, &block[size]);
+        size += (count + 1u) / 2u;
+        decoded += decode_block(block, size, &output[decoded]) - (count & 1u);
+
+        state_errors += (output[decoded - 1u] != state.predictor) ? 1u : 0u;
+    }
+
+    double snr = snr_db(input, output, SAMPLES);
+    printf("%-22s SNR %.1f dB\n", name, snr);
+    TEST_CHECK(decoded == SAMPLES, "%s: %u of %u samples decoded", name, decoded, SAMPLES);
+    TEST_CHECK(state_errors == 0u, "%s: %u blocks end off the encoder state", name, state_errors);
+    return snr;
+}
+
+/*******************************************************************************
+* Function Name: test_golden
+********************************************************************************
+* Summary:
+*  The encoder produces the codes and the final state of the reference
+*  algorithm, and an odd count ends on a half-filled byte.
+*
+*******************************************************************************/
+static void test_golden(void)
+{
+    audio_adpcm_state_t state;
+    uint8_t codes[sizeof(golden_codes)];
+
+    audio_adpcm_init(&state);
+    audio_adpcm_encode(&state, golden_input, 32u, codes);
+    TEST_CHECK(memcmp(codes, golden_codes, sizeof(codes)) == 0, "codes differ from the reference");
+    TEST_CHECK((state.predictor == GOLDEN_PREDICTOR) && (state.step_index == GOLDEN_STEP_INDEX),
+               "final state %d/%d, expected %d/%d", state.predictor, state.step_index,
+               GOLDEN_PREDICTOR, GOLDEN_STEP_INDEX);
+
+    /* An odd count leaves the high nibble of its last byte zero */
+    audio_adpcm_init(&state);
+    memset(codes, 0xFF, sizeof(codes));
+    audio_adpcm_encode(&state, golden_input, 31u, codes);
+    TEST_CHECK((memcmp(codes, golden_codes, 15u) == 0) && (codes[15] == (golden_codes[15] & 0x0Fu)),
+               "odd count: last byte 0x%02X", codes[15]);
+}
+
+/*******************************************************************************
+* Function Name: test_round_trip
+********************************************************************************
+* Summary:
+*  Tones across the speech band and noise survive the round trip with the
+*  SNR expected of 4-bit ADPCM; a full scale square wave does not overflow.
+*
+*******************************************************************************/
+static void test_round_trip(void)
+{
+    static const double freqs_hz[] = { 200.0, 1000.0, 3000.0 };
+    char name[32];
+
+    for (uint32_t f = 0; f < sizeof(freqs_hz) / sizeof(freqs_hz[0]); f++)
+    {
+        for (uint32_t n = 0; n < SAMPLES; n++)
+        {
+            input[n] = test_saturate(test_amplitude(-12.0) * M_SQRT2 * sin(2.0 * M_PI * freqs_hz[f] * n / SAMPLE_RATE_HZ));
+        }
+        snprintf(name, sizeof(name), "%.0f Hz -12 dBFS:", freqs_hz[f]);
+        double snr = round_trip(name);
+        TEST_CHECK(snr > ((freqs_hz[f] < 2000.0) ? 25.0 : 15.0), "%.0f Hz: SNR %.1f dB", freqs_hz[f], snr);
+    }
+
+    /* Noise shaped like speech, most of its energy at low frequencies */
+    double lp = 0.0;
+    for (uint32_t n = 0; n < SAMPLES; n++)
+    {
+        lp = 0.9 * lp + 0.1 * test_gauss();
+        input[n] = test_saturate(test_amplitude(-20.0) * 4.4 * lp);
+    }
+    TEST_CHECK(round_trip("low-pass noise:") > 15.0, "noise SNR too low");
+
+    for (uint32_t n = 0; n < SAMPLES; n++)
+    {
+        input[n] = ((n / 40u) & 1u) ? INT16_MAX : INT16_MIN;
+    }
+    (void)round_trip("full scale square:");
+    int32_t peak = 0;
+    for (uint32_t n = SAMPLE_RATE_HZ; n < SAMPLES; n++)
+    {
+        peak = (abs(output[n]) > peak) ? abs(output[n]) : peak;
+    }
+    TEST_CHECK(peak >= 32000, "square wave peak %d after decoding", peak);
+}
+
+/*******************************************************************************
+* Function Name: test_throughput
+********************************************************************************
+* Summary:
+*  Reports the encoder throughput on the host.
+*
+*******************************************************************************/
+static void test_throughput(void)
+{
+    const uint32_t rounds = 50u;
+    audio_adpcm_state_t state;
+    struct timespec t0, t1;
+
+    audio_adpcm_init(&state);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        audio_adpcm_encode(&state, input, SAMPLES, encoded);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    printf("encoder: %.1f Msamples/s on the host\n", rounds * SAMPLES / seconds * 1e-6);
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the IMA-ADPCM encoder.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    test_golden();
+    test_round_trip();
+    test_throughput();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+/******************************************************************************
+* File Name:   test_arq.c
+*
+* Description: This file contains the host test of the upload
+* retransmission: the window follows the datagram size of the session,
+* NACKed datagrams come back unchanged but for the retransmit flag, and the
+* window stays consistent across the wrap of the sequence numbers.
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "audio_arq.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static uint8_t sent[AUDIO_ARQ_MAX_DATAGRAM];
+static uint32_t sent_size;
+static uint32_t sent_count;
+
+/*******************************************************************************
+* Function Name: capture_send
+********************************************************************************
+* Summary:
+*  Keeps the last datagram sent by the retransmission, see audio_arq_send_t.
+*
+*******************************************************************************/
+static bool capture_send(const uint8_t *datagram, uint32_t size)
+{
+    memcpy(sent, datagram, size);
+    sent_size = size;
+    sent_count++;
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: store_datagram
+********************************************************************************
+* Summary:
+*  Builds the datagram of a sequence number, its payload filled from the
+*  sequence number, and stores it.
+*
+*******************************************************************************/
+static void store_datagram(audio_arq_t *arq, uint16_t seq, uint32_t payload_size)
+{
+    uint8_t datagram[AUDIO_ARQ_MAX_DATAGRAM];
+    audio_packet_header_t header = { 0u, 0u, arq->session, seq, 0u };
+
+    memset(&datagram[AUDIO_PACKET_HEADER_SIZE], (int)(seq & 0xFFu), payload_size);
+    uint32_t size = audio_packet_encode(&header, datagram, payload_size);
+    audio_arq_store(arq, datagram, size, 0u);
+}
+
+/*******************************************************************************
+* Function Name: nack
+********************************************************************************
+* Summary:
+*  Passes the NACK of a single sequence number to the retransmission and
+*  returns whether that datagram was sent again, intact.
+*
+*******************************************************************************/
+static bool nack(audio_arq_t *arq, uint16_t seq)
+{
+    uint8_t datagram[AUDIO_PACKET_HEADER_SIZE + 1u];
+    audio_packet_header_t header = { 0u, AUDIO_PACKET_FLAG_NACK, arq->session, seq, 0u };
+    audio_packet_header_t resent;
+    const uint8_t *payload;
+    uint32_t payload_size;
+
+    datagram[AUDIO_PACKET_HEADER_SIZE] = 0x01u;
+    uint32_t size = audio_packet_encode(&header, datagram, 1u);
+
+    sent_count = 0;
+    audio_arq_feedback(arq, datagram, size, 0u, capture_send);
+    if (sent_count == 0u)
+    {
+        return false;
+    }
+
+    return audio_packet_decode(sent, sent_size, &resent, &payload, &payload_size) &&
+           (resent.seq == seq) && ((resent.flags & AUDIO_PACKET_FLAG_RETRANSMIT) != 0u) &&
+           (payload_size > 0u) && (payload[payload_size - 1u] == (uint8_t)(seq & 0xFFu));
+}
+
+/*******************************************************************************
+* Function Name: test_window_size
+********************************************************************************
+* Summary:
+*  The window holds as many datagrams as fit the buffer at the chunk size of
+*  the session: the oldest datagram in it is resent, the one before is not.
+*
+*******************************************************************************/
+static void test_window_size(void)
+{
+    static const uint32_t chunks[] = { 64u, 512u, 1024u, AUDIO_PACKET_MAX_PAYLOAD };
+    static audio_arq_t arq;
+
+    for (uint32_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++)
+    {
+        uint32_t datagram = AUDIO_PACKET_HEADER_SIZE + chunks[c];
+        uint32_t window = AUDIO_ARQ_BUFFER_SIZE / datagram;
+        window = (window > AUDIO_ARQ_MAX_WINDOW) ? AUDIO_ARQ_MAX_WINDOW : window;
+
+        audio_arq_begin(&arq, (uint16_t)(c + 1u), datagram);
+        for (uint32_t seq = 0; seq < 3u * window; seq++)
+        {
+            store_datagram(&arq, (uint16_t)seq, chunks[c]);
+        }
+
+        printf("chunk %4u bytes: window %u datagrams\n", chunks[c], arq.window);
+        TEST_CHECK(arq.window == window, "chunk %u: window %u, expected %u", chunks[c], arq.window, window);
+        TEST_CHECK(nack(&arq, (uint16_t)(3u * window - 1u)), "chunk %u: newest datagram not resent", chunks[c]);
+        TEST_CHECK(nack(&arq, (uint16_t)(2u * window)), "chunk %u: oldest datagram not resent", chunks[c]);
+        TEST_CHECK(!nack(&arq, (uint16_t)(2u * window - 1u)), "chunk %u: replaced datagram resent", chunks[c]);
+        TEST_CHECK(arq.unavailable == 1u, "chunk %u: %u unavailable", chunks[c], arq.unavailable);
+    }
+}
+
+/*******************************************************************************
+* Function Name: test_oversized
+********************************************************************************
+* Summary:
+*  A datagram larger than the session's largest takes its sequence number
+*  without being kept, the others keep their place.
+*
+*******************************************************************************/
+static void test_oversized(void)
+{
+    static audio_arq_t arq;
+
+    audio_arq_begin(&arq, 1u, AUDIO_PACKET_HEADER_SIZE + 512u);
+    store_datagram(&arq, 0u, 512u);
+    store_datagram(&arq, 1u, 1024u);
+    store_datagram(&arq, 2u, 512u);
+
+    TEST_CHECK(nack(&arq, 0u) && nack(&arq, 2u), "datagrams around the oversized one not resent");
+    TEST_CHECK(!nack(&arq, 1u), "oversized datagram resent");
+}
+
+/*******************************************************************************
+* Function Name: test_sequence_wrap
+********************************************************************************
+* Summary:
+*  Datagrams on both sides of the wrap of the 16-bit sequence numbers are
+*  found, with a window that does not divide 2^16.
+*
+*******************************************************************************/
+static void test_sequence_wrap(void)
+{
+    static audio_arq_t arq;
+
+    audio_arq_begin(&arq, 1u, AUDIO_PACKET_HEADER_SIZE + 1024u);
+    TEST_CHECK((65536u % arq.window) != 0u, "window %u divides 2^16", arq.window);
+
+    for (uint32_t seq = 0; seq < 65536u + 10u; seq++)
+    {
+        store_datagram(&arq, (uint16_t)seq, 1024u);
+    }
+
+    TEST_CHECK(nack(&arq, 65530u), "datagram before the wrap not resent");
+    TEST_CHECK(nack(&arq, 9u), "datagram after the wrap not resent");
+    TEST_CHECK(!nack(&arq, (uint16_t)(10u - arq.window - 1u)), "datagram beyond the window resent");
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the retransmission.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    test_window_size();
+    test_oversized();
+    test_sequence_wrap();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
@@ -0,0 +1,318 @@
+/******************************************************************************
+* File Name:   test_beam.c
+*
+* Description: This file contains the host test of the two-microphone front
+* end. The test is built with the SIMD kernels on, through the host
+* intrinsics of cmsis_compiler.h. Golden vectors, computed offline from the
+* definition in audio_beam.c, check the beamformer steered to either side;
+* the SIMD deinterleave and beamformer are compared bit for bit with their
+* references. Simulated plane waves check the steering: a source in the
+* steering direction passes unchanged, one from the other side is
+* attenuated as the delay-and-sum response predicts, and uncorrelated noise
+* loses 3 dB against the source.
+*
+*******************************************************************************/
+
+#include <string.h>
+#include <time.h>
+
+#include "audio_beam.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define SAMPLE_RATE_HZ                      (16000u)
+/* A 10 ms frame at 16 kHz */
+#define FRAME_SAMPLES                       (160u)
+#define SAMPLES                             (2u * SAMPLE_RATE_HZ)
+#define GOLDEN_SAMPLES                      (32u)
+/* Delay of the unsteered channel, AUDIO_BEAM_FD_CENTER of audio_beam.c */
+#define FD_CENTER                           (3u)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* Beamformer outputs of left[n] = (n * 7919) % 20001 - 10000 and
+ * right[n] = (n * 104729) % 30001 - 15000 from an empty history, steered by
+ * +11/8 sample (left delayed) and -20/8 sample (right delayed) */
+static const int16_t golden_left[GOLDEN_SAMPLES] =
+{
+    0, 159, -363, -6740, -3543, 3273, 2645, 5945, -2936, 12068, -906, 7902, -1829, 3431, 3678, 5704,
+    -488, 4781, -4959, 10289, -2686, 6123, -3609, 1652, 1899, 3925, -2267, 3002, -6738, 8509, -4465, 4343,
+};
+static const int16_t golden_right[GOLDEN_SAMPLES] =
+{
+    0, 0, 227, -5575, 85, -1238, -9509, 7316, 7050, 2480, 5848, -330, 3492, 7314, 1136, 4958,
+    -1220, 2602, 6425, 246, 4069, -2110, 1713, 5535, -643, 3179, -2999, 823, 4645, -1533, 2289, -3889,
+};
+
+static int16_t left[SAMPLES];
+static int16_t right[SAMPLES];
+static int16_t output[SAMPLES];
+static int16_t output_ref[SAMPLES];
+
+/*******************************************************************************
+* Function Name: beamform
+********************************************************************************
+* Summary:
+*  Runs the beamformer over the two channels in blocks with the SIMD or the
+*  reference kernel.
+*
+*******************************************************************************/
+static void beamform(int32_t delay, uint32_t count, uint32_t block, bool ref, int16_t *out)
+{
+    static audio_beam_t beam;
+
+    audio_beam_init(&beam, delay);
+    for (uint32_t n = 0; n < count; n += block)
+    {
+        if (ref)
+        {
+            audio_beam_process_ref(&beam, &left[n], &right[n], block, &out[n]);
+        }
+        else
+        {
+            audio_beam_process(&beam, &left[n], &right[n], block, &out[n]);
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: test_golden
+********************************************************************************
+* Summary:
+*  Both kernels give the golden outputs, whatever the block size.
+*
+*******************************************************************************/
+static void test_golden(void)
+{
+    static const uint32_t blocks[] = { 1u, 3u, 32u };
+
+    for (uint32_t n = 0; n < GOLDEN_SAMPLES; n++)
+    {
+        left[n] = (int16_t)((int32_t)((n * 7919u) % 20001u) - 10000);
+        right[n] = (int16_t)((int32_t)((n * 104729u) % 30001u) - 15000);
+    }
+
+    for (uint32_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++)
+    {
+        beamform(11, GOLDEN_SAMPLES, blocks[b], false, output);
+        beamform(11, GOLDEN_SAMPLES, blocks[b], true, output_ref);
+        TEST_CHECK((memcmp(output, golden_left, sizeof(golden_left)) == 0) &&
+                   (memcmp(output_ref, golden_left, sizeof(golden_left)) == 0),
+                   "blocks of %u: left steered output differs from the golden vector", blocks[b]);
+
+        beamform(-20, GOLDEN_SAMPLES, blocks[b], false, output);
+        beamform(-20, GOLDEN_SAMPLES, blocks[b], true, output_ref);
+        TEST_CHECK((memcmp(output, golden_right, sizeof(golden_right)) == 0) &&
+                   (memcmp(output_ref, golden_right, sizeof(golden_right)) == 0),
+                   "blocks of %u: right steered output differs from the golden vector", blocks[b]);
+    }
+}
+
+/*******************************************************************************
+* Function Name: test_simd_exact
+********************************************************************************
+* Summary:
+*  The SIMD deinterleave and beamformer give the results of the references
+*  on full scale noise, for every steering delay.
+*
+*******************************************************************************/
+static void test_simd_exact(void)
+{
+    static int16_t stereo[2u * SAMPLES];
+    static int16_t left_ref[SAMPLES];
+    static int16_t right_ref[SAMPLES];
+    const int32_t max_delay = (int32_t)(AUDIO_BEAM_MAX_DELAY * AUDIO_BEAM_FD_PHASES);
+    uint32_t mismatches = 0;
+
+    for (uint32_t n = 0; n < 2u * SAMPLES; n++)
+    {
+        stereo[n] = test_saturate(20000.0 * test_gauss());
+    }
+
+    /* An odd count leaves one frame to the tail of the SIMD loop */
+    audio_beam_deinterleave(stereo, left, right, SAMPLES - 1u);
+    audio_beam_deinterleave_ref(stereo, left_ref, right_ref, SAMPLES - 1u);
+    TEST_CHECK((memcmp(left, left_ref, (SAMPLES - 1u) * sizeof(int16_t)) == 0) &&
+               (memcmp(right, right_ref, (SAMPLES - 1u) * sizeof(int16_t)) == 0),
+               "SIMD deinterleave differs from the reference");
+
+    for (int32_t delay = -max_delay; delay <= max_delay; delay++)
+    {
+        beamform(delay, SAMPLES / 4u, FRAME_SAMPLES, false, output);
+        beamform(delay, SAMPLES / 4u, FRAME_SAMPLES, true, output_ref);
+        mismatches += (memcmp(output, output_ref, (SAMPLES / 4u) * sizeof(int16_t)) != 0) ? 1u : 0u;
+    }
+
+    TEST_CHECK(AUDIO_DSP_USE_SIMD == 1, "built without the SIMD kernels");
+    TEST_CHECK(mismatches == 0u, "SIMD beamformer differs from the reference for %u delays", mismatches);
+}
+
+/*******************************************************************************
+* Function Name: plane_wave
+********************************************************************************
+* Summary:
+*  Fills the channels with a tone reaching the left microphone lead samples
+*  before the right one (negative: right first), plus uncorrelated noise.
+*
+*******************************************************************************/
+static void plane_wave(double freq_hz, double lead, double noise_rms)
+{
+    const double w = 2.0 * M_PI * freq_hz / SAMPLE_RATE_HZ;
+
+    for (uint32_t n = 0; n < SAMPLES; n++)
+    {
+        left[n] = test_saturate(8000.0 * sin(w * n) + noise_rms * test_gauss());
+        right[n] = test_saturate(8000.0 * sin(w * (n - lead)) + noise_rms * test_gauss());
+    }
+}
+
+/*******************************************************************************
+* Function Name: output_gain_db
+********************************************************************************
+* Summary:
+*  Returns the power of the output in dB relative to the tone of one
+*  microphone, over the second half of the signal.
+*
+*******************************************************************************/
+static double output_gain_db(void)
+{
+    double power = 0.0;
+
+    for (uint32_t n = SAMPLES / 2u; n < SAMPLES; n++)
+    {
+        power += (double)output[n] * output[n];
+    }
+    power /= SAMPLES / 2u;
+    return 10.0 * log10(power / (8000.0 * 8000.0 / 2.0));
+}
+
+/*******************************************************************************
+* Function Name: test_steering
+********************************************************************************
+* Summary:
+*  Steered by 11/8 sample to the left, the beamformer passes a source on
+*  the left unchanged and attenuates the same source on the right by the
+*  delay-and-sum response |cos(w * 2 * lead / 2)|. The output is the left
+*  channel delayed by FD_CENTER plus the steering delay.
+*
+*******************************************************************************/
+static void test_steering(void)
+{
+    static const double freqs_hz[] = { 500.0, 1500.0, 2500.0, 3500.0 };
+    const int32_t delay = 11;
+    const double lead = (double)delay / AUDIO_BEAM_FD_PHASES;
+
+    for (uint32_t f = 0; f < sizeof(freqs_hz) / sizeof(freqs_hz[0]); f++)
+    {
+        const double w = 2.0 * M_PI * freqs_hz[f] / SAMPLE_RATE_HZ;
+
+        plane_wave(freqs_hz[f], lead, 0.0);
+        beamform(delay, SAMPLES, FRAME_SAMPLES, false, output);
+        double on = output_gain_db();
+
+        /* The output is the left channel delayed by FD_CENTER + lead */
+        double error = 0.0;
+        for (uint32_t n = SAMPLES / 2u; n < SAMPLES; n++)
+        {
+            double expected = 8000.0 * sin(w * (n - FD_CENTER - lead));
+            error += (output[n] - expected) * (output[n] - expected);
+        }
+        double error_db = 10.0 * log10(error / (SAMPLES / 2u) / (8000.0 * 8000.0 / 2.0));
+
+        plane_wave(freqs_hz[f], -lead, 0.0);
+        beamform(delay, SAMPLES, FRAME_SAMPLES, false, output);
+        double off = output_gain_db();
+        double expected_off = 20.0 * log10(fabs(cos(w * lead)));
+
+        printf("%4.0f Hz: on-axis %+.2f dB (error %.1f dB), opposite %+.2f dB, expected %+.2f dB\n",
+               freqs_hz[f], on, error_db, off, expected_off);
+        TEST_CHECK(fabs(on) < 0.2, "%.0f Hz: on-axis gain %.2f dB", freqs_hz[f], on);
+        TEST_CHECK(error_db < -30.0, "%.0f Hz: on-axis output off the delayed source by %.1f dB",
+                   freqs_hz[f], error_db);
+        TEST_CHECK(fabs(off - expected_off) < 0.3, "%.0f Hz: opposite gain %.2f dB, expected %.2f dB",
+                   freqs_hz[f], off, expected_off);
+    }
+}
+
+/*******************************************************************************
+* Function Name: test_diffuse_noise
+********************************************************************************
+* Summary:
+*  Uncorrelated noise of the two microphones is averaged down by 3 dB.
+*
+*******************************************************************************/
+static void test_diffuse_noise(void)
+{
+    double in = 0.0;
+    double out = 0.0;
+
+    for (uint32_t n = 0; n < SAMPLES; n++)
+    {
+        left[n] = test_saturate(3000.0 * test_gauss());
+        right[n] = test_saturate(3000.0 * test_gauss());
+    }
+    beamform(11, SAMPLES, FRAME_SAMPLES, false, output);
+
+    for (uint32_t n = SAMPLES / 2u; n < SAMPLES; n++)
+    {
+        in += (double)left[n] * left[n];
+        out += (double)output[n] * output[n];
+    }
+    double gain = 10.0 * log10(out / in);
+
+    printf("uncorrelated noise: %+.2f dB\n", gain);
+    TEST_CHECK(fabs(gain + 3.0) < 0.3, "uncorrelated noise gain %.2f dB", gain);
+}
+
+/*******************************************************************************
+* Function Name: test_throughput
+********************************************************************************
+* Summary:
+*  Reports the throughput of the deinterleave and the fractional steering.
+*
+*******************************************************************************/
+static void test_throughput(void)
+{
+    static int16_t stereo[2u * SAMPLES];
+    const uint32_t rounds = 50u;
+    struct timespec t0, t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        for (uint32_t n = 0; n < SAMPLES; n += FRAME_SAMPLES)
+        {
+            audio_beam_deinterleave(&stereo[2u * n], &left[n], &right[n], FRAME_SAMPLES);
+        }
+        beamform(11, SAMPLES, FRAME_SAMPLES, false, output);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    printf("front end: %.1f Mframes/s on the host\n", rounds * SAMPLES / seconds * 1e-6);
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the two-microphone front end.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    test_golden();
+    test_simd_exact();
+    test_steering();
+    test_diffuse_noise();
+    test_throughput();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
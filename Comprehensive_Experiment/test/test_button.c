@@ -0,0 +1,223 @@
+/******************************************************************************
+* File Name:   test_button.c
+*
+* Description: This file contains the host test of the button debounce. The
+* test drives the state machine the way button.c does, on every edge of a
+* simulated pin and on the expiry of the timer it asks for, and checks the
+* events of bouncing presses, short glitches and long presses, also across
+* the wrap of the millisecond counter.
+*
+*******************************************************************************/
+
+#include "button_fsm.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define MAX_EDGES                           (64u)
+/* Contact bounce of the simulated button */
+#define BOUNCE_EDGES                        (6u)
+#define BOUNCE_PERIOD_MS                    (2u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+/* Level changes of the simulated pin, relative to the start */
+typedef struct
+{
+    uint32_t count;
+    uint32_t time_ms[MAX_EDGES];
+    bool pressed[MAX_EDGES];
+} pin_t;
+
+/* Events seen by the driver and when */
+typedef struct
+{
+    uint32_t presses;
+    uint32_t releases;
+    uint32_t long_presses;
+    uint32_t press_ms;
+    uint32_t release_ms;
+    uint32_t long_press_ms;
+    uint32_t held_ms;
+} events_t;
+
+/*******************************************************************************
+* Function Name: pin_edge
+********************************************************************************
+* Summary:
+*  Adds a level change at a time; a bouncing change first toggles
+*  BOUNCE_EDGES times.
+*
+*******************************************************************************/
+static void pin_edge(pin_t *pin, uint32_t time_ms, bool pressed, bool bounce)
+{
+    uint32_t bounces = bounce ? BOUNCE_EDGES : 0u;
+
+    for (uint32_t i = 0; i <= bounces; i++)
+    {
+        pin->time_ms[pin->count] = time_ms + i * BOUNCE_PERIOD_MS;
+        pin->pressed[pin->count] = (((bounces - i) % 2u) == 0u) ? pressed : !pressed;
+        pin->count++;
+    }
+}
+
+/*******************************************************************************
+* Function Name: run
+********************************************************************************
+* Summary:
+*  Feeds the edges of the pin to the state machine, calling it also when
+*  its timer expires, until end_ms. Times are reported relative to start_ms.
+*
+*******************************************************************************/
+static events_t run(const pin_t *pin, uint32_t start_ms, uint32_t end_ms)
+{
+    button_fsm_t fsm;
+    events_t seen = { 0 };
+    uint32_t now = 0;
+    uint32_t edge = 0;
+    bool level = false;
+
+    button_fsm_init(&fsm, start_ms);
+
+    while (now < end_ms)
+    {
+        uint32_t timeout = button_fsm_next_timeout(&fsm, start_ms + now);
+        uint32_t timer_ms = (timeout == BUTTON_FSM_NO_TIMEOUT) ? end_ms : (now + timeout);
+        uint32_t edge_ms = (edge < pin->count) ? pin->time_ms[edge] : end_ms;
+
+        if (edge_ms <= timer_ms)
+        {
+            now = edge_ms;
+            if (edge < pin->count)
+            {
+                level = pin->pressed[edge++];
+            }
+        }
+        else
+        {
+            now = timer_ms;
+        }
+
+        uint32_t events = button_fsm_update(&fsm, level, start_ms + now);
+        if (events & BUTTON_EVT_PRESS)
+        {
+            seen.presses++;
+            seen.press_ms = now;
+        }
+        if (events & BUTTON_EVT_LONG_PRESS)
+        {
+            seen.long_presses++;
+            seen.long_press_ms = now;
+        }
+        if (events & BUTTON_EVT_RELEASE)
+        {
+            seen.releases++;
+            seen.release_ms = now;
+            seen.held_ms = fsm.held_ms;
+        }
+    }
+
+    return seen;
+}
+
+/*******************************************************************************
+* Function Name: test_bouncing_press
+********************************************************************************
+* Summary:
+*  A bouncing press and release give one press and one release, one
+*  debounce time after the contact settled, and the held time of the press.
+*
+*******************************************************************************/
+static void test_bouncing_press(uint32_t start_ms)
+{
+    pin_t pin = { 0 };
+    const uint32_t settle_ms = BOUNCE_EDGES * BOUNCE_PERIOD_MS;
+
+    pin_edge(&pin, 100u, true, true);
+    pin_edge(&pin, 400u, false, true);
+    events_t seen = run(&pin, start_ms, 1000u);
+
+    TEST_CHECK((seen.presses == 1u) && (seen.releases == 1u) && (seen.long_presses == 0u),
+               "start %u: %u presses, %u releases, %u long presses",
+               start_ms, seen.presses, seen.releases, seen.long_presses);
+    TEST_CHECK(seen.press_ms == 100u + settle_ms + BUTTON_DEBOUNCE_MS,
+               "start %u: press at %u ms", start_ms, seen.press_ms);
+    TEST_CHECK(seen.release_ms == 400u + settle_ms + BUTTON_DEBOUNCE_MS,
+               "start %u: release at %u ms", start_ms, seen.release_ms);
+    TEST_CHECK(seen.held_ms == 300u, "start %u: held %u ms", start_ms, seen.held_ms);
+}
+
+/*******************************************************************************
+* Function Name: test_glitches
+********************************************************************************
+* Summary:
+*  Pulses shorter than the debounce time are ignored, while released as
+*  well as while pressed.
+*
+*******************************************************************************/
+static void test_glitches(void)
+{
+    pin_t pin = { 0 };
+
+    pin_edge(&pin, 100u, true, false);
+    pin_edge(&pin, 100u + BUTTON_DEBOUNCE_MS - 1u, false, false);
+    events_t seen = run(&pin, 0u, 1000u);
+    TEST_CHECK((seen.presses == 0u) && (seen.releases == 0u), "short press: %u presses, %u releases",
+               seen.presses, seen.releases);
+
+    pin.count = 0;
+    pin_edge(&pin, 100u, true, false);
+    pin_edge(&pin, 300u, false, false);
+    pin_edge(&pin, 300u + BUTTON_DEBOUNCE_MS / 2u, true, false);
+    pin_edge(&pin, 600u, false, false);
+    seen = run(&pin, 0u, 1000u);
+    TEST_CHECK((seen.presses == 1u) && (seen.releases == 1u), "release glitch: %u presses, %u releases",
+               seen.presses, seen.releases);
+    TEST_CHECK(seen.held_ms == 500u, "release glitch: held %u ms", seen.held_ms);
+}
+
+/*******************************************************************************
+* Function Name: test_long_press
+********************************************************************************
+* Summary:
+*  Holding the button reports the long press once, BUTTON_LONG_PRESS_MS
+*  after the press started, without waiting for an edge.
+*
+*******************************************************************************/
+static void test_long_press(void)
+{
+    pin_t pin = { 0 };
+
+    pin_edge(&pin, 100u, true, false);
+    pin_edge(&pin, 100u + 3u * BUTTON_LONG_PRESS_MS, false, false);
+    events_t seen = run(&pin, 0u, 5000u);
+
+    TEST_CHECK((seen.presses == 1u) && (seen.long_presses == 1u) && (seen.releases == 1u),
+               "%u presses, %u long presses, %u releases", seen.presses, seen.long_presses, seen.releases);
+    TEST_CHECK(seen.long_press_ms == 100u + BUTTON_LONG_PRESS_MS, "long press at %u ms", seen.long_press_ms);
+    TEST_CHECK(seen.held_ms == 3u * BUTTON_LONG_PRESS_MS, "held %u ms", seen.held_ms);
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the button debounce.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    test_bouncing_press(0u);
+    /* The millisecond counter wraps during the press */
+    test_bouncing_press(UINT32_MAX - 200u);
+    test_glitches();
+    test_long_press();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
@@ -0,0 +1,325 @@
+/******************************************************************************
+* File Name:   test_chunk.c
+*
+* Description: This file contains the host test of the assembly of the
+* upload datagrams. PCM chunks carry the audio unchanged at the offsets of
+* their first samples; ADPCM chunks start with the encoder state and hold
+* the codes of one continuous encoding, so every datagram decodes on its
+* own. A recording of speech and pauses streamed on a virtual clock checks
+* that no audio waits longer than the hold time for its datagram.
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "audio_chunk.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define FRAME_MS                            (10u)
+#define FRAME_SAMPLES                       (160u)
+#define CHUNK_SIZE                          (1456u)
+#define MAX_HOLD_MS                         (100u)
+#define SIGNAL_SAMPLES                      (48000u)
+#define MAX_CHUNKS                          (256u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    uint32_t offset;
+    uint32_t len;
+    uint32_t first_ms;
+    uint32_t sent_ms;
+    uint8_t data[CHUNK_SIZE];
+} sent_chunk_t;
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static audio_chunk_t chunk;
+static uint8_t buffer[CHUNK_SIZE];
+static int16_t signal[SIGNAL_SAMPLES];
+static sent_chunk_t sent[MAX_CHUNKS];
+static uint32_t sent_count;
+
+/*******************************************************************************
+* Function Name: send
+********************************************************************************
+* Summary:
+*  Keeps the chunk as the upload sends it, and empties it.
+*
+*******************************************************************************/
+static void send(uint32_t now_ms)
+{
+    if (sent_count < MAX_CHUNKS)
+    {
+        sent[sent_count].offset = chunk.offset;
+        sent[sent_count].len = chunk.len;
+        sent[sent_count].first_ms = chunk.first_ms;
+        sent[sent_count].sent_ms = now_ms;
+        memcpy(sent[sent_count].data, chunk.data, chunk.len);
+    }
+    sent_count++;
+    chunk.len = 0;
+}
+
+/*******************************************************************************
+* Function Name: add
+********************************************************************************
+* Summary:
+*  Adds audio the way send_audio_data_to_server does, sending every chunk
+*  that fills.
+*
+*******************************************************************************/
+static void add(const int16_t *samples, uint32_t count, uint32_t now_ms)
+{
+    const uint8_t *audio = (const uint8_t *)samples;
+    uint32_t size = count * sizeof(int16_t);
+
+    while (size > 0u)
+    {
+        uint32_t added = audio_chunk_add(&chunk, audio, size, now_ms);
+        audio += added;
+        size -= added;
+        if (audio_chunk_full(&chunk))
+        {
+            send(now_ms);
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: test_pcm
+********************************************************************************
+* Summary:
+*  PCM frames fill chunks of the chunk size, whatever the frame size; the
+*  chunks hold the audio unchanged, each at the offset of its first sample,
+*  and the samples of the upload are counted.
+*
+*******************************************************************************/
+static void test_pcm(void)
+{
+    static uint8_t received[SIGNAL_SAMPLES * sizeof(int16_t)];
+    uint32_t failures = 0;
+
+    for (uint32_t n = 0; n < SIGNAL_SAMPLES; n++)
+    {
+        signal[n] = test_saturate(test_gauss() * 3000.0);
+    }
+
+    audio_chunk_begin(&chunk, buffer, 1024u, false);
+    sent_count = 0;
+    for (uint32_t n = 0; n < SIGNAL_SAMPLES; n += 300u)
+    {
+        add(&signal[n], (SIGNAL_SAMPLES - n < 300u) ? SIGNAL_SAMPLES - n : 300u, 0u);
+    }
+    if (chunk.len > 0u)
+    {
+        send(0u);
+    }
+
+    memset(received, 0, sizeof(received));
+    for (uint32_t c = 0; c < sent_count; c++)
+    {
+        failures += (sent[c].offset == c * 512u) ? 0u : 1u;
+        failures += ((c + 1u == sent_count) || (sent[c].len == 1024u)) ? 0u : 1u;
+        memcpy(&received[sent[c].offset * sizeof(int16_t)], sent[c].data, sent[c].len);
+    }
+
+    TEST_CHECK(sent_count == (SIGNAL_SAMPLES * 2u + 1023u) / 1024u, "%u PCM chunks", sent_count);
+    TEST_CHECK(failures == 0u, "%u PCM chunks at the wrong offset or size", failures);
+    TEST_CHECK(memcmp(received, signal, sizeof(received)) == 0, "PCM audio changed");
+    TEST_CHECK(chunk.total_samples == SIGNAL_SAMPLES, "%u samples counted", chunk.total_samples);
+}
+
+/*******************************************************************************
+* Function Name: test_adpcm
+********************************************************************************
+* Summary:
+*  ADPCM chunks hold 2 samples per byte behind the encoder header. The
+*  header of each chunk is the state of one continuous encoding at its
+*  offset and the codes are those of the continuous encoding, so each
+*  datagram decodes on its own to the audio of an unbroken stream.
+*
+*******************************************************************************/
+static void test_adpcm(void)
+{
+    const uint32_t chunk_samples = AUDIO_ADPCM_SAMPLES_IN_BYTES(CHUNK_SIZE - AUDIO_ADPCM_HEADER_SIZE);
+    audio_adpcm_state_t reference;
+    uint8_t expected[CHUNK_SIZE];
+    uint32_t failures = 0;
+
+    for (uint32_t n = 0; n < SIGNAL_SAMPLES; n++)
+    {
+        signal[n] = (int16_t)lround(8000.0 * sin(2.0 * M_PI * 440.0 * n / 16000.0)) +
+                    test_saturate(test_gauss() * 500.0);
+    }
+
+    audio_chunk_begin(&chunk, buffer, CHUNK_SIZE, true);
+    sent_count = 0;
+    for (uint32_t n = 0; n < SIGNAL_SAMPLES; n += FRAME_SAMPLES)
+    {
+        add(&signal[n], FRAME_SAMPLES, 0u);
+    }
+    if (chunk.len > 0u)
+    {
+        send(0u);
+    }
+
+    audio_adpcm_init(&reference);
+    for (uint32_t c = 0; c < sent_count; c++)
+    {
+        uint32_t count = (SIGNAL_SAMPLES - sent[c].offset < chunk_samples) ? SIGNAL_SAMPLES - sent[c].offset :
+                         chunk_samples;
+        uint32_t header_size = audio_adpcm_write_header(&reference, expected);
+        audio_adpcm_encode(&reference, &signal[sent[c].offset], count, &expected[header_size]);
+
+        failures += (sent[c].offset == c * chunk_samples) ? 0u : 1u;
+        failures += (sent[c].len == header_size + count / 2u) ? 0u : 1u;
+        failures += (memcmp(sent[c].data, expected, header_size + count / 2u) == 0) ? 0u : 1u;
+    }
+
+    TEST_CHECK(sent_count == (SIGNAL_SAMPLES + chunk_samples - 1u) / chunk_samples, "%u ADPCM chunks", sent_count);
+    TEST_CHECK(failures == 0u, "%u ADPCM chunks differ from the continuous encoding", failures);
+    TEST_CHECK(chunk.total_samples == SIGNAL_SAMPLES, "%u samples counted", chunk.total_samples);
+}
+
+/*******************************************************************************
+* Function Name: test_held
+********************************************************************************
+* Summary:
+*  An empty chunk is never held, nor any chunk with a hold time of 0. A
+*  chunk is held from the hold time after its first audio, also across a
+*  wrap of the millisecond clock, and a new chunk starts a new hold.
+*
+*******************************************************************************/
+static void test_held(void)
+{
+    int16_t frame[FRAME_SAMPLES] = { 0 };
+    const uint32_t start_ms = 0xFFFFFFC0u;
+
+    audio_chunk_begin(&chunk, buffer, CHUNK_SIZE, true);
+    TEST_CHECK(!audio_chunk_held(&chunk, MAX_HOLD_MS, 1000u), "empty chunk held");
+    /* A byte short of a sample is dropped without opening a chunk */
+    TEST_CHECK((audio_chunk_add(&chunk, (const uint8_t *)frame, 1u, 0u) == 1u) && (chunk.len == 0u),
+               "odd byte opened a chunk");
+
+    add(frame, FRAME_SAMPLES, start_ms);
+    add(frame, FRAME_SAMPLES, start_ms + 50u);
+    TEST_CHECK(!audio_chunk_held(&chunk, MAX_HOLD_MS, start_ms + MAX_HOLD_MS - 1u), "chunk held early");
+    TEST_CHECK(audio_chunk_held(&chunk, MAX_HOLD_MS, start_ms + MAX_HOLD_MS), "chunk not held across the wrap");
+    TEST_CHECK(!audio_chunk_held(&chunk, 0u, start_ms + 10000u), "chunk held without a hold time");
+
+    send(start_ms + MAX_HOLD_MS);
+    add(frame, FRAME_SAMPLES, start_ms + 150u);
+    TEST_CHECK((chunk.offset == 2u * FRAME_SAMPLES) && !audio_chunk_held(&chunk, MAX_HOLD_MS, start_ms + 200u),
+               "new chunk at offset %u keeps the old hold", chunk.offset);
+}
+
+/*******************************************************************************
+* Function Name: stream
+********************************************************************************
+* Summary:
+*  Streams a recording of speech segments and pauses on a virtual clock of
+*  10 ms frames, like record_process: speech frames are added as captured
+*  and the hold is checked on every frame. Returns the longest wait of
+*  audio for its datagram in milliseconds, with the number of datagrams.
+*
+*******************************************************************************/
+static uint32_t stream(uint32_t max_hold_ms, uint32_t *datagrams)
+{
+    static const uint32_t segments_ms[] = { 730u, 420u, 1260u, 350u, 90u, 600u, 1540u, 800u };
+    int16_t frame[FRAME_SAMPLES];
+    uint32_t longest_ms = 0;
+    uint32_t now_ms = 5u;
+    uint32_t samples = 0;
+
+    audio_chunk_begin(&chunk, buffer, CHUNK_SIZE, true);
+    sent_count = 0;
+
+    /* Even entries are speech, odd ones pauses; the upload ends after the
+     * last pause */
+    for (uint32_t s = 0; s < sizeof(segments_ms) / sizeof(segments_ms[0]); s++)
+    {
+        for (uint32_t t = 0; t < segments_ms[s]; t += FRAME_MS, now_ms += FRAME_MS)
+        {
+            if ((s % 2u) == 0u)
+            {
+                for (uint32_t n = 0; n < FRAME_SAMPLES; n++)
+                {
+                    frame[n] = test_saturate(test_gauss() * 3000.0);
+                }
+                add(frame, FRAME_SAMPLES, now_ms);
+                samples += FRAME_SAMPLES;
+            }
+            if (audio_chunk_held(&chunk, max_hold_ms, now_ms))
+            {
+                send(now_ms);
+            }
+        }
+    }
+    if (chunk.len > 0u)
+    {
+        send(now_ms);
+    }
+
+    /* The first audio of a chunk waits longest */
+    for (uint32_t c = 0; (c < sent_count) && (c < MAX_CHUNKS); c++)
+    {
+        uint32_t wait_ms = sent[c].sent_ms - sent[c].first_ms;
+        longest_ms = (wait_ms > longest_ms) ? wait_ms : longest_ms;
+    }
+
+    *datagrams = sent_count;
+    TEST_CHECK(chunk.total_samples == samples, "%u of %u samples", chunk.total_samples, samples);
+    return longest_ms;
+}
+
+/*******************************************************************************
+* Function Name: test_stream
+********************************************************************************
+* Summary:
+*  Without a hold time the chunk in progress at a pause waits through the
+*  pause; with AUDIO_UPLOAD_MAX_HOLD_MS no audio waits longer than it, at
+*  the cost of more datagrams.
+*
+*******************************************************************************/
+static void test_stream(void)
+{
+    uint32_t full_datagrams;
+    uint32_t held_datagrams;
+
+    uint32_t full_ms = stream(0u, &full_datagrams);
+    uint32_t held_ms = stream(MAX_HOLD_MS, &held_datagrams);
+
+    printf("full chunks: longest wait %u ms, %u datagrams\n", full_ms, full_datagrams);
+    printf("%u ms hold: longest wait %u ms, %u datagrams\n", MAX_HOLD_MS, held_ms, held_datagrams);
+    TEST_CHECK(full_ms > 4u * MAX_HOLD_MS, "full chunks wait %u ms", full_ms);
+    TEST_CHECK(held_ms <= MAX_HOLD_MS, "audio waits %u ms with the hold", held_ms);
+    TEST_CHECK(held_datagrams <= 3u * full_datagrams, "%u datagrams with the hold", held_datagrams);
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the datagram assembly.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    test_pcm();
+    test_adpcm();
+    test_held();
+    test_stream();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
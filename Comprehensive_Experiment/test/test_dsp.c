@@ -0,0 +1,305 @@
+/******************************************************************************
+* File Name:   test_dsp.c
+*
+* Description: This file contains the host test of the conditioning chain.
+* The test is built with the SIMD kernels on, through the host intrinsics of
+* cmsis_compiler.h, and checks them bit for bit against the reference
+* kernels. It then checks the DC blocker, the pre-emphasis response and the
+* AGC against their definitions and reports the throughput of the chain.
+*
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_dsp.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define SAMPLE_RATE_HZ                      (16000u)
+/* A 10 ms frame at 16 kHz */
+#define FRAME_SAMPLES                       (160u)
+#define SECONDS                             (4u)
+#define SAMPLES                             (SECONDS * SAMPLE_RATE_HZ)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static int16_t input[SAMPLES];
+static int16_t simd[SAMPLES];
+static int16_t ref[SAMPLES];
+
+/*******************************************************************************
+* Function Name: make_tone
+********************************************************************************
+* Summary:
+*  Fills the input with a tone of a peak amplitude on a DC offset.
+*
+*******************************************************************************/
+static void make_tone(double freq_hz, double peak, double dc)
+{
+    for (uint32_t n = 0; n < SAMPLES; n++)
+    {
+        input[n] = test_saturate(dc + peak * sin(2.0 * M_PI * freq_hz * n / SAMPLE_RATE_HZ));
+    }
+}
+
+/*******************************************************************************
+* Function Name: tone_gain
+********************************************************************************
+* Summary:
+*  Returns the gain of a tone from the input to an output, measured as the
+*  RMS ratio over the last second.
+*
+*******************************************************************************/
+static double tone_gain(const int16_t *output, double in_dc)
+{
+    double in = 0.0;
+    double out = 0.0;
+
+    for (uint32_t n = SAMPLES - SAMPLE_RATE_HZ; n < SAMPLES; n++)
+    {
+        in += (input[n] - in_dc) * (input[n] - in_dc);
+        out += (double)output[n] * output[n];
+    }
+    return sqrt(out / in);
+}
+
+/*******************************************************************************
+* Function Name: test_simd_exact
+********************************************************************************
+* Summary:
+*  The SIMD pre-emphasis and gain give the samples of the reference kernels,
+*  with saturation, odd frame lengths and the state carried across frames.
+*
+*******************************************************************************/
+static void test_simd_exact(void)
+{
+    static const int16_t gains[] = { 1, 1024, AUDIO_DSP_GAIN_ONE_Q12, 4097, 20000, INT16_MAX };
+    static const uint32_t lengths[] = { 1u, 2u, 7u, 160u, 161u };
+    uint32_t mismatches = 0;
+
+    for (uint32_t n = 0; n < SAMPLES; n++)
+    {
+        /* Full scale noise with runs of the extreme values */
+        input[n] = ((n / 64u) % 5u == 0u) ? (((n & 1u) != 0u) ? INT16_MIN : INT16_MAX)
+                                         : test_saturate(12000.0 * test_gauss());
+    }
+
+    for (uint32_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+    {
+        audio_dsp_preemph_t pe_simd;
+        audio_dsp_preemph_t pe_ref;
+
+        audio_dsp_preemph_init(&pe_simd, AUDIO_DSP_PREEMPH_COEF_Q15);
+        audio_dsp_preemph_init(&pe_ref, AUDIO_DSP_PREEMPH_COEF_Q15);
+        memcpy(simd, input, sizeof(input));
+        memcpy(ref, input, sizeof(input));
+
+        for (uint32_t n = 0; (n + lengths[l]) <= SAMPLES; n += lengths[l])
+        {
+            audio_dsp_preemph_q15(&pe_simd, &simd[n], lengths[l]);
+            audio_dsp_preemph_q15_ref(&pe_ref, &ref[n], lengths[l]);
+        }
+        mismatches += (memcmp(simd, ref, sizeof(simd)) != 0) ? 1u : 0u;
+
+        for (uint32_t g = 0; g < sizeof(gains) / sizeof(gains[0]); g++)
+        {
+            memcpy(simd, input, sizeof(input));
+            memcpy(ref, input, sizeof(input));
+            for (uint32_t n = 0; (n + lengths[l]) <= SAMPLES; n += lengths[l])
+            {
+                audio_dsp_gain_q15(&simd[n], lengths[l], gains[g]);
+                audio_dsp_gain_q15_ref(&ref[n], lengths[l], gains[g]);
+            }
+            mismatches += (memcmp(simd, ref, sizeof(simd)) != 0) ? 1u : 0u;
+        }
+    }
+
+    TEST_CHECK(AUDIO_DSP_USE_SIMD == 1, "built without the SIMD kernels");
+    TEST_CHECK(mismatches == 0u, "%u SIMD runs differ from the reference", mismatches);
+}
+
+/*******************************************************************************
+* Function Name: test_dc_block
+********************************************************************************
+* Summary:
+*  The DC blocker removes an offset and passes a 1 kHz tone unchanged.
+*
+*******************************************************************************/
+static void test_dc_block(void)
+{
+    audio_dsp_dc_t dc;
+    double mean = 0.0;
+
+    make_tone(1000.0, 8000.0, 6000.0);
+    memcpy(simd, input, sizeof(input));
+    audio_dsp_dc_init(&dc, AUDIO_DSP_DC_POLE_Q15);
+    for (uint32_t n = 0; n < SAMPLES; n += FRAME_SAMPLES)
+    {
+        audio_dsp_dc_block_q15(&dc, &simd[n], FRAME_SAMPLES);
+    }
+
+    for (uint32_t n = SAMPLES - SAMPLE_RATE_HZ; n < SAMPLES; n++)
+    {
+        mean += simd[n];
+    }
+    mean /= SAMPLE_RATE_HZ;
+    double gain = tone_gain(simd, 6000.0);
+
+    printf("DC blocker: offset 6000 -> %.1f, 1 kHz gain %.4f\n", mean, gain);
+    TEST_CHECK(fabs(mean) < 2.0, "offset %.1f left", mean);
+    TEST_CHECK(fabs(gain - 1.0) < 0.01, "1 kHz gain %.4f", gain);
+}
+
+/*******************************************************************************
+* Function Name: test_preemph
+********************************************************************************
+* Summary:
+*  The pre-emphasis has the magnitude response |1 - coef * e^-jw|.
+*
+*******************************************************************************/
+static void test_preemph(void)
+{
+    static const double freqs_hz[] = { 100.0, 1000.0, 4000.0, 7000.0 };
+    const double coef = AUDIO_DSP_PREEMPH_COEF_Q15 / 32768.0;
+
+    for (uint32_t f = 0; f < sizeof(freqs_hz) / sizeof(freqs_hz[0]); f++)
+    {
+        audio_dsp_preemph_t pe;
+        double w = 2.0 * M_PI * freqs_hz[f] / SAMPLE_RATE_HZ;
+        double expected = sqrt(1.0 - 2.0 * coef * cos(w) + coef * coef);
+
+        make_tone(freqs_hz[f], 10000.0, 0.0);
+        memcpy(simd, input, sizeof(input));
+        audio_dsp_preemph_init(&pe, AUDIO_DSP_PREEMPH_COEF_Q15);
+        audio_dsp_preemph_q15(&pe, simd, SAMPLES);
+
+        double gain = tone_gain(simd, 0.0);
+        printf("pre-emphasis %4.0f Hz: gain %.4f, expected %.4f\n", freqs_hz[f], gain, expected);
+        TEST_CHECK(fabs(gain - expected) < 0.002 + 0.002 * expected, "%.0f Hz: gain %.4f, expected %.4f",
+                   freqs_hz[f], gain, expected);
+    }
+}
+
+/*******************************************************************************
+* Function Name: agc_run
+********************************************************************************
+* Summary:
+*  Runs the AGC over the input frame by frame and returns the peak of the
+*  last frame.
+*
+*******************************************************************************/
+static int32_t agc_run(audio_dsp_agc_t *agc)
+{
+    int32_t peak = 0;
+
+    memcpy(simd, input, sizeof(input));
+    for (uint32_t n = 0; n < SAMPLES; n += FRAME_SAMPLES)
+    {
+        audio_dsp_agc_process(agc, &simd[n], FRAME_SAMPLES);
+    }
+    for (uint32_t n = SAMPLES - FRAME_SAMPLES; n < SAMPLES; n++)
+    {
+        peak = (abs(simd[n]) > peak) ? abs(simd[n]) : peak;
+    }
+    return peak;
+}
+
+/*******************************************************************************
+* Function Name: test_agc
+********************************************************************************
+* Summary:
+*  The AGC brings a quiet and a loud tone to the target peak, stops at its
+*  highest gain and leaves frames below the noise gate at the current gain.
+*
+*******************************************************************************/
+static void test_agc(void)
+{
+    audio_dsp_agc_t agc;
+    int32_t peak;
+
+    make_tone(500.0, 4000.0, 0.0);
+    audio_dsp_agc_init(&agc, AUDIO_DSP_AGC_TARGET_PEAK, AUDIO_DSP_AGC_MAX_GAIN_Q12);
+    peak = agc_run(&agc);
+    printf("AGC: peak 4000 -> %d, gain %.3f\n", peak, agc.gain_q12 / 4096.0);
+    TEST_CHECK(abs(peak - AUDIO_DSP_AGC_TARGET_PEAK) < AUDIO_DSP_AGC_TARGET_PEAK / 50, "quiet tone peak %d", peak);
+
+    make_tone(500.0, 30000.0, 0.0);
+    audio_dsp_agc_init(&agc, AUDIO_DSP_AGC_TARGET_PEAK, AUDIO_DSP_AGC_MAX_GAIN_Q12);
+    peak = agc_run(&agc);
+    printf("AGC: peak 30000 -> %d, gain %.3f\n", peak, agc.gain_q12 / 4096.0);
+    TEST_CHECK(abs(peak - AUDIO_DSP_AGC_TARGET_PEAK) < AUDIO_DSP_AGC_TARGET_PEAK / 50, "loud tone peak %d", peak);
+
+    make_tone(500.0, 400.0, 0.0);
+    audio_dsp_agc_init(&agc, AUDIO_DSP_AGC_TARGET_PEAK, AUDIO_DSP_AGC_MAX_GAIN_Q12);
+    (void)agc_run(&agc);
+    TEST_CHECK(agc.gain_q12 >= AUDIO_DSP_AGC_MAX_GAIN_Q12 - 64, "gain %d short of the highest gain", agc.gain_q12);
+
+    make_tone(500.0, AUDIO_DSP_AGC_NOISE_GATE / 2, 0.0);
+    int16_t gain = agc.gain_q12;
+    (void)agc_run(&agc);
+    TEST_CHECK(agc.gain_q12 == gain, "gain changed below the noise gate: %d to %d", gain, agc.gain_q12);
+}
+
+/*******************************************************************************
+* Function Name: test_throughput
+********************************************************************************
+* Summary:
+*  Reports the throughput of the whole chain, frame by frame.
+*
+*******************************************************************************/
+static void test_throughput(void)
+{
+    static const audio_dsp_cfg_t cfg =
+    {
+        .dc_block = true, .preemph = true, .agc = true,
+        .dc_pole_q15 = AUDIO_DSP_DC_POLE_Q15, .preemph_coef_q15 = AUDIO_DSP_PREEMPH_COEF_Q15,
+        .agc_target_peak = AUDIO_DSP_AGC_TARGET_PEAK, .agc_max_gain_q12 = AUDIO_DSP_AGC_MAX_GAIN_Q12,
+    };
+    const uint32_t rounds = 50u;
+    audio_dsp_chain_t chain;
+    struct timespec t0, t1;
+
+    make_tone(300.0, 3000.0, 200.0);
+    audio_dsp_chain_init(&chain, &cfg);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        memcpy(simd, input, sizeof(input));
+        for (uint32_t n = 0; n < SAMPLES; n += FRAME_SAMPLES)
+        {
+            audio_dsp_chain_process(&chain, &simd[n], FRAME_SAMPLES);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    printf("chain: %.1f Msamples/s on the host\n", rounds * SAMPLES / seconds * 1e-6);
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the conditioning chain.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    test_simd_exact();
+    test_dc_block();
+    test_preemph();
+    test_agc();
+    test_throughput();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
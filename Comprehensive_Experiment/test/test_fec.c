@@ -0,0 +1,549 @@
+/******************************************************************************
+* File Name:   test_fec.c
+*
+* Description: This file contains the host test of the forward error
+* correction of the upload. The test decodes the parity datagrams the way
+* the UDP server does (python/udp.py, recover): the lost symbols of a block
+* are solved from the parities received, over GF(256) with the Cauchy
+* coefficients of audio_fec.h. Every pattern of up to K lost datagrams of a
+* block, data or parity, is recovered exactly, header fields included. A
+* burst loss channel measures the residual loss of the upload with and
+* without FEC, and the encode cost is reported on the host.
+*
+*******************************************************************************/
+
+#include <string.h>
+#include <time.h>
+
+#include "audio_fec.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define GF_POLYNOMIAL                       (0x11Du)
+/* Datagrams of the simulated uploads */
+#define UPLOAD_DATAGRAMS                    (32000u)
+#define CHUNK_SIZE                          (1024u)
+/* Gilbert-Elliott channel: losses in the bad state, switching chances */
+#define CHANNEL_BAD_LOSS                    (0.5)
+#define CHANNEL_GOOD_TO_BAD                 (0.01)
+#define CHANNEL_BAD_TO_GOOD                 (0.4)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+/* A datagram as sent */
+typedef struct
+{
+    uint8_t  bytes[AUDIO_FEC_MAX_DATAGRAM];
+    uint32_t size;
+} sent_t;
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static uint8_t gf_exp[512];
+static uint8_t gf_log[256];
+static audio_fec_t fec;
+static sent_t data[AUDIO_FEC_MAX_DATA];
+static sent_t parity[AUDIO_FEC_MAX_PARITY];
+/* Seed of the channel, apart from the payloads so that every code sees the
+ * same losses */
+static uint32_t channel_seed;
+
+/*******************************************************************************
+* Function Name: gf_init, gf_mul, gf_inv
+********************************************************************************
+* Summary:
+*  GF(256) arithmetic with exponent and logarithm tables, as in the server.
+*
+*******************************************************************************/
+static void gf_init(void)
+{
+    uint32_t x = 1u;
+
+    for (uint32_t i = 0; i < 255u; i++)
+    {
+        gf_exp[i] = (uint8_t)x;
+        gf_exp[i + 255u] = (uint8_t)x;
+        gf_log[x] = (uint8_t)i;
+        x <<= 1;
+        x ^= ((x & 0x100u) != 0u) ? GF_POLYNOMIAL : 0u;
+    }
+}
+
+static uint8_t gf_mul(uint8_t a, uint8_t b)
+{
+    return ((a == 0u) || (b == 0u)) ? 0u : gf_exp[gf_log[a] + gf_log[b]];
+}
+
+static uint8_t gf_inv(uint8_t a)
+{
+    return gf_exp[255u - gf_log[a]];
+}
+
+/*******************************************************************************
+* Function Name: channel_uniform
+********************************************************************************
+* Summary:
+*  Returns a uniform random number in (0, 1) for the loss channel.
+*
+*******************************************************************************/
+static double channel_uniform(void)
+{
+    channel_seed = channel_seed * 1664525u + 1013904223u;
+    return ((channel_seed >> 8) + 0.5) / 16777216.0;
+}
+
+/*******************************************************************************
+* Function Name: coefficient
+********************************************************************************
+* Summary:
+*  Coefficient of data datagram i in parity j: a Cauchy matrix with its
+*  columns scaled so that the first row is all ones.
+*
+*******************************************************************************/
+static uint8_t coefficient(uint32_t j, uint32_t i)
+{
+    return gf_mul(gf_inv((uint8_t)((255u - j) ^ i)), (uint8_t)(255u ^ i));
+}
+
+/*******************************************************************************
+* Function Name: symbol_of
+********************************************************************************
+* Summary:
+*  Writes the symbol of a data datagram, zero padded to length: payload
+*  size, flags without RETRANSMIT, offset and payload.
+*
+*******************************************************************************/
+static void symbol_of(const sent_t *dg, uint8_t *symbol, uint32_t length)
+{
+    uint32_t payload_size = dg->size - AUDIO_PACKET_HEADER_SIZE;
+
+    memset(symbol, 0, length);
+    symbol[0] = (uint8_t)(payload_size & 0xFFu);
+    symbol[1] = (uint8_t)(payload_size >> 8);
+    symbol[2] = dg->bytes[3] & (uint8_t)~AUDIO_PACKET_FLAG_RETRANSMIT;
+    memcpy(&symbol[3], &dg->bytes[8], 4u);
+    memcpy(&symbol[AUDIO_FEC_SYMBOL_PREFIX], &dg->bytes[AUDIO_PACKET_HEADER_SIZE], payload_size);
+}
+
+/*******************************************************************************
+* Function Name: send_block
+********************************************************************************
+* Summary:
+*  Encodes count datagrams with random payloads of 1 to CHUNK_SIZE bytes
+*  (the last one an end datagram if end is set) into data[], feeds them to
+*  the FEC and collects the parities into parity[]. Returns true if the
+*  FEC closed the block on the last datagram.
+*
+*******************************************************************************/
+static bool send_block(uint16_t first_seq, uint32_t count, bool end)
+{
+    bool closed = false;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        audio_packet_header_t header =
+        {
+            1u, ((i + 1u) == count && end) ? AUDIO_PACKET_FLAG_END : 0u, 0x5A5Au,
+            (uint16_t)(first_seq + i), (uint32_t)(test_uniform() * 4294967296.0)
+        };
+        uint32_t payload_size = 1u + (uint32_t)(test_uniform() * CHUNK_SIZE);
+
+        for (uint32_t b = 0; b < payload_size; b++)
+        {
+            data[i].bytes[AUDIO_PACKET_HEADER_SIZE + b] = (uint8_t)(test_uniform() * 256.0);
+        }
+        data[i].size = audio_packet_encode(&header, data[i].bytes, payload_size);
+        closed = audio_fec_add(&fec, &header, &data[i].bytes[AUDIO_PACKET_HEADER_SIZE], payload_size);
+        TEST_CHECK(!closed || ((i + 1u) == count), "block closed after %u of %u datagrams", i + 1u, count);
+    }
+
+    for (uint32_t j = 0; closed && (j < fec.parities); j++)
+    {
+        parity[j].size = audio_fec_parity(&fec, j, parity[j].bytes);
+    }
+    return closed;
+}
+
+/*******************************************************************************
+* Function Name: recover
+********************************************************************************
+* Summary:
+*  Rebuilds the lost data datagrams of the block from the ones received and
+*  the parities received, like the server: the received symbols are
+*  removed from each parity and the lost ones solved by Gauss-Jordan
+*  elimination. The rebuilt datagrams are encoded again with the sequence
+*  number of their position. Returns false if the block cannot be
+*  recovered or a datagram comes out different from the one sent.
+*
+*******************************************************************************/
+static bool recover(const bool *data_lost, const bool *parity_lost)
+{
+    static uint8_t rhs[AUDIO_FEC_MAX_PARITY][AUDIO_FEC_MAX_SYMBOL];
+    static uint8_t symbol[AUDIO_FEC_MAX_SYMBOL];
+    static uint8_t rebuilt[AUDIO_FEC_MAX_DATAGRAM];
+    uint8_t rows[AUDIO_FEC_MAX_PARITY][AUDIO_FEC_MAX_PARITY];
+    uint32_t lost[AUDIO_FEC_MAX_DATA];
+    uint32_t num_lost = 0;
+    uint32_t num_rows = 0;
+    uint32_t count = 0;
+    uint32_t length = 0;
+    uint16_t first_seq = 0;
+
+    for (uint32_t j = 0; j < fec.parities; j++)
+    {
+        audio_packet_header_t header;
+        const uint8_t *payload;
+        uint32_t payload_size;
+
+        if (parity_lost[j])
+        {
+            continue;
+        }
+        if (!audio_packet_decode(parity[j].bytes, parity[j].size, &header, &payload, &payload_size) ||
+            ((header.flags & AUDIO_PACKET_FLAG_PARITY) == 0u) || ((header.offset & 0xFFu) != j) ||
+            (((header.offset >> 16) & 0xFFu) != fec.parities))
+        {
+            return false;
+        }
+        count = (header.offset >> 8) & 0xFFu;
+        length = payload_size;
+        first_seq = header.seq;
+        memcpy(rhs[num_rows], payload, payload_size);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (data_lost[i])
+            {
+                continue;
+            }
+            symbol_of(&data[i], symbol, length);
+            for (uint32_t b = 0; b < length; b++)
+            {
+                rhs[num_rows][b] ^= gf_mul(coefficient(j, i), symbol[b]);
+            }
+        }
+        num_rows++;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (data_lost[i])
+        {
+            lost[num_lost++] = i;
+        }
+    }
+    if (num_lost > num_rows)
+    {
+        return false;
+    }
+
+    /* Parities received, in order, as the equations of the lost symbols */
+    for (uint32_t r = 0, j = 0; r < num_lost; j++)
+    {
+        if (!parity_lost[j])
+        {
+            for (uint32_t c = 0; c < num_lost; c++)
+            {
+                rows[r][c] = coefficient(j, lost[c]);
+            }
+            r++;
+        }
+    }
+
+    for (uint32_t col = 0; col < num_lost; col++)
+    {
+        uint8_t inv = gf_inv(rows[col][col]);
+
+        for (uint32_t c = 0; c < num_lost; c++)
+        {
+            rows[col][c] = gf_mul(rows[col][c], inv);
+        }
+        for (uint32_t b = 0; b < length; b++)
+        {
+            rhs[col][b] = gf_mul(rhs[col][b], inv);
+        }
+        for (uint32_t r = 0; r < num_lost; r++)
+        {
+            uint8_t factor = rows[r][col];
+            if ((r == col) || (factor == 0u))
+            {
+                continue;
+            }
+            for (uint32_t c = 0; c < num_lost; c++)
+            {
+                rows[r][c] ^= gf_mul(factor, rows[col][c]);
+            }
+            for (uint32_t b = 0; b < length; b++)
+            {
+                rhs[r][b] ^= gf_mul(factor, rhs[col][b]);
+            }
+        }
+    }
+
+    for (uint32_t k = 0; k < num_lost; k++)
+    {
+        const uint8_t *s = rhs[k];
+        audio_packet_header_t header =
+        {
+            1u, s[2], 0x5A5Au, (uint16_t)(first_seq + lost[k]),
+            (uint32_t)s[3] | ((uint32_t)s[4] << 8) | ((uint32_t)s[5] << 16) | ((uint32_t)s[6] << 24)
+        };
+        uint32_t payload_size = (uint32_t)s[0] | ((uint32_t)s[1] << 8);
+
+        if (payload_size + AUDIO_FEC_SYMBOL_PREFIX > length)
+        {
+            return false;
+        }
+        memcpy(&rebuilt[AUDIO_PACKET_HEADER_SIZE], &s[AUDIO_FEC_SYMBOL_PREFIX], payload_size);
+        uint32_t size = audio_packet_encode(&header, rebuilt, payload_size);
+        if ((size != data[lost[k]].size) || (memcmp(rebuilt, data[lost[k]].bytes, size) != 0))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: test_xor
+********************************************************************************
+* Summary:
+*  With K = 1 the parity is the XOR of the zero padded symbols, and the
+*  parity header carries the block's first sequence number and layout.
+*
+*******************************************************************************/
+static void test_xor(void)
+{
+    static uint8_t expected[AUDIO_FEC_MAX_SYMBOL];
+    static uint8_t symbol[AUDIO_FEC_MAX_SYMBOL];
+    audio_packet_header_t header;
+    const uint8_t *payload;
+    uint32_t payload_size;
+
+    TEST_CHECK(audio_fec_init(&fec, 5u, 1u), "N 5 K 1 refused");
+    audio_fec_begin(&fec, 1u, 0x5A5Au);
+    TEST_CHECK(send_block(100u, 5u, false), "block of 5 not closed");
+
+    TEST_CHECK(audio_packet_decode(parity[0].bytes, parity[0].size, &header, &payload, &payload_size),
+               "parity datagram invalid");
+    memset(expected, 0, sizeof(expected));
+    for (uint32_t i = 0; i < 5u; i++)
+    {
+        symbol_of(&data[i], symbol, payload_size);
+        for (uint32_t b = 0; b < payload_size; b++)
+        {
+            expected[b] ^= symbol[b];
+        }
+    }
+    TEST_CHECK(memcmp(payload, expected, payload_size) == 0, "K 1 parity is not the XOR of the block");
+    TEST_CHECK((header.flags == AUDIO_PACKET_FLAG_PARITY) && (header.seq == 100u) && (header.codec == 1u) &&
+               (header.session == 0x5A5Au) && (header.offset == ((1u << 16) | (5u << 8) | 0u)),
+               "parity header: flags 0x%02X seq %u offset 0x%06X", header.flags, header.seq, header.offset);
+}
+
+/*******************************************************************************
+* Function Name: test_recovery
+********************************************************************************
+* Summary:
+*  For the codes up to N 16 and K 4, every pattern of at most K lost
+*  datagrams of a block, data or parity, is recovered exactly. A short
+*  block closed by the end datagram recovers too.
+*
+*******************************************************************************/
+static void test_recovery(void)
+{
+    static const uint32_t codes[][2] = { { 4u, 1u }, { 4u, 2u }, { 8u, 2u }, { 6u, 3u }, { 16u, 4u } };
+    uint32_t patterns = 0;
+    uint32_t failures = 0;
+
+    for (uint32_t c = 0; c < sizeof(codes) / sizeof(codes[0]); c++)
+    {
+        uint32_t n = codes[c][0];
+        uint32_t k = codes[c][1];
+        uint32_t total = n + k;
+
+        TEST_CHECK(audio_fec_init(&fec, n, k), "N %u K %u refused", n, k);
+        audio_fec_begin(&fec, 1u, 0x5A5Au);
+
+        for (uint32_t block = 0; block < 2u; block++)
+        {
+            /* The second block is cut short by the end datagram */
+            uint32_t count = (block == 0u) ? n : (n / 2u);
+            TEST_CHECK(send_block((uint16_t)(65530u + block * n), count, block == 1u),
+                       "N %u K %u: block %u not closed", n, k, block);
+
+            /* Every subset of the datagrams of the block, at most K lost */
+            for (uint32_t mask = 0; mask < (1u << total); mask++)
+            {
+                bool data_lost[AUDIO_FEC_MAX_DATA] = { false };
+                bool parity_lost[AUDIO_FEC_MAX_PARITY] = { false };
+
+                if (((uint32_t)__builtin_popcount(mask) > k) || ((mask & ((1u << n) - 1u)) >> count) != 0u)
+                {
+                    continue;
+                }
+                for (uint32_t i = 0; i < n; i++)
+                {
+                    data_lost[i] = ((mask >> i) & 1u) != 0u;
+                }
+                for (uint32_t j = 0; j < k; j++)
+                {
+                    parity_lost[j] = ((mask >> (n + j)) & 1u) != 0u;
+                }
+                patterns++;
+                failures += recover(data_lost, parity_lost) ? 0u : 1u;
+            }
+        }
+    }
+
+    printf("recovery: %u loss patterns of at most K datagrams\n", patterns);
+    TEST_CHECK(failures == 0u, "%u of %u loss patterns not recovered", failures, patterns);
+
+    TEST_CHECK(!audio_fec_init(&fec, 0u, 1u) && !audio_fec_init(&fec, AUDIO_FEC_MAX_DATA + 1u, 1u) &&
+               !audio_fec_init(&fec, 4u, 0u) && !audio_fec_init(&fec, 4u, AUDIO_FEC_MAX_PARITY + 1u),
+               "invalid code accepted");
+}
+
+/*******************************************************************************
+* Function Name: test_burst_loss
+********************************************************************************
+* Summary:
+*  Sends uploads over a Gilbert-Elliott burst loss channel and reports the
+*  datagrams lost without FEC and left lost after recovery. At the same
+*  25 % overhead every code removes more than half of the loss, and the
+*  longer blocks of N 16 K 4, which span the bursts, more than 80 %.
+*
+*******************************************************************************/
+static void test_burst_loss(void)
+{
+    static const uint32_t codes[][2] = { { 4u, 1u }, { 8u, 2u }, { 16u, 4u } };
+    double residual[3];
+    double raw[3];
+
+    for (uint32_t c = 0; c < sizeof(codes) / sizeof(codes[0]); c++)
+    {
+        uint32_t n = codes[c][0];
+        uint32_t k = codes[c][1];
+        uint32_t lost_raw = 0;
+        uint32_t lost_left = 0;
+        bool bad = false;
+
+        (void)audio_fec_init(&fec, n, k);
+        audio_fec_begin(&fec, 1u, 0x5A5Au);
+        channel_seed = 12345u;
+
+        for (uint32_t sent = 0; sent < UPLOAD_DATAGRAMS; sent += n)
+        {
+            bool data_lost[AUDIO_FEC_MAX_DATA];
+            bool parity_lost[AUDIO_FEC_MAX_PARITY];
+            uint32_t block_lost = 0;
+
+            (void)send_block((uint16_t)sent, n, false);
+            for (uint32_t i = 0; i < n + k; i++)
+            {
+                bad = bad ? (channel_uniform() >= CHANNEL_BAD_TO_GOOD) : (channel_uniform() < CHANNEL_GOOD_TO_BAD);
+                bool lost = bad && (channel_uniform() < CHANNEL_BAD_LOSS);
+
+                if (i < n)
+                {
+                    data_lost[i] = lost;
+                    block_lost += lost ? 1u : 0u;
+                }
+                else
+                {
+                    parity_lost[i - n] = lost;
+                }
+            }
+            lost_raw += block_lost;
+            if ((block_lost > 0u) && !recover(data_lost, parity_lost))
+            {
+                lost_left += block_lost;
+            }
+        }
+
+        raw[c] = 100.0 * lost_raw / UPLOAD_DATAGRAMS;
+        residual[c] = 100.0 * lost_left / UPLOAD_DATAGRAMS;
+        printf("burst loss N %2u K %u: %.2f %% of the datagrams lost, %.2f %% left after recovery\n",
+               n, k, raw[c], residual[c]);
+    }
+
+    for (uint32_t c = 0; c < sizeof(codes) / sizeof(codes[0]); c++)
+    {
+        TEST_CHECK(residual[c] < raw[c] / 2.0, "N %u K %u leaves %.2f %% of %.2f %% lost",
+                   codes[c][0], codes[c][1], residual[c], raw[c]);
+    }
+    TEST_CHECK(residual[2] < raw[2] / 5.0, "N 16 K 4 leaves %.2f %% of %.2f %% lost", residual[2], raw[2]);
+}
+
+/*******************************************************************************
+* Function Name: test_throughput
+********************************************************************************
+* Summary:
+*  Reports the encode cost per 1 KB datagram of the XOR and the
+*  Reed-Solomon codes on the host.
+*
+*******************************************************************************/
+static void test_throughput(void)
+{
+    static const uint32_t codes[][2] = { { 8u, 1u }, { 8u, 2u }, { 8u, 4u } };
+    static uint8_t payload[CHUNK_SIZE];
+    const uint32_t rounds = 50000u;
+    struct timespec t0, t1;
+
+    for (uint32_t b = 0; b < CHUNK_SIZE; b++)
+    {
+        payload[b] = (uint8_t)(test_uniform() * 256.0);
+    }
+
+    for (uint32_t c = 0; c < sizeof(codes) / sizeof(codes[0]); c++)
+    {
+        audio_packet_header_t header = { 1u, 0u, 1u, 0u, 0u };
+
+        (void)audio_fec_init(&fec, codes[c][0], codes[c][1]);
+        audio_fec_begin(&fec, 1u, 1u);
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (uint32_t r = 0; r < rounds; r++)
+        {
+            header.seq = (uint16_t)r;
+            if (audio_fec_add(&fec, &header, payload, CHUNK_SIZE))
+            {
+                for (uint32_t j = 0; j < codes[c][1]; j++)
+                {
+                    (void)audio_fec_parity(&fec, j, parity[j].bytes);
+                }
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+        printf("encode N %u K %u: %.0f ns per 1 KB datagram on the host\n", codes[c][0], codes[c][1],
+               seconds / rounds * 1e9);
+    }
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the forward error correction.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    gf_init();
+
+    test_xor();
+    test_recovery();
+    test_burst_loss();
+    test_throughput();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+/******************************************************************************
+* File Name:   test_gain.c
+*
+* Description: This file contains the host level-trace test of the closed
+* loop of the hardware gain with the VAD. The chain follows the frame loop
+* of audio_task.c: statistics and noise floor of the raw frame, DC removal,
+* VAD, gain controller, and the noise estimates scaled once the frames at a
+* new gain arrive. The PDM/PCM block is modelled as applying a gain
+* AUDIO_GAIN_SETTLE_FRAMES frames after it is programmed.
+*
+* A quiet talker raises the gain; once the talker stops, the background,
+* now louder at the output, must not be taken for speech.
+*
+*******************************************************************************/
+
+#include <stdbool.h>
+
+#include "audio_dsp.h"
+#include "audio_gain.h"
+#include "audio_stats.h"
+#include "audio_vad.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define FRAME_SAMPLES                       (160u)
+#define SAMPLE_RATE_HZ                      (16000.0)
+#define FRAMES_PER_SECOND                   (100u)
+
+/* 2 s of noise, 3 s of a talker, 15 s of noise */
+#define TALK_START_FRAME                    (2u * FRAMES_PER_SECOND)
+#define TALK_END_FRAME                      (5u * FRAMES_PER_SECOND)
+#define TOTAL_FRAMES                        (20u * FRAMES_PER_SECOND)
+/* Pure noise frames checked, from the end of the hangover after the talker */
+#define CHECK_START_FRAME                   (TALK_END_FRAME + 40u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    uint32_t speech_frames;         /* Speech frames from CHECK_START_FRAME */
+    int16_t  final_gain;
+    double   vad_floor_error_db;    /* VAD noise floor against the true noise, as the talker stops */
+    double   floor_error_db;        /* Telemetry noise floor against the true noise, at the end */
+} trace_result_t;
+
+/*******************************************************************************
+* Function Name: run_trace
+********************************************************************************
+* Summary:
+*  Runs the level trace of a noise and talker level.
+*
+* Parameters:
+*  noise_dbfs: Noise level at 0 dB gain
+*  speech_dbfs: Talker level at 0 dB gain
+*  scale: Scale the noise estimates on gain changes, as audio_task.c does
+*  result: Outcome of the trace
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void run_trace(double noise_dbfs, double speech_dbfs, bool scale, trace_result_t *result)
+{
+    static const audio_dsp_cfg_t cfg =
+    {
+        .dc_block         = true,
+        .preemph          = false,
+        .agc              = false,
+        .dc_pole_q15      = AUDIO_DSP_DC_POLE_Q15,
+        .preemph_coef_q15 = AUDIO_DSP_PREEMPH_COEF_Q15,
+        .agc_target_peak  = AUDIO_DSP_AGC_TARGET_PEAK,
+        .agc_max_gain_q12 = AUDIO_DSP_AGC_MAX_GAIN_Q12,
+    };
+    audio_dsp_chain_t dsp;
+    audio_vad_t vad;
+    audio_gain_t ctrl;
+    audio_stats_frame_t stats;
+    audio_stats_noise_t noise;
+    int16_t frame[FRAME_SAMPLES];
+    int16_t hw_gain[AUDIO_GAIN_SETTLE_FRAMES + 1u];     /* hw_gain[0] is applied */
+    int16_t programmed = AUDIO_GAIN_DEFAULT;
+    uint32_t ratio_q16 = 0;
+    uint32_t ratio_frames = 0;
+    double phase = 0.0;
+
+    audio_dsp_chain_init(&dsp, &cfg);
+    audio_vad_init(&vad);
+    audio_gain_init(&ctrl, AUDIO_GAIN_DEFAULT, 10u);
+    audio_stats_noise_init(&noise);
+    for (uint32_t i = 0; i <= AUDIO_GAIN_SETTLE_FRAMES; i++)
+    {
+        hw_gain[i] = AUDIO_GAIN_DEFAULT;
+    }
+
+    result->speech_frames = 0;
+    for (uint32_t f = 0; f < TOTAL_FRAMES; f++)
+    {
+        /* Syllables of 200 ms with pauses of 100 ms */
+        bool talk = (f >= TALK_START_FRAME) && (f < TALK_END_FRAME) && ((f % 30u) < 20u);
+        double gain = pow(10.0, hw_gain[0] * 0.5 / 20.0);
+
+        for (uint32_t i = 0; i < FRAME_SAMPLES; i++)
+        {
+            double x = test_amplitude(noise_dbfs) * test_gauss();
+            if (talk)
+            {
+                x += test_amplitude(speech_dbfs) * sqrt(2.0) * sin(phase);
+                phase += 2.0 * M_PI * 200.0 / SAMPLE_RATE_HZ;
+            }
+            frame[i] = test_saturate(x * gain);
+        }
+
+        if (scale && (ratio_frames > 0u) && (--ratio_frames == 0u))
+        {
+            audio_vad_scale_noise(&vad, ratio_q16);
+            audio_stats_noise_scale(&noise, ratio_q16);
+        }
+
+        audio_stats_measure(frame, FRAME_SAMPLES, &stats);
+        audio_stats_noise_update(&noise, stats.power);
+        audio_dsp_chain_process(&dsp, frame, FRAME_SAMPLES);
+        bool speech = audio_vad_process(&vad, frame, FRAME_SAMPLES);
+
+        if (audio_gain_update(&ctrl, stats.rms, stats.peak, speech))
+        {
+            ratio_q16 = audio_gain_power_ratio_q16(programmed, ctrl.gain);
+            ratio_frames = AUDIO_GAIN_SETTLE_FRAMES + 1u;
+            programmed = ctrl.gain;
+        }
+
+        /* The programmed gain reaches the samples after the settling frames */
+        for (uint32_t i = 0; i < AUDIO_GAIN_SETTLE_FRAMES; i++)
+        {
+            hw_gain[i] = hw_gain[i + 1u];
+        }
+        hw_gain[AUDIO_GAIN_SETTLE_FRAMES] = programmed;
+
+        if (f == TALK_END_FRAME)
+        {
+            result->vad_floor_error_db = 10.0 * log10((double)vad.noise_energy) -
+                                         20.0 * log10(test_amplitude(noise_dbfs) * gain);
+        }
+        if ((f >= CHECK_START_FRAME) && speech)
+        {
+            result->speech_frames++;
+        }
+    }
+
+    result->final_gain = ctrl.gain;
+    result->floor_error_db = 10.0 * log10((double)noise.floor) -
+                             20.0 * log10(test_amplitude(noise_dbfs) * pow(10.0, hw_gain[0] * 0.5 / 20.0));
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the level traces of a quiet talker over several noise levels, with
+*  and without scaling the noise estimates.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    static const double noise_levels_dbfs[] = { -80.0, -74.0, -70.0 };
+    const uint32_t check_frames = TOTAL_FRAMES - CHECK_START_FRAME;
+
+    for (uint32_t n = 0; n < sizeof(noise_levels_dbfs) / sizeof(noise_levels_dbfs[0]); n++)
+    {
+        trace_result_t fixed;
+        trace_result_t scaled;
+
+        test_seed = 1u;
+        run_trace(noise_levels_dbfs[n], -50.0, false, &fixed);
+        test_seed = 1u;
+        run_trace(noise_levels_dbfs[n], -50.0, true, &scaled);
+
+        printf("noise %.0f dBFS: gain %+.1f dB, VAD floor %+.1f dB unscaled, %+.1f dB scaled, "
+               "noise frames speech %u/%u unscaled, %u/%u scaled\n", noise_levels_dbfs[n], scaled.final_gain * 0.5,
+               fixed.vad_floor_error_db, scaled.vad_floor_error_db,
+               fixed.speech_frames, check_frames, scaled.speech_frames, check_frames);
+
+        TEST_CHECK(scaled.speech_frames <= check_frames / 100u, "noise %.0f dBFS: %u of %u noise frames speech",
+                   noise_levels_dbfs[n], scaled.speech_frames, check_frames);
+        TEST_CHECK(fabs(scaled.vad_floor_error_db) < 3.0, "noise %.0f dBFS: VAD noise floor off by %.1f dB",
+                   noise_levels_dbfs[n], scaled.vad_floor_error_db);
+        TEST_CHECK(fabs(scaled.floor_error_db) < 3.0, "noise %.0f dBFS: noise floor off by %.1f dB",
+                   noise_levels_dbfs[n], scaled.floor_error_db);
+    }
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
@@ -0,0 +1,330 @@
+/******************************************************************************
+* File Name:   test_kws.c
+*
+* Description: This file contains the host test of the wake word network.
+* A DS-CNN of random int8 weights, shaped like the exported models, runs on
+* random features through audio_kws and through a plain reference of the
+* TensorFlow Lite int8 kernels written from their definition; the logits have
+* to match exactly.
+*
+* audio_kws.c is included so that the test reaches its network directly,
+* without the MFCC front end.
+*
+*******************************************************************************/
+
+#include <stdlib.h>
+
+#include "../source/audio_kws.c"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define CHANNELS                            (64)
+#define BLOCKS                              (4)
+#define LABELS                              (12)
+#define NUM_LAYERS                          (1 + 2 * BLOCKS + 2)
+
+/* Output of the first convolution, stride 2 over the 49 x 10 features */
+#define MAP_H                               (25)
+#define MAP_W                               (5)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static int8_t  conv_weights[CHANNELS * 10 * 4];
+static int8_t  dw_weights[BLOCKS][3 * 3 * CHANNELS];
+static int8_t  pw_weights[BLOCKS][CHANNELS * CHANNELS];
+static int8_t  fc_weights[LABELS * CHANNELS];
+static int32_t conv_bias[CHANNELS];
+static int32_t dw_bias[BLOCKS][CHANNELS];
+static int32_t pw_bias[BLOCKS][CHANNELS];
+static int32_t fc_bias[LABELS];
+static int32_t multipliers[CHANNELS];
+static int8_t  shifts[CHANNELS];
+static audio_kws_layer_t layers[NUM_LAYERS];
+
+const audio_kws_model_t audio_kws_model =
+{
+    .layers = layers,
+    .num_layers = NUM_LAYERS,
+    .input_multiplier = 1 << 30,
+    .input_shift = -4,
+    .input_zero_point = -10,
+    .output_zero_point = 4,
+    .output_scale = 0.1f,
+    .num_labels = LABELS,
+    .keyword_index = 2,
+    .keyword = "test",
+};
+
+static int8_t reference[2][MAP_H * MAP_W * CHANNELS * 2];
+
+/*******************************************************************************
+* Function Name: random_int8
+********************************************************************************
+* Summary:
+*  Returns a random weight or activation in [-127, 127].
+*
+*******************************************************************************/
+static int8_t random_int8(void)
+{
+    return (int8_t)((int32_t)(test_uniform() * 255.0) - 127);
+}
+
+/*******************************************************************************
+* Function Name: random_bias
+********************************************************************************
+* Summary:
+*  Returns a random bias in [-1000, 1000).
+*
+*******************************************************************************/
+static int32_t random_bias(void)
+{
+    return (int32_t)(test_uniform() * 2000.0) - 1000;
+}
+
+/*******************************************************************************
+* Function Name: build_model
+********************************************************************************
+* Summary:
+*  Fills the weights and describes the layers: a 10 x 4 stride 2
+*  convolution, BLOCKS depthwise separable blocks, the average pool and the
+*  fully connected classifier.
+*
+*******************************************************************************/
+static void build_model(void)
+{
+    uint32_t n = 0;
+
+    for (uint32_t c = 0; c < CHANNELS; c++)
+    {
+        multipliers[c] = 1500000000 + (int32_t)(test_uniform() * 500000000.0);
+        shifts[c] = (int8_t)(-8 - (int32_t)(test_uniform() * 3.0));
+        conv_bias[c] = random_bias();
+    }
+    for (uint32_t i = 0; i < sizeof(conv_weights); i++)
+    {
+        conv_weights[i] = random_int8();
+    }
+    for (uint32_t b = 0; b < BLOCKS; b++)
+    {
+        for (uint32_t i = 0; i < sizeof(dw_weights[b]); i++)
+        {
+            dw_weights[b][i] = random_int8();
+        }
+        for (uint32_t i = 0; i < sizeof(pw_weights[b]); i++)
+        {
+            pw_weights[b][i] = random_int8();
+        }
+        for (uint32_t c = 0; c < CHANNELS; c++)
+        {
+            dw_bias[b][c] = random_bias();
+            pw_bias[b][c] = random_bias();
+        }
+    }
+    for (uint32_t i = 0; i < sizeof(fc_weights); i++)
+    {
+        fc_weights[i] = random_int8();
+    }
+    for (uint32_t i = 0; i < LABELS; i++)
+    {
+        fc_bias[i] = random_bias();
+    }
+
+    layers[n++] = (audio_kws_layer_t){ AUDIO_KWS_LAYER_CONV, 49, 10, 1, MAP_H, MAP_W, CHANNELS, 10, 4, 2, 2, 4, 1,
+                                       5, -3, -3, 127, conv_weights, conv_bias, multipliers, shifts };
+    for (uint32_t b = 0; b < BLOCKS; b++)
+    {
+        layers[n++] = (audio_kws_layer_t){ AUDIO_KWS_LAYER_DEPTHWISE, MAP_H, MAP_W, CHANNELS, MAP_H, MAP_W, CHANNELS,
+                                           3, 3, 1, 1, 1, 1, 3, -2, -2, 127,
+                                           dw_weights[b], dw_bias[b], multipliers, shifts };
+        layers[n++] = (audio_kws_layer_t){ AUDIO_KWS_LAYER_CONV, MAP_H, MAP_W, CHANNELS, MAP_H, MAP_W, CHANNELS,
+                                           1, 1, 1, 1, 0, 0, 2, -1, -1, 127,
+                                           pw_weights[b], pw_bias[b], multipliers, shifts };
+    }
+    layers[n++] = (audio_kws_layer_t){ AUDIO_KWS_LAYER_AVG_POOL, MAP_H, MAP_W, CHANNELS, 1, 1, CHANNELS,
+                                       MAP_H, MAP_W, MAP_H, MAP_W, 0, 0, 0, 0, -128, 127,
+                                       NULL, NULL, NULL, NULL };
+    layers[n++] = (audio_kws_layer_t){ AUDIO_KWS_LAYER_FULLY_CONNECTED, 1, 1, CHANNELS, 1, 1, LABELS,
+                                       1, 1, 1, 1, 0, 0, 1, 4, -128, 127, fc_weights, fc_bias, multipliers, shifts };
+}
+
+/*******************************************************************************
+* Function Name: ref_requantize
+********************************************************************************
+* Summary:
+*  TensorFlow Lite MultiplyByQuantizedMultiplier: the saturating rounding
+*  doubling high multiply followed by the rounding division by a power of
+*  two, as gemmlowp defines them.
+*
+*******************************************************************************/
+static int32_t ref_requantize(int32_t value, int32_t multiplier, int32_t shift)
+{
+    int64_t a = (int64_t)value * (1 << ((shift > 0) ? shift : 0));
+    int64_t ab = a * multiplier;
+    int64_t nudge = (ab >= 0) ? (1 << 30) : (1 - (1 << 30));
+    int64_t v = ab + nudge;
+    int32_t high = (int32_t)((v >= 0) ? (v >> 31) : -((-v) >> 31));
+    int32_t exponent = (shift > 0) ? 0 : -shift;
+
+    if (exponent == 0)
+    {
+        return high;
+    }
+    int32_t mask = (1 << exponent) - 1;
+    int32_t remainder = high & mask;
+    int32_t threshold = (mask >> 1) + ((high < 0) ? 1 : 0);
+    return (high >> exponent) + ((remainder > threshold) ? 1 : 0);
+}
+
+/*******************************************************************************
+* Function Name: ref_clamp
+********************************************************************************
+* Summary:
+*  Limits a value to [min, max].
+*
+*******************************************************************************/
+static int32_t ref_clamp(int32_t value, int32_t min, int32_t max)
+{
+    return (value < min) ? min : ((value > max) ? max : value);
+}
+
+/*******************************************************************************
+* Function Name: ref_layer
+********************************************************************************
+* Summary:
+*  Runs one layer by its definition: every output element sums its window
+*  of the zero-padded input, element by element.
+*
+*******************************************************************************/
+static void ref_layer(const audio_kws_layer_t *l, const int8_t *in, int8_t *out)
+{
+    for (int32_t oy = 0; oy < l->out_h; oy++)
+    {
+        for (int32_t ox = 0; ox < l->out_w; ox++)
+        {
+            for (int32_t oc = 0; oc < l->out_c; oc++)
+            {
+                int32_t acc = (l->type == AUDIO_KWS_LAYER_AVG_POOL) ? 0 : l->bias[oc];
+                int32_t count = 0;
+
+                for (int32_t ky = 0; ky < l->kernel_h; ky++)
+                {
+                    for (int32_t kx = 0; kx < l->kernel_w; kx++)
+                    {
+                        int32_t iy = oy * l->stride_h - l->pad_h + ky;
+                        int32_t ix = ox * l->stride_w - l->pad_w + kx;
+                        if ((iy < 0) || (iy >= l->in_h) || (ix < 0) || (ix >= l->in_w))
+                        {
+                            continue;
+                        }
+
+                        const int8_t *pixel = &in[(iy * l->in_w + ix) * l->in_c];
+                        switch (l->type)
+                        {
+                            case AUDIO_KWS_LAYER_CONV:
+                                for (int32_t ic = 0; ic < l->in_c; ic++)
+                                {
+                                    acc += (pixel[ic] + l->input_offset) *
+                                           l->weights[((oc * l->kernel_h + ky) * l->kernel_w + kx) * l->in_c + ic];
+                                }
+                                break;
+                            case AUDIO_KWS_LAYER_DEPTHWISE:
+                                acc += (pixel[oc] + l->input_offset) *
+                                       l->weights[(ky * l->kernel_w + kx) * l->in_c + oc];
+                                break;
+                            case AUDIO_KWS_LAYER_AVG_POOL:
+                                acc += pixel[oc];
+                                count++;
+                                break;
+                            default:
+                                break;
+                        }
+                    }
+                }
+
+                if (l->type == AUDIO_KWS_LAYER_FULLY_CONNECTED)
+                {
+                    int32_t size = l->in_h * l->in_w * l->in_c;
+                    for (int32_t i = 0; i < size; i++)
+                    {
+                        acc += (in[i] + l->input_offset) * l->weights[oc * size + i];
+                    }
+                }
+
+                int32_t value;
+                if (l->type == AUDIO_KWS_LAYER_AVG_POOL)
+                {
+                    /* Rounded half away from zero */
+                    value = (acc >= 0) ? ((acc + count / 2) / count) : -((-acc + count / 2) / count);
+                }
+                else
+                {
+                    value = ref_requantize(acc, l->multiplier[oc], l->shift[oc]) + l->output_offset;
+                }
+                out[(oy * l->out_w + ox) * l->out_c + oc] = (int8_t)ref_clamp(value, l->act_min, l->act_max);
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Compares the logits of audio_kws with the reference over several random
+*  feature windows.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    static audio_kws_t kws;
+
+    build_model();
+    audio_mfcc_init();
+    TEST_CHECK(audio_kws_init(&kws), "model refused");
+    printf("arena %u of %u bytes\n", (unsigned)arena.peak, (unsigned)AUDIO_KWS_ARENA_SIZE);
+
+    for (uint32_t run = 0; run < 8u; run++)
+    {
+        for (uint32_t r = 0; r < AUDIO_KWS_NUM_FRAMES; r++)
+        {
+            for (uint32_t i = 0; i < AUDIO_KWS_NUM_FEATURES; i++)
+            {
+                kws.features[r][i] = random_int8();
+            }
+        }
+        kws.head = run * 7u;
+        kws.count = AUDIO_KWS_NUM_FRAMES;
+
+        /* The window oldest row first, as kws_invoke reads it */
+        for (uint32_t r = 0; r < AUDIO_KWS_NUM_FRAMES; r++)
+        {
+            memcpy(reference[0] + r * AUDIO_KWS_NUM_FEATURES,
+                   kws.features[(kws.head + r) % AUDIO_KWS_NUM_FRAMES], AUDIO_KWS_NUM_FEATURES);
+        }
+        uint32_t in = 0;
+        for (uint32_t l = 0; l < NUM_LAYERS; l++)
+        {
+            ref_layer(&layers[l], reference[in], reference[in ^ 1u]);
+            in ^= 1u;
+        }
+
+        (void)kws_invoke(&kws);
+
+        /* The logits end in the buffer the last of the odd number of layers wrote */
+        uint32_t mismatches = 0;
+        for (uint32_t i = 0; i < LABELS; i++)
+        {
+            mismatches += (activations[NUM_LAYERS % 2u][i] != reference[in][i]) ? 1u : 0u;
+        }
+        TEST_CHECK(mismatches == 0u, "window %u: %u of %u logits differ", run, mismatches, LABELS);
+    }
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
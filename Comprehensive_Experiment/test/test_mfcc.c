@@ -0,0 +1,357 @@
+/******************************************************************************
+* File Name:   test_mfcc.c
+*
+* Description: This file contains the host test of the fixed-point FFT and
+* the log-mel and MFCC feature extraction. The complex and real FFTs are
+* compared with a direct DFT in double precision, and the real FFT is
+* inverted back to its input. Golden features, computed offline in double
+* precision from the definition in audio_mfcc.h (Hamming window, 512-point
+* power spectrum, 40 mel triangles from 20 Hz to Nyquist, log2 in Q8 and an
+* orthonormal DCT-II), check the extraction of a two-tone frame. The test
+* also reports the frame rate of the extraction on the host.
+*
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_mfcc.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define SAMPLE_RATE_HZ                      (16000u)
+/* Golden frame: 3 hops, the window covers samples 80 to 479 */
+#define GOLDEN_HOPS                         (3u)
+/* Tolerances in Q8 log2 units, 3 LSB is 0.035 dB */
+#define LOG_MEL_TOLERANCE                   (3)
+#define MFCC_TOLERANCE                      (8)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* Features of x[n] = round(8000 sin(2 pi 440 n / fs) + 3000 sin(2 pi 2500 n / fs)) */
+static const int16_t golden_log_mel[AUDIO_MFCC_NUM_BANDS] =
+{
+    9590, 9394, 9425, 9963, 9528, 11386, 13584, 13667, 11739, 10329,
+    10080, 10126, 9929, 9832, 9811, 9725, 9656, 9603, 9570, 9545,
+    9554, 9612, 9742, 12872, 12935, 9704, 9482, 9362, 9273, 9217,
+    9178, 9147, 9126, 9098, 9091, 9074, 9072, 9071, 9074, 9089
+};
+static const int32_t golden_coeffs[AUDIO_MFCC_NUM_COEFFS] =
+{
+    63128, 3294, -866, 632, -1422, -4162, -1635, -207, -1733, 101, 2739, 1136, 341
+};
+
+static audio_mfcc_t mfcc;
+
+/*******************************************************************************
+* Function Name: snr_db
+********************************************************************************
+* Summary:
+*  Returns the ratio of the reference power to the power of the difference.
+*
+*******************************************************************************/
+static double snr_db(const double *ref, const double *got, uint32_t count)
+{
+    double signal = 0.0;
+    double error = 0.0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        signal += ref[i] * ref[i];
+        error += (ref[i] - got[i]) * (ref[i] - got[i]);
+    }
+    return 10.0 * log10(signal / error);
+}
+
+/*******************************************************************************
+* Function Name: dft
+********************************************************************************
+* Summary:
+*  Direct DFT of n complex or, with a NULL imaginary part, real values,
+*  scaled by 1/n like the fixed-point transforms. Writes bins 0 to count-1.
+*
+*******************************************************************************/
+static void dft(const double *re, const double *im, uint32_t n, uint32_t count, double *bins)
+{
+    for (uint32_t k = 0; k < count; k++)
+    {
+        double sum_re = 0.0;
+        double sum_im = 0.0;
+
+        for (uint32_t t = 0; t < n; t++)
+        {
+            double a = -2.0 * M_PI * (double)((k * t) % n) / n;
+            double x_im = (im != NULL) ? im[t] : 0.0;
+
+            sum_re += re[t] * cos(a) - x_im * sin(a);
+            sum_im += re[t] * sin(a) + x_im * cos(a);
+        }
+        bins[2u * k] = sum_re / n;
+        bins[2u * k + 1u] = sum_im / n;
+    }
+}
+
+/*******************************************************************************
+* Function Name: test_cfft
+********************************************************************************
+* Summary:
+*  The Q15 and Q31 complex FFTs of every supported size match the DFT of
+*  full scale noise, to the precision of their format.
+*
+*******************************************************************************/
+static void test_cfft(void)
+{
+    static int16_t data_q15[2u * AUDIO_FFT_MAX_SIZE];
+    static int32_t data_q31[2u * AUDIO_FFT_MAX_SIZE];
+    static double re[AUDIO_FFT_MAX_SIZE];
+    static double im[AUDIO_FFT_MAX_SIZE];
+    static double ref[2u * AUDIO_FFT_MAX_SIZE];
+    static double got_q15[2u * AUDIO_FFT_MAX_SIZE];
+    static double got_q31[2u * AUDIO_FFT_MAX_SIZE];
+
+    for (uint32_t n = 16u; n <= AUDIO_FFT_MAX_SIZE; n *= 4u)
+    {
+        for (uint32_t t = 0; t < n; t++)
+        {
+            data_q15[2u * t] = test_saturate(30000.0 * (2.0 * test_uniform() - 1.0));
+            data_q15[2u * t + 1u] = test_saturate(30000.0 * (2.0 * test_uniform() - 1.0));
+            data_q31[2u * t] = (int32_t)data_q15[2u * t] << 16;
+            data_q31[2u * t + 1u] = (int32_t)data_q15[2u * t + 1u] << 16;
+            re[t] = data_q15[2u * t];
+            im[t] = data_q15[2u * t + 1u];
+        }
+        dft(re, im, n, n, ref);
+
+        audio_fft_cfft_q15(data_q15, n);
+        audio_fft_cfft_q31(data_q31, n);
+        for (uint32_t i = 0; i < 2u * n; i++)
+        {
+            got_q15[i] = data_q15[i];
+            got_q31[i] = data_q31[i] / 65536.0;
+        }
+
+        double snr_q15 = snr_db(ref, got_q15, 2u * n);
+        double snr_q31 = snr_db(ref, got_q31, 2u * n);
+        printf("cfft %3u: Q15 SNR %.1f dB, Q31 SNR %.1f dB\n", n, snr_q15, snr_q31);
+        TEST_CHECK(snr_q15 > 50.0, "cfft %u: Q15 SNR %.1f dB", n, snr_q15);
+        TEST_CHECK(snr_q31 > 140.0, "cfft %u: Q31 SNR %.1f dB", n, snr_q31);
+    }
+}
+
+/*******************************************************************************
+* Function Name: test_rfft
+********************************************************************************
+* Summary:
+*  The real FFT matches the DFT from DC to Nyquist, and the inverse
+*  returns the input scaled by 1/1024, less the 10 bits the scaling drops.
+*
+*******************************************************************************/
+static void test_rfft(void)
+{
+    static int32_t data[AUDIO_FFT_RFFT_SIZE];
+    static int32_t bins[2u * AUDIO_FFT_RFFT_BINS];
+    static double x[AUDIO_FFT_RFFT_SIZE];
+    static double ref[2u * AUDIO_FFT_RFFT_BINS];
+    static double got[2u * AUDIO_FFT_RFFT_SIZE];
+
+    for (uint32_t t = 0; t < AUDIO_FFT_RFFT_SIZE; t++)
+    {
+        x[t] = test_saturate(30000.0 * (2.0 * test_uniform() - 1.0));
+        data[t] = (int32_t)x[t] << 16;
+    }
+    dft(x, NULL, AUDIO_FFT_RFFT_SIZE, AUDIO_FFT_RFFT_BINS, ref);
+
+    audio_fft_rfft_q31(data, bins);
+    for (uint32_t i = 0; i < 2u * AUDIO_FFT_RFFT_BINS; i++)
+    {
+        got[i] = bins[i] / 65536.0;
+    }
+    double snr = snr_db(ref, got, 2u * AUDIO_FFT_RFFT_BINS);
+    printf("rfft %u: Q31 SNR %.1f dB\n", AUDIO_FFT_RFFT_SIZE, snr);
+    TEST_CHECK(snr > 140.0, "rfft: SNR %.1f dB", snr);
+    TEST_CHECK((bins[1] == 0) && (bins[2u * AUDIO_FFT_RFFT_BINS - 1u] == 0),
+               "rfft: imaginary DC %d or Nyquist %d", bins[1], bins[2u * AUDIO_FFT_RFFT_BINS - 1u]);
+
+    audio_fft_rifft_q31(bins, data);
+    for (uint32_t t = 0; t < AUDIO_FFT_RFFT_SIZE; t++)
+    {
+        got[t] = data[t] * 1024.0 / 65536.0;
+    }
+    snr = snr_db(x, got, AUDIO_FFT_RFFT_SIZE);
+    printf("rifft(rfft): Q31 SNR %.1f dB\n", snr);
+    TEST_CHECK(snr > 100.0, "rifft(rfft): SNR %.1f dB", snr);
+}
+
+/*******************************************************************************
+* Function Name: test_golden
+********************************************************************************
+* Summary:
+*  The log-mel energies and MFCCs of the golden frame match the double
+*  precision reference; the two tones peak in their bands. Silence gives
+*  zero energies, also after a reset that follows the tones.
+*
+*******************************************************************************/
+static void test_golden(void)
+{
+    int16_t samples[GOLDEN_HOPS * AUDIO_MFCC_HOP_SAMPLES];
+    int16_t log_mel[AUDIO_MFCC_NUM_BANDS];
+    int32_t coeffs[AUDIO_MFCC_NUM_COEFFS];
+    int32_t log_mel_error = 0;
+    int32_t coeff_error = 0;
+
+    for (uint32_t n = 0; n < GOLDEN_HOPS * AUDIO_MFCC_HOP_SAMPLES; n++)
+    {
+        samples[n] = (int16_t)lround(8000.0 * sin(2.0 * M_PI * 440.0 * n / SAMPLE_RATE_HZ) +
+                                     3000.0 * sin(2.0 * M_PI * 2500.0 * n / SAMPLE_RATE_HZ));
+    }
+
+    audio_mfcc_reset(&mfcc);
+    for (uint32_t hop = 0; hop < GOLDEN_HOPS; hop++)
+    {
+        audio_mfcc_process(&mfcc, &samples[hop * AUDIO_MFCC_HOP_SAMPLES], log_mel, coeffs);
+    }
+
+    for (uint32_t b = 0; b < AUDIO_MFCC_NUM_BANDS; b++)
+    {
+        int32_t error = abs(log_mel[b] - golden_log_mel[b]);
+        log_mel_error = (error > log_mel_error) ? error : log_mel_error;
+    }
+    for (uint32_t i = 0; i < AUDIO_MFCC_NUM_COEFFS; i++)
+    {
+        int32_t error = abs(coeffs[i] - golden_coeffs[i]);
+        coeff_error = (error > coeff_error) ? error : coeff_error;
+    }
+    printf("log-mel error %d LSB, MFCC error %d LSB\n", log_mel_error, coeff_error);
+    TEST_CHECK(log_mel_error <= LOG_MEL_TOLERANCE, "log-mel off the reference by %d LSB", log_mel_error);
+    TEST_CHECK(coeff_error <= MFCC_TOLERANCE, "MFCCs off the reference by %d LSB", coeff_error);
+
+    /* 440 Hz lies in bands 6 and 7, 2500 Hz in bands 23 and 24 */
+    TEST_CHECK((log_mel[7] > log_mel[4] + 1024) && (log_mel[24] > log_mel[20] + 768),
+               "tones do not stand out of their bands");
+
+    /* The process without coefficients gives the same energies */
+    int16_t again[AUDIO_MFCC_NUM_BANDS];
+    audio_mfcc_reset(&mfcc);
+    for (uint32_t hop = 0; hop < GOLDEN_HOPS; hop++)
+    {
+        audio_mfcc_process(&mfcc, &samples[hop * AUDIO_MFCC_HOP_SAMPLES], again, NULL);
+    }
+    TEST_CHECK(memcmp(again, log_mel, sizeof(again)) == 0, "log-mel depends on the MFCC output");
+
+    memset(samples, 0, sizeof(samples));
+    audio_mfcc_reset(&mfcc);
+    audio_mfcc_process(&mfcc, samples, log_mel, coeffs);
+    uint32_t nonzero = 0;
+    for (uint32_t b = 0; b < AUDIO_MFCC_NUM_BANDS; b++)
+    {
+        nonzero += (log_mel[b] != 0) ? 1u : 0u;
+    }
+    TEST_CHECK((nonzero == 0u) && (coeffs[0] == 0), "silence after a reset: %u bands non-zero", nonzero);
+}
+
+/*******************************************************************************
+* Function Name: test_level
+********************************************************************************
+* Summary:
+*  Halving a noise signal lowers every log-mel energy by 2 in log2, 512 in
+*  Q8, and c0 by 512 sqrt(40).
+*
+*******************************************************************************/
+static void test_level(void)
+{
+    int16_t loud[GOLDEN_HOPS * AUDIO_MFCC_HOP_SAMPLES];
+    int16_t quiet[GOLDEN_HOPS * AUDIO_MFCC_HOP_SAMPLES];
+    int16_t log_mel_loud[AUDIO_MFCC_NUM_BANDS];
+    int16_t log_mel_quiet[AUDIO_MFCC_NUM_BANDS];
+    int32_t coeffs_loud[AUDIO_MFCC_NUM_COEFFS];
+    int32_t coeffs_quiet[AUDIO_MFCC_NUM_COEFFS];
+    int32_t worst = 0;
+
+    /* Even samples, so that the quiet signal is exactly half */
+    for (uint32_t n = 0; n < GOLDEN_HOPS * AUDIO_MFCC_HOP_SAMPLES; n++)
+    {
+        loud[n] = (int16_t)(2 * lround(4000.0 * test_gauss()));
+        quiet[n] = loud[n] / 2;
+    }
+
+    audio_mfcc_reset(&mfcc);
+    for (uint32_t hop = 0; hop < GOLDEN_HOPS; hop++)
+    {
+        audio_mfcc_process(&mfcc, &loud[hop * AUDIO_MFCC_HOP_SAMPLES], log_mel_loud, coeffs_loud);
+    }
+    audio_mfcc_reset(&mfcc);
+    for (uint32_t hop = 0; hop < GOLDEN_HOPS; hop++)
+    {
+        audio_mfcc_process(&mfcc, &quiet[hop * AUDIO_MFCC_HOP_SAMPLES], log_mel_quiet, coeffs_quiet);
+    }
+
+    for (uint32_t b = 0; b < AUDIO_MFCC_NUM_BANDS; b++)
+    {
+        int32_t error = abs(log_mel_loud[b] - log_mel_quiet[b] - 512);
+        worst = (error > worst) ? error : worst;
+    }
+    int32_t c0_step = coeffs_loud[0] - coeffs_quiet[0];
+    TEST_CHECK(worst <= 4, "6 dB level step off by %d LSB in a band", worst);
+    TEST_CHECK(abs(c0_step - (int32_t)lround(512.0 * sqrt(40.0))) <= 8, "6 dB level step moves c0 by %d", c0_step);
+}
+
+/*******************************************************************************
+* Function Name: test_throughput
+********************************************************************************
+* Summary:
+*  Reports the frame rate of the feature extraction on the host.
+*
+*******************************************************************************/
+static void test_throughput(void)
+{
+    static int16_t samples[SAMPLE_RATE_HZ];
+    int16_t log_mel[AUDIO_MFCC_NUM_BANDS];
+    int32_t coeffs[AUDIO_MFCC_NUM_COEFFS];
+    const uint32_t frames = 20u * (SAMPLE_RATE_HZ / AUDIO_MFCC_HOP_SAMPLES);
+    struct timespec t0, t1;
+
+    for (uint32_t n = 0; n < SAMPLE_RATE_HZ; n++)
+    {
+        samples[n] = test_saturate(3000.0 * test_gauss());
+    }
+
+    audio_mfcc_reset(&mfcc);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t f = 0; f < frames; f++)
+    {
+        uint32_t hop = f % (SAMPLE_RATE_HZ / AUDIO_MFCC_HOP_SAMPLES);
+        audio_mfcc_process(&mfcc, &samples[hop * AUDIO_MFCC_HOP_SAMPLES], log_mel, coeffs);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    printf("MFCC: %.0f frames/s on the host\n", frames / seconds);
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the FFT and the feature extraction.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    audio_mfcc_init();
+
+    test_cfft();
+    test_rfft();
+    test_golden();
+    test_level();
+    test_throughput();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
@@ -0,0 +1,384 @@
+/******************************************************************************
+* File Name:   test_mtu.c
+*
+* Description: This file contains the host test of the upload chunk size
+* policy. The largest chunk follows the link MTU and the datagram overhead,
+* a probe acknowledged by the server raises the chunk and only such an
+* acknowledgement does, unanswered probes end the search for a while, and
+* lossy uploads fall back to a smaller chunk unless the smaller chunk loses
+* as much. Uploads over simulated paths check that the chunk settles at the
+* size the path carries.
+*
+*******************************************************************************/
+
+#include "audio_fec.h"
+#include "audio_mtu.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define LINK_MTU                            (1500u)
+/* Largest chunk of a 1500 byte link without overhead */
+#define MAX_CHUNK                           (LINK_MTU - AUDIO_MTU_IP_UDP_HEADER_SIZE - AUDIO_PACKET_HEADER_SIZE)
+/* Datagrams of an upload of 7 s of ADPCM at 16 kHz */
+#define UPLOAD_BYTES                        (56000u)
+#define PATH_UPLOADS                        (60u)
+#define PATH_SEEDS                          (20u)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static audio_mtu_t mtu;
+
+/*******************************************************************************
+* Function Name: feedback
+********************************************************************************
+* Summary:
+*  Passes a feedback datagram of the given flags, session and offset to the
+*  policy and returns its result.
+*
+*******************************************************************************/
+static bool feedback(uint8_t flags, uint16_t session, uint32_t offset)
+{
+    uint8_t datagram[AUDIO_PACKET_HEADER_SIZE];
+    audio_packet_header_t header = { 1u, flags, session, 1u, offset };
+
+    uint32_t size = audio_packet_encode(&header, datagram, 0u);
+    return audio_mtu_feedback(&mtu, datagram, size);
+}
+
+/*******************************************************************************
+* Function Name: ack_probe
+********************************************************************************
+* Summary:
+*  Acknowledges a probe of the given payload size the way the server does.
+*
+*******************************************************************************/
+static bool ack_probe(uint16_t session, uint32_t probe_size)
+{
+    return feedback(AUDIO_PACKET_FLAG_ACK | AUDIO_PACKET_FLAG_PROBE, session, probe_size);
+}
+
+/*******************************************************************************
+* Function Name: test_init
+********************************************************************************
+* Summary:
+*  The largest chunk fills the link MTU with the IP, UDP and upload headers
+*  and the overhead, in whole samples, never exceeds the largest payload and
+*  never drops below the base chunk. The first uploads use the former fixed
+*  chunk if the link carries it.
+*
+*******************************************************************************/
+static void test_init(void)
+{
+    audio_mtu_init(&mtu, LINK_MTU, 0u);
+    TEST_CHECK((mtu.max_chunk == MAX_CHUNK) && (mtu.chunk == AUDIO_MTU_INITIAL_CHUNK),
+               "1500 link: max %u chunk %u", mtu.max_chunk, mtu.chunk);
+
+    /* 1500 - 28 - 16 - 7 is odd */
+    audio_mtu_init(&mtu, LINK_MTU, AUDIO_FEC_SYMBOL_PREFIX);
+    TEST_CHECK(mtu.max_chunk == MAX_CHUNK - 8u, "1500 link with FEC: max %u", mtu.max_chunk);
+    TEST_CHECK((AUDIO_MTU_IP_UDP_HEADER_SIZE + AUDIO_PACKET_HEADER_SIZE + mtu.max_chunk + mtu.overhead) <= LINK_MTU,
+               "parity datagram exceeds the link MTU");
+
+    audio_mtu_init(&mtu, 9000u, 0u);
+    TEST_CHECK(mtu.max_chunk == AUDIO_PACKET_MAX_PAYLOAD, "jumbo link: max %u", mtu.max_chunk);
+    audio_mtu_init(&mtu, 9000u, AUDIO_FEC_SYMBOL_PREFIX);
+    TEST_CHECK(mtu.max_chunk == ((AUDIO_PACKET_MAX_PAYLOAD - AUDIO_FEC_SYMBOL_PREFIX) & ~1u),
+               "jumbo link with FEC: max %u", mtu.max_chunk);
+
+    audio_mtu_init(&mtu, 576u, 0u);
+    TEST_CHECK((mtu.max_chunk == 532u) && (mtu.chunk == 532u), "576 link: max %u chunk %u",
+               mtu.max_chunk, mtu.chunk);
+    TEST_CHECK(audio_mtu_probe(&mtu, 1u) == 0u, "576 link probed beyond its largest chunk");
+
+    audio_mtu_init(&mtu, 300u, 0u);
+    TEST_CHECK((mtu.max_chunk == AUDIO_MTU_BASE_CHUNK) && (mtu.chunk == AUDIO_MTU_BASE_CHUNK),
+               "300 link: max %u chunk %u", mtu.max_chunk, mtu.chunk);
+}
+
+/*******************************************************************************
+* Function Name: test_probe
+********************************************************************************
+* Summary:
+*  The first upload probes the largest chunk with the overhead added. Only
+*  the acknowledgement of that size in that session raises the chunk; other
+*  probe feedback is consumed without effect and other datagrams are left
+*  to the caller. Once at the largest chunk there is nothing to probe.
+*
+*******************************************************************************/
+static void test_probe(void)
+{
+    audio_mtu_init(&mtu, LINK_MTU, AUDIO_FEC_SYMBOL_PREFIX);
+    uint32_t probe_size = audio_mtu_probe(&mtu, 7u);
+    TEST_CHECK(probe_size == mtu.max_chunk + AUDIO_FEC_SYMBOL_PREFIX, "probe of %u bytes", probe_size);
+
+    TEST_CHECK(ack_probe(8u, probe_size) && (mtu.chunk == AUDIO_MTU_INITIAL_CHUNK), "ack of another session taken");
+    TEST_CHECK(ack_probe(7u, probe_size - 2u) && (mtu.chunk == AUDIO_MTU_INITIAL_CHUNK), "ack of another size taken");
+    TEST_CHECK(feedback(AUDIO_PACKET_FLAG_PROBE, 7u, probe_size) && (mtu.chunk == AUDIO_MTU_INITIAL_CHUNK),
+               "probe without ack taken");
+    TEST_CHECK(!feedback(AUDIO_PACKET_FLAG_ACK, 7u, probe_size) && (mtu.chunk == AUDIO_MTU_INITIAL_CHUNK),
+               "upload ack taken for a probe ack");
+
+    /* A corrupted acknowledgement is left to the caller, which drops it */
+    uint8_t datagram[AUDIO_PACKET_HEADER_SIZE];
+    audio_packet_header_t header = { 1u, AUDIO_PACKET_FLAG_ACK | AUDIO_PACKET_FLAG_PROBE, 7u, 1u, probe_size };
+    uint32_t size = audio_packet_encode(&header, datagram, 0u);
+    datagram[8] ^= 0x01u;
+    TEST_CHECK(!audio_mtu_feedback(&mtu, datagram, size) && (mtu.chunk == AUDIO_MTU_INITIAL_CHUNK),
+               "corrupted ack taken");
+
+    TEST_CHECK(ack_probe(7u, probe_size) && (mtu.chunk == mtu.max_chunk), "probe ack ignored, chunk %u", mtu.chunk);
+    audio_mtu_upload_done(&mtu, 50u, 0u);
+    TEST_CHECK((mtu.probe_failures == 0u) && (audio_mtu_probe(&mtu, 8u) == 0u), "probed at the largest chunk");
+
+    /* A late ack of a probe already counted as unanswered is ignored */
+    audio_mtu_init(&mtu, LINK_MTU, 0u);
+    probe_size = audio_mtu_probe(&mtu, 9u);
+    audio_mtu_upload_done(&mtu, 50u, 0u);
+    TEST_CHECK(ack_probe(9u, probe_size) && (mtu.chunk == AUDIO_MTU_INITIAL_CHUNK), "late ack taken");
+}
+
+/*******************************************************************************
+* Function Name: test_unanswered
+********************************************************************************
+* Summary:
+*  Every upload probes again until AUDIO_MTU_MAX_PROBES probes went
+*  unanswered; the next AUDIO_MTU_RAISE_UPLOADS uploads do not probe, and
+*  the one after starts a new search.
+*
+*******************************************************************************/
+static void test_unanswered(void)
+{
+    uint16_t session = 0;
+
+    audio_mtu_init(&mtu, LINK_MTU, 0u);
+    for (uint32_t p = 0; p < AUDIO_MTU_MAX_PROBES; p++)
+    {
+        TEST_CHECK(audio_mtu_probe(&mtu, session++) == MAX_CHUNK, "probe %u not sent", p);
+        audio_mtu_upload_done(&mtu, 50u, 0u);
+    }
+
+    uint32_t probes = 0;
+    for (uint32_t u = 0; u < AUDIO_MTU_RAISE_UPLOADS; u++)
+    {
+        probes += (audio_mtu_probe(&mtu, session++) != 0u) ? 1u : 0u;
+        audio_mtu_upload_done(&mtu, 50u, 0u);
+    }
+    TEST_CHECK(probes == 0u, "%u probes while the search rests", probes);
+
+    uint32_t probe_size = audio_mtu_probe(&mtu, session);
+    TEST_CHECK(probe_size == MAX_CHUNK, "search not resumed");
+    TEST_CHECK(ack_probe(session, probe_size) && (mtu.chunk == MAX_CHUNK), "resumed probe ack ignored");
+}
+
+/*******************************************************************************
+* Function Name: test_fallback
+********************************************************************************
+* Summary:
+*  An upload NACKed for AUDIO_MTU_LOSS_PERCENT of its datagrams moves to the
+*  next smaller chunk, down to the base chunk and no further; less loss or
+*  a short upload do not. If the smaller chunk loses less it stays, and the
+*  larger chunk is probed after AUDIO_MTU_RAISE_UPLOADS uploads.
+*
+*******************************************************************************/
+static void test_fallback(void)
+{
+    audio_mtu_init(&mtu, LINK_MTU, 0u);
+    (void)ack_probe(0u, audio_mtu_probe(&mtu, 0u));
+    TEST_CHECK(mtu.chunk == MAX_CHUNK, "chunk %u", mtu.chunk);
+
+    audio_mtu_upload_done(&mtu, 100u, 9u);
+    audio_mtu_upload_done(&mtu, AUDIO_MTU_LOSS_MIN_DATAGRAMS - 1u, AUDIO_MTU_LOSS_MIN_DATAGRAMS - 1u);
+    TEST_CHECK((mtu.chunk == MAX_CHUNK) && (mtu.fallbacks == 0u), "fell back below the loss threshold");
+
+    audio_mtu_upload_done(&mtu, 100u, 10u);
+    TEST_CHECK((mtu.chunk == AUDIO_MTU_INITIAL_CHUNK) && (mtu.fallbacks == 1u), "10%% loss: chunk %u", mtu.chunk);
+
+    /* The smaller chunk loses less: it stays until the search resumes */
+    uint32_t probes = 0;
+    for (uint32_t u = 0; u < AUDIO_MTU_RAISE_UPLOADS; u++)
+    {
+        probes += (audio_mtu_probe(&mtu, 1u) != 0u) ? 1u : 0u;
+        audio_mtu_upload_done(&mtu, 100u, 1u);
+        TEST_CHECK((mtu.chunk == AUDIO_MTU_INITIAL_CHUNK) && (mtu.loss_chunk == 0u), "smaller chunk left, %u",
+                   mtu.chunk);
+    }
+    TEST_CHECK(probes == 0u, "%u probes after the fall back", probes);
+    TEST_CHECK(audio_mtu_probe(&mtu, 2u) == MAX_CHUNK, "larger chunk not probed again");
+    audio_mtu_upload_done(&mtu, 100u, 0u);
+
+    /* Loss at the smaller chunks steps down to the base chunk */
+    audio_mtu_upload_done(&mtu, 100u, 50u);
+    audio_mtu_upload_done(&mtu, 100u, 0u);
+    audio_mtu_upload_done(&mtu, 100u, 50u);
+    audio_mtu_upload_done(&mtu, 100u, 0u);
+    TEST_CHECK((mtu.chunk == AUDIO_MTU_BASE_CHUNK) && (mtu.fallbacks == 2u), "chunk %u after %u fall backs",
+               mtu.chunk, mtu.fallbacks);
+    audio_mtu_upload_done(&mtu, 100u, 50u);
+    TEST_CHECK((mtu.chunk == AUDIO_MTU_BASE_CHUNK) && (mtu.fallbacks == 2u), "fell back below the base chunk");
+}
+
+/*******************************************************************************
+* Function Name: test_loss_not_size
+********************************************************************************
+* Summary:
+*  If the smaller chunk loses as much, the larger chunk is restored and the
+*  loss ignored for AUDIO_MTU_RAISE_UPLOADS uploads; then a lossy upload
+*  falls back again.
+*
+*******************************************************************************/
+static void test_loss_not_size(void)
+{
+    audio_mtu_init(&mtu, LINK_MTU, 0u);
+    (void)ack_probe(0u, audio_mtu_probe(&mtu, 0u));
+
+    audio_mtu_upload_done(&mtu, 100u, 20u);
+    TEST_CHECK(mtu.chunk == AUDIO_MTU_INITIAL_CHUNK, "no fall back, chunk %u", mtu.chunk);
+    audio_mtu_upload_done(&mtu, 100u, 20u);
+    TEST_CHECK(mtu.chunk == MAX_CHUNK, "larger chunk not restored, chunk %u", mtu.chunk);
+    TEST_CHECK(audio_mtu_probe(&mtu, 1u) == 0u, "probed at the restored largest chunk");
+
+    for (uint32_t u = 0; u < AUDIO_MTU_RAISE_UPLOADS; u++)
+    {
+        audio_mtu_upload_done(&mtu, 100u, 20u);
+    }
+    TEST_CHECK((mtu.chunk == MAX_CHUNK) && (mtu.fallbacks == 1u), "loss not ignored, chunk %u", mtu.chunk);
+    audio_mtu_upload_done(&mtu, 100u, 20u);
+    TEST_CHECK((mtu.chunk == AUDIO_MTU_INITIAL_CHUNK) && (mtu.fallbacks == 2u), "loss ignored for good");
+}
+
+/*******************************************************************************
+* Function Name: lost
+********************************************************************************
+* Summary:
+*  Returns whether a datagram is lost on a path: one within the path MTU
+*  with the path loss, a larger one with the loss of fragmented datagrams,
+*  1 if the path drops fragments.
+*
+*******************************************************************************/
+static bool lost(uint32_t datagram_size, uint32_t path_mtu, double fragment_loss, double loss)
+{
+    if ((datagram_size + AUDIO_MTU_IP_UDP_HEADER_SIZE) <= path_mtu)
+    {
+        return test_uniform() < loss;
+    }
+    return test_uniform() < fragment_loss;
+}
+
+/*******************************************************************************
+* Function Name: run_path
+********************************************************************************
+* Summary:
+*  Runs uploads over a path, the probes and their acknowledgements crossing
+*  it too, and returns the number of uploads at the largest chunk and the
+*  number of uploads in datagrams larger than the path MTU.
+*
+*******************************************************************************/
+static uint32_t run_path(uint32_t path_mtu, double fragment_loss, double loss, uint32_t *oversized)
+{
+    uint32_t at_max = 0;
+
+    audio_mtu_init(&mtu, LINK_MTU, 0u);
+    *oversized = 0;
+
+    for (uint16_t session = 0; session < PATH_UPLOADS; session++)
+    {
+        /* An acknowledged probe raises the chunk from the next upload */
+        uint32_t chunk = mtu.chunk;
+        uint32_t probe_size = audio_mtu_probe(&mtu, session);
+        if ((probe_size != 0u) &&
+            !lost(AUDIO_PACKET_HEADER_SIZE + probe_size, path_mtu, fragment_loss, loss) &&
+            !lost(AUDIO_PACKET_HEADER_SIZE, path_mtu, fragment_loss, loss))
+        {
+            (void)ack_probe(session, probe_size);
+        }
+
+        uint32_t datagrams = (UPLOAD_BYTES + chunk - 1u) / chunk;
+        uint32_t nacked = 0;
+        for (uint32_t d = 0; d < datagrams; d++)
+        {
+            nacked += lost(AUDIO_PACKET_HEADER_SIZE + chunk, path_mtu, fragment_loss, loss) ? 1u : 0u;
+        }
+        at_max += (chunk == mtu.max_chunk) ? 1u : 0u;
+        *oversized += ((AUDIO_MTU_IP_UDP_HEADER_SIZE + AUDIO_PACKET_HEADER_SIZE + chunk) > path_mtu) ? 1u : 0u;
+        audio_mtu_upload_done(&mtu, datagrams, nacked);
+    }
+    return at_max;
+}
+
+/*******************************************************************************
+* Function Name: test_paths
+********************************************************************************
+* Summary:
+*  Over PATH_SEEDS runs of PATH_UPLOADS uploads each: a 1500 byte path with
+*  0.5 % loss uses the largest chunk from the second upload on, but for a
+*  rare fall back. A 1400 byte path that drops fragments never carries an
+*  upload in oversized datagrams, as only probes test the larger chunk. One
+*  that passes fragments but loses 15 % of the fragmented datagrams falls
+*  back after uploads at the largest chunk and carries most uploads below
+*  the path MTU. On a 1500 byte path with 20 % loss of any size the loss is
+*  found not to be caused by the size, and most uploads keep the largest
+*  chunk.
+*
+*******************************************************************************/
+static void test_paths(void)
+{
+    uint32_t clean = PATH_UPLOADS;
+    uint32_t black_hole = 0;
+    uint32_t fragmenting = 0;
+    uint32_t lossy = PATH_UPLOADS;
+    uint32_t oversized;
+
+    for (uint32_t seed = 1u; seed <= PATH_SEEDS; seed++)
+    {
+        test_seed = seed;
+        uint32_t at_max = run_path(1500u, 0.005, 0.005, &oversized);
+        clean = (at_max < clean) ? at_max : clean;
+
+        (void)run_path(1400u, 1.0, 0.01, &oversized);
+        black_hole = (oversized > black_hole) ? oversized : black_hole;
+
+        (void)run_path(1400u, 0.15, 0.01, &oversized);
+        fragmenting = (oversized > fragmenting) ? oversized : fragmenting;
+
+        at_max = run_path(1500u, 0.2, 0.2, &oversized);
+        lossy = (at_max < lossy) ? at_max : lossy;
+    }
+
+    printf("of %u uploads, worst of %u runs:\n", PATH_UPLOADS, PATH_SEEDS);
+    printf("  1500 path, 0.5%% loss: %u at the largest chunk\n", clean);
+    printf("  1400 path, fragments dropped: %u oversized\n", black_hole);
+    printf("  1400 path, 15%% loss of fragmented datagrams: %u oversized\n", fragmenting);
+    printf("  1500 path, 20%% loss: %u at the largest chunk\n", lossy);
+
+    TEST_CHECK(clean >= PATH_UPLOADS - AUDIO_MTU_RAISE_UPLOADS - 3u, "clean path: %u at the largest chunk", clean);
+    TEST_CHECK(black_hole == 0u, "black hole: %u oversized uploads", black_hole);
+    TEST_CHECK((fragmenting >= 1u) && (fragmenting <= PATH_UPLOADS / 6u), "fragmenting path: %u oversized uploads",
+               fragmenting);
+    TEST_CHECK(lossy >= PATH_UPLOADS / 2u, "lossy path: %u at the largest chunk", lossy);
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the chunk size policy.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    test_init();
+    test_probe();
+    test_unanswered();
+    test_fallback();
+    test_loss_not_size();
+    test_paths();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
@@ -0,0 +1,454 @@
+/******************************************************************************
+* File Name:   test_net_tx.c
+*
+* Description: This file contains the host test of the task that sends all
+* datagrams to the UDP server. net_tx_task.c runs unchanged on the host
+* RTOS of rtos_host.c, against a cy_socket_sendto that logs every datagram
+* and can hold the task inside the send, so that the test fills the queues
+* behind it. Checked are the order of the priorities and within them, the
+* queue limits, the return of the messages to their pools, also after a
+* failed send, and the pacing of the bulk datagrams on the monotonic clock,
+* which a control message overtakes.
+*
+*******************************************************************************/
+
+#include <pthread.h>
+#include <string.h>
+
+#include "net_tx_task.h"
+#include "udp_client.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define LOG_SIZE                            (1024u)
+#define DATAGRAM_SIZE                       (1472u)
+#define PACED_DATAGRAMS                     (100u)
+/* Longest wait of the test for the task, far above any pacing */
+#define TIMEOUT_MS                          (5000u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    uint8_t tag;                    /* First byte of the datagram */
+    uint8_t seq;                    /* Second byte of the datagram */
+    uint32_t size;
+    uint32_t ms;                    /* Time the send started */
+} sent_t;
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* Read by net_tx_task.c, see udp_client.h and main.c */
+static int socket_dummy;
+cy_socket_t client_handle = &socket_dummy;
+TaskHandle_t net_tx_task_handle;
+
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gate_cond = PTHREAD_COND_INITIALIZER;
+static sent_t sent[LOG_SIZE];
+static uint32_t sent_count;
+static bool gate_closed;
+static uint32_t fail_count;         /* Sends still to fail */
+
+static uint8_t datagram[NET_TX_BULK_MAX_SIZE + 1u];
+
+/*******************************************************************************
+* Function Name: cy_socket_sendto
+********************************************************************************
+* Summary:
+*  Logs the datagram, then waits while the gate is closed. Fails while
+*  fail_count is not 0.
+*
+*******************************************************************************/
+cy_rslt_t cy_socket_sendto(cy_socket_t handle, const void *buffer, uint32_t length, int flags,
+                           const cy_socket_sockaddr_t *dest_addr, cy_socket_sockaddr_len_t address_length,
+                           uint32_t *bytes_sent)
+{
+    const uint8_t *data = buffer;
+    cy_rslt_t result = CY_RSLT_SUCCESS;
+
+    (void)flags;
+    TEST_CHECK(handle == client_handle, "datagram sent on another socket");
+    TEST_CHECK((dest_addr->port == UDP_SERVER_PORT) && (address_length == sizeof(cy_socket_sockaddr_t)),
+               "datagram sent to port %u", dest_addr->port);
+
+    pthread_mutex_lock(&log_mutex);
+    if (sent_count < LOG_SIZE)
+    {
+        sent[sent_count].tag = data[0];
+        sent[sent_count].seq = data[1];
+        sent[sent_count].size = length;
+        sent[sent_count].ms = xTaskGetTickCount();
+        sent_count++;
+    }
+    pthread_cond_broadcast(&gate_cond);
+    while (gate_closed)
+    {
+        pthread_cond_wait(&gate_cond, &log_mutex);
+    }
+    if (fail_count > 0u)
+    {
+        fail_count--;
+        result = CY_RSLT_MODULE_SECURE_SOCKETS_NOMEM;
+    }
+    pthread_mutex_unlock(&log_mutex);
+
+    *bytes_sent = (result == CY_RSLT_SUCCESS) ? length : 0u;
+    return result;
+}
+
+/*******************************************************************************
+* Function Name: sent_total
+********************************************************************************
+* Summary:
+*  Returns the number of sends started.
+*
+*******************************************************************************/
+static uint32_t sent_total(void)
+{
+    uint32_t count;
+
+    pthread_mutex_lock(&log_mutex);
+    count = sent_count;
+    pthread_mutex_unlock(&log_mutex);
+
+    return count;
+}
+
+/*******************************************************************************
+* Function Name: wait_sent
+********************************************************************************
+* Summary:
+*  Waits until count sends have started. Returns false on a timeout.
+*
+*******************************************************************************/
+static bool wait_sent(uint32_t count)
+{
+    uint32_t start_ms = xTaskGetTickCount();
+    uint32_t now_count;
+
+    do
+    {
+        now_count = sent_total();
+        if (now_count >= count)
+        {
+            return true;
+        }
+        vTaskDelay(1u);
+    } while ((xTaskGetTickCount() - start_ms) < TIMEOUT_MS);
+
+    TEST_CHECK(false, "%u of %u datagrams sent", now_count, count);
+    return false;
+}
+
+/*******************************************************************************
+* Function Name: gate
+********************************************************************************
+* Summary:
+*  Opens or closes the gate that holds the task inside the send.
+*
+*******************************************************************************/
+static void gate(bool closed)
+{
+    pthread_mutex_lock(&log_mutex);
+    gate_closed = closed;
+    pthread_cond_broadcast(&gate_cond);
+    pthread_mutex_unlock(&log_mutex);
+}
+
+/*******************************************************************************
+* Function Name: send
+********************************************************************************
+* Summary:
+*  Queues a datagram of the given size starting with the tag and sequence
+*  number.
+*
+*******************************************************************************/
+static cy_rslt_t send(net_tx_priority_t priority, uint8_t tag, uint8_t seq, uint32_t size, uint32_t wait_ms)
+{
+    datagram[0] = tag;
+    datagram[1] = seq;
+    return net_tx_send_wait(priority, datagram, size, wait_ms);
+}
+
+/*******************************************************************************
+* Function Name: hold_task
+********************************************************************************
+* Summary:
+*  Closes the gate and queues a datagram that holds the task inside its
+*  send, so that the queues fill behind it. Returns the log index of the
+*  datagram.
+*
+*******************************************************************************/
+static uint32_t hold_task(net_tx_priority_t priority, uint8_t tag)
+{
+    uint32_t index = sent_total();
+
+    gate(true);
+    TEST_CHECK(send(priority, tag, 0u, 2u, 0u) == CY_RSLT_SUCCESS, "holding datagram not queued");
+    (void)wait_sent(index + 1u);
+
+    return index;
+}
+
+/*******************************************************************************
+* Function Name: fill
+********************************************************************************
+* Summary:
+*  Queues datagrams until the queue of the priority is full. Returns the
+*  number queued.
+*
+*******************************************************************************/
+static uint32_t fill(net_tx_priority_t priority, uint8_t tag, uint32_t size)
+{
+    uint32_t count = 0;
+
+    while ((count < 64u) && (send(priority, tag, (uint8_t)count, size, 0u) == CY_RSLT_SUCCESS))
+    {
+        count++;
+    }
+
+    return count;
+}
+
+/*******************************************************************************
+* Function Name: test_start
+********************************************************************************
+* Summary:
+*  Datagrams are refused before the task runs, then accepted and sent.
+*
+*******************************************************************************/
+static void test_start(void)
+{
+    uint32_t start_ms;
+
+    TEST_CHECK(send(NET_TX_PRIORITY_CONTROL, 'C', 0u, 4u, 0u) == CY_RSLT_MODULE_SECURE_SOCKETS_NOT_INITIALIZED,
+               "datagram queued before the task runs");
+
+    TEST_CHECK(xTaskCreate(net_tx_task, "Net TX Task", 0u, NULL, 0u, &net_tx_task_handle) == pdPASS,
+               "task not created");
+    start_ms = xTaskGetTickCount();
+    while ((send(NET_TX_PRIORITY_CONTROL, 'C', 0u, 4u, 0u) != CY_RSLT_SUCCESS) &&
+           ((xTaskGetTickCount() - start_ms) < TIMEOUT_MS))
+    {
+        vTaskDelay(1u);
+    }
+    (void)wait_sent(1u);
+    TEST_CHECK((sent[0].tag == 'C') && (sent[0].size == 4u), "first datagram %c of %u bytes", sent[0].tag,
+               sent[0].size);
+}
+
+/*******************************************************************************
+* Function Name: test_order
+********************************************************************************
+* Summary:
+*  Queued behind a send, control goes before telemetry and telemetry before
+*  bulk, whatever order they were queued in, oldest first within each.
+*
+*******************************************************************************/
+static void test_order(void)
+{
+    static const uint8_t expected[][2] =
+    {
+        { 'C', 0u }, { 'C', 1u }, { 'T', 0u }, { 'T', 1u }, { 'B', 0u }, { 'B', 1u }, { 'B', 2u }
+    };
+    uint32_t first = hold_task(NET_TX_PRIORITY_CONTROL, 'C');
+
+    (void)send(NET_TX_PRIORITY_BULK, 'B', 0u, DATAGRAM_SIZE, 0u);
+    (void)send(NET_TX_PRIORITY_TELEMETRY, 'T', 0u, 16u, 0u);
+    (void)send(NET_TX_PRIORITY_BULK, 'B', 1u, DATAGRAM_SIZE, 0u);
+    (void)send(NET_TX_PRIORITY_TELEMETRY, 'T', 1u, 16u, 0u);
+    (void)send(NET_TX_PRIORITY_BULK, 'B', 2u, DATAGRAM_SIZE, 0u);
+    (void)send(NET_TX_PRIORITY_CONTROL, 'C', 1u, 4u, 0u);
+    gate(false);
+
+    if (!wait_sent(first + 7u))
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < 7u; i++)
+    {
+        TEST_CHECK((sent[first + i].tag == expected[i][0]) && (sent[first + i].seq == expected[i][1]),
+                   "datagram %u is %c%u, expected %c%u", i, sent[first + i].tag, sent[first + i].seq,
+                   expected[i][0], expected[i][1]);
+    }
+}
+
+/*******************************************************************************
+* Function Name: test_limits
+********************************************************************************
+* Summary:
+*  Each priority queues its own number of datagrams, the one in the send
+*  included, and refuses the next without blocking, or after wait_ms with
+*  net_tx_send_wait. Datagrams larger than their priority are refused. The
+*  queued datagrams are all sent, in order.
+*
+*******************************************************************************/
+static void test_limits(void)
+{
+    uint32_t first = hold_task(NET_TX_PRIORITY_CONTROL, 'H');
+    uint32_t control = fill(NET_TX_PRIORITY_CONTROL, 'C', 4u);
+    uint32_t telemetry = fill(NET_TX_PRIORITY_TELEMETRY, 'T', NET_TX_MESSAGE_MAX_SIZE);
+    uint32_t bulk = fill(NET_TX_PRIORITY_BULK, 'B', NET_TX_BULK_MAX_SIZE);
+
+    TEST_CHECK(control == NET_TX_CONTROL_QUEUE_LENGTH - 1u, "%u control datagrams queued", control);
+    TEST_CHECK(telemetry == NET_TX_TELEMETRY_QUEUE_LENGTH, "%u telemetry datagrams queued", telemetry);
+    TEST_CHECK(bulk == NET_TX_BULK_QUEUE_LENGTH, "%u bulk datagrams queued", bulk);
+
+    uint32_t start_ms = xTaskGetTickCount();
+    TEST_CHECK(send(NET_TX_PRIORITY_BULK, 'B', 0u, 4u, 50u) == CY_RSLT_MODULE_SECURE_SOCKETS_NOMEM,
+               "bulk datagram queued on a full queue");
+    uint32_t wait_ms = xTaskGetTickCount() - start_ms;
+    TEST_CHECK(wait_ms >= 49u, "full queue refused after %u ms", wait_ms);
+
+    TEST_CHECK(send(NET_TX_PRIORITY_CONTROL, 'C', 0u, NET_TX_MESSAGE_MAX_SIZE + 1u, 0u) ==
+               CY_RSLT_MODULE_SECURE_SOCKETS_BADARG, "oversized control datagram not refused");
+    TEST_CHECK(send(NET_TX_PRIORITY_BULK, 'B', 0u, NET_TX_BULK_MAX_SIZE + 1u, 0u) ==
+               CY_RSLT_MODULE_SECURE_SOCKETS_BADARG, "oversized bulk datagram not refused");
+    gate(false);
+
+    if (!wait_sent(first + 1u + control + telemetry + bulk))
+    {
+        return;
+    }
+    first++;
+    for (uint32_t i = 0; i < control + telemetry + bulk; i++)
+    {
+        uint8_t tag = (i < control) ? 'C' : ((i < control + telemetry) ? 'T' : 'B');
+        uint32_t seq = (i < control) ? i : ((i < control + telemetry) ? (i - control) : (i - control - telemetry));
+
+        TEST_CHECK((sent[first + i].tag == tag) && (sent[first + i].seq == seq), "datagram %u is %c%u, expected %c%u",
+                   i, sent[first + i].tag, sent[first + i].seq, tag, seq);
+    }
+    TEST_CHECK(sent[first + control + telemetry].size == NET_TX_BULK_MAX_SIZE, "bulk datagram of %u bytes sent",
+               sent[first + control + telemetry].size);
+}
+
+/*******************************************************************************
+* Function Name: test_failure
+********************************************************************************
+* Summary:
+*  Failed sends return their messages to the pool like sent ones: after a
+*  full queue of failures, the queue takes as many datagrams again.
+*
+*******************************************************************************/
+static void test_failure(void)
+{
+    uint32_t first = sent_total();
+
+    pthread_mutex_lock(&log_mutex);
+    fail_count = NET_TX_CONTROL_QUEUE_LENGTH;
+    pthread_mutex_unlock(&log_mutex);
+
+    gate(true);
+    uint32_t control = fill(NET_TX_PRIORITY_CONTROL, 'C', 4u);
+    gate(false);
+    TEST_CHECK(control == NET_TX_CONTROL_QUEUE_LENGTH, "%u control datagrams queued", control);
+    if (!wait_sent(first + control))
+    {
+        return;
+    }
+    TEST_CHECK(fail_count == 0u, "%u sends did not fail", fail_count);
+
+    first = hold_task(NET_TX_PRIORITY_TELEMETRY, 'H');
+    control = fill(NET_TX_PRIORITY_CONTROL, 'C', 4u);
+    gate(false);
+    TEST_CHECK(control == NET_TX_CONTROL_QUEUE_LENGTH, "%u control datagrams queued after failed sends", control);
+    (void)wait_sent(first + 1u + control);
+}
+
+/*******************************************************************************
+* Function Name: test_pacing
+********************************************************************************
+* Summary:
+*  A sender waiting for free messages is paced: from an idle start, the
+*  bulk bytes whose sends started by any time are at most the rate times
+*  the time since the first, plus the burst, and the last of them takes
+*  about as long as that allows. A control datagram queued behind paced
+*  bulk datagrams is sent before most of them.
+*
+*******************************************************************************/
+static void test_pacing(void)
+{
+    uint32_t first;
+    uint32_t refused = 0;
+    uint64_t bytes = 0;
+    uint32_t bulk_after = 0;
+
+    /* Idle long enough to fill the bucket */
+    vTaskDelay(100u);
+    first = sent_total();
+    for (uint32_t i = 0; i < PACED_DATAGRAMS; i++)
+    {
+        if (send(NET_TX_PRIORITY_BULK, 'B', (uint8_t)i, DATAGRAM_SIZE, TIMEOUT_MS) != CY_RSLT_SUCCESS)
+        {
+            refused++;
+        }
+    }
+    TEST_CHECK(refused == 0u, "%u paced datagrams refused", refused);
+    if (!wait_sent(first + PACED_DATAGRAMS))
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < PACED_DATAGRAMS; i++)
+    {
+        uint32_t elapsed_ms = sent[first + i].ms - sent[first].ms;
+        /* A millisecond of rounding of the clock */
+        double allowed = (double)UDP_PACING_RATE_BPS * (elapsed_ms + 1u) / 1000.0 + UDP_PACING_BURST_BYTES;
+
+        bytes += sent[first + i].size;
+        TEST_CHECK((double)bytes <= allowed, "%llu bytes sent within %u ms, %.0f allowed", (unsigned long long)bytes,
+                   elapsed_ms, allowed);
+    }
+    uint32_t total_ms = sent[first + PACED_DATAGRAMS - 1u].ms - sent[first].ms;
+    uint32_t expected_ms = (uint32_t)(((double)bytes - DATAGRAM_SIZE - UDP_PACING_BURST_BYTES) * 1000.0 /
+                                      UDP_PACING_RATE_BPS);
+    printf("%u bulk datagrams paced over %u ms, %u ms at the rate\n", PACED_DATAGRAMS, total_ms, expected_ms);
+    TEST_CHECK(total_ms < expected_ms + 100u, "paced datagrams took %u ms", total_ms);
+
+    /* The bucket is empty: the bulk datagrams leave one by one */
+    first = sent_total();
+    uint32_t bulk = fill(NET_TX_PRIORITY_BULK, 'B', DATAGRAM_SIZE);
+    (void)send(NET_TX_PRIORITY_CONTROL, 'C', 0u, 4u, 0u);
+    if (!wait_sent(first + bulk + 1u))
+    {
+        return;
+    }
+    for (uint32_t i = 0; i <= bulk; i++)
+    {
+        if (sent[first + i].tag == 'C')
+        {
+            bulk_after = bulk - i;
+            break;
+        }
+    }
+    TEST_CHECK(bulk_after >= bulk - 2u, "control datagram sent before only %u of %u bulk datagrams", bulk_after,
+               bulk);
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the network TX task.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    test_start();
+    test_order();
+    test_limits();
+    test_failure();
+    test_pacing();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
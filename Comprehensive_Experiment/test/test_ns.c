@@ -0,0 +1,383 @@
+/******************************************************************************
+* File Name:   test_ns.c
+*
+* Description: This file contains the host test of the spectral subtraction
+* noise suppressor. A synthetic corpus of voiced syllables (a gliding pitch
+* through two formants) with pauses is mixed with white and pink noise at 0,
+* 5 and 10 dB SNR; the suppressor runs on it with the labels of the VAD, as
+* in the capture path. The objective measure is the segmental SNR of the
+* speech frames against the clean signal, and the attenuation of the pauses.
+* The test also checks that the suppressor is transparent until it has
+* learned a noise, that a loud tone passes unchanged, and reports the time
+* per frame against the 10 ms real-time budget.
+*
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_ns.h"
+#include "audio_vad.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define SAMPLE_RATE_HZ                      (16000u)
+/* A 10 ms frame at 16 kHz */
+#define FRAME_SAMPLES                       (160u)
+#define SECONDS                             (15u)
+#define SAMPLES                             (SECONDS * SAMPLE_RATE_HZ)
+#define FRAMES                              (SAMPLES / FRAME_SAMPLES)
+#define FRAMES_PER_SECOND                   (SAMPLE_RATE_HZ / FRAME_SAMPLES)
+/* RMS of the active speech */
+#define SPEECH_RMS                          (3000.0)
+/* Segmental SNR limits of every frame, dB */
+#define SEG_SNR_MIN                         (-10.0)
+#define SEG_SNR_MAX                         (35.0)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    bool     pink;
+    double   snr_db;
+    double   min_gain_db;                   /* Least segmental SNR gain accepted */
+} condition_t;
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static const condition_t conditions[] =
+{
+    { false, 0.0, 2.5 }, { false, 5.0, 0.5 }, { false, 10.0, 0.5 },
+    { true, 0.0, 3.0 }, { true, 5.0, 2.5 }, { true, 10.0, 2.5 },
+};
+
+static audio_ns_t ns;
+static audio_vad_t vad;
+static double speech[SAMPLES];
+static double noise[SAMPLES];
+static int16_t clean[SAMPLES];
+static int16_t noisy[SAMPLES];
+static int16_t output[SAMPLES];
+
+/*******************************************************************************
+* Function Name: make_speech
+********************************************************************************
+* Summary:
+*  Fills the corpus with syllables of 120 to 320 ms, each a harmonic series
+*  on a pitch of 100 to 220 Hz with a 3 Hz vibrato, shaped by two formants
+*  and a half sine envelope. Most syllables follow on closely, about a third
+*  are followed by a pause of 200 to 800 ms.
+*
+*******************************************************************************/
+static void make_speech(void)
+{
+    uint32_t t = SAMPLE_RATE_HZ / 2u;
+    double power = 0.0;
+    uint32_t active = 0;
+
+    memset(speech, 0, sizeof(speech));
+    while (t < SAMPLES - SAMPLE_RATE_HZ / 2u)
+    {
+        uint32_t length = (uint32_t)(SAMPLE_RATE_HZ * (0.12 + 0.2 * test_uniform()));
+        double f0 = 100.0 + 120.0 * test_uniform();
+        double f1 = 300.0 + 600.0 * test_uniform();
+        double f2 = 900.0 + 1500.0 * test_uniform();
+        double phase = 0.0;
+
+        for (uint32_t i = 0; (i < length) && ((t + i) < SAMPLES); i++)
+        {
+            double f = f0 * (1.0 + 0.1 * sin(2.0 * M_PI * 3.0 * i / SAMPLE_RATE_HZ));
+            double x = 0.0;
+
+            phase += 2.0 * M_PI * f / SAMPLE_RATE_HZ;
+            for (uint32_t k = 1u; (k * f) < (SAMPLE_RATE_HZ / 2u - 200u); k++)
+            {
+                double a = 1.0 / (1.0 + pow((k * f - f1) / 150.0, 2.0)) +
+                           0.6 / (1.0 + pow((k * f - f2) / 200.0, 2.0)) + 0.05;
+                x += a * sin(k * phase) / k;
+            }
+            speech[t + i] = sin(M_PI * i / length) * x;
+        }
+
+        t += length;
+        t += (test_uniform() < 0.3) ? (uint32_t)(SAMPLE_RATE_HZ * (0.2 + 0.6 * test_uniform()))
+                                    : (uint32_t)(SAMPLE_RATE_HZ * 0.03 * test_uniform());
+    }
+
+    for (uint32_t n = 0; n < SAMPLES; n++)
+    {
+        power += speech[n] * speech[n];
+        active += (speech[n] != 0.0) ? 1u : 0u;
+    }
+    double scale = SPEECH_RMS / sqrt(power / active);
+    for (uint32_t n = 0; n < SAMPLES; n++)
+    {
+        speech[n] *= scale;
+        clean[n] = test_saturate(speech[n]);
+    }
+}
+
+/*******************************************************************************
+* Function Name: make_noise
+********************************************************************************
+* Summary:
+*  Fills the noise with white noise, or pink noise from three first order
+*  sections, scaled to the given SNR against the active speech.
+*
+*******************************************************************************/
+static void make_noise(bool pink, double snr_db)
+{
+    double b0 = 0.0;
+    double b1 = 0.0;
+    double b2 = 0.0;
+    double power = 0.0;
+
+    for (uint32_t n = 0; n < SAMPLES; n++)
+    {
+        double w = test_gauss();
+
+        if (pink)
+        {
+            b0 = 0.99765 * b0 + w * 0.0990460;
+            b1 = 0.96300 * b1 + w * 0.2965164;
+            b2 = 0.57000 * b2 + w * 1.0526913;
+            w = b0 + b1 + b2 + w * 0.1848;
+        }
+        noise[n] = w;
+        power += w * w;
+    }
+
+    double scale = SPEECH_RMS / sqrt(power / SAMPLES) / pow(10.0, snr_db / 20.0);
+    for (uint32_t n = 0; n < SAMPLES; n++)
+    {
+        noisy[n] = test_saturate(speech[n] + scale * noise[n]);
+    }
+}
+
+/*******************************************************************************
+* Function Name: suppress
+********************************************************************************
+* Summary:
+*  Runs the suppressor in place over the noisy corpus, frame by frame with
+*  the labels of the VAD, and returns the time per frame in microseconds.
+*
+*******************************************************************************/
+static double suppress(void)
+{
+    struct timespec t0, t1;
+    double seconds = 0.0;
+
+    memcpy(output, noisy, sizeof(output));
+    (void)audio_ns_init(&ns, FRAME_SAMPLES);
+    audio_vad_init(&vad);
+
+    for (uint32_t f = 0; f < FRAMES; f++)
+    {
+        bool is_speech = audio_vad_process(&vad, &noisy[f * FRAME_SAMPLES], FRAME_SAMPLES);
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        audio_ns_process(&ns, &output[f * FRAME_SAMPLES], is_speech);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        seconds += (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    }
+    return seconds / FRAMES * 1e6;
+}
+
+/*******************************************************************************
+* Function Name: clamp_db
+********************************************************************************
+* Summary:
+*  Limits a frame SNR to the range of the segmental SNR.
+*
+*******************************************************************************/
+static double clamp_db(double db)
+{
+    return (db < SEG_SNR_MIN) ? SEG_SNR_MIN : ((db > SEG_SNR_MAX) ? SEG_SNR_MAX : db);
+}
+
+/*******************************************************************************
+* Function Name: test_corpus
+********************************************************************************
+* Summary:
+*  In every condition the suppressor raises the segmental SNR of the speech
+*  frames by at least the figure of the condition and attenuates the pauses
+*  by more than 10 dB. The output is one frame late.
+*
+*******************************************************************************/
+static void test_corpus(void)
+{
+    double worst_us = 0.0;
+
+    make_speech();
+    for (uint32_t c = 0; c < sizeof(conditions) / sizeof(conditions[0]); c++)
+    {
+        double seg_in = 0.0;
+        double seg_out = 0.0;
+        double pause_in = 0.0;
+        double pause_out = 0.0;
+        uint32_t segments = 0;
+
+        make_noise(conditions[c].pink, conditions[c].snr_db);
+        double us = suppress();
+        worst_us = (us > worst_us) ? us : worst_us;
+
+        /* The first frames, before the VAD has seen the noise, are left out */
+        for (uint32_t f = 5u; f < FRAMES - 1u; f++)
+        {
+            double signal = 0.0;
+            double error_in = 0.0;
+            double error_out = 0.0;
+            double level_in = 0.0;
+            double level_out = 0.0;
+
+            for (uint32_t i = 0; i < FRAME_SAMPLES; i++)
+            {
+                uint32_t n = f * FRAME_SAMPLES + i;
+                double x = clean[n];
+                double y = output[n + FRAME_SAMPLES];
+
+                signal += x * x;
+                error_in += (noisy[n] - x) * (noisy[n] - x);
+                error_out += (y - x) * (y - x);
+                level_in += (double)noisy[n] * noisy[n];
+                level_out += y * y;
+            }
+
+            if (signal == 0.0)
+            {
+                pause_in += level_in;
+                pause_out += level_out;
+                continue;
+            }
+            seg_in += clamp_db(10.0 * log10(signal / (error_in + 1.0)));
+            seg_out += clamp_db(10.0 * log10(signal / (error_out + 1.0)));
+            segments++;
+        }
+
+        double gain = (seg_out - seg_in) / segments;
+        double pause_db = 10.0 * log10(pause_in / pause_out);
+        printf("%s noise %2.0f dB SNR: segmental SNR %+6.2f -> %+6.2f dB (%+.2f), pauses -%.1f dB\n",
+               conditions[c].pink ? "pink " : "white", conditions[c].snr_db,
+               seg_in / segments, seg_out / segments, gain, pause_db);
+        TEST_CHECK(gain >= conditions[c].min_gain_db, "%s %.0f dB: segmental SNR gain %.2f dB",
+                   conditions[c].pink ? "pink" : "white", conditions[c].snr_db, gain);
+        TEST_CHECK((pause_db > 10.0) && (pause_db < 20.5), "%s %.0f dB: pauses attenuated by %.1f dB",
+                   conditions[c].pink ? "pink" : "white", conditions[c].snr_db, pause_db);
+    }
+
+    printf("suppressor: %.1f us per %u ms frame on the host (%.2f %% of real time)\n",
+           worst_us, FRAME_SAMPLES * 1000u / SAMPLE_RATE_HZ, worst_us / 100.0);
+}
+
+/*******************************************************************************
+* Function Name: test_transparent
+********************************************************************************
+* Summary:
+*  Until a silent frame has taught it a noise, the suppressor returns its
+*  input one frame late within 2 LSB. A tone 30 dB above the learned noise
+*  keeps its level.
+*
+*******************************************************************************/
+static void test_transparent(void)
+{
+    int32_t worst = 0;
+
+    for (uint32_t n = 0; n < SAMPLES; n++)
+    {
+        noisy[n] = test_saturate(8000.0 * test_gauss());
+    }
+    memcpy(output, noisy, sizeof(output));
+    (void)audio_ns_init(&ns, FRAME_SAMPLES);
+    for (uint32_t f = 0; f < FRAMES; f++)
+    {
+        audio_ns_process(&ns, &output[f * FRAME_SAMPLES], true);
+    }
+    for (uint32_t n = FRAME_SAMPLES; n < SAMPLES; n++)
+    {
+        int32_t error = abs(output[n] - noisy[n - FRAME_SAMPLES]);
+        worst = (error > worst) ? error : worst;
+    }
+    TEST_CHECK(worst <= 2, "no noise learned: output off the input by %d LSB", worst);
+
+    /* One second of noise at 100 RMS, then a tone of 100 * 10^1.5 RMS */
+    double in = 0.0;
+    double out = 0.0;
+    (void)audio_ns_init(&ns, FRAME_SAMPLES);
+    for (uint32_t n = 0; n < SAMPLES; n++)
+    {
+        double tone = (n < SAMPLE_RATE_HZ) ? 0.0 : 3162.0 * M_SQRT2 * sin(2.0 * M_PI * 700.0 * n / SAMPLE_RATE_HZ);
+        noisy[n] = test_saturate(tone + 100.0 * test_gauss());
+    }
+    memcpy(output, noisy, sizeof(output));
+    for (uint32_t f = 0; f < FRAMES; f++)
+    {
+        audio_ns_process(&ns, &output[f * FRAME_SAMPLES], f >= FRAMES_PER_SECOND);
+    }
+    for (uint32_t n = 2u * SAMPLE_RATE_HZ; n < SAMPLES - FRAME_SAMPLES; n++)
+    {
+        in += (double)noisy[n] * noisy[n];
+        out += (double)output[n + FRAME_SAMPLES] * output[n + FRAME_SAMPLES];
+    }
+    double gain = 10.0 * log10(out / in);
+    printf("tone 30 dB above the noise: %+.2f dB\n", gain);
+    TEST_CHECK(fabs(gain) < 0.3, "tone 30 dB above the noise changed by %.2f dB", gain);
+}
+
+/*******************************************************************************
+* Function Name: test_config
+********************************************************************************
+* Summary:
+*  Frame lengths that do not fit the FFT are refused; the noise estimate
+*  follows a gain change.
+*
+*******************************************************************************/
+static void test_config(void)
+{
+    int16_t frame[FRAME_SAMPLES];
+
+    TEST_CHECK(!audio_ns_init(&ns, 0u), "frame length 0 accepted");
+    TEST_CHECK(!audio_ns_init(&ns, AUDIO_NS_MAX_HOP + 1u), "frame length %u accepted", AUDIO_NS_MAX_HOP + 1u);
+    TEST_CHECK(audio_ns_init(&ns, AUDIO_NS_MAX_HOP), "frame length %u refused", AUDIO_NS_MAX_HOP);
+
+    (void)audio_ns_init(&ns, FRAME_SAMPLES);
+    for (uint32_t f = 0; f < 50u; f++)
+    {
+        for (uint32_t i = 0; i < FRAME_SAMPLES; i++)
+        {
+            frame[i] = test_saturate(1000.0 * test_gauss());
+        }
+        audio_ns_process(&ns, frame, false);
+    }
+    uint64_t before = ns.noise[100];
+    audio_ns_scale_noise(&ns, 4u << 16);
+    TEST_CHECK(ns.noise_valid && (before > 0u) && (ns.noise[100] == 4u * before),
+               "6 dB gain step: noise %llu from %llu", (unsigned long long)ns.noise[100],
+               (unsigned long long)before);
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the noise suppressor.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    audio_fft_init();
+
+    test_config();
+    test_transparent();
+    test_corpus();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+/******************************************************************************
+* File Name:   test_pacer.c
+*
+* Description: This file contains the host test of the token bucket that
+* paces the datagrams sent to the UDP server. The waits are checked
+* against the token arithmetic on the virtual clock, including rates that
+* do not divide a byte per millisecond, the debt limit, a wrap of the clock
+* and idle times that would overflow the refill. Senders run for a while
+* check that paced and unpaced traffic together keep to the rate.
+*
+*******************************************************************************/
+
+#include "audio_pacer.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define DATAGRAM_SIZE                       (1472u)
+#define RUN_MS                              (60000u)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static audio_pacer_t pacer;
+
+/*******************************************************************************
+* Function Name: test_unpaced
+********************************************************************************
+* Summary:
+*  A rate of 0 never waits, whatever was sent.
+*
+*******************************************************************************/
+static void test_unpaced(void)
+{
+    uint32_t waits = 0;
+
+    audio_pacer_init(&pacer, 0u, 4000u, 0u);
+    for (uint32_t i = 0; i < 1000u; i++)
+    {
+        waits += audio_pacer_delay(&pacer, DATAGRAM_SIZE, 0u);
+        audio_pacer_consume(&pacer, DATAGRAM_SIZE, 0u);
+    }
+    TEST_CHECK(waits == 0u, "unpaced sender waited %u ms", waits);
+}
+
+/*******************************************************************************
+* Function Name: test_delay
+********************************************************************************
+* Summary:
+*  A full bucket sends a burst at once; an empty bucket waits the time the
+*  rate takes to refill the datagram, rounded up to whole milliseconds, and
+*  not a millisecond longer. Datagrams larger than the bucket wait for a
+*  full bucket, and buckets larger than the limit are clamped.
+*
+*******************************************************************************/
+static void test_delay(void)
+{
+    /* 100 bytes per millisecond */
+    audio_pacer_init(&pacer, 100000u, 4000u, 1000u);
+    TEST_CHECK(audio_pacer_delay(&pacer, 4000u, 1000u) == 0u, "full bucket waits");
+    audio_pacer_consume(&pacer, 4000u, 1000u);
+    TEST_CHECK(audio_pacer_delay(&pacer, 1000u, 1000u) == 10u, "1000 bytes wait %u ms",
+               audio_pacer_delay(&pacer, 1000u, 1000u));
+    TEST_CHECK(audio_pacer_delay(&pacer, 1000u, 1004u) == 6u, "1000 bytes wait %u ms after 4 ms",
+               audio_pacer_delay(&pacer, 1000u, 1004u));
+    TEST_CHECK(audio_pacer_delay(&pacer, 1000u, 1010u) == 0u, "1000 bytes wait after 10 ms");
+    TEST_CHECK(audio_pacer_delay(&pacer, 9000u, 1010u) == 30u, "datagram larger than the bucket waits %u ms",
+               audio_pacer_delay(&pacer, 9000u, 1010u));
+
+    /* 3 bytes per millisecond: 1000 bytes need 333 1/3 ms */
+    audio_pacer_init(&pacer, 3000u, 2000u, 0u);
+    audio_pacer_consume(&pacer, 2000u, 0u);
+    uint32_t wait_ms = audio_pacer_delay(&pacer, 1000u, 0u);
+    TEST_CHECK(wait_ms == 334u, "1000 bytes at 3000 B/s wait %u ms", wait_ms);
+    TEST_CHECK(audio_pacer_delay(&pacer, 1000u, wait_ms - 1u) == 1u, "wait not exact");
+    TEST_CHECK(audio_pacer_delay(&pacer, 1000u, wait_ms) == 0u, "wait too short");
+    audio_pacer_consume(&pacer, 1000u, wait_ms);
+    /* 334 ms refilled 1002 bytes, the 2 left over are kept */
+    TEST_CHECK(pacer.tokens == 2 * 1000, "left over %d tokens", (int)pacer.tokens);
+
+    audio_pacer_init(&pacer, 1000000u, 5000000u, 0u);
+    TEST_CHECK(pacer.burst == 1000000u, "bucket of %u bytes", pacer.burst);
+}
+
+/*******************************************************************************
+* Function Name: test_debt
+********************************************************************************
+* Summary:
+*  Senders that do not wait run the bucket into debt, which paced senders
+*  wait off; the debt stops at one bucket.
+*
+*******************************************************************************/
+static void test_debt(void)
+{
+    audio_pacer_init(&pacer, 100000u, 4000u, 0u);
+    audio_pacer_consume(&pacer, 4000u, 0u);
+    audio_pacer_consume(&pacer, 2000u, 0u);
+    TEST_CHECK(audio_pacer_delay(&pacer, 1000u, 0u) == 30u, "1000 bytes after 2000 of debt wait %u ms",
+               audio_pacer_delay(&pacer, 1000u, 0u));
+
+    for (uint32_t i = 0; i < 100u; i++)
+    {
+        audio_pacer_consume(&pacer, DATAGRAM_SIZE, 0u);
+    }
+    TEST_CHECK(pacer.tokens == -4000 * 1000, "debt of %d tokens", (int)pacer.tokens);
+    TEST_CHECK(audio_pacer_delay(&pacer, 1000u, 0u) == 50u, "1000 bytes after the largest debt wait %u ms",
+               audio_pacer_delay(&pacer, 1000u, 0u));
+}
+
+/*******************************************************************************
+* Function Name: test_clock
+********************************************************************************
+* Summary:
+*  The millisecond clock wraps without a spurious wait or refill, and idle
+*  times whose tokens overflow 32 bits fill the bucket.
+*
+*******************************************************************************/
+static void test_clock(void)
+{
+    audio_pacer_init(&pacer, 100000u, 4000u, 0xFFFFFFF0u);
+    audio_pacer_consume(&pacer, 4000u, 0xFFFFFFF0u);
+    TEST_CHECK(audio_pacer_delay(&pacer, 4000u, 0xFFFFFFF0u + 16u) == 24u, "4000 bytes across the wrap wait %u ms",
+               audio_pacer_delay(&pacer, 4000u, 0xFFFFFFF0u + 16u));
+    TEST_CHECK(audio_pacer_delay(&pacer, 4000u, 24u) == 0u, "clock wrap not handled");
+
+    /* 10 MB/s idle for 1000 s: 10^13 tokens */
+    audio_pacer_init(&pacer, 10000000u, 1000000u, 0u);
+    audio_pacer_consume(&pacer, 1000000u, 0u);
+    audio_pacer_consume(&pacer, 1000000u, 0u);
+    (void)audio_pacer_delay(&pacer, 0u, 1000000u);
+    TEST_CHECK(pacer.tokens == 1000000 * 1000, "idle bucket holds %d tokens", (int)pacer.tokens);
+}
+
+/*******************************************************************************
+* Function Name: run
+********************************************************************************
+* Summary:
+*  Sends datagrams for RUN_MS on a 1 ms virtual clock: a paced sender with
+*  a datagram always ready, and an unpaced sender of a datagram every
+*  unpaced_period_ms, 0 for none. Returns the bytes sent in all.
+*
+*******************************************************************************/
+static uint64_t run(uint32_t rate, uint32_t burst, uint32_t unpaced_period_ms)
+{
+    uint64_t sent = 0;
+
+    audio_pacer_init(&pacer, rate, burst, 0u);
+    for (uint32_t now_ms = 0; now_ms < RUN_MS; now_ms++)
+    {
+        if ((unpaced_period_ms != 0u) && ((now_ms % unpaced_period_ms) == 0u))
+        {
+            audio_pacer_consume(&pacer, DATAGRAM_SIZE, now_ms);
+            sent += DATAGRAM_SIZE;
+        }
+        while (audio_pacer_delay(&pacer, DATAGRAM_SIZE, now_ms) == 0u)
+        {
+            audio_pacer_consume(&pacer, DATAGRAM_SIZE, now_ms);
+            sent += DATAGRAM_SIZE;
+        }
+    }
+    return sent;
+}
+
+/*******************************************************************************
+* Function Name: test_rate
+********************************************************************************
+* Summary:
+*  Over RUN_MS the senders send no more than the rate plus the initial
+*  bucket, and less by under a datagram, at rates above and below a byte
+*  per millisecond and with unpaced traffic of a fifth of the rate.
+*
+*******************************************************************************/
+static void test_rate(void)
+{
+    static const uint32_t rates[] = { 900u, 64000u, 250000u, 1234567u };
+
+    for (uint32_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+    {
+        uint32_t burst = 4u * DATAGRAM_SIZE;
+        /* The last datagrams leave at RUN_MS - 1 */
+        double allowed = (double)rates[r] * (RUN_MS - 1u) / 1000.0 + burst;
+        uint32_t unpaced_period_ms = (uint32_t)(5.0 * DATAGRAM_SIZE * 1000.0 / rates[r]);
+
+        double paced = (double)run(rates[r], burst, 0u);
+        double mixed = (double)run(rates[r], burst, unpaced_period_ms);
+        printf("%7u B/s: bytes sent %.4f of those allowed, %.4f with unpaced traffic\n", rates[r], paced / allowed,
+               mixed / allowed);
+        TEST_CHECK((paced <= allowed) && (paced > allowed - DATAGRAM_SIZE), "%u B/s: %.0f bytes sent, %.0f allowed",
+                   rates[r], paced, allowed);
+        TEST_CHECK((mixed <= allowed) && (mixed > allowed - DATAGRAM_SIZE),
+                   "%u B/s with unpaced traffic: %.0f bytes sent, %.0f allowed", rates[r], mixed, allowed);
+    }
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the token bucket.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    test_unpaced();
+    test_delay();
+    test_debt();
+    test_clock();
+    test_rate();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
@@ -0,0 +1,252 @@
+/******************************************************************************
+* File Name:   test_packet.c
+*
+* Description: This file contains the host test of the upload datagram
+* framing. The CRC-32 is checked against the check value of the IEEE 802.3
+* polynomial, and encoded datagrams against golden bytes produced by
+* build_packet of the UDP server (python/udp.py). Random datagrams survive
+* the encode and decode round trip; truncated datagrams, a wrong magic and
+* every single bit error are rejected. The test also reports the CRC
+* throughput on the host.
+*
+*******************************************************************************/
+
+#include <string.h>
+#include <time.h>
+
+#include "audio_packet.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define ROUND_TRIPS                         (1000u)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* build_packet(1, START, 0x1234, 0, 0, pack('<IBBH', 16000, 8, 2, 1008)) */
+static const uint8_t golden_start[] =
+{
+    0x41, 0x55, 0x01, 0x01, 0x34, 0x12, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x17, 0x51, 0x7E,
+    0x80, 0x3E, 0x00, 0x00, 0x08, 0x02, 0xF0, 0x03
+};
+/* build_packet(1, 0, 0x1234, 7, 0xA1B2C3, b'123456789') */
+static const uint8_t golden_data[] =
+{
+    0x41, 0x55, 0x01, 0x00, 0x34, 0x12, 0x07, 0x00, 0xC3, 0xB2, 0xA1, 0x00, 0x36, 0x9F, 0xE3, 0x96,
+    0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39
+};
+
+static uint8_t datagram[AUDIO_PACKET_HEADER_SIZE + AUDIO_PACKET_MAX_PAYLOAD];
+
+/*******************************************************************************
+* Function Name: same_header
+********************************************************************************
+* Summary:
+*  Returns true if two headers have the same fields.
+*
+*******************************************************************************/
+static bool same_header(const audio_packet_header_t *a, const audio_packet_header_t *b)
+{
+    return (a->codec == b->codec) && (a->flags == b->flags) && (a->session == b->session) &&
+           (a->seq == b->seq) && (a->offset == b->offset);
+}
+
+/*******************************************************************************
+* Function Name: test_crc
+********************************************************************************
+* Summary:
+*  The CRC-32 of "123456789" is the check value 0xCBF43926, the CRC of
+*  nothing is 0, and a message in pieces gives the CRC of the whole.
+*
+*******************************************************************************/
+static void test_crc(void)
+{
+    const uint8_t *check = (const uint8_t *)"123456789";
+    uint32_t whole = audio_packet_crc32(0u, check, 9u);
+    uint32_t pieces = audio_packet_crc32(audio_packet_crc32(audio_packet_crc32(0u, check, 2u), &check[2], 0u),
+                                         &check[2], 7u);
+
+    TEST_CHECK(whole == 0xCBF43926u, "CRC of \"123456789\" 0x%08X", whole);
+    TEST_CHECK(pieces == whole, "CRC in pieces 0x%08X", pieces);
+    TEST_CHECK(audio_packet_crc32(0u, check, 0u) == 0u, "CRC of nothing not 0");
+}
+
+/*******************************************************************************
+* Function Name: test_golden
+********************************************************************************
+* Summary:
+*  The encoder produces the bytes of the server's build_packet, and the
+*  decoder returns their fields and payload.
+*
+*******************************************************************************/
+static void test_golden(void)
+{
+    const audio_packet_header_t start = { 1u, AUDIO_PACKET_FLAG_START, 0x1234u, 0u, 0u };
+    const audio_packet_header_t data = { 1u, 0u, 0x1234u, 7u, 0xA1B2C3u };
+    audio_packet_header_t header;
+    const uint8_t *payload;
+    uint32_t payload_size;
+
+    memcpy(&datagram[AUDIO_PACKET_HEADER_SIZE], &golden_start[AUDIO_PACKET_HEADER_SIZE],
+           sizeof(golden_start) - AUDIO_PACKET_HEADER_SIZE);
+    uint32_t size = audio_packet_encode(&start, datagram, sizeof(golden_start) - AUDIO_PACKET_HEADER_SIZE);
+    TEST_CHECK((size == sizeof(golden_start)) && (memcmp(datagram, golden_start, size) == 0),
+               "start datagram differs from the server's");
+
+    memcpy(&datagram[AUDIO_PACKET_HEADER_SIZE], "123456789", 9u);
+    size = audio_packet_encode(&data, datagram, 9u);
+    TEST_CHECK((size == sizeof(golden_data)) && (memcmp(datagram, golden_data, size) == 0),
+               "data datagram differs from the server's");
+
+    TEST_CHECK(audio_packet_decode(golden_data, sizeof(golden_data), &header, &payload, &payload_size) &&
+               same_header(&header, &data) && (payload == &golden_data[AUDIO_PACKET_HEADER_SIZE]) &&
+               (payload_size == 9u), "server datagram not decoded");
+
+    /* A header without payload, like the feedback of the server */
+    size = audio_packet_encode(&start, datagram, 0u);
+    TEST_CHECK((size == AUDIO_PACKET_HEADER_SIZE) &&
+               audio_packet_decode(datagram, size, &header, &payload, &payload_size) && (payload_size == 0u),
+               "empty payload not decoded");
+}
+
+/*******************************************************************************
+* Function Name: test_round_trip
+********************************************************************************
+* Summary:
+*  Random headers and payloads of every size up to the largest decode to
+*  the fields and payload encoded; flags added after encoding, as for a
+*  retransmission, keep the datagram valid.
+*
+*******************************************************************************/
+static void test_round_trip(void)
+{
+    static uint8_t sent[AUDIO_PACKET_MAX_PAYLOAD];
+    uint32_t failures = 0;
+
+    for (uint32_t trial = 0; trial < ROUND_TRIPS; trial++)
+    {
+        audio_packet_header_t header =
+        {
+            (uint8_t)(test_uniform() * 256.0), (uint8_t)(test_uniform() * 256.0),
+            (uint16_t)(test_uniform() * 65536.0), (uint16_t)(test_uniform() * 65536.0),
+            (uint32_t)(test_uniform() * 4294967296.0)
+        };
+        uint32_t payload_size = (trial * 7919u) % (AUDIO_PACKET_MAX_PAYLOAD + 1u);
+        audio_packet_header_t decoded;
+        const uint8_t *payload;
+        uint32_t decoded_size;
+
+        for (uint32_t i = 0; i < payload_size; i++)
+        {
+            sent[i] = (uint8_t)(test_uniform() * 256.0);
+        }
+        memcpy(&datagram[AUDIO_PACKET_HEADER_SIZE], sent, payload_size);
+        uint32_t size = audio_packet_encode(&header, datagram, payload_size);
+
+        bool ok = (size == AUDIO_PACKET_HEADER_SIZE + payload_size) &&
+                  audio_packet_decode(datagram, size, &decoded, &payload, &decoded_size) &&
+                  same_header(&decoded, &header) && (decoded_size == payload_size) &&
+                  (memcmp(payload, sent, payload_size) == 0);
+
+        audio_packet_set_flags(datagram, size, AUDIO_PACKET_FLAG_RETRANSMIT);
+        header.flags |= AUDIO_PACKET_FLAG_RETRANSMIT;
+        ok = ok && audio_packet_decode(datagram, size, &decoded, &payload, &decoded_size) &&
+             same_header(&decoded, &header);
+
+        failures += ok ? 0u : 1u;
+    }
+
+    TEST_CHECK(failures == 0u, "%u of %u datagrams lost in the round trip", failures, ROUND_TRIPS);
+}
+
+/*******************************************************************************
+* Function Name: test_corruption
+********************************************************************************
+* Summary:
+*  Every single bit error of a datagram, in the header, the CRC or the
+*  payload, is rejected, as are a datagram shorter than the header, a
+*  wrong magic and a datagram cut short or extended by a byte.
+*
+*******************************************************************************/
+static void test_corruption(void)
+{
+    const audio_packet_header_t header = { 2u, 0u, 0xBEEFu, 1234u, 567890u };
+    audio_packet_header_t decoded;
+    const uint8_t *payload;
+    uint32_t payload_size;
+    uint32_t accepted = 0;
+
+    for (uint32_t i = 0; i < 1000u; i++)
+    {
+        datagram[AUDIO_PACKET_HEADER_SIZE + i] = (uint8_t)(test_uniform() * 256.0);
+    }
+    uint32_t size = audio_packet_encode(&header, datagram, 1000u);
+
+    for (uint32_t bit = 0; bit < 8u * size; bit++)
+    {
+        datagram[bit / 8u] ^= (uint8_t)(1u << (bit % 8u));
+        accepted += audio_packet_decode(datagram, size, &decoded, &payload, &payload_size) ? 1u : 0u;
+        datagram[bit / 8u] ^= (uint8_t)(1u << (bit % 8u));
+    }
+    TEST_CHECK(accepted == 0u, "%u single bit errors accepted", accepted);
+
+    TEST_CHECK(audio_packet_decode(datagram, size, &decoded, &payload, &payload_size), "intact datagram rejected");
+    TEST_CHECK(!audio_packet_decode(datagram, size - 1u, &decoded, &payload, &payload_size), "cut datagram accepted");
+    TEST_CHECK(!audio_packet_decode(datagram, size + 1u, &decoded, &payload, &payload_size),
+               "extended datagram accepted");
+    TEST_CHECK(!audio_packet_decode(datagram, AUDIO_PACKET_HEADER_SIZE - 1u, &decoded, &payload, &payload_size),
+               "datagram shorter than the header accepted");
+
+    /* A datagram of the old protocol, the "aaaa" start marker */
+    TEST_CHECK(!audio_packet_decode((const uint8_t *)"aaaaaaaaaaaaaaaa", 16u, &decoded, &payload, &payload_size),
+               "datagram without magic accepted");
+}
+
+/*******************************************************************************
+* Function Name: test_throughput
+********************************************************************************
+* Summary:
+*  Reports the throughput of encoding full datagrams on the host.
+*
+*******************************************************************************/
+static void test_throughput(void)
+{
+    const audio_packet_header_t header = { 1u, 0u, 1u, 0u, 0u };
+    const uint32_t rounds = 20000u;
+    struct timespec t0, t1;
+    uint32_t sink = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        sink += audio_packet_encode(&header, datagram, AUDIO_PACKET_MAX_PAYLOAD);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    printf("encode: %.0f MB/s on the host\n", sink / seconds * 1e-6);
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the datagram framing.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    test_crc();
+    test_golden();
+    test_round_trip();
+    test_corruption();
+    test_throughput();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
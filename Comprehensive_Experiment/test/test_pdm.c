@@ -0,0 +1,255 @@
+/******************************************************************************
+* File Name:   test_pdm.c
+*
+* Description: This file contains the host test and the benchmark of the
+* software PDM decimator. A second order sigma-delta modulator encodes a
+* -6 dBFS 1 kHz tone at every supported decimation rate; the decimator has
+* to match a bit-serial CIC and FIR reference exactly, fed in chunks of
+* varying size, and reach the SINAD of the modulator. The throughput is
+* reported in Msamples/s.
+*
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_pdm.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define PCM_RATE_HZ                         (16000u)
+#define TONE_HZ                             (1000.0)
+/* PCM samples of the test signal, 1 s */
+#define PCM_SAMPLES                         (PCM_RATE_HZ)
+/* Samples skipped before the SINAD is measured, the filters settle */
+#define SETTLE_SAMPLES                      (1000u)
+#define BENCHMARK_RUNS                      (20u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+/* Bit-serial CIC and direct form FIR, written from their definition */
+typedef struct
+{
+    uint32_t integrator[AUDIO_PDM_CIC_ORDER];
+    uint32_t comb[AUDIO_PDM_CIC_ORDER];
+    uint32_t bits;
+    int32_t  delay[AUDIO_PDM_FIR_TAPS];
+    uint32_t phase;
+} reference_t;
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* The taps of audio_pdm.c, a copy so that the reference stays independent */
+static const int16_t reference_taps[AUDIO_PDM_FIR_TAPS] =
+{
+    0, 3, 5, -5, -14, 7, 33, -7, -63, 1, 109, 14,
+    -177, -45, 272, 98, -399, -186, 567, 323, -785, -535, 1071, 867,
+    -1458, -1416, 2018, 2447, -2925, -4990, 4493, 17061, 17061, 4493, -4990, -2925,
+    2447, 2018, -1416, -1458, 867, 1071, -535, -785, 323, 567, -186, -399,
+    98, 272, -45, -177, 14, 109, 1, -63, -7, 33, 7, -14,
+    -5, 5, 3, 0
+};
+
+static int16_t output[PCM_SAMPLES + 1u];
+static int16_t expected[PCM_SAMPLES + 1u];
+
+/*******************************************************************************
+* Function Name: reference_run
+********************************************************************************
+* Summary:
+*  Decimates PDM bytes one bit at a time.
+*
+*******************************************************************************/
+static uint32_t reference_run(reference_t *ref, const uint8_t *pdm, uint32_t num_bytes, int16_t *out,
+                              uint32_t cic_rate, uint32_t log2_rate)
+{
+    uint32_t written = 0;
+
+    for (uint32_t i = 0; i < num_bytes; i++)
+    {
+        for (int32_t b = 7; b >= 0; b--)
+        {
+            ref->integrator[0] += (pdm[i] >> b) & 1u;
+            for (uint32_t k = 1; k < AUDIO_PDM_CIC_ORDER; k++)
+            {
+                ref->integrator[k] += ref->integrator[k - 1u];
+            }
+            if (++ref->bits < cic_rate)
+            {
+                continue;
+            }
+            ref->bits = 0;
+
+            uint32_t value = ref->integrator[AUDIO_PDM_CIC_ORDER - 1u];
+            for (uint32_t s = 0; s < AUDIO_PDM_CIC_ORDER; s++)
+            {
+                uint32_t diff = value - ref->comb[s];
+                ref->comb[s] = value;
+                value = diff;
+            }
+
+            int32_t sample = (int32_t)(value - (1u << (AUDIO_PDM_CIC_ORDER * log2_rate - 1u)));
+            int32_t shift = 25 - (int32_t)(AUDIO_PDM_CIC_ORDER * log2_rate);
+            sample = (shift >= 0) ? (sample * (1 << shift)) : (sample >> -shift);
+
+            memmove(ref->delay, ref->delay + 1, (AUDIO_PDM_FIR_TAPS - 1u) * sizeof(int32_t));
+            ref->delay[AUDIO_PDM_FIR_TAPS - 1u] = sample;
+            if (++ref->phase < AUDIO_PDM_FIR_DECIMATION)
+            {
+                continue;
+            }
+            ref->phase = 0;
+
+            int64_t acc = 0;
+            for (uint32_t t = 0; t < AUDIO_PDM_FIR_TAPS; t++)
+            {
+                acc += (int64_t)ref->delay[t] * reference_taps[t];
+            }
+            acc = (acc + (1 << 23)) >> 24;
+            out[written++] = (int16_t)((acc > INT16_MAX) ? INT16_MAX : ((acc < INT16_MIN) ? INT16_MIN : acc));
+        }
+    }
+
+    return written;
+}
+
+/*******************************************************************************
+* Function Name: modulate
+********************************************************************************
+* Summary:
+*  Encodes the tone with a second order sigma-delta modulator, earliest bit
+*  first in each byte.
+*
+*******************************************************************************/
+static void modulate(uint8_t *pdm, uint32_t num_bits, uint32_t decimation)
+{
+    double i1 = 0.0;
+    double i2 = 0.0;
+    double y = 0.0;
+    double step = 2.0 * M_PI * TONE_HZ / ((double)PCM_RATE_HZ * decimation);
+
+    memset(pdm, 0, num_bits / 8u);
+    for (uint32_t k = 0; k < num_bits; k++)
+    {
+        i1 += 0.5 * sin(step * k) - y;
+        i2 += i1 - y;
+        y = (i2 >= 0.0) ? 1.0 : -1.0;
+        if (y > 0.0)
+        {
+            pdm[k / 8u] |= (uint8_t)(0x80u >> (k % 8u));
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: sinad_db
+********************************************************************************
+* Summary:
+*  Fits the tone to the settled samples and returns the ratio of its power
+*  to the power of the rest, in dB.
+*
+*******************************************************************************/
+static double sinad_db(const int16_t *pcm, uint32_t count, double *level_dbfs)
+{
+    double step = 2.0 * M_PI * TONE_HZ / PCM_RATE_HZ;
+    double c = 0.0;
+    double s = 0.0;
+    double signal = 0.0;
+    double error = 0.0;
+    uint32_t m = count - SETTLE_SAMPLES;
+
+    for (uint32_t k = SETTLE_SAMPLES; k < count; k++)
+    {
+        c += pcm[k] * cos(step * k);
+        s += pcm[k] * sin(step * k);
+    }
+    c *= 2.0 / m;
+    s *= 2.0 / m;
+
+    for (uint32_t k = SETTLE_SAMPLES; k < count; k++)
+    {
+        double fit = c * cos(step * k) + s * sin(step * k);
+        signal += fit * fit;
+        error += (pcm[k] - fit) * (pcm[k] - fit);
+    }
+
+    *level_dbfs = 20.0 * log10(hypot(c, s) / 32768.0);
+    return 10.0 * log10(signal / error);
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Checks and benchmarks the decimator at every supported rate.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    /* The SINAD of the test modulator at each rate, less a margin */
+    static const double min_sinad_db[] = { 50.0, 65.0, 80.0 };
+    static const uint32_t chunks[] = { 1u, 7u, 64u, 333u, 1000u };
+    uint32_t index = 0;
+
+    for (uint32_t decimation = AUDIO_PDM_MIN_DECIMATION; decimation <= AUDIO_PDM_MAX_DECIMATION;
+         decimation *= 2u, index++)
+    {
+        uint32_t num_bits = decimation * PCM_SAMPLES;
+        uint32_t num_bytes = num_bits / 8u;
+        uint8_t *pdm = malloc(num_bytes);
+        audio_pdm_t decimator;
+        reference_t ref = { 0 };
+        uint32_t cic_rate = decimation / AUDIO_PDM_FIR_DECIMATION;
+        uint32_t log2_rate = 0;
+        uint32_t count = 0;
+        double level_dbfs;
+
+        while ((1u << log2_rate) < cic_rate)
+        {
+            log2_rate++;
+        }
+
+        modulate(pdm, num_bits, decimation);
+        TEST_CHECK(audio_pdm_init(&decimator, decimation), "decimation %u refused", decimation);
+
+        for (uint32_t pos = 0, c = 0; pos < num_bytes; c++)
+        {
+            uint32_t size = chunks[c % (sizeof(chunks) / sizeof(chunks[0]))];
+            size = (pos + size > num_bytes) ? (num_bytes - pos) : size;
+            count += audio_pdm_process(&decimator, &pdm[pos], size, &output[count], 1u);
+            pos += size;
+        }
+
+        uint32_t expected_count = reference_run(&ref, pdm, num_bytes, expected, cic_rate, log2_rate);
+        TEST_CHECK((count == expected_count) && (memcmp(output, expected, count * sizeof(int16_t)) == 0),
+                   "decimation %u differs from the bit-serial reference", decimation);
+
+        double sinad = sinad_db(output, count, &level_dbfs);
+        TEST_CHECK(sinad >= min_sinad_db[index], "decimation %u: SINAD %.1f dB", decimation, sinad);
+
+        clock_t start = clock();
+        for (uint32_t run = 0; run < BENCHMARK_RUNS; run++)
+        {
+            (void)audio_pdm_process(&decimator, pdm, num_bytes, output, 1u);
+        }
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        printf("decimation %3u: tone %.1f dBFS, SINAD %.1f dB, %.0f Msamples/s PDM, %.1f Msamples/s PCM\n",
+               decimation, level_dbfs, sinad, BENCHMARK_RUNS * (double)num_bits / seconds * 1e-6,
+               BENCHMARK_RUNS * (double)PCM_SAMPLES / seconds * 1e-6);
+        free(pdm);
+    }
+
+    TEST_CHECK(!audio_pdm_init(&(audio_pdm_t){ 0 }, 48u), "decimation 48 accepted");
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+/******************************************************************************
+* File Name:   test_pool.c
+*
+* Description: This file contains the host stress test of the frame pool.
+* The main thread stands in for audio_task: it allocates every frame, fills
+* it with its sequence number and hands a reference of it to each of three
+* consumer threads, the way a recorded frame goes to the UDP upload and to
+* the SD card writer. Each consumer checks the contents of every frame
+* before it releases it. A frame returned to the pool while a consumer
+* still reads it shows up as a corrupted frame; a lost reference shows up
+* as a frame missing from the pool at the end.
+*
+*******************************************************************************/
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "audio_pool.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define FRAMES                              (200000u)
+#define CONSUMERS                           (3u)
+#define QUEUE_LENGTH                        (64u)
+/* A 10 ms frame at 16 kHz */
+#define FRAME_SAMPLES                       (160u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+/* Queue of frame references to one consumer, NULL ends the consumer */
+typedef struct
+{
+    audio_pool_frame_t *frames[QUEUE_LENGTH];
+    uint32_t head;
+    uint32_t tail;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} consumer_queue_t;
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static audio_pool_t pool;
+static consumer_queue_t queues[CONSUMERS];
+static atomic_uint corrupted;
+
+/*******************************************************************************
+* Function Name: queue_push
+********************************************************************************
+* Summary:
+*  Queues a frame reference to a consumer.
+*
+* Return:
+*  bool: false if the queue is full and the reference was not queued
+*
+*******************************************************************************/
+static bool queue_push(consumer_queue_t *queue, audio_pool_frame_t *frame)
+{
+    bool queued = false;
+
+    pthread_mutex_lock(&queue->mutex);
+    if ((queue->head - queue->tail) < QUEUE_LENGTH)
+    {
+        queue->frames[queue->head++ % QUEUE_LENGTH] = frame;
+        pthread_cond_signal(&queue->cond);
+        queued = true;
+    }
+    pthread_mutex_unlock(&queue->mutex);
+
+    return queued;
+}
+
+/*******************************************************************************
+* Function Name: queue_pop
+********************************************************************************
+* Summary:
+*  Waits for the next frame reference of a consumer.
+*
+*******************************************************************************/
+static audio_pool_frame_t *queue_pop(consumer_queue_t *queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->head == queue->tail)
+    {
+        pthread_cond_wait(&queue->cond, &queue->mutex);
+    }
+    audio_pool_frame_t *frame = queue->frames[queue->tail++ % QUEUE_LENGTH];
+    pthread_mutex_unlock(&queue->mutex);
+
+    return frame;
+}
+
+/*******************************************************************************
+* Function Name: consumer
+********************************************************************************
+* Summary:
+*  Checks and releases every frame queued to it until it receives NULL.
+*
+*******************************************************************************/
+static void *consumer(void *arg)
+{
+    consumer_queue_t *queue = arg;
+    audio_pool_frame_t *frame;
+    uint32_t count = 0;
+
+    while ((frame = queue_pop(queue)) != NULL)
+    {
+        for (uint32_t i = 0; i < frame->num_samples; i++)
+        {
+            if (frame->samples[i] != (int16_t)frame->seq)
+            {
+                atomic_fetch_add(&corrupted, 1u);
+                break;
+            }
+        }
+
+        /* Hold some frames longer, like a slow SD card write */
+        if ((++count % 8u) == 0u)
+        {
+            sched_yield();
+        }
+
+        audio_pool_release(frame);
+    }
+
+    return NULL;
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Fans the frames out to the consumers and checks the pool afterwards.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    pthread_t threads[CONSUMERS];
+    uint32_t alloc_waits = 0;
+    uint32_t dropped = 0;
+
+    audio_pool_init(&pool);
+    for (uint32_t c = 0; c < CONSUMERS; c++)
+    {
+        pthread_mutex_init(&queues[c].mutex, NULL);
+        pthread_cond_init(&queues[c].cond, NULL);
+        pthread_create(&threads[c], NULL, consumer, &queues[c]);
+    }
+
+    for (uint32_t seq = 0; seq < FRAMES; seq++)
+    {
+        audio_pool_frame_t *frame;
+        while ((frame = audio_pool_alloc(&pool)) == NULL)
+        {
+            alloc_waits++;
+            sched_yield();
+        }
+
+        frame->seq = seq;
+        frame->num_samples = FRAME_SAMPLES;
+        for (uint32_t i = 0; i < FRAME_SAMPLES; i++)
+        {
+            frame->samples[i] = (int16_t)seq;
+        }
+
+        for (uint32_t c = 0; c < CONSUMERS; c++)
+        {
+            audio_pool_retain(frame);
+            if (!queue_push(&queues[c], frame))
+            {
+                audio_pool_release(frame);
+                dropped++;
+            }
+        }
+        audio_pool_release(frame);
+    }
+
+    for (uint32_t c = 0; c < CONSUMERS; c++)
+    {
+        while (!queue_push(&queues[c], NULL))
+        {
+            sched_yield();
+        }
+        pthread_join(threads[c], NULL);
+    }
+
+    printf("%u frames to %u consumers: %u dropped on full queues, %u waits for a free frame\n",
+           FRAMES, CONSUMERS, dropped, alloc_waits);
+
+    TEST_CHECK(atomic_load(&corrupted) == 0u, "%u frames reused while referenced", atomic_load(&corrupted));
+    TEST_CHECK(audio_pool_available(&pool) == AUDIO_POOL_FRAMES, "%u of %u frames back in the pool",
+               audio_pool_available(&pool), AUDIO_POOL_FRAMES);
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+/******************************************************************************
+* File Name:   test_preroll.c
+*
+* Description: This file contains the host test of the pre-roll. The
+* capture is simulated as a continuous ramp, pushed frame by frame into the
+* pre-roll until a recording is requested; the recording is then assembled
+* the way record_start does, pre-roll oldest first followed by the live
+* frames. The test checks that the recording is gapless and starts
+* AUDIO_PREROLL_MS before the request, and the partially filled and cleared
+* pre-roll.
+*
+*******************************************************************************/
+
+#include "audio_preroll.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* A 10 ms frame at 16 kHz */
+#define FRAME_SAMPLES                       (160u)
+#define LIVE_FRAMES                         (20u)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static audio_preroll_t preroll;
+
+/*******************************************************************************
+* Function Name: capture
+********************************************************************************
+* Summary:
+*  Fills a frame of the simulated capture: sample n of the capture holds
+*  n modulo 2^16, so any gap or repeat shows up in the samples.
+*
+*******************************************************************************/
+static void capture(uint32_t seq, int16_t *samples)
+{
+    for (uint32_t i = 0; i < FRAME_SAMPLES; i++)
+    {
+        samples[i] = (int16_t)(seq * FRAME_SAMPLES + i);
+    }
+}
+
+/*******************************************************************************
+* Function Name: record
+********************************************************************************
+* Summary:
+*  Captures idle_frames frames into the pre-roll, speech flagged on every
+*  third, then records the pre-roll and LIVE_FRAMES live frames. Returns the
+*  sequence number of the first recorded frame and checks that the samples
+*  and speech flags follow on without a gap.
+*
+*******************************************************************************/
+static uint32_t record(uint32_t idle_frames)
+{
+    int16_t frame[FRAME_SAMPLES];
+    uint32_t expected_sample = 0;
+    uint32_t first_seq = idle_frames;
+    uint32_t gaps = 0;
+
+    audio_preroll_init(&preroll);
+    for (uint32_t seq = 0; seq < idle_frames; seq++)
+    {
+        capture(seq, frame);
+        audio_preroll_push(&preroll, frame, FRAME_SAMPLES, seq, (seq % 3u) == 0u);
+    }
+
+    /* record_start: the pre-roll oldest first, then the live frames */
+    uint32_t count = audio_preroll_count(&preroll);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const audio_preroll_frame_t *pre = audio_preroll_get(&preroll, i);
+
+        if (i == 0u)
+        {
+            first_seq = pre->seq;
+            expected_sample = pre->seq * FRAME_SAMPLES;
+        }
+        for (uint32_t s = 0; s < FRAME_SAMPLES; s++)
+        {
+            gaps += (pre->samples[s] != (int16_t)expected_sample++) ? 1u : 0u;
+        }
+        gaps += (pre->speech != ((pre->seq % 3u) == 0u)) ? 1u : 0u;
+    }
+    audio_preroll_clear(&preroll);
+
+    if (count == 0u)
+    {
+        expected_sample = idle_frames * FRAME_SAMPLES;
+    }
+    for (uint32_t seq = idle_frames; seq < idle_frames + LIVE_FRAMES; seq++)
+    {
+        capture(seq, frame);
+        for (uint32_t s = 0; s < FRAME_SAMPLES; s++)
+        {
+            gaps += (frame[s] != (int16_t)expected_sample++) ? 1u : 0u;
+        }
+    }
+
+    TEST_CHECK(gaps == 0u, "idle %u frames: %u samples or flags out of place", idle_frames, gaps);
+    TEST_CHECK(audio_preroll_count(&preroll) == 0u, "pre-roll not emptied");
+    return first_seq;
+}
+
+/*******************************************************************************
+* Function Name: test_full
+********************************************************************************
+* Summary:
+*  After a long idle time, also across the wrap of the slots, the recording
+*  starts exactly AUDIO_PREROLL_MS before the request.
+*
+*******************************************************************************/
+static void test_full(void)
+{
+    static const uint32_t idle[] = { AUDIO_PREROLL_FRAMES, AUDIO_PREROLL_FRAMES + 1u, 1000u, 12345u };
+
+    for (uint32_t i = 0; i < sizeof(idle) / sizeof(idle[0]); i++)
+    {
+        uint32_t first = record(idle[i]);
+        uint32_t lead_ms = (idle[i] - first) * AUDIO_STREAM_FRAME_MS;
+
+        TEST_CHECK(lead_ms == AUDIO_PREROLL_MS, "idle %u frames: recording starts %u ms early", idle[i], lead_ms);
+    }
+    printf("recording starts %u ms before the request\n", AUDIO_PREROLL_MS);
+}
+
+/*******************************************************************************
+* Function Name: test_partial
+********************************************************************************
+* Summary:
+*  A recording requested right after start up or after a profile change
+*  gets the frames captured so far, none with an empty pre-roll.
+*
+*******************************************************************************/
+static void test_partial(void)
+{
+    TEST_CHECK(record(0u) == 0u, "empty pre-roll: recording does not start live");
+    TEST_CHECK(record(7u) == 0u, "partial pre-roll: recording does not start at the first frame");
+
+    audio_preroll_init(&preroll);
+    TEST_CHECK(audio_preroll_get(&preroll, 0u) == NULL, "frame returned from an empty pre-roll");
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the pre-roll.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    test_full();
+    test_partial();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
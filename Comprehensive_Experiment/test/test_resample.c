@@ -0,0 +1,215 @@
+/******************************************************************************
+* File Name:   test_resample.c
+*
+* Description: This file contains the host test of the polyphase decimator.
+* The test is built with the SIMD kernel on, through the host intrinsics of
+* cmsis_compiler.h. A golden vector, computed offline by direct convolution
+* with the 2:1 taps, checks the filtering, the phase of the kept outputs and
+* the rounding and saturation. The test then measures the passband and
+* stopband of the 16 kHz to 8 kHz profile against the figures of
+* audio_resample.c and reports the throughput.
+*
+*******************************************************************************/
+
+#include <string.h>
+#include <time.h>
+
+#include "audio_resample.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define SAMPLE_RATE_HZ                      (16000u)
+/* A 10 ms frame at 16 kHz */
+#define FRAME_SAMPLES                       (160u)
+#define SAMPLES                             (2u * SAMPLE_RATE_HZ)
+#define GOLDEN_SAMPLES                      (96u)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* Decimated golden input: x[n] = (n * 7919) % 20001 - 10000 with a full scale
+ * spike at 40..42, from an empty history */
+static const int16_t golden_output[GOLDEN_SAMPLES / 2u] =
+{
+    2, -6, 17, -36, 65, -111, 180, -278, 420, -640, 1033, -2137,
+    -3724, -119, 2985, 2184, -1637, 5465, -3227, 3424, 576, -1928, 4293, -3784,
+    2407, -38, -2978, 3795, -5054, 2280, -1997, -1057, 26502, -18291, 3280, -3474,
+    -2720, -515, 3384, 2084, -1427, 5490, -3096, 3499, 680, -1845, 4409, -3733,
+};
+
+static int16_t input[SAMPLES];
+static int16_t output[SAMPLES];
+static int16_t output_ref[SAMPLES];
+
+/*******************************************************************************
+* Function Name: decimate
+********************************************************************************
+* Summary:
+*  Decimates the input in blocks with the SIMD or the reference kernel and
+*  returns the number of output samples.
+*
+*******************************************************************************/
+static uint32_t decimate(uint32_t factor, uint32_t block, bool ref, int16_t *out)
+{
+    static audio_resample_t rs;
+    uint32_t num_out = 0;
+
+    audio_resample_init(&rs, factor);
+    for (uint32_t n = 0; n < SAMPLES; n += block)
+    {
+        num_out += ref ? audio_resample_process_ref(&rs, &input[n], block, &out[num_out])
+                       : audio_resample_process(&rs, &input[n], block, &out[num_out]);
+    }
+    return num_out;
+}
+
+/*******************************************************************************
+* Function Name: test_golden
+********************************************************************************
+* Summary:
+*  Both kernels give the golden output, whatever the block size.
+*
+*******************************************************************************/
+static void test_golden(void)
+{
+    static const uint32_t blocks[] = { 2u, 16u, 48u, 96u };
+
+    memset(input, 0, sizeof(input));
+    for (uint32_t n = 0; n < GOLDEN_SAMPLES; n++)
+    {
+        input[n] = (int16_t)((int32_t)((n * 7919u) % 20001u) - 10000);
+    }
+    input[40] = INT16_MAX;
+    input[41] = INT16_MAX;
+    input[42] = INT16_MIN;
+
+    for (uint32_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++)
+    {
+        (void)decimate(2u, blocks[b], false, output);
+        (void)decimate(2u, blocks[b], true, output_ref);
+        TEST_CHECK(memcmp(output, golden_output, sizeof(golden_output)) == 0,
+                   "blocks of %u: SIMD output differs from the golden vector", blocks[b]);
+        TEST_CHECK(memcmp(output_ref, golden_output, sizeof(golden_output)) == 0,
+                   "blocks of %u: reference output differs from the golden vector", blocks[b]);
+    }
+
+    TEST_CHECK(AUDIO_DSP_USE_SIMD == 1, "built without the SIMD kernel");
+}
+
+/*******************************************************************************
+* Function Name: tone_gain_db
+********************************************************************************
+* Summary:
+*  Decimates a tone by 2 and returns its gain in dB, measured on the second
+*  half of the output against the input RMS.
+*
+*******************************************************************************/
+static double tone_gain_db(double freq_hz)
+{
+    const double amplitude = 16000.0;
+    double power = 0.0;
+
+    for (uint32_t n = 0; n < SAMPLES; n++)
+    {
+        input[n] = test_saturate(amplitude * sin(2.0 * M_PI * freq_hz * n / SAMPLE_RATE_HZ));
+    }
+    uint32_t num_out = decimate(2u, FRAME_SAMPLES, false, output);
+
+    for (uint32_t k = num_out / 2u; k < num_out; k++)
+    {
+        power += (double)output[k] * output[k];
+    }
+    power /= num_out / 2u;
+    return 10.0 * log10(power / (amplitude * amplitude / 2.0));
+}
+
+/*******************************************************************************
+* Function Name: test_response
+********************************************************************************
+* Summary:
+*  The 2:1 filter is flat within 0.02 dB up to 3.4 kHz and attenuates the
+*  band that would alias into it, from 4.6 kHz, by at least 53 dB.
+*
+*******************************************************************************/
+static void test_response(void)
+{
+    static const double pass_hz[] = { 100.0, 1000.0, 2500.0, 3400.0 };
+    static const double stop_hz[] = { 4600.0, 5000.0, 6000.0, 7900.0 };
+
+    for (uint32_t f = 0; f < sizeof(pass_hz) / sizeof(pass_hz[0]); f++)
+    {
+        double gain = tone_gain_db(pass_hz[f]);
+        printf("passband %4.0f Hz: %+.3f dB\n", pass_hz[f], gain);
+        TEST_CHECK(fabs(gain) < 0.02, "%.0f Hz: gain %.3f dB", pass_hz[f], gain);
+    }
+    for (uint32_t f = 0; f < sizeof(stop_hz) / sizeof(stop_hz[0]); f++)
+    {
+        double gain = tone_gain_db(stop_hz[f]);
+        printf("stopband %4.0f Hz: %+.1f dB\n", stop_hz[f], gain);
+        TEST_CHECK(gain < -53.0, "%.0f Hz: gain %.1f dB", stop_hz[f], gain);
+    }
+}
+
+/*******************************************************************************
+* Function Name: test_passthrough
+********************************************************************************
+* Summary:
+*  Factor 1 passes the samples through unchanged.
+*
+*******************************************************************************/
+static void test_passthrough(void)
+{
+    for (uint32_t n = 0; n < SAMPLES; n++)
+    {
+        input[n] = test_saturate(8000.0 * test_gauss());
+    }
+    uint32_t num_out = decimate(1u, FRAME_SAMPLES, false, output);
+
+    TEST_CHECK((num_out == SAMPLES) && (memcmp(input, output, sizeof(input)) == 0), "factor 1 changed the samples");
+}
+
+/*******************************************************************************
+* Function Name: test_throughput
+********************************************************************************
+* Summary:
+*  Reports the throughput of the 2:1 decimation on the host.
+*
+*******************************************************************************/
+static void test_throughput(void)
+{
+    const uint32_t rounds = 50u;
+    struct timespec t0, t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        (void)decimate(2u, FRAME_SAMPLES, false, output);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    printf("decimation 2:1: %.1f Msamples/s in on the host\n", rounds * SAMPLES / seconds * 1e-6);
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the polyphase decimator.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    test_golden();
+    test_response();
+    test_passthrough();
+    test_throughput();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
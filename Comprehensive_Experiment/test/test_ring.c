@@ -0,0 +1,179 @@
+/******************************************************************************
+* File Name:   test_ring.c
+*
+* Description: This file contains the host stress test of the capture ring.
+* A producer thread stands in for the PDM/PCM interrupt: like audio_stream
+* it fills one more frame buffer than the ring has slots, and only once the
+* ring has a free slot, then publishes it. Both threads yield while they
+* wait, so the test also runs on a single core. A consumer thread checks the
+* order of the descriptors and the contents of every frame before handing
+* its slot back. The test reports the throughput and the latency from the
+* push to the peek.
+*
+*******************************************************************************/
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "audio_ring.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define FRAMES                              (1000000u)
+/* A 10 ms frame at 16 kHz */
+#define FRAME_SAMPLES                       (160u)
+#define BUFFERS                             (AUDIO_RING_CAPACITY + 1u)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static audio_ring_t ring;
+static int16_t buffers[BUFFERS][FRAME_SAMPLES];
+/* Push time of every frame, ordered by the ring like the samples */
+static uint64_t push_ns[FRAMES];
+static uint32_t latency_ns[FRAMES];
+static uint32_t out_of_order;
+static uint32_t corrupted;
+
+/*******************************************************************************
+* Function Name: now_ns
+********************************************************************************
+* Summary:
+*  Returns the monotonic clock in nanoseconds.
+*
+*******************************************************************************/
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/*******************************************************************************
+* Function Name: producer
+********************************************************************************
+* Summary:
+*  Fills every frame with its sequence number and publishes it.
+*
+*******************************************************************************/
+static void *producer(void *arg)
+{
+    (void)arg;
+
+    for (uint32_t seq = 0; seq < FRAMES; seq++)
+    {
+        /* The buffer of frame seq - BUFFERS is free once the ring has room */
+        while (audio_ring_count(&ring) >= AUDIO_RING_CAPACITY)
+        {
+            sched_yield();
+        }
+
+        int16_t *samples = buffers[seq % BUFFERS];
+        for (uint32_t i = 0; i < FRAME_SAMPLES; i++)
+        {
+            samples[i] = (int16_t)(seq + i);
+        }
+
+        audio_ring_desc_t desc = { .samples = samples, .seq = seq };
+        push_ns[seq] = now_ns();
+        if (!audio_ring_push(&ring, &desc))
+        {
+            printf("FAIL: push refused with a free slot\n");
+            exit(1);
+        }
+    }
+
+    return NULL;
+}
+
+/*******************************************************************************
+* Function Name: consumer
+********************************************************************************
+* Summary:
+*  Checks every published frame, then hands its slot back.
+*
+*******************************************************************************/
+static void *consumer(void *arg)
+{
+    (void)arg;
+
+    for (uint32_t seq = 0; seq < FRAMES; seq++)
+    {
+        const audio_ring_desc_t *desc;
+        while ((desc = audio_ring_peek(&ring)) == NULL)
+        {
+            sched_yield();
+        }
+
+        latency_ns[seq] = (uint32_t)(now_ns() - push_ns[desc->seq]);
+        out_of_order += (desc->seq != seq) ? 1u : 0u;
+        for (uint32_t i = 0; i < FRAME_SAMPLES; i++)
+        {
+            if (desc->samples[i] != (int16_t)(desc->seq + i))
+            {
+                corrupted++;
+                break;
+            }
+        }
+
+        audio_ring_pop(&ring);
+    }
+
+    return NULL;
+}
+
+/*******************************************************************************
+* Function Name: compare_u32
+********************************************************************************
+* Summary:
+*  Orders latencies for qsort.
+*
+*******************************************************************************/
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the producer and the consumer concurrently and reports the results.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    pthread_t threads[2];
+
+    audio_ring_init(&ring);
+
+    uint64_t start = now_ns();
+    pthread_create(&threads[0], NULL, consumer, NULL);
+    pthread_create(&threads[1], NULL, producer, NULL);
+    pthread_join(threads[1], NULL);
+    pthread_join(threads[0], NULL);
+    double seconds = (double)(now_ns() - start) * 1e-9;
+
+    qsort(latency_ns, FRAMES, sizeof(latency_ns[0]), compare_u32);
+    printf("%u frames: %.2f M frames/s, latency median %u ns, 99%% %u ns, max %u ns\n",
+           FRAMES, FRAMES / seconds * 1e-6, latency_ns[FRAMES / 2u], latency_ns[FRAMES / 100u * 99u],
+           latency_ns[FRAMES - 1u]);
+
+    TEST_CHECK(out_of_order == 0u, "%u frames out of order", out_of_order);
+    TEST_CHECK(corrupted == 0u, "%u frames overwritten while held", corrupted);
+    TEST_CHECK(audio_ring_count(&ring) == 0u, "%u frames left in the ring", audio_ring_count(&ring));
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
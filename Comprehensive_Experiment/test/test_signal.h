@@ -0,0 +1,96 @@
+/******************************************************************************
+* File Name:   test_signal.h
+*
+* Description: This file contains the synthetic signals and the check macro
+* shared by the host tests. The noise generator is seeded, so every run of a
+* test sees the same samples.
+*
+*******************************************************************************/
+
+#ifndef TEST_SIGNAL_H_
+#define TEST_SIGNAL_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Reports a failed condition and counts it in test_failures */
+#define TEST_CHECK(cond, ...)                                               \
+    do {                                                                    \
+        if (!(cond))                                                        \
+        {                                                                   \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);                     \
+            printf(__VA_ARGS__);                                            \
+            printf("\n");                                                   \
+            test_failures++;                                                \
+        }                                                                   \
+    } while (0)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static unsigned test_failures;
+static uint32_t test_seed = 1u;
+
+/*******************************************************************************
+* Function Name: test_uniform
+********************************************************************************
+* Summary:
+*  Returns a uniform random number in (0, 1).
+*
+*******************************************************************************/
+static inline double test_uniform(void)
+{
+    test_seed = test_seed * 1664525u + 1013904223u;
+    return ((test_seed >> 8) + 0.5) / 16777216.0;
+}
+
+/*******************************************************************************
+* Function Name: test_gauss
+********************************************************************************
+* Summary:
+*  Returns a normally distributed random number of unit variance.
+*
+*******************************************************************************/
+static inline double test_gauss(void)
+{
+    return sqrt(-2.0 * log(test_uniform())) * cos(2.0 * M_PI * test_uniform());
+}
+
+/*******************************************************************************
+* Function Name: test_amplitude
+********************************************************************************
+* Summary:
+*  Converts an RMS level in dBFS to the RMS in samples.
+*
+*******************************************************************************/
+static inline double test_amplitude(double dbfs)
+{
+    return 32768.0 * pow(10.0, dbfs / 20.0);
+}
+
+/*******************************************************************************
+* Function Name: test_saturate
+********************************************************************************
+* Summary:
+*  Rounds and saturates a sample to 16 bits.
+*
+*******************************************************************************/
+static inline int16_t test_saturate(double x)
+{
+    x = (x >= 0.0) ? (x + 0.5) : (x - 0.5);
+    if (x > 32767.0)
+    {
+        return 32767;
+    }
+    if (x < -32768.0)
+    {
+        return -32768;
+    }
+    return (int16_t)x;
+}
+
+#endif /* TEST_SIGNAL_H_ */
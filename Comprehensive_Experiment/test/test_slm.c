@@ -0,0 +1,263 @@
+/******************************************************************************
+* File Name:   test_slm.c
+*
+* Description: This file contains the host test of the sound level meter.
+* The A-weighting is measured with tones at the nominal frequencies of
+* IEC 61672-1 and compared with the table of the standard at the uplink
+* sample rates. A calibrated 1 kHz tone checks the levels, the 'Fast'
+* decay rate, the gain compensation and the summary datagram of
+* python/udp.py. The test also reports the throughput of the meter.
+*
+*******************************************************************************/
+
+#include <string.h>
+#include <time.h>
+
+#include "audio_slm.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define FRAME_MS                            (10u)
+#define SAMPLE_RATE_HZ                      (16000u)
+#define FRAME_SAMPLES                       (SAMPLE_RATE_HZ * FRAME_MS / 1000u)
+#define FRAMES_PER_PERIOD                   (AUDIO_SLM_PERIOD_MS / FRAME_MS)
+/* Peak of a 1 kHz sine at 94 dB SPL: -26 dBFS at 0 dB gain */
+#define CALIBRATION_PEAK                    (0.0501 * 32767.0)
+#define TONE_SAMPLES                        (4u * 48000u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef struct
+{
+    double freq_hz;
+    double weight_db;                       /* A-weighting of IEC 61672-1 */
+} nominal_t;
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static const nominal_t nominal[] =
+{
+    { 20.0, -50.5 }, { 25.0, -44.7 }, { 31.5, -39.4 }, { 40.0, -34.6 }, { 50.0, -30.2 },
+    { 63.0, -26.2 }, { 80.0, -22.5 }, { 100.0, -19.1 }, { 125.0, -16.1 }, { 160.0, -13.4 },
+    { 200.0, -10.9 }, { 250.0, -8.6 }, { 315.0, -6.6 }, { 400.0, -4.8 }, { 500.0, -3.2 },
+    { 630.0, -1.9 }, { 800.0, -0.8 }, { 1000.0, 0.0 }, { 1250.0, 0.6 }, { 1600.0, 1.0 },
+    { 2000.0, 1.2 }, { 2500.0, 1.3 }, { 3150.0, 1.2 }, { 4000.0, 1.0 }, { 5000.0, 0.5 },
+    { 6300.0, -0.1 }, { 8000.0, -1.1 }, { 10000.0, -2.5 }, { 12500.0, -4.3 }, { 16000.0, -6.6 },
+};
+
+static audio_slm_t slm;
+static int16_t tone[TONE_SAMPLES];
+static int32_t weighted[TONE_SAMPLES];
+
+/*******************************************************************************
+* Function Name: weighting_db
+********************************************************************************
+* Summary:
+*  Returns the response of the A-weighting to a tone, measured over the
+*  second half of enough samples for the 20 Hz section to settle. The
+*  weighted samples carry 8 extra fraction bits.
+*
+*******************************************************************************/
+static double weighting_db(uint32_t sample_rate_hz, double freq_hz)
+{
+    uint32_t count = (freq_hz < 50.0) ? TONE_SAMPLES : (TONE_SAMPLES / 4u);
+    count = (count > sample_rate_hz * 20u) ? sample_rate_hz * 20u : count;
+    double in = 0.0;
+    double out = 0.0;
+
+    for (uint32_t n = 0; n < count; n++)
+    {
+        tone[n] = (int16_t)lround(8000.0 * sin(2.0 * M_PI * freq_hz * n / sample_rate_hz));
+    }
+    audio_slm_init(&slm, sample_rate_hz, FRAME_MS);
+    audio_slm_weight(&slm, tone, count, weighted);
+
+    for (uint32_t n = count / 2u; n < count; n++)
+    {
+        in += (double)tone[n] * tone[n] * 65536.0;
+        out += (double)weighted[n] * weighted[n];
+    }
+    return 10.0 * log10(out / in);
+}
+
+/*******************************************************************************
+* Function Name: test_weighting
+********************************************************************************
+* Summary:
+*  At 8, 16 and 48 kHz the A-weighting follows the table of the standard
+*  within 0.3 dB from 20 Hz to 0.4 of the sample rate, and is 0 dB at
+*  1 kHz.
+*
+*******************************************************************************/
+static void test_weighting(void)
+{
+    static const uint32_t rates_hz[] = { 8000u, 16000u, 48000u };
+
+    for (uint32_t r = 0; r < sizeof(rates_hz) / sizeof(rates_hz[0]); r++)
+    {
+        double worst = 0.0;
+        double worst_hz = 0.0;
+
+        for (uint32_t k = 0; k < sizeof(nominal) / sizeof(nominal[0]); k++)
+        {
+            if (nominal[k].freq_hz > 0.4 * rates_hz[r])
+            {
+                continue;
+            }
+            double error = weighting_db(rates_hz[r], nominal[k].freq_hz) - nominal[k].weight_db;
+            if (fabs(error) > fabs(worst))
+            {
+                worst = error;
+                worst_hz = nominal[k].freq_hz;
+            }
+        }
+
+        double one_khz = weighting_db(rates_hz[r], 1000.0);
+        double hundred_hz = weighting_db(rates_hz[r], 100.0);
+        printf("%5u Hz: 1 kHz %+.3f dB, 100 Hz %+.2f dB, worst error %+.2f dB at %.1f Hz\n",
+               rates_hz[r], one_khz, hundred_hz, worst, worst_hz);
+        TEST_CHECK(fabs(worst) <= 0.3, "%u Hz: %.2f dB off the standard at %.1f Hz", rates_hz[r], worst, worst_hz);
+        TEST_CHECK(fabs(one_khz) < 0.02, "%u Hz: %.3f dB at 1 kHz", rates_hz[r], one_khz);
+    }
+}
+
+/*******************************************************************************
+* Function Name: measure
+********************************************************************************
+* Summary:
+*  Feeds frames of a 1 kHz sine of the given peak, captured with the given
+*  gain in 0.5 dB units, to the meter. Returns true with the summary if a
+*  period ended.
+*
+*******************************************************************************/
+static bool measure(uint32_t frames, double peak, int16_t gain, audio_slm_summary_t *summary)
+{
+    static uint32_t t;
+    int16_t frame[FRAME_SAMPLES];
+    bool ended = false;
+
+    for (uint32_t f = 0; f < frames; f++)
+    {
+        for (uint32_t n = 0; n < FRAME_SAMPLES; n++, t++)
+        {
+            frame[n] = (int16_t)lround(peak * sin(2.0 * M_PI * 1000.0 * t / SAMPLE_RATE_HZ));
+        }
+        ended |= audio_slm_process(&slm, frame, FRAME_SAMPLES, gain, summary);
+    }
+    return ended;
+}
+
+/*******************************************************************************
+* Function Name: test_levels
+********************************************************************************
+* Summary:
+*  The calibration tone reads 94 dB and a tone 20 dB louder 114 dB; in the
+*  period of the step LAFmax reaches the new level and LAFmin stays below
+*  it. In silence the 'Fast' level decays at 34.7 dB/s, down to LAFmin at
+*  the end of the period. A tone captured with +10.5 dB of gain reads the
+*  same level.
+*
+*******************************************************************************/
+static void test_levels(void)
+{
+    audio_slm_summary_t summary;
+
+    audio_slm_init(&slm, SAMPLE_RATE_HZ, FRAME_MS);
+    TEST_CHECK(!measure(FRAMES_PER_PERIOD - 1u, CALIBRATION_PEAK, 0, &summary), "period ended early");
+    TEST_CHECK(measure(1u, CALIBRATION_PEAK, 0, &summary), "period did not end");
+    printf("94 dB tone: LAeq %.2f LAFmax %.2f LAFmin %.2f\n", summary.laeq_db, summary.lafmax_db, summary.lafmin_db);
+    TEST_CHECK((summary.period == 0u) && (fabs(summary.laeq_db - 94.0) < 0.05) &&
+               (fabs(summary.lafmax_db - 94.0) < 0.05), "94 dB tone: period %u LAeq %.2f LAFmax %.2f",
+               summary.period, summary.laeq_db, summary.lafmax_db);
+
+    (void)measure(FRAMES_PER_PERIOD, 10.0 * CALIBRATION_PEAK, 0, &summary);
+    printf("114 dB step: LAeq %.2f LAFmax %.2f LAFmin %.2f\n", summary.laeq_db, summary.lafmax_db, summary.lafmin_db);
+    TEST_CHECK((summary.period == 1u) && (fabs(summary.lafmax_db - 114.0) < 0.05) &&
+               (summary.lafmin_db > 94.0) && (summary.lafmin_db < 110.0) && (fabs(summary.laeq_db - 114.0) < 0.1),
+               "114 dB step: LAeq %.2f LAFmax %.2f LAFmin %.2f", summary.laeq_db, summary.lafmax_db, summary.lafmin_db);
+
+    /* Silence: 'Fast' decays by 10 log10(e) dB per 125 ms */
+    double before = 10.0 * log10(slm.fast);
+    (void)measure(50u, 0.0, 0, &summary);
+    double rate = (before - 10.0 * log10(slm.fast)) / 0.5;
+    printf("'Fast' decay: %.1f dB/s\n", rate);
+    TEST_CHECK(fabs(rate - 34.7) < 0.3, "'Fast' decays at %.1f dB/s", rate);
+    /* The third period holds 1 s of the decay */
+    TEST_CHECK(measure(FRAMES_PER_PERIOD, 0.0, 0, &summary), "period did not end");
+    TEST_CHECK((summary.period == 2u) && (fabs(summary.lafmin_db - (114.0 - 34.7)) < 0.5),
+               "silence: period %u LAFmin %.2f", summary.period, summary.lafmin_db);
+
+    audio_slm_init(&slm, SAMPLE_RATE_HZ, FRAME_MS);
+    (void)measure(FRAMES_PER_PERIOD, CALIBRATION_PEAK * pow(10.0, 10.5 / 20.0), 21, &summary);
+    TEST_CHECK(fabs(summary.laeq_db - 94.0) < 0.05, "+10.5 dB gain: LAeq %.2f", summary.laeq_db);
+}
+
+/*******************************************************************************
+* Function Name: test_encode
+********************************************************************************
+* Summary:
+*  The summary datagram holds "SL" and the period and levels in 0.01 dB,
+*  little endian, as decoded by python/udp.py; levels out of range are
+*  clamped.
+*
+*******************************************************************************/
+static void test_encode(void)
+{
+    static const uint8_t expected[AUDIO_SLM_SUMMARY_SIZE] =
+    {
+        'S', 'L', 0x34, 0x12, 0xB7, 0x24, 0x00, 0x00, 0xFF, 0xFF
+    };
+    audio_slm_summary_t summary = { .laeq_db = 93.99f, .lafmax_db = -3.0f, .lafmin_db = 700.0f, .period = 0x1234u };
+    uint8_t out[AUDIO_SLM_SUMMARY_SIZE];
+
+    TEST_CHECK(audio_slm_encode(&summary, out) == AUDIO_SLM_SUMMARY_SIZE, "summary size");
+    TEST_CHECK(memcmp(out, expected, sizeof(expected)) == 0, "summary datagram differs");
+}
+
+/*******************************************************************************
+* Function Name: test_throughput
+********************************************************************************
+* Summary:
+*  Reports the throughput of the meter on the host.
+*
+*******************************************************************************/
+static void test_throughput(void)
+{
+    const uint32_t frames = 20u * FRAMES_PER_PERIOD;
+    audio_slm_summary_t summary;
+    struct timespec t0, t1;
+
+    audio_slm_init(&slm, SAMPLE_RATE_HZ, FRAME_MS);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    (void)measure(frames, CALIBRATION_PEAK, 0, &summary);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    printf("meter: %.1f Msamples/s on the host, signal generation included\n",
+           frames * FRAME_SAMPLES / seconds * 1e-6);
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the sound level meter.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    test_weighting();
+    test_levels();
+    test_encode();
+    test_throughput();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
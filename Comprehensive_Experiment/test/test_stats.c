@@ -0,0 +1,324 @@
+/******************************************************************************
+* File Name:   test_stats.c
+*
+* Description: This file contains the host test of the audio quality
+* telemetry. The test is built with the SIMD frame pass on, through the host
+* intrinsics of cmsis_compiler.h, and compares it bit for bit with the
+* reference on noise, full scale and odd-length frames. Frames of known
+* content check the RMS, peak, clipped count and DC offset; simulated
+* speech bursts over a noise floor check the minimum statistics tracker
+* and a recording checks the summary sent to the server. The test also
+* reports the throughput of the frame pass.
+*
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_stats.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define SAMPLE_RATE_HZ                      (16000u)
+/* A 10 ms frame at 16 kHz */
+#define FRAME_SAMPLES                       (160u)
+#define FRAMES_PER_SECOND                   (SAMPLE_RATE_HZ / FRAME_SAMPLES)
+/* Frames of the whole minimum search window */
+#define NOISE_WINDOW_FRAMES                 (AUDIO_STATS_NOISE_SUBWINDOWS * AUDIO_STATS_NOISE_SUBWINDOW_FRAMES)
+
+/*******************************************************************************
+* Function Name: same_stats
+********************************************************************************
+* Summary:
+*  Returns true if two sets of frame statistics are identical.
+*
+*******************************************************************************/
+static bool same_stats(const audio_stats_frame_t *a, const audio_stats_frame_t *b)
+{
+    return (a->power == b->power) && (a->rms == b->rms) && (a->peak == b->peak) &&
+           (a->clipped == b->clipped) && (a->dc == b->dc);
+}
+
+/*******************************************************************************
+* Function Name: test_simd_exact
+********************************************************************************
+* Summary:
+*  The SIMD frame pass gives the statistics of the reference on noise at
+*  every level up to heavy clipping, on frames of every length up to a
+*  frame and a half, and on the extreme sample values.
+*
+*******************************************************************************/
+static void test_simd_exact(void)
+{
+    static int16_t samples[3u * FRAME_SAMPLES / 2u];
+    audio_stats_frame_t simd;
+    audio_stats_frame_t ref;
+    uint32_t mismatches = 0;
+
+    for (uint32_t trial = 0; trial < 2000u; trial++)
+    {
+        double sigma = 100.0 * pow(10.0, 3.0 * test_uniform());
+        double dc = 2000.0 * (2.0 * test_uniform() - 1.0);
+
+        for (uint32_t n = 0; n < sizeof(samples) / sizeof(samples[0]); n++)
+        {
+            samples[n] = test_saturate(dc + sigma * test_gauss());
+        }
+        uint32_t count = trial % (sizeof(samples) / sizeof(samples[0]) + 1u);
+
+        audio_stats_measure(samples, count, &simd);
+        audio_stats_measure_ref(samples, count, &ref);
+        mismatches += same_stats(&simd, &ref) ? 0u : 1u;
+    }
+
+    /* The extremes, also in the last sample of an odd frame */
+    static const int16_t extremes[] = { INT16_MIN, INT16_MAX, INT16_MIN, -32700, 32700, -32699, 32699, INT16_MIN, 0 };
+    for (uint32_t count = 0; count <= sizeof(extremes) / sizeof(extremes[0]); count++)
+    {
+        audio_stats_measure(extremes, count, &simd);
+        audio_stats_measure_ref(extremes, count, &ref);
+        mismatches += same_stats(&simd, &ref) ? 0u : 1u;
+    }
+
+    TEST_CHECK(AUDIO_DSP_USE_SIMD == 1, "built without the SIMD frame pass");
+    TEST_CHECK(mismatches == 0u, "SIMD frame pass differs from the reference in %u frames", mismatches);
+}
+
+/*******************************************************************************
+* Function Name: test_frame
+********************************************************************************
+* Summary:
+*  Frames of known content give the expected statistics: a square wave on a
+*  DC offset, a sine, a clipped sine and a frame of INT16_MIN, which counts
+*  as 32767.
+*
+*******************************************************************************/
+static void test_frame(void)
+{
+    int16_t samples[FRAME_SAMPLES];
+    audio_stats_frame_t stats;
+
+    for (uint32_t n = 0; n < FRAME_SAMPLES; n++)
+    {
+        samples[n] = (int16_t)(((n & 1u) ? -1000 : 1000) - 200);
+    }
+    audio_stats_measure(samples, FRAME_SAMPLES, &stats);
+    TEST_CHECK((stats.power == 1000000u) && (stats.rms == 1000u) && (stats.dc == -200) &&
+               (stats.peak == 1200u) && (stats.clipped == 0u),
+               "square on DC: power %u rms %u dc %d peak %u clipped %u",
+               stats.power, stats.rms, stats.dc, stats.peak, stats.clipped);
+
+    /* Exactly 4 periods of a 400 Hz sine, RMS 10000 / sqrt(2) */
+    for (uint32_t n = 0; n < FRAME_SAMPLES; n++)
+    {
+        samples[n] = (int16_t)lround(10000.0 * sin(2.0 * M_PI * 400.0 * n / SAMPLE_RATE_HZ));
+    }
+    audio_stats_measure(samples, FRAME_SAMPLES, &stats);
+    TEST_CHECK((abs((int32_t)stats.rms - 7071) <= 1) && (stats.peak == 10000u) && (stats.dc == 0),
+               "sine: rms %u peak %u dc %d", stats.rms, stats.peak, stats.dc);
+
+    /* Twice full scale, clipped: the samples from 32700 up count */
+    uint32_t expected_clipped = 0;
+    for (uint32_t n = 0; n < FRAME_SAMPLES; n++)
+    {
+        samples[n] = test_saturate(65536.0 * sin(2.0 * M_PI * 400.0 * n / SAMPLE_RATE_HZ));
+        expected_clipped += (abs(samples[n]) >= AUDIO_STATS_CLIP_LEVEL) ? 1u : 0u;
+    }
+    audio_stats_measure(samples, FRAME_SAMPLES, &stats);
+    TEST_CHECK((stats.clipped == expected_clipped) && (expected_clipped > FRAME_SAMPLES / 2u) &&
+               (stats.peak == INT16_MAX), "clipped sine: %u of %u clipped, peak %u",
+               stats.clipped, expected_clipped, stats.peak);
+
+    for (uint32_t n = 0; n < FRAME_SAMPLES; n++)
+    {
+        samples[n] = INT16_MIN;
+    }
+    audio_stats_measure(samples, FRAME_SAMPLES, &stats);
+    TEST_CHECK((stats.peak == INT16_MAX) && (stats.clipped == FRAME_SAMPLES) && (stats.dc == INT16_MIN) &&
+               (stats.power == 0u), "INT16_MIN frame: peak %u clipped %u dc %d power %u",
+               stats.peak, stats.clipped, stats.dc, stats.power);
+
+    audio_stats_measure(samples, 0u, &stats);
+    TEST_CHECK((stats.power == 0u) && (stats.rms == 0u) && (stats.peak == 0u) && (stats.clipped == 0u),
+               "empty frame not zero");
+}
+
+/*******************************************************************************
+* Function Name: track
+********************************************************************************
+* Summary:
+*  Feeds frames of white noise of the given RMS, with a loud tone burst of
+*  speech length in the first half of every second if speech is set, to the
+*  noise floor tracker. Returns the RMS of the final estimate.
+*
+*******************************************************************************/
+static double track(audio_stats_noise_t *noise, double rms, uint32_t frames, bool speech)
+{
+    int16_t samples[FRAME_SAMPLES];
+    audio_stats_frame_t stats;
+
+    for (uint32_t f = 0; f < frames; f++)
+    {
+        bool burst = speech && ((f % FRAMES_PER_SECOND) < (FRAMES_PER_SECOND / 2u));
+
+        for (uint32_t n = 0; n < FRAME_SAMPLES; n++)
+        {
+            double tone = burst ? 8000.0 * sin(2.0 * M_PI * 300.0 * (f * FRAME_SAMPLES + n) / SAMPLE_RATE_HZ) : 0.0;
+            samples[n] = test_saturate(tone + rms * test_gauss());
+        }
+        audio_stats_measure(samples, FRAME_SAMPLES, &stats);
+        audio_stats_noise_update(noise, stats.power);
+    }
+    return sqrt((double)noise->floor);
+}
+
+/*******************************************************************************
+* Function Name: test_noise_floor
+********************************************************************************
+* Summary:
+*  The noise floor estimate stays on the noise under speech bursts, within
+*  the bias of the uncorrected minimum; it follows a falling floor within
+*  0.2 s and a rising one within the search window, and scales with the
+*  gain.
+*
+*******************************************************************************/
+static void test_noise_floor(void)
+{
+    audio_stats_noise_t noise;
+
+    audio_stats_noise_init(&noise);
+    double floor = track(&noise, 300.0, 5u * FRAMES_PER_SECOND, true);
+    printf("noise floor under speech: RMS %.0f of 300\n", floor);
+    TEST_CHECK((floor > 0.85 * 300.0) && (floor <= 300.0), "noise 300 with speech: floor %.0f", floor);
+
+    floor = track(&noise, 100.0, 20u, false);
+    TEST_CHECK((floor > 0.8 * 100.0) && (floor < 1.2 * 100.0), "falling floor: %.0f after 20 frames", floor);
+
+    /* A rising floor: still low before the window has passed, then there */
+    floor = track(&noise, 1000.0, NOISE_WINDOW_FRAMES / 2u, true);
+    TEST_CHECK(floor < 200.0, "rising floor followed too early: %.0f", floor);
+    floor = track(&noise, 1000.0, NOISE_WINDOW_FRAMES + AUDIO_STATS_NOISE_SUBWINDOW_FRAMES, true);
+    printf("rising floor: RMS %.0f of 1000 after %.1f s\n", floor,
+           (double)(3u * NOISE_WINDOW_FRAMES / 2u + AUDIO_STATS_NOISE_SUBWINDOW_FRAMES) / FRAMES_PER_SECOND);
+    TEST_CHECK((floor > 0.85 * 1000.0) && (floor <= 1000.0), "rising floor: %.0f", floor);
+
+    /* A 6 dB gain step scales the power by 4 */
+    uint32_t before = noise.floor;
+    audio_stats_noise_scale(&noise, 4u << 16);
+    TEST_CHECK(noise.floor == 4u * before, "gain step: floor %u from %u", noise.floor, before);
+
+    /* Minima not taken yet stay unset */
+    audio_stats_noise_init(&noise);
+    audio_stats_noise_scale(&noise, 1u << 15);
+    TEST_CHECK((noise.minima[0] == UINT32_MAX) && (noise.window_min == UINT32_MAX), "unset minimum scaled");
+}
+
+/*******************************************************************************
+* Function Name: test_summary
+********************************************************************************
+* Summary:
+*  The summary of a recording gives the RMS of the mean power, the largest
+*  peak, the total clipped samples, the mean DC offset and the noise floor.
+*
+*******************************************************************************/
+static void test_summary(void)
+{
+    static const audio_stats_frame_t frames[] =
+    {
+        { .power = 1000000u, .rms = 1000u, .peak = 3000u, .clipped = 0u, .dc = 10 },
+        { .power = 4000000u, .rms = 2000u, .peak = 32767u, .clipped = 7u, .dc = -40 },
+        { .power = 4000000u, .rms = 2000u, .peak = 5000u, .clipped = 2u, .dc = 0 },
+    };
+    audio_stats_session_t session;
+    audio_stats_noise_t noise;
+    audio_stats_summary_t summary;
+
+    audio_stats_noise_init(&noise);
+    audio_stats_noise_update(&noise, 2500u);
+    audio_stats_session_init(&session);
+    audio_stats_session_summary(&session, &noise, &summary);
+    TEST_CHECK((summary.frames == 0u) && (summary.rms == 0u) && (summary.noise_floor == 50u),
+               "empty recording: frames %u rms %u floor %u", summary.frames, summary.rms, summary.noise_floor);
+
+    for (uint32_t f = 0; f < sizeof(frames) / sizeof(frames[0]); f++)
+    {
+        audio_stats_session_add(&session, &frames[f]);
+    }
+    audio_stats_session_summary(&session, &noise, &summary);
+    TEST_CHECK((summary.frames == 3u) && (summary.rms == 1732u) && (summary.peak == 32767u) &&
+               (summary.clipped == 9u) && (summary.dc == -10) && (summary.noise_floor == 50u),
+               "summary: frames %u rms %u peak %u clipped %u dc %d floor %u", summary.frames, summary.rms,
+               summary.peak, summary.clipped, summary.dc, summary.noise_floor);
+}
+
+/*******************************************************************************
+* Function Name: test_throughput
+********************************************************************************
+* Summary:
+*  Reports the throughput of the SIMD and reference frame passes.
+*
+*******************************************************************************/
+static void test_throughput(void)
+{
+    static int16_t samples[SAMPLE_RATE_HZ];
+    const uint32_t rounds = 200u;
+    audio_stats_frame_t stats;
+    struct timespec t0, t1, t2;
+    uint32_t sink = 0;
+
+    for (uint32_t n = 0; n < SAMPLE_RATE_HZ; n++)
+    {
+        samples[n] = test_saturate(3000.0 * test_gauss());
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        for (uint32_t n = 0; n < SAMPLE_RATE_HZ; n += FRAME_SAMPLES)
+        {
+            audio_stats_measure(&samples[n], FRAME_SAMPLES, &stats);
+            sink += stats.power;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        for (uint32_t n = 0; n < SAMPLE_RATE_HZ; n += FRAME_SAMPLES)
+        {
+            audio_stats_measure_ref(&samples[n], FRAME_SAMPLES, &stats);
+            sink -= stats.power;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+
+    double simd = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    double ref = (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) * 1e-9;
+    printf("frame pass: SIMD %.1f, reference %.1f Msamples/s on the host\n",
+           rounds * SAMPLE_RATE_HZ / simd * 1e-6, rounds * SAMPLE_RATE_HZ / ref * 1e-6);
+    TEST_CHECK(sink == 0u, "SIMD and reference powers differ");
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the audio quality telemetry.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    test_simd_exact();
+    test_frame();
+    test_noise_floor();
+    test_summary();
+    test_throughput();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+/******************************************************************************
+* File Name:   test_stream.c
+*
+* Description: This file contains the host test of the continuous capture.
+* The test stands in for the PDM/PCM interrupt: it fills the frame handed out
+* by audio_stream_start and audio_stream_frame_done with its sequence number.
+* The consumer gets every frame in order and intact, the buffer being
+* captured into is never one the consumer holds, and a stalled consumer
+* loses whole frames that show up as overruns and sequence gaps.
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "audio_stream.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* A 10 ms frame at the capture rate, mono */
+#define FRAME_SAMPLES                       AUDIO_STREAM_MAX_FRAME_SAMPLES
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static audio_stream_t stream;
+static int16_t *dma_frame;
+static uint32_t captured;
+
+/*******************************************************************************
+* Function Name: capture_frame
+********************************************************************************
+* Summary:
+*  Fills the frame owned by the PDM/PCM block with the number of the frame
+*  and completes it like the interrupt does. Returns whether the frame was
+*  published.
+*
+*******************************************************************************/
+static bool capture_frame(void)
+{
+    for (uint32_t i = 0; i < FRAME_SAMPLES; i++)
+    {
+        dma_frame[i] = (int16_t)(captured + i);
+    }
+    captured++;
+
+    return audio_stream_frame_done(&stream, &dma_frame);
+}
+
+/*******************************************************************************
+* Function Name: frame_intact
+********************************************************************************
+* Summary:
+*  Returns whether a frame holds the samples capture_frame wrote for its
+*  sequence number.
+*
+*******************************************************************************/
+static bool frame_intact(const audio_stream_frame_t *frame)
+{
+    for (uint32_t i = 0; i < FRAME_SAMPLES; i++)
+    {
+        if (frame->samples[i] != (int16_t)(frame->seq + i))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: test_in_order
+********************************************************************************
+* Summary:
+*  A consumer keeping up takes every frame in capture order, without loss.
+*
+*******************************************************************************/
+static void test_in_order(void)
+{
+    uint32_t expected = 0;
+    uint32_t broken = 0;
+
+    audio_stream_init(&stream);
+    dma_frame = audio_stream_start(&stream);
+    captured = 0;
+
+    for (uint32_t n = 0; n < 10000u; n++)
+    {
+        (void)capture_frame();
+
+        /* The consumer lags behind by up to three frames */
+        if ((n % 4u) == 3u)
+        {
+            const audio_stream_frame_t *frame;
+            while ((frame = audio_stream_get_frame(&stream)) != NULL)
+            {
+                broken += ((frame->seq != expected) || !frame_intact(frame)) ? 1u : 0u;
+                expected++;
+                audio_stream_release_frame(&stream);
+            }
+        }
+    }
+
+    TEST_CHECK(expected == captured, "%u of %u frames received", expected, captured);
+    TEST_CHECK(broken == 0u, "%u frames out of order or corrupted", broken);
+    TEST_CHECK(audio_stream_overruns(&stream) == 0u, "%u overruns", audio_stream_overruns(&stream));
+}
+
+/*******************************************************************************
+* Function Name: test_held_frames
+********************************************************************************
+* Summary:
+*  The consumer can hold every frame of the ring while the capture goes on
+*  into a buffer of its own; the frames held are not overwritten.
+*
+*******************************************************************************/
+static void test_held_frames(void)
+{
+    audio_stream_init(&stream);
+    dma_frame = audio_stream_start(&stream);
+    captured = 0;
+
+    for (uint32_t n = 0; n < AUDIO_RING_CAPACITY; n++)
+    {
+        TEST_CHECK(capture_frame(), "frame %u dropped with free slots", n);
+    }
+
+    for (uint32_t n = 0; n < AUDIO_STREAM_NUM_FRAMES; n++)
+    {
+        TEST_CHECK((dma_frame != stream.buffer[n]) || (n == stream.dma_index),
+                   "capture buffer is held by the consumer");
+    }
+
+    /* The ring is full: further frames are captured into the same buffer */
+    TEST_CHECK(!capture_frame(), "frame published into a full ring");
+    TEST_CHECK(!capture_frame(), "frame published into a full ring");
+
+    for (uint32_t n = 0; n < AUDIO_RING_CAPACITY; n++)
+    {
+        const audio_stream_frame_t *frame = audio_stream_get_frame(&stream);
+        TEST_CHECK((frame != NULL) && (frame->seq == n) && frame_intact(frame), "held frame %u lost", n);
+        audio_stream_release_frame(&stream);
+    }
+    TEST_CHECK(audio_stream_get_frame(&stream) == NULL, "dropped frame published");
+}
+
+/*******************************************************************************
+* Function Name: test_overrun
+********************************************************************************
+* Summary:
+*  Frames captured while the consumer stalls are dropped whole: they are
+*  counted as overruns and leave a gap in the sequence numbers.
+*
+*******************************************************************************/
+static void test_overrun(void)
+{
+    const uint32_t stalled = 25u;
+    const audio_stream_frame_t *frame;
+    uint32_t received = 0;
+    uint32_t last_seq = 0;
+
+    audio_stream_init(&stream);
+    dma_frame = audio_stream_start(&stream);
+    captured = 0;
+
+    for (uint32_t n = 0; n < stalled; n++)
+    {
+        (void)capture_frame();
+    }
+    while ((frame = audio_stream_get_frame(&stream)) != NULL)
+    {
+        received++;
+        audio_stream_release_frame(&stream);
+    }
+
+    (void)capture_frame();
+    frame = audio_stream_get_frame(&stream);
+    if (frame != NULL)
+    {
+        last_seq = frame->seq;
+        TEST_CHECK(frame_intact(frame), "frame after the overrun corrupted");
+    }
+
+    printf("stalled for %u frames: %u received, %u overruns\n", stalled, received, audio_stream_overruns(&stream));
+    TEST_CHECK(received == AUDIO_RING_CAPACITY, "%u frames received, expected %u", received, AUDIO_RING_CAPACITY);
+    TEST_CHECK(audio_stream_overruns(&stream) == stalled - AUDIO_RING_CAPACITY,
+               "%u overruns, expected %u", audio_stream_overruns(&stream), stalled - AUDIO_RING_CAPACITY);
+    TEST_CHECK(last_seq == stalled, "frame after the overrun has sequence %u, expected %u", last_seq, stalled);
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the capture stream.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    test_in_order();
+    test_held_frames();
+    test_overrun();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+/******************************************************************************
+* File Name:   test_vad.c
+*
+* Description: This file contains the host test of the voice activity
+* detector. Speech is a 200 Hz vowel-like tone switched on and off at a
+* syllable rate, noise is white; frames are 10 ms at 16 kHz.
+*
+*******************************************************************************/
+
+#include <stdbool.h>
+
+#include "audio_vad.h"
+#include "test_signal.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define FRAME_SAMPLES                       (160u)
+#define SAMPLE_RATE_HZ                      (16000.0)
+#define FRAMES_PER_SECOND                   (100u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+/* Level of the background noise and of the talker in one segment */
+typedef struct
+{
+    uint32_t frames;
+    double   noise_dbfs;
+    double   speech_dbfs;           /* 0 for no talker */
+} segment_t;
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static double tone_phase;
+
+/*******************************************************************************
+* Function Name: run_segment
+********************************************************************************
+* Summary:
+*  Feeds a segment to the detector and counts the frames reported as speech,
+*  in total and in the last second of the segment.
+*
+* Parameters:
+*  vad: Voice activity detector
+*  seg: Segment to feed
+*  last_second: Speech frames in the last second of the segment
+*
+* Return:
+*  uint32_t: Speech frames of the segment
+*
+*******************************************************************************/
+static uint32_t run_segment(audio_vad_t *vad, const segment_t *seg, uint32_t *last_second)
+{
+    int16_t frame[FRAME_SAMPLES];
+    uint32_t speech_frames = 0;
+
+    *last_second = 0;
+    for (uint32_t f = 0; f < seg->frames; f++)
+    {
+        /* Syllables of 200 ms with pauses of 100 ms */
+        bool voiced = (seg->speech_dbfs != 0.0) && ((f % 30u) < 20u);
+
+        for (uint32_t i = 0; i < FRAME_SAMPLES; i++)
+        {
+            double x = test_amplitude(seg->noise_dbfs) * test_gauss();
+            if (voiced)
+            {
+                x += test_amplitude(seg->speech_dbfs) * sqrt(2.0) * sin(tone_phase);
+            }
+            tone_phase += 2.0 * M_PI * 200.0 / SAMPLE_RATE_HZ;
+            frame[i] = test_saturate(x);
+        }
+
+        if (audio_vad_process(vad, frame, FRAME_SAMPLES))
+        {
+            speech_frames++;
+            if (f + FRAMES_PER_SECOND >= seg->frames)
+            {
+                (*last_second)++;
+            }
+        }
+    }
+    return speech_frames;
+}
+
+/*******************************************************************************
+* Function Name: test_noise_only
+********************************************************************************
+* Summary:
+*  Steady noise is never speech.
+*
+*******************************************************************************/
+static void test_noise_only(void)
+{
+    audio_vad_t vad;
+    segment_t noise = { 10u * FRAMES_PER_SECOND, -70.0, 0.0 };
+    uint32_t last;
+
+    audio_vad_init(&vad);
+    uint32_t speech = run_segment(&vad, &noise, &last);
+    TEST_CHECK(speech == 0u, "steady noise: %u speech frames", speech);
+}
+
+/*******************************************************************************
+* Function Name: test_speech_burst
+********************************************************************************
+* Summary:
+*  A talker 30 dB above the noise is detected and the detector returns to
+*  silence within the hangover once the talker stops.
+*
+*******************************************************************************/
+static void test_speech_burst(void)
+{
+    audio_vad_t vad;
+    segment_t noise = { 2u * FRAMES_PER_SECOND, -70.0, 0.0 };
+    segment_t talk = { 10u * FRAMES_PER_SECOND, -70.0, -40.0 };
+    uint32_t last;
+
+    audio_vad_init(&vad);
+    (void)run_segment(&vad, &noise, &last);
+    uint32_t speech = run_segment(&vad, &talk, &last);
+    TEST_CHECK(speech >= talk.frames * 9u / 10u, "talker: %u of %u frames speech", speech, talk.frames);
+
+    uint32_t after = run_segment(&vad, &noise, &last);
+    TEST_CHECK(last == 0u, "after the talker: %u speech frames in the last second", last);
+    TEST_CHECK(after <= AUDIO_VAD_HANGOVER_FRAMES, "after the talker: %u speech frames", after);
+}
+
+/*******************************************************************************
+* Function Name: test_noise_step
+********************************************************************************
+* Summary:
+*  A step of the background noise well above the high energy ratio first
+*  looks like speech, but the detector has to settle on the new floor and
+*  still detect a talker above it.
+*
+*******************************************************************************/
+static void test_noise_step(void)
+{
+    static const double steps_db[] = { 6.0, 12.0, 20.0, 30.0 };
+
+    for (uint32_t s = 0; s < sizeof(steps_db) / sizeof(steps_db[0]); s++)
+    {
+        audio_vad_t vad;
+        segment_t quiet = { 3u * FRAMES_PER_SECOND, -70.0, 0.0 };
+        segment_t loud = { 10u * FRAMES_PER_SECOND, -70.0 + steps_db[s], 0.0 };
+        segment_t talk = { 3u * FRAMES_PER_SECOND, loud.noise_dbfs, loud.noise_dbfs + 20.0 };
+        uint32_t last;
+
+        audio_vad_init(&vad);
+        (void)run_segment(&vad, &quiet, &last);
+        uint32_t speech = run_segment(&vad, &loud, &last);
+        printf("noise step %+.0f dB: %u of %u frames speech\n", steps_db[s], speech, loud.frames);
+        TEST_CHECK(last == 0u, "noise step %+.0f dB: still speech in the last second", steps_db[s]);
+        TEST_CHECK(speech <= 5u * FRAMES_PER_SECOND, "noise step %+.0f dB: %u speech frames",
+                   steps_db[s], speech);
+
+        speech = run_segment(&vad, &talk, &last);
+        TEST_CHECK(speech >= talk.frames * 9u / 10u, "talker after the step %+.0f dB: %u of %u frames",
+                   steps_db[s], speech, talk.frames);
+    }
+}
+
+/*******************************************************************************
+* Function Name: main
+********************************************************************************
+* Summary:
+*  Runs the tests of the detector.
+*
+* Return:
+*  int: 0 if all checks passed
+*
+*******************************************************************************/
+int main(void)
+{
+    test_noise_only();
+    test_speech_burst();
+    test_noise_step();
+
+    printf("%s\n", (test_failures == 0u) ? "PASS" : "FAIL");
+    return (test_failures == 0u) ? 0 : 1;
+}
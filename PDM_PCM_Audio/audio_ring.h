@@ -0,0 +1,136 @@
+/******************************************************************************
+* File Name:   audio_ring.h
+*
+* Description: This file contains a lock-free single-producer/single-consumer
+* ring of audio frame descriptors. The producer is the PDM/PCM interrupt, the
+* consumer is one task. 'head' is only written by the producer and 'tail' only
+* by the consumer; the release store of one index paired with the acquire
+* load of it on the other side orders the descriptor contents, so no critical
+* section is needed on either side.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_RING_H_
+#define AUDIO_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Number of descriptors in the ring. Must be a power of two. */
+#define AUDIO_RING_CAPACITY                 (8u)
+#define AUDIO_RING_INDEX_MASK               (AUDIO_RING_CAPACITY - 1u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+/* Descriptor of one filled audio frame */
+typedef struct
+{
+    int16_t  *samples;      /* Frame samples, owned by the consumer until popped */
+    uint32_t seq;           /* Frame sequence number */
+} audio_ring_desc_t;
+
+typedef struct
+{
+    audio_ring_desc_t slots[AUDIO_RING_CAPACITY];
+    _Atomic uint32_t  head;         /* Next slot to be written by the producer */
+    _Atomic uint32_t  tail;         /* Next slot to be read by the consumer */
+} audio_ring_t;
+
+/*******************************************************************************
+* Function Name: audio_ring_init
+********************************************************************************
+* Summary:
+*  Empties the ring. Must not run concurrently with the producer or consumer.
+*
+*******************************************************************************/
+static inline void audio_ring_init(audio_ring_t *ring)
+{
+    atomic_init(&ring->head, 0u);
+    atomic_init(&ring->tail, 0u);
+}
+
+/*******************************************************************************
+* Function Name: audio_ring_push
+********************************************************************************
+* Summary:
+*  Producer side. Copies the descriptor into the ring and publishes it.
+*
+* Return:
+*  bool: false if the ring is full and the descriptor was not published
+*
+*******************************************************************************/
+static inline bool audio_ring_push(audio_ring_t *ring, const audio_ring_desc_t *desc)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if ((head - tail) >= AUDIO_RING_CAPACITY)
+    {
+        return false;
+    }
+
+    ring->slots[head & AUDIO_RING_INDEX_MASK] = *desc;
+    atomic_store_explicit(&ring->head, head + 1u, memory_order_release);
+
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: audio_ring_peek
+********************************************************************************
+* Summary:
+*  Consumer side. Returns the oldest descriptor without removing it.
+*
+* Return:
+*  const audio_ring_desc_t*: Oldest descriptor, NULL if the ring is empty
+*
+*******************************************************************************/
+static inline const audio_ring_desc_t *audio_ring_peek(audio_ring_t *ring)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (head == tail)
+    {
+        return NULL;
+    }
+
+    return &ring->slots[tail & AUDIO_RING_INDEX_MASK];
+}
+
+/*******************************************************************************
+* Function Name: audio_ring_pop
+********************************************************************************
+* Summary:
+*  Consumer side. Removes the descriptor returned by audio_ring_peek and hands
+*  its slot back to the producer.
+*
+*******************************************************************************/
+static inline void audio_ring_pop(audio_ring_t *ring)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    atomic_store_explicit(&ring->tail, tail + 1u, memory_order_release);
+}
+
+/*******************************************************************************
+* Function Name: audio_ring_count
+********************************************************************************
+* Summary:
+*  Returns the number of published descriptors. Exact only when called from
+*  the producer or the consumer.
+*
+*******************************************************************************/
+static inline uint32_t audio_ring_count(audio_ring_t *ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_acquire) -
+           atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+#endif /* AUDIO_RING_H_ */
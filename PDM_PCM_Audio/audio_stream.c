@@ -0,0 +1,160 @@
+/******************************************************************************
+* File Name:   audio_stream.c
+*
+* Description: This file contains the frame management of the continuous
+* (ping-pong) PDM/PCM capture.
+*
+* The PDM/PCM block always writes into the buffer at 'dma_index'. When a frame
+* is complete its descriptor is pushed into the lock-free ring and the block
+* is re-armed on the next buffer. Buffers are used strictly in order, so with
+* one buffer more than ring slots the next buffer is never one the consumer
+* still holds. If the ring is full, the just filled frame is dropped and
+* re-used so that the capture never stops.
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "audio_stream.h"
+
+/*******************************************************************************
+* Function Name: audio_stream_init
+********************************************************************************
+* Summary:
+*  Initializes the capture stream. Must be called before the PDM/PCM block is
+*  started.
+*
+* Parameters:
+*  stream: Capture stream
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_stream_init(audio_stream_t *stream)
+{
+    memset(stream->buffer, 0, sizeof(stream->buffer));
+    audio_ring_init(&stream->filled);
+
+    stream->dma_index = 0;
+    stream->next_seq = 0;
+    stream->overruns = 0;
+}
+
+/*******************************************************************************
+* Function Name: audio_stream_start
+********************************************************************************
+* Summary:
+*  Returns the frame the first PDM/PCM async read has to be started on.
+*
+* Parameters:
+*  stream: Capture stream
+*
+* Return:
+*  int16_t*: Buffer of AUDIO_STREAM_MAX_FRAME_SAMPLES *
+*            AUDIO_STREAM_MAX_CHANNELS samples
+*
+*******************************************************************************/
+int16_t *audio_stream_start(audio_stream_t *stream)
+{
+    return stream->buffer[stream->dma_index];
+}
+
+/*******************************************************************************
+* Function Name: audio_stream_frame_done
+********************************************************************************
+* Summary:
+*  Publishes the frame that has just been filled by the PDM/PCM block and
+*  returns the frame the next async read has to be started on. Called from
+*  the PDM/PCM interrupt.
+*
+* Parameters:
+*  stream: Capture stream
+*  next_frame: Returns the buffer to capture into next, of
+*              AUDIO_STREAM_MAX_FRAME_SAMPLES * AUDIO_STREAM_MAX_CHANNELS
+*              samples
+*
+* Return:
+*  bool: true if the frame was published, false if it was dropped
+*
+*******************************************************************************/
+bool audio_stream_frame_done(audio_stream_t *stream, int16_t **next_frame)
+{
+    /* Every captured frame gets a sequence number, including the dropped
+     * ones, so that the consumer can detect the gap. */
+    audio_stream_frame_t desc =
+    {
+        .samples = stream->buffer[stream->dma_index],
+        .seq     = stream->next_seq++,
+    };
+
+    if (!audio_ring_push(&stream->filled, &desc))
+    {
+        stream->overruns++;
+        *next_frame = desc.samples;
+        return false;
+    }
+
+    stream->dma_index++;
+    if (stream->dma_index == AUDIO_STREAM_NUM_FRAMES)
+    {
+        stream->dma_index = 0;
+    }
+
+    *next_frame = stream->buffer[stream->dma_index];
+    return true;
+}
+
+/*******************************************************************************
+* Function Name: audio_stream_get_frame
+********************************************************************************
+* Summary:
+*  Returns the oldest filled frame without removing it from the stream.
+*
+* Parameters:
+*  stream: Capture stream
+*
+* Return:
+*  const audio_stream_frame_t*: Filled frame, NULL if none is available
+*
+*******************************************************************************/
+const audio_stream_frame_t *audio_stream_get_frame(audio_stream_t *stream)
+{
+    return audio_ring_peek(&stream->filled);
+}
+
+/*******************************************************************************
+* Function Name: audio_stream_release_frame
+********************************************************************************
+* Summary:
+*  Hands the frame returned by audio_stream_get_frame back to the producer.
+*
+* Parameters:
+*  stream: Capture stream
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+void audio_stream_release_frame(audio_stream_t *stream)
+{
+    audio_ring_pop(&stream->filled);
+}
+
+/*******************************************************************************
+* Function Name: audio_stream_overruns
+********************************************************************************
+* Summary:
+*  Returns the number of frames dropped because the consumer was too slow.
+*
+* Parameters:
+*  stream: Capture stream
+*
+* Return:
+*  uint32_t: Number of dropped frames
+*
+*******************************************************************************/
+uint32_t audio_stream_overruns(const audio_stream_t *stream)
+{
+    return stream->overruns;
+}
@@ -0,0 +1,81 @@
+/******************************************************************************
+* File Name:   audio_stream.h
+*
+* Description: This file contains the frame management of the continuous
+* (ping-pong) PDM/PCM capture. It has no dependency on the HAL or the RTOS so
+* that it can also be built on a host with a simulated PDM source.
+*
+*******************************************************************************/
+
+#ifndef AUDIO_STREAM_H_
+#define AUDIO_STREAM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "audio_ring.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Microphones: 1 captures the left one only, 2 captures both in stereo.
+ * Set in the Makefile of the application */
+#ifndef AUDIO_CAPTURE_CHANNELS
+#define AUDIO_CAPTURE_CHANNELS              (1u)
+#endif
+/* Highest capture sample rate of the application, 16000 or 48000 Hz. Set
+ * in the Makefile of the application */
+#ifndef AUDIO_CAPTURE_MAX_RATE_HZ
+#define AUDIO_CAPTURE_MAX_RATE_HZ           (16000u)
+#endif
+/* Highest capture sample rate and number of interleaved channels, the frame
+ * buffers are sized for them */
+#define AUDIO_STREAM_MAX_SAMPLE_RATE_HZ     AUDIO_CAPTURE_MAX_RATE_HZ
+#define AUDIO_STREAM_MAX_CHANNELS           AUDIO_CAPTURE_CHANNELS
+/* Length of one capture frame (one PDM/PCM async read) in milliseconds */
+#define AUDIO_STREAM_FRAME_MS               (10u)
+/* Number of 16-bit samples in one capture frame at a sample rate */
+#define AUDIO_STREAM_FRAME_SAMPLES_AT(rate_hz) (((rate_hz) * AUDIO_STREAM_FRAME_MS) / 1000u)
+/* Largest number of samples of one channel in one capture frame */
+#define AUDIO_STREAM_MAX_FRAME_SAMPLES      AUDIO_STREAM_FRAME_SAMPLES_AT(AUDIO_STREAM_MAX_SAMPLE_RATE_HZ)
+/* Number of frame buffers. One frame is always owned by the PDM/PCM block,
+ * the others can be held by the consumer through the descriptor ring. */
+#define AUDIO_STREAM_NUM_FRAMES             (AUDIO_RING_CAPACITY + 1u)
+
+_Static_assert((AUDIO_CAPTURE_CHANNELS == 1u) || (AUDIO_CAPTURE_CHANNELS == 2u),
+               "AUDIO_CAPTURE_CHANNELS must be 1 or 2");
+_Static_assert((AUDIO_CAPTURE_MAX_RATE_HZ == 16000u) || (AUDIO_CAPTURE_MAX_RATE_HZ == 48000u),
+               "AUDIO_CAPTURE_MAX_RATE_HZ must be 16000 or 48000");
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+/* Descriptor of one filled capture frame. 'samples' holds one frame at the
+ * capture sample rate, interleaved if the capture is stereo; 'seq' counts
+ * frames since audio_stream_init. */
+typedef audio_ring_desc_t audio_stream_frame_t;
+
+/* Capture stream. The producer side (audio_stream_start and
+ * audio_stream_frame_done) runs in the PDM/PCM interrupt, the consumer side
+ * (audio_stream_get_frame and audio_stream_release_frame) in a single task. */
+typedef struct
+{
+    int16_t buffer[AUDIO_STREAM_NUM_FRAMES][AUDIO_STREAM_MAX_FRAME_SAMPLES * AUDIO_STREAM_MAX_CHANNELS];
+    audio_ring_t filled;            /* Frames published to the consumer */
+
+    uint32_t dma_index;             /* Buffer owned by the PDM/PCM block */
+    uint32_t next_seq;
+    volatile uint32_t overruns;     /* Frames dropped because the ring was full */
+} audio_stream_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void audio_stream_init(audio_stream_t *stream);
+int16_t *audio_stream_start(audio_stream_t *stream);
+bool audio_stream_frame_done(audio_stream_t *stream, int16_t **next_frame);
+const audio_stream_frame_t *audio_stream_get_frame(audio_stream_t *stream);
+void audio_stream_release_frame(audio_stream_t *stream);
+uint32_t audio_stream_overruns(const audio_stream_t *stream);
+
+#endif /* AUDIO_STREAM_H_ */
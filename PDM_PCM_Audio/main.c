@@ -10,11 +10,21 @@
 #include "cy_wcm.h"
 #include "cy_wcm_error.h"
 
+/* 连续采集帧管理 */
+#include "audio_stream.h"
+
+/* 按钮消抖状态机 */
+#include "button_fsm.h"
+
 /*******************************************************************************
 * Macros
 ********************************************************************************/
 /* Define how many samples in a frame */
 #define PDM_PCM_BUFFER_SIZE                 (224000u) // 16000 * 2 * 7 (7 seconds)
+/* Number of capture frames in one recording */
+#define RECORD_NUM_FRAMES                   (PDM_PCM_BUFFER_SIZE / AUDIO_FRAME_BYTES)
+/* Audio discarded after the button press before the recording starts */
+#define RECORD_START_DELAY_MS               (1000u)
 
 /* WiFi 连接配置 */
 #define WIFI_SSID                             "spike"
@@ -33,6 +43,9 @@
 
 /* Desired sample rate. Typical values: 8/16/22.05/32/44.1/48kHz */
 #define SAMPLE_RATE_HZ                      16000u
+/* Samples and bytes of one capture frame at SAMPLE_RATE_HZ */
+#define AUDIO_FRAME_SAMPLES                 AUDIO_STREAM_FRAME_SAMPLES_AT(SAMPLE_RATE_HZ)
+#define AUDIO_FRAME_BYTES                   (AUDIO_FRAME_SAMPLES * sizeof(int16_t))
 /* Decimation Rate of the PDM/PCM block. Typical value is 64 */
 #define DECIMATION_RATE                     64u
 /* Audio Subsystem Clock. Typical values depends on the desire sample rate:
@@ -42,10 +55,8 @@
 /* PDM/PCM Pins */
 #define PDM_DATA                            P10_5
 #define PDM_CLK                             P10_4
-/* Switch press/release check interval in milliseconds for debouncing */
-#define SWITCH_DEBOUNCE_CHECK_UNIT          (1u)
-/* Number of debounce check units to count before considering that switch is pressed or released */
-#define SWITCH_DEBOUNCE_MAX_PERIOD_UNITS    (80u)
+/* Priority of the user button GPIO interrupt */
+#define BUTTON_IRQ_PRIORITY                 (7u)
 
 #define AMBIENT_TEMPERATURE_C               (20)
 #define SPI_BAUD_RATE_HZ                    (20000000)
@@ -56,14 +67,34 @@
 ********************************************************************************/
 void clock_init(void);
 void pdm_pcm_isr_handler(void *arg, cyhal_pdm_pcm_event_t event);
-static uint32_t read_switch_status(void);
+static void button_isr(void *arg, cyhal_gpio_event_t event);
+static uint32_t button_poll(void);
 cy_rslt_t send_audio_data_to_server(uint8_t *audio_data, uint32_t data_size);
 static cy_rslt_t connect_to_wifi_ap(void);
 
 /*******************************************************************************
 * Global Variables
 ********************************************************************************/
-volatile bool pdm_pcm_flag = false;
+/* Continuous capture ring filled by the PDM/PCM block */
+static audio_stream_t capture_stream;
+
+/* HTTP POST needs the whole recording as one body */
+static uint8_t audio_frame[PDM_PCM_BUFFER_SIZE];
+
+/* Milliseconds of audio captured since start, used as the time base of the
+ * button state machine */
+static volatile uint32_t capture_time_ms;
+
+/* User button debouncing */
+static button_fsm_t button_fsm;
+static volatile bool button_edge_pending;
+static volatile uint32_t button_edge_ms;
+
+cyhal_gpio_callback_data_t button_cb_data =
+{
+    .callback     = button_isr,
+    .callback_arg = NULL
+};
 
 /* HTTP 客户端变量 */
 cy_http_client_t http_client_handle;
@@ -87,10 +118,6 @@ const cyhal_pdm_pcm_cfg_t pdm_pcm_cfg =
 };
 
 
-/* Pointer to the new frame that need to be written */
-uint8_t *current_frame;
-
-
 
 /*******************************************************************************
 * Function Name: main
@@ -112,7 +139,10 @@ uint8_t *current_frame;
 int main(void)
 {
     cy_rslt_t result;
-    uint8_t  audio_frame[PDM_PCM_BUFFER_SIZE] = {0};
+    const audio_stream_frame_t *frame;
+    uint32_t skip_frames = 0;
+    uint32_t record_frames = 0;
+    bool recording = false;
 
     /* Initialize the device and board peripherals */
     result = cybsp_init() ;
@@ -142,12 +172,23 @@ int main(void)
     {
         CY_ASSERT(0);
     }
+
+    /* Debounce the button on its edges instead of polling it */
+    button_fsm_init(&button_fsm, 0);
+    button_edge_pending = true;
+    cyhal_gpio_register_callback(CYBSP_USER_BTN, &button_cb_data);
+    cyhal_gpio_enable_event(CYBSP_USER_BTN, CYHAL_GPIO_IRQ_BOTH, BUTTON_IRQ_PRIORITY, true);
+
     /* Initialize the PDM/PCM block */
+    audio_stream_init(&capture_stream);
     cyhal_pdm_pcm_init(&pdm_pcm, PDM_DATA, PDM_CLK, &audio_clock, &pdm_pcm_cfg);
     cyhal_pdm_pcm_register_callback(&pdm_pcm, pdm_pcm_isr_handler, NULL);
     cyhal_pdm_pcm_enable_event(&pdm_pcm, CYHAL_PDM_PCM_ASYNC_COMPLETE, CYHAL_ISR_PRIORITY_DEFAULT, true);
     cyhal_pdm_pcm_start(&pdm_pcm);
 
+    /* Start the continuous capture on the first frame of the ring */
+    cyhal_pdm_pcm_read_async(&pdm_pcm, audio_stream_start(&capture_stream), AUDIO_FRAME_SAMPLES);
+
     /* To avoid compiler warning */
     (void)result;
     
@@ -196,46 +237,56 @@ int main(void)
 
     for(;;)
     {
-        /* Check if any microphone has data to process */
-        if (pdm_pcm_flag)
+        /* Consume every frame captured since the last pass */
+        while ((frame = audio_stream_get_frame(&capture_stream)) != NULL)
         {
-        	//printf("\nWriting to UART...\n");
-            cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_ON);
-
-            /* Clear the PDM/PCM flag */
-            pdm_pcm_flag = 0;
-
-
-            printf("录音完成，正在发送数据到服务器...\r\n");
-            
-            /* 发送音频数据到服务器 */
-            result = send_audio_data_to_server(audio_frame, PDM_PCM_BUFFER_SIZE);
-            if (result != CY_RSLT_SUCCESS)
+            if (skip_frames > 0)
             {
-                printf("发送数据到服务器失败，错误码: %ld\r\n", result);
+                skip_frames--;
             }
-            else
+            else if (record_frames > 0)
             {
-                printf("数据发送成功！\r\n");
+                uint32_t offset = (RECORD_NUM_FRAMES - record_frames) * AUDIO_FRAME_BYTES;
+                memcpy(&audio_frame[offset], frame->samples, AUDIO_FRAME_BYTES);
+                record_frames--;
             }
-            
-            cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_OFF);
-            printf("按下按钮开始新的录音\r\n");
 
+            audio_stream_release_frame(&capture_stream);
+
+            if (recording && (skip_frames == 0) && (record_frames == 0))
+            {
+                recording = false;
+                printf("录音完成，正在发送数据到服务器...\r\n");
+
+                /* 发送音频数据到服务器 */
+                result = send_audio_data_to_server(audio_frame, PDM_PCM_BUFFER_SIZE);
+                if (result != CY_RSLT_SUCCESS)
+                {
+                    printf("发送数据到服务器失败，错误码: %ld\r\n", result);
+                }
+                else
+                {
+                    printf("数据发送成功！\r\n");
+                }
+
+                cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_OFF);
+                printf("按下按钮开始新的录音\r\n");
+            }
         }
-        if (0UL != read_switch_status())
-        {
-            //printf("Recording\n");
 
+        /* A recording starts when the button is pressed and released */
+        uint32_t button_events = button_poll();
+        if (!recording && (0UL != (button_events & BUTTON_EVT_RELEASE)))
+        {
             cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_ON);
-            cyhal_system_delay_ms(1000);
 
-            /* Read the next frame */
-            cyhal_pdm_pcm_read_async(&pdm_pcm, audio_frame, PDM_PCM_BUFFER_SIZE/2);
-            cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_OFF);
+            recording = true;
+            skip_frames = RECORD_START_DELAY_MS / AUDIO_STREAM_FRAME_MS;
+            record_frames = RECORD_NUM_FRAMES;
         }
 
-        cyhal_system_delay_ms(1);
+        /* Sleep until the next captured frame or button edge */
+        cyhal_syspm_sleep();
     }
 }
 
@@ -245,7 +296,62 @@ void pdm_pcm_isr_handler(void *arg, cyhal_pdm_pcm_event_t event)
     (void) arg;
     (void) event;
 
-    pdm_pcm_flag = true;
+    /* Publish the filled frame and re-arm on the next one */
+    int16_t *next_frame;
+    (void)audio_stream_frame_done(&capture_stream, &next_frame);
+
+    cyhal_pdm_pcm_read_async(&pdm_pcm, next_frame, AUDIO_FRAME_SAMPLES);
+
+    capture_time_ms += AUDIO_STREAM_FRAME_MS;
+}
+
+/*******************************************************************************
+* Function Name: button_isr
+********************************************************************************
+* Summary:
+*  User button edge interrupt. Time stamps the edge for button_poll.
+*
+*******************************************************************************/
+static void button_isr(void *arg, cyhal_gpio_event_t event)
+{
+    (void) arg;
+    (void) event;
+
+    button_edge_ms = capture_time_ms;
+    button_edge_pending = true;
+}
+
+/*******************************************************************************
+* Function Name: button_poll
+********************************************************************************
+* Summary:
+*  Feeds a pending edge and any expired debounce or long press timeout into
+*  the button state machine. Only reads the pin, never waits.
+*
+* Return:
+*  uint32_t: Combination of BUTTON_EVT_* generated since the last call
+*
+*******************************************************************************/
+static uint32_t button_poll(void)
+{
+    uint32_t events = 0;
+    bool pressed;
+
+    if (button_edge_pending)
+    {
+        button_edge_pending = false;
+        pressed = (cyhal_gpio_read(CYBSP_USER_BTN) == CYBSP_BTN_PRESSED);
+        events |= button_fsm_update(&button_fsm, pressed, button_edge_ms);
+    }
+
+    uint32_t now_ms = capture_time_ms;
+    if (button_fsm_next_timeout(&button_fsm, now_ms) == 0)
+    {
+        pressed = (cyhal_gpio_read(CYBSP_USER_BTN) == CYBSP_BTN_PRESSED);
+        events |= button_fsm_update(&button_fsm, pressed, now_ms);
+    }
+
+    return events;
 }
 
 void clock_init(void)
@@ -264,48 +370,6 @@ void clock_init(void)
     cyhal_clock_set_enabled(&audio_clock, true, true);
 }
 
-uint32_t read_switch_status(void)
-{
-    uint32_t delayCounter = 0;
-    uint32_t sw_status = 0;
-
-    /* Check if the switch is pressed */
-    while(0UL == cyhal_gpio_read(CYBSP_USER_BTN))
-    {
-        /* Switch is pressed. Proceed for debouncing. */
-        cyhal_system_delay_ms(SWITCH_DEBOUNCE_CHECK_UNIT);
-        ++delayCounter;
-
-        /* Keep checking the switch status till the switch is pressed for a
-         * minimum period of SWITCH_DEBOUNCE_CHECK_UNIT x SWITCH_DEBOUNCE_MAX_PERIOD_UNITS */
-        if (delayCounter > SWITCH_DEBOUNCE_MAX_PERIOD_UNITS)
-        {
-            /* Wait till the switch is released */
-            while(0UL == cyhal_gpio_read(CYBSP_USER_BTN))
-            {
-            }
-
-            /* Debounce when the switch is being released */
-            do
-            {
-                delayCounter = 0;
-
-                while(delayCounter < SWITCH_DEBOUNCE_MAX_PERIOD_UNITS)
-                {
-                    cyhal_system_delay_ms(SWITCH_DEBOUNCE_CHECK_UNIT);
-                    ++delayCounter;
-                }
-
-            }while(0UL == cyhal_gpio_read(CYBSP_USER_BTN));
-
-            /* Switch is pressed and released*/
-            sw_status = 1u;
-        }
-    }
-
-    return (sw_status);
-}
-
 /*******************************************************************************
 * Function Name: connect_to_wifi_ap
 ********************************************************************************
@@ -13,6 +13,8 @@
 
 /* RTOS header file. */
 #include "cyabs_rtos.h"
+#include <FreeRTOS.h>
+#include <task.h>
 
 /* Standard C header file. */
 #include <string.h>
@@ -21,19 +23,18 @@
 /* TCP client task header file. */
 #include "udp_client.h"
 #include "audio_task.h"
+#include "button.h"
 
 /*******************************************************************************
 * Function Prototypes
 ********************************************************************************/
 static void pdm_pcm_isr_handler(void *arg, cyhal_pdm_pcm_event_t event);
-static uint32_t read_switch_status(void);
 static void clock_init(void);
+static cy_rslt_t init_network(void);
 
 /*******************************************************************************
 * Global Variables
 ********************************************************************************/
-volatile bool pdm_pcm_flag = false;
-
 /* HAL Object */
 cyhal_pdm_pcm_t pdm_pcm;
 cyhal_clock_t   audio_clock;
@@ -50,17 +51,36 @@ const cyhal_pdm_pcm_cfg_t pdm_pcm_cfg =
     .right_gain      = 0U,   /* dB */
 };
 
-/* Pointer to the new frame that need to be written */
-uint8_t *current_frame;
+/* Continuous capture ring filled by the PDM/PCM block */
+static audio_stream_t capture_stream;
+
+/* Task notified by the PDM/PCM interrupt for every published frame */
+static TaskHandle_t capture_consumer = NULL;
+
+/* Debounced user button events */
+static QueueHandle_t button_event_q = NULL;
+
+/* Server address of the audio upload */
+static const cy_socket_sockaddr_t audio_server_addr =
+{
+    .ip_address.ip.v4 = UDP_SERVER_IP_ADDRESS,
+    .ip_address.version = CY_SOCKET_IP_VER_V4,
+    .port = UDP_SERVER_PORT
+};
 
-/* Audio buffer */
-uint8_t audio_frame[PDM_PCM_BUFFER_SIZE] = {0};
+/* Audio not yet sent because it does not fill a whole datagram */
+static uint8_t  upload_chunk[AUDIO_UPLOAD_CHUNK_SIZE];
+static uint32_t upload_chunk_len;
+static uint32_t upload_total_bytes;
 
 /*******************************************************************************
 * Function Name: audio_task
 ********************************************************************************
 * Summary:
-*  Task function that handles audio recording and sending to TCP server.
+*  Task function that handles audio recording and sending to UDP server.
+*  The PDM/PCM block captures continuously into capture_stream; while a
+*  recording is active each frame is forwarded to the UDP server as soon as
+*  it is filled, otherwise it is discarded.
 *
 * Parameters:
 *  void *arg : Task parameter defined during task creation (unused).
@@ -72,10 +92,19 @@ uint8_t audio_frame[PDM_PCM_BUFFER_SIZE] = {0};
 void audio_task(void *arg)
 {
     cy_rslt_t result;
-    
+    const audio_stream_frame_t *frame;
+    button_event_t button_event;
+    uint32_t skip_frames = 0;
+    uint32_t record_frames = 0;
+
     /* To avoid compiler warning */
     (void)arg;
 
+    capture_consumer = xTaskGetCurrentTaskHandle();
+
+    button_event_q = xQueueCreate(BUTTON_EVENT_QUEUE_LENGTH, sizeof(button_event_t));
+    button_subscribe(button_event_q);
+
     /* 初始化音频系统 */
     result = init_audio_system();
     if (result != CY_RSLT_SUCCESS)
@@ -84,49 +113,66 @@ void audio_task(void *arg)
         return;
     }
 
+    /* 初始化网络 */
+    result = init_network();
+    if (result != CY_RSLT_SUCCESS)
+    {
+        printf("网络初始化失败，错误码: %ld\r\n", result);
+        return;
+    }
+
     printf("音频任务已启动，按下按钮开始录音\r\n");
 
     for(;;)
     {
-        /* Check if any microphone has data to process */
-        if (pdm_pcm_flag)
-        {
-            cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_ON);
-
-            /* Clear the PDM/PCM flag */
-            pdm_pcm_flag = 0;
-
-            printf("录音完成，正在发送数据到UDP服务器...\r\n");
-            
-            /* 发送音频数据到服务器 */
-            result = send_audio_data_to_server(audio_frame, PDM_PCM_BUFFER_SIZE);
+        /* Sleep until the PDM/PCM interrupt publishes the next frame */
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(AUDIO_FRAME_WAIT_TIMEOUT_MS));
 
-            if (result != CY_RSLT_SUCCESS)
+        /* Consume every frame captured since the last pass */
+        while ((frame = audio_stream_get_frame(&capture_stream)) != NULL)
+        {
+            if (skip_frames > 0)
             {
-                printf("发送数据到服务器失败，错误码: %ld\r\n", result);
+                skip_frames--;
             }
-            else
+            else if (record_frames > 0)
             {
-                printf("数据发送成功！\r\n");
+                result = send_audio_data_to_server((const uint8_t *)frame->samples, AUDIO_FRAME_BYTES);
+                if (result != CY_RSLT_SUCCESS)
+                {
+                    printf("发送数据到服务器失败，错误码: %ld\r\n", result);
+                }
+
+                record_frames--;
+                if (record_frames == 0)
+                {
+                    audio_upload_end();
+                    cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_OFF);
+
+                    printf("录音完成，共发送 %lu 字节\r\n", upload_total_bytes);
+                    printf("按下按钮开始新的录音\r\n");
+                }
             }
-            
-            cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_OFF);
-            printf("按下按钮开始新的录音\r\n");
+
+            audio_stream_release_frame(&capture_stream);
         }
-        
-        if (0UL != read_switch_status())
+
+        /* A recording starts when the button is pressed and released */
+        while (xQueueReceive(button_event_q, &button_event, 0) == pdTRUE)
         {
-            printf("开始录音...\r\n");
+            if ((record_frames != 0) || (0UL == (button_event.events & BUTTON_EVT_RELEASE)))
+            {
+                continue;
+            }
 
+            printf("开始录音...\r\n");
             cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_ON);
-            cyhal_system_delay_ms(1000);
 
-            /* Read the next frame */
-            cyhal_pdm_pcm_read_async(&pdm_pcm, audio_frame, PDM_PCM_BUFFER_SIZE/2);
-            cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_OFF);
-        }
+            audio_upload_begin();
 
-        cyhal_system_delay_ms(1);
+            skip_frames = RECORD_START_DELAY_MS / AUDIO_STREAM_FRAME_MS;
+            record_frames = RECORD_NUM_FRAMES;
+        }
     }
 }
 
@@ -149,16 +195,6 @@ cy_rslt_t init_audio_system(void)
     
     /* Init the clocks */
     clock_init();
-
-    /* Initialize the User button */
-    result = cyhal_gpio_init(CYBSP_USER_BTN, CYHAL_GPIO_DIR_INPUT, CYHAL_GPIO_DRIVE_PULLUP, 1);
-
-    /* GPIO initialization failed. Return error */
-    if (result != CY_RSLT_SUCCESS)
-    {
-        printf("按钮初始化失败，错误码: %ld\r\n", result);
-        return result;
-    }
     
     /* Initialize the PDM/PCM block */
     result = cyhal_pdm_pcm_init(&pdm_pcm, PDM_DATA, PDM_CLK, &audio_clock, &pdm_pcm_cfg);
@@ -168,6 +204,8 @@ cy_rslt_t init_audio_system(void)
         return result;
     }
     
+    audio_stream_init(&capture_stream);
+
     cyhal_pdm_pcm_register_callback(&pdm_pcm, pdm_pcm_isr_handler, NULL);
     cyhal_pdm_pcm_enable_event(&pdm_pcm, CYHAL_PDM_PCM_ASYNC_COMPLETE, CYHAL_ISR_PRIORITY_DEFAULT, true);
     
@@ -177,6 +215,14 @@ cy_rslt_t init_audio_system(void)
         printf("PDM/PCM启动失败，错误码: %ld\r\n", result);
         return result;
     }
+
+    /* Start the continuous capture on the first frame of the ring */
+    result = cyhal_pdm_pcm_read_async(&pdm_pcm, audio_stream_start(&capture_stream), AUDIO_FRAME_SAMPLES);
+    if (result != CY_RSLT_SUCCESS)
+    {
+        printf("PDM/PCM读取失败，错误码: %ld\r\n", result);
+        return result;
+    }
     
     printf("音频系统初始化完成\r\n");
     return CY_RSLT_SUCCESS;
@@ -186,7 +232,8 @@ cy_rslt_t init_audio_system(void)
 * Function Name: pdm_pcm_isr_handler
 ********************************************************************************
 * Summary:
-*  PDM/PCM interrupt handler.
+*  PDM/PCM interrupt handler. Publishes the filled frame and re-arms the
+*  async read on the next frame of the capture ring.
 *
 * Parameters:
 *  void *arg: Pointer to the argument passed during initialization
@@ -201,7 +248,18 @@ static void pdm_pcm_isr_handler(void *arg, cyhal_pdm_pcm_event_t event)
     (void) arg;
     (void) event;
 
-    pdm_pcm_flag = true;
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    int16_t *next_frame;
+
+    bool published = audio_stream_frame_done(&capture_stream, &next_frame);
+
+    cyhal_pdm_pcm_read_async(&pdm_pcm, next_frame, AUDIO_FRAME_SAMPLES);
+
+    if (published && (capture_consumer != NULL))
+    {
+        vTaskNotifyGiveFromISR(capture_consumer, &higher_priority_task_woken);
+        portYIELD_FROM_ISR(higher_priority_task_woken);
+    }
 }
 
 /*******************************************************************************
@@ -234,65 +292,90 @@ static void clock_init(void)
 }
 
 /*******************************************************************************
-* Function Name: read_switch_status
+* Function Name: init_network
 ********************************************************************************
 * Summary:
-*  Reads the status of the user button with debouncing.
+*  Connects to the Wi-Fi AP and creates the UDP client socket once, before
+*  the first recording.
 *
 * Parameters:
 *  None
 *
 * Return:
-*  uint32_t: 1 if button is pressed and released, 0 otherwise
+*  cy_rslt_t: CY_RSLT_SUCCESS if the operation is successful, an error code otherwise
 *
 *******************************************************************************/
-static uint32_t read_switch_status(void)
+static cy_rslt_t init_network(void)
 {
-    uint32_t delayCounter = 0;
-    uint32_t sw_status = 0;
+    cy_rslt_t result;
 
-    /* Check if the switch is pressed */
-    while(0UL == cyhal_gpio_read(CYBSP_USER_BTN))
+    if(connect_to_wifi_ap() != CY_RSLT_SUCCESS )
     {
-        /* Switch is pressed. Proceed for debouncing. */
-        cyhal_system_delay_ms(SWITCH_DEBOUNCE_CHECK_UNIT);
-        ++delayCounter;
-
-        /* Keep checking the switch status till the switch is pressed for a
-         * minimum period of SWITCH_DEBOUNCE_CHECK_UNIT x SWITCH_DEBOUNCE_MAX_PERIOD_UNITS */
-        if (delayCounter > SWITCH_DEBOUNCE_MAX_PERIOD_UNITS)
-        {
-            /* Wait till the switch is released */
-            while(0UL == cyhal_gpio_read(CYBSP_USER_BTN))
-            {
-            }
+        printf("\n Failed to connect to Wi-FI AP.\n");
+        CY_ASSERT(0);
+    }
 
-            /* Debounce when the switch is being released */
-            do
-            {
-                delayCounter = 0;
+    /* Secure Sockets initialized */
+    result = cy_socket_init();
+    if (result != CY_RSLT_SUCCESS)
+    {
+        printf("Secure Sockets initialization failed!\n");
+        CY_ASSERT(0);
+    }
+    printf("Secure Sockets initialized\n");
 
-                while(delayCounter < SWITCH_DEBOUNCE_MAX_PERIOD_UNITS)
-                {
-                    cyhal_system_delay_ms(SWITCH_DEBOUNCE_CHECK_UNIT);
-                    ++delayCounter;
-                }
+    result = create_udp_client_socket();
+    if (result != CY_RSLT_SUCCESS)
+    {
+        printf("UDP Client Socket creation failed!\n");
+        CY_ASSERT(0);
+    }
 
-            }while(0UL == cyhal_gpio_read(CYBSP_USER_BTN));
+    return result;
+}
 
-            /* Switch is pressed and released*/
-            sw_status = 1u;
-        }
+/*******************************************************************************
+* Function Name: audio_upload_begin
+********************************************************************************
+* Summary:
+*  Starts a new audio upload.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  cy_rslt_t: CY_RSLT_SUCCESS if the operation is successful, an error code otherwise
+*
+*******************************************************************************/
+cy_rslt_t audio_upload_begin(void)
+{
+    /* 检查客户端套接字是否已创建 */
+    if (client_handle == NULL)
+    {
+        printf("错误：UDP客户端套接字未初始化\r\n");
+        return CY_RSLT_MODULE_SECURE_SOCKETS_NOT_INITIALIZED;
     }
 
-    return (sw_status);
+    upload_chunk_len = 0;
+    upload_total_bytes = 0;
+
+    printf("正在发送音频数据到服务器 %d.%d.%d.%d:%d...\r\n",
+           (uint8)(audio_server_addr.ip_address.ip.v4),
+           (uint8)(audio_server_addr.ip_address.ip.v4 >> 8),
+           (uint8)(audio_server_addr.ip_address.ip.v4 >> 16),
+           (uint8)(audio_server_addr.ip_address.ip.v4 >> 24),
+           audio_server_addr.port);
+
+    return CY_RSLT_SUCCESS;
 }
 
 /*******************************************************************************
 * Function Name: send_audio_data_to_server
 ********************************************************************************
 * Summary:
-*  Sends audio data to the UDP server.
+*  Sends audio data of the current upload to the UDP server. The data is
+*  collected into datagrams of AUDIO_UPLOAD_CHUNK_SIZE bytes; a partial
+*  datagram is kept until more data arrives or audio_upload_end is called.
 *
 * Parameters:
 *  audio_data: Pointer to the audio data buffer
@@ -302,94 +385,92 @@ static uint32_t read_switch_status(void)
 *  cy_rslt_t: CY_RSLT_SUCCESS if the operation is successful, an error code otherwise
 *
 *******************************************************************************/
-cy_rslt_t send_audio_data_to_server(uint8_t *audio_data, uint32_t data_size)
+cy_rslt_t send_audio_data_to_server(const uint8_t *audio_data, uint32_t data_size)
 {
     cy_rslt_t result;
-    
-    /* 设置目标服务器地址和端口 */
-    cy_socket_sockaddr_t server_addr = {
-        .ip_address.ip.v4 = UDP_SERVER_IP_ADDRESS,
-        .ip_address.version = CY_SOCKET_IP_VER_V4,
-        .port = UDP_SERVER_PORT
-    };
+    uint32_t bytes_sent = 0;
 
-    if(connect_to_wifi_ap() != CY_RSLT_SUCCESS )
+    /* 检查客户端套接字是否已创建 */
+    if (client_handle == NULL)
     {
-        printf("\n Failed to connect to Wi-FI AP.\n");
-        CY_ASSERT(0);
+        return CY_RSLT_MODULE_SECURE_SOCKETS_NOT_INITIALIZED;
     }
 
-    /* Secure Sockets initialized */
-    result = cy_socket_init();
-    if (result != CY_RSLT_SUCCESS)
+    while (data_size > 0)
     {
-        printf("Secure Sockets initialization failed!\n");
-        CY_ASSERT(0);
-    }
-    printf("Secure Sockets initialized\n");
+        uint32_t copy_size = AUDIO_UPLOAD_CHUNK_SIZE - upload_chunk_len;
+        if (copy_size > data_size)
+        {
+            copy_size = data_size;
+        }
 
-    result = create_udp_client_socket();
-    if (result != CY_RSLT_SUCCESS)
-    {
-        printf("UDP Client Socket creation failed!\n");
-        CY_ASSERT(0);
+        memcpy(&upload_chunk[upload_chunk_len], audio_data, copy_size);
+        upload_chunk_len += copy_size;
+        audio_data += copy_size;
+        data_size -= copy_size;
+
+        if (upload_chunk_len == AUDIO_UPLOAD_CHUNK_SIZE)
+        {
+            /* 使用UDP发送数据 */
+            result = cy_socket_sendto(client_handle, upload_chunk, upload_chunk_len,
+                                      CY_SOCKET_FLAGS_NONE, &audio_server_addr,
+                                      sizeof(cy_socket_sockaddr_t), &bytes_sent);
+            upload_chunk_len = 0;
+
+            if (result != CY_RSLT_SUCCESS)
+            {
+                printf("发送音频数据失败，已发送 %lu 字节\r\n", upload_total_bytes);
+                return result;
+            }
+
+            upload_total_bytes += bytes_sent;
+        }
     }
-    
-    /* 检查客户端套接字是否已创建 */
+
+    return CY_RSLT_SUCCESS;
+}
+
+/*******************************************************************************
+* Function Name: audio_upload_end
+********************************************************************************
+* Summary:
+*  Sends the remaining audio data of the current upload and the end flag.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  cy_rslt_t: CY_RSLT_SUCCESS if the operation is successful, an error code otherwise
+*
+*******************************************************************************/
+cy_rslt_t audio_upload_end(void)
+{
+    cy_rslt_t result;
+    uint32_t bytes_sent = 0;
+
     if (client_handle == NULL)
     {
-        printf("错误：UDP客户端套接字未初始化\r\n");
         return CY_RSLT_MODULE_SECURE_SOCKETS_NOT_INITIALIZED;
     }
-    
-    /* 发送音频数据到服务器 */
-    printf("正在发送 %lu 字节的音频数据到服务器 %d.%d.%d.%d:%d...\r\n", 
-           data_size,
-           (uint8)(server_addr.ip_address.ip.v4),
-           (uint8)(server_addr.ip_address.ip.v4 >> 8),
-           (uint8)(server_addr.ip_address.ip.v4 >> 16),
-           (uint8)(server_addr.ip_address.ip.v4 >> 24),
-           server_addr.port);
-    
-
-    /* 分块发送音频数据，每次发送1KB */
-    uint32_t bytes_sent = 0;
-    uint32_t total_bytes_sent = 0;
-    uint32_t chunk_size = 1024;
-    uint32_t remaining_bytes = data_size;
 
-    while (remaining_bytes > 0)
+    if (upload_chunk_len > 0)
     {
-        uint32_t current_chunk_size = (remaining_bytes < chunk_size) ? remaining_bytes : chunk_size;
-        
-        /* 使用UDP发送数据 */
-        result = cy_socket_sendto(client_handle, audio_data + total_bytes_sent, current_chunk_size, 
-                             CY_SOCKET_FLAGS_NONE, &server_addr,
-                             sizeof(cy_socket_sockaddr_t), &bytes_sent);
-        
-        if (result != CY_RSLT_SUCCESS)
+        result = cy_socket_sendto(client_handle, upload_chunk, upload_chunk_len,
+                                  CY_SOCKET_FLAGS_NONE, &audio_server_addr,
+                                  sizeof(cy_socket_sockaddr_t), &bytes_sent);
+        upload_chunk_len = 0;
+
+        if (result == CY_RSLT_SUCCESS)
         {
-            printf("发送音频数据失败，已发送 %lu 字节\r\n", total_bytes_sent);
-            return result;
+            upload_total_bytes += bytes_sent;
         }
-        
-        total_bytes_sent += bytes_sent;
-        remaining_bytes -= bytes_sent;
-        
-        /* 打印进度 */
-        // if (total_bytes_sent % (chunk_size * 10) == 0 || total_bytes_sent == data_size)
-        // {
-        //     printf("已发送 %lu / %lu 字节 (%.1f%%)\r\n", 
-        //            total_bytes_sent, data_size, 
-        //            ((float)total_bytes_sent / data_size) * 100);
-        // }
     }
 
     /* 发送结束标志位，以便server处理 */
     char* end_flag = "flag";
-    result = cy_socket_sendto(client_handle, end_flag, sizeof(end_flag), 
-                             CY_SOCKET_FLAGS_NONE, &server_addr,
+    result = cy_socket_sendto(client_handle, end_flag, sizeof(end_flag),
+                             CY_SOCKET_FLAGS_NONE, &audio_server_addr,
                              sizeof(cy_socket_sockaddr_t), &bytes_sent);
-    
-    return CY_RSLT_SUCCESS;
+
+    return result;
 }
@@ -12,14 +12,27 @@
 /* RTOS header file. */
 #include "cyabs_rtos.h"
 
+#include "audio_stream.h"
+
 /*******************************************************************************
 * Macros
 ********************************************************************************/
-/* Define how many samples in a frame */
-#define PDM_PCM_BUFFER_SIZE                 (224000u) // 16000 * 2 * 7 (7 seconds)
+/* Length of one recording in milliseconds */
+#define RECORD_DURATION_MS                  (7000u)
+/* Number of capture frames in one recording */
+#define RECORD_NUM_FRAMES                   (RECORD_DURATION_MS / AUDIO_STREAM_FRAME_MS)
+/* Audio discarded after the button press before the recording starts */
+#define RECORD_START_DELAY_MS               (1000u)
+/* Longest wait for a captured frame before the task re-checks the button events */
+#define AUDIO_FRAME_WAIT_TIMEOUT_MS         (2u * AUDIO_STREAM_FRAME_MS)
+/* Size of one UDP audio datagram in bytes */
+#define AUDIO_UPLOAD_CHUNK_SIZE             (1024u)
 
 /* Desired sample rate. Typical values: 8/16/22.05/32/44.1/48kHz */
 #define SAMPLE_RATE_HZ                      16000u
+/* Samples and bytes of one capture frame at SAMPLE_RATE_HZ */
+#define AUDIO_FRAME_SAMPLES                 AUDIO_STREAM_FRAME_SAMPLES_AT(SAMPLE_RATE_HZ)
+#define AUDIO_FRAME_BYTES                   (AUDIO_FRAME_SAMPLES * sizeof(int16_t))
 /* Decimation Rate of the PDM/PCM block. Typical value is 64 */
 #define DECIMATION_RATE                     64u
 /* Audio Subsystem Clock. Typical values depends on the desire sample rate:
@@ -29,10 +42,6 @@
 /* PDM/PCM Pins */
 #define PDM_DATA                            P10_5
 #define PDM_CLK                             P10_4
-/* Switch press/release check interval in milliseconds for debouncing */
-#define SWITCH_DEBOUNCE_CHECK_UNIT          (1u)
-/* Number of debounce check units to count before considering that switch is pressed or released */
-#define SWITCH_DEBOUNCE_MAX_PERIOD_UNITS    (80u)
 
 #define AMBIENT_TEMPERATURE_C               (20)
 #define SPI_BAUD_RATE_HZ                    (20000000)
@@ -45,7 +54,9 @@
 * Function Prototypes
 ********************************************************************************/
 void audio_task(void *arg);
-cy_rslt_t send_audio_data_to_server(uint8_t *audio_data, uint32_t data_size);
+cy_rslt_t audio_upload_begin(void);
+cy_rslt_t send_audio_data_to_server(const uint8_t *audio_data, uint32_t data_size);
+cy_rslt_t audio_upload_end(void);
 cy_rslt_t init_audio_system(void);
 
 #endif /* AUDIO_TASK_H_ */
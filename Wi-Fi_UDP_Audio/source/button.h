@@ -0,0 +1,48 @@
+/******************************************************************************
+* File Name:   button.h
+*
+* Description: This file contains the interrupt driven handling of the user
+* button. Edges are time stamped in the GPIO interrupt and debounced by
+* button_fsm in the RTOS timer task; accepted press, release and long press
+* events are posted to the subscribed queues.
+*
+*******************************************************************************/
+
+#ifndef BUTTON_H_
+#define BUTTON_H_
+
+#include "cyhal.h"
+
+#include "FreeRTOS.h"
+#include "queue.h"
+
+#include "button_fsm.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Maximum number of queues that can subscribe to button events */
+#define BUTTON_MAX_SUBSCRIBERS              (4u)
+/* Priority of the user button GPIO interrupt */
+#define BUTTON_IRQ_PRIORITY                 (7u)
+/* Queue length a subscriber should use for button_event_t */
+#define BUTTON_EVENT_QUEUE_LENGTH           (4u)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+/* Message posted to the subscribed queues */
+typedef struct
+{
+    uint32_t events;        /* Combination of BUTTON_EVT_* */
+    uint32_t time_ms;       /* Time of the update that generated the events */
+    uint32_t held_ms;       /* Press duration, valid with BUTTON_EVT_RELEASE */
+} button_event_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+cy_rslt_t button_init(void);
+bool button_subscribe(QueueHandle_t queue);
+
+#endif /* BUTTON_H_ */
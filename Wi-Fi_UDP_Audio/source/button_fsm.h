@@ -0,0 +1,61 @@
+/******************************************************************************
+* File Name:   button_fsm.h
+*
+* Description: This file contains the debounce state machine of the user
+* button. It is fed with the raw pin level and a millisecond timestamp on
+* every edge and on every timer expiry, and has no dependency on the HAL or
+* the RTOS.
+*
+*******************************************************************************/
+
+#ifndef BUTTON_FSM_H_
+#define BUTTON_FSM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Time the level has to be stable before a press or release is accepted */
+#define BUTTON_DEBOUNCE_MS                  (80u)
+/* Time the button has to be held for a long press */
+#define BUTTON_LONG_PRESS_MS                (1000u)
+
+/* Returned by button_fsm_next_timeout when no timer is needed */
+#define BUTTON_FSM_NO_TIMEOUT               (UINT32_MAX)
+
+/* Events returned by button_fsm_update, may be combined */
+#define BUTTON_EVT_PRESS                    (1u << 0)
+#define BUTTON_EVT_RELEASE                  (1u << 1)
+#define BUTTON_EVT_LONG_PRESS               (1u << 2)
+
+/*******************************************************************************
+* Data structure and enumeration
+********************************************************************************/
+typedef enum
+{
+    BUTTON_STATE_RELEASED,
+    BUTTON_STATE_PRESS_DEBOUNCE,
+    BUTTON_STATE_PRESSED,
+    BUTTON_STATE_LONG_PRESSED,
+    BUTTON_STATE_RELEASE_DEBOUNCE,
+} button_state_t;
+
+typedef struct
+{
+    button_state_t state;
+    bool     raw_pressed;           /* Last level seen */
+    uint32_t last_edge_ms;          /* Time of the last level change */
+    uint32_t press_ms;              /* Time the accepted press started */
+    uint32_t held_ms;               /* Duration of the last completed press */
+} button_fsm_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void button_fsm_init(button_fsm_t *fsm, uint32_t now_ms);
+uint32_t button_fsm_update(button_fsm_t *fsm, bool pressed, uint32_t now_ms);
+uint32_t button_fsm_next_timeout(const button_fsm_t *fsm, uint32_t now_ms);
+
+#endif /* BUTTON_FSM_H_ */
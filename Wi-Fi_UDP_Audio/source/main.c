@@ -54,6 +54,7 @@
 #include "udp_client.h"
 
 #include "audio_task.h"
+#include "button.h"
 
 /* Include serial flash library and QSPI memory configurations only for the
  * kits that require the Wi-Fi firmware to be loaded in external QSPI NOR flash.
@@ -131,6 +132,13 @@ int main(void)
     // xTaskCreate(udp_client_task, "Network task", UDP_CLIENT_TASK_STACK_SIZE, NULL,
     //             UDP_CLIENT_TASK_PRIORITY, &client_task_handle);
     
+    /* Debounce the user button on its edges */
+    result = button_init();
+    if (result != CY_RSLT_SUCCESS)
+    {
+        CY_ASSERT(0);
+    }
+
     /* 创建音频任务 */
     TaskHandle_t audio_task_handle;
     xTaskCreate(audio_task, "Audio task", AUDIO_TASK_STACK_SIZE, NULL,